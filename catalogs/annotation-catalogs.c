@@ -0,0 +1,210 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "os-features.h"
+#include "annotation-catalogs.h"
+#include "openngc.h"
+#include "brightstars.h"
+#include "constellations.h"
+#include "hd.h"
+#include "kdtree.h"
+#include "permutedsort.h"
+#include "ioutils.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "log.h"
+#include "errors.h"
+
+// Guards building the indices (and the HD list); searches of a built
+// index don't take it.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static kdtree_t* ngc_kd = NULL;
+static kdtree_t* bright_kd = NULL;
+
+// Constellation bounding circles: center xyz and chord-distance radius.
+static int con_n = 0;
+static double* con_xyz = NULL;
+static double* con_rad = NULL;
+
+static pl* hd_cats = NULL;
+
+static kdtree_t* build_tree(double* xyz, int N) {
+    kdtree_t* kd = kdtree_build(NULL, xyz, N, 3, 8, KDTT_DOUBLE,
+                                KD_BUILD_BBOX);
+    if (!kd) {
+        ERROR("Failed to build annotation catalog kd-tree");
+        free(xyz);
+        return NULL;
+    }
+    kd->free_data = TRUE;
+    return kd;
+}
+
+static kdtree_t* get_ngc_tree(void) {
+    pthread_mutex_lock(&lock);
+    if (!ngc_kd) {
+        int i, N = ngc_num_entries();
+        double* xyz = malloc(MAX(N, 1) * 3 * sizeof(double));
+        for (i=0; i<N; i++) {
+            ngc_entry* ngc = ngc_get_entry(i);
+            if (!ngc)
+                break;
+            radecdeg2xyzarr(ngc->ra, ngc->dec, xyz + 3*i);
+        }
+        ngc_kd = build_tree(xyz, i);
+        logverb("Indexed %i NGC/IC objects\n", i);
+    }
+    pthread_mutex_unlock(&lock);
+    return ngc_kd;
+}
+
+static kdtree_t* get_bright_tree(void) {
+    pthread_mutex_lock(&lock);
+    if (!bright_kd) {
+        int i, N = bright_stars_n();
+        double* xyz = malloc(MAX(N, 1) * 3 * sizeof(double));
+        for (i=0; i<N; i++) {
+            const brightstar_t* bs = bright_stars_get(i);
+            radecdeg2xyzarr(bs->ra, bs->dec, xyz + 3*i);
+        }
+        bright_kd = build_tree(xyz, N);
+    }
+    pthread_mutex_unlock(&lock);
+    return bright_kd;
+}
+
+static void build_constellations(void) {
+    int i, j, k, N;
+    N = constellations_n();
+    con_xyz = calloc(N * 3, sizeof(double));
+    con_rad = calloc(N, sizeof(double));
+    for (i=0; i<N; i++) {
+        il* stars = constellations_get_unique_stars(i);
+        double* xyzc = con_xyz + 3*i;
+        double maxr2 = 0;
+        double ra, dec, xyz[3];
+        for (j=0; j<il_size(stars); j++) {
+            constellations_get_star_radec(il_get(stars, j), &ra, &dec);
+            radecdeg2xyzarr(ra, dec, xyz);
+            for (k=0; k<3; k++)
+                xyzc[k] += xyz[k];
+        }
+        normalize_3(xyzc);
+        for (j=0; j<il_size(stars); j++) {
+            constellations_get_star_radec(il_get(stars, j), &ra, &dec);
+            radecdeg2xyzarr(ra, dec, xyz);
+            maxr2 = MAX(maxr2, distsq(xyzc, xyz, 3));
+        }
+        con_rad[i] = sqrt(maxr2);
+        il_free(stars);
+    }
+    con_n = N;
+}
+
+static int search_tree(const kdtree_t* kd, double ra, double dec,
+                       double radius, il* inds) {
+    kdtree_qres_t* q;
+    double xyz[3];
+    int i, N;
+    if (!kd)
+        return 0;
+    radecdeg2xyzarr(ra, dec, xyz);
+    // (deg2dist() isn't monotonic past 180 degrees)
+    q = kdtree_rangesearch_nosort(kd, xyz,
+                                  deg2distsq(MIN(radius, 180.0)));
+    if (!q)
+        return 0;
+    N = q->nres;
+    qsort(q->inds, N, sizeof(int), compare_ints_asc);
+    for (i=0; i<N; i++)
+        il_append(inds, q->inds[i]);
+    kdtree_free_query(q);
+    return N;
+}
+
+int annotation_catalogs_ngc(double ra, double dec, double radius, il* inds) {
+    return search_tree(get_ngc_tree(), ra, dec, radius, inds);
+}
+
+int annotation_catalogs_bright_stars(double ra, double dec, double radius,
+                                     il* inds) {
+    return search_tree(get_bright_tree(), ra, dec, radius, inds);
+}
+
+static void get_constellations(void) {
+    pthread_mutex_lock(&lock);
+    if (!con_n)
+        build_constellations();
+    pthread_mutex_unlock(&lock);
+}
+
+int annotation_catalogs_constellations(double ra, double dec, double radius,
+                                       il* inds) {
+    double xyz[3];
+    double r;
+    int i, n = 0;
+    get_constellations();
+    radecdeg2xyzarr(ra, dec, xyz);
+    r = deg2dist(MIN(radius, 180.0));
+    for (i=0; i<con_n; i++) {
+        if (distsq(xyz, con_xyz + 3*i, 3) > square(con_rad[i] + r))
+            continue;
+        il_append(inds, i);
+        n++;
+    }
+    return n;
+}
+
+void annotation_catalogs_constellation_center(int con, double* ra,
+                                              double* dec) {
+    get_constellations();
+    xyzarr2radecdeg(con_xyz + 3*con, ra, dec);
+}
+
+hd_catalog_t* annotation_catalogs_hd(const char* fn) {
+    hd_catalog_t* hd = NULL;
+    size_t i;
+    pthread_mutex_lock(&lock);
+    if (!hd_cats)
+        hd_cats = pl_new(4);
+    for (i=0; i<pl_size(hd_cats); i++) {
+        hd_catalog_t* h = pl_get(hd_cats, i);
+        if (streq(h->fn, fn)) {
+            hd = h;
+            break;
+        }
+    }
+    if (!hd) {
+        hd = henry_draper_open(fn);
+        if (hd)
+            pl_append(hd_cats, hd);
+    }
+    pthread_mutex_unlock(&lock);
+    return hd;
+}
+
+void annotation_catalogs_free(void) {
+    size_t i;
+    kdtree_free(ngc_kd);
+    ngc_kd = NULL;
+    kdtree_free(bright_kd);
+    bright_kd = NULL;
+    con_n = 0;
+    free(con_xyz);
+    con_xyz = NULL;
+    free(con_rad);
+    con_rad = NULL;
+    if (hd_cats) {
+        for (i=0; i<pl_size(hd_cats); i++)
+            henry_draper_close(pl_get(hd_cats, i));
+        pl_free(hd_cats);
+        hd_cats = NULL;
+    }
+}
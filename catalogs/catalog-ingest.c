@@ -0,0 +1,473 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "os-features.h"
+#include "catalog-ingest.h"
+#include "bl.h"
+#include "ioutils.h"
+#include "mathutil.h"
+#include "errors.h"
+#include "log.h"
+
+// A run of entries for one healpix, from one input file, in a shard file.
+struct chunk {
+    int hp;
+    int filenum;
+    int worker;
+    off_t offset;
+    int64_t n;
+};
+
+struct ingest_state {
+    catalog_ingest_t* ci;
+    char** infns;
+    int ninfns;
+    int nworkers;
+    catalog_ingest_worker_t* workers;
+    int nextfile;
+    int failed;
+    // entries read from each input file, or -1 until it's done; files
+    // before "nreported" have been logged.
+    int64_t* nread;
+    int nreported;
+    // (the fitstable and qfits header code isn't thread-safe)
+    pthread_mutex_t lock;
+
+    // single-threaded mode: the output tables.
+    fitstable_t** outputs;
+
+    // merge phase: chunks sorted by healpix; those of healpix "hp" are
+    // chunks[hpstart[hp]] to chunks[hpstart[hp+1]-1].
+    struct chunk* chunks;
+    size_t* hpstart;
+    int nexthp;
+};
+
+struct catalog_ingest_worker {
+    struct ingest_state* st;
+    int index;
+    int filenum;
+    int64_t nwritten;
+
+    // shard mode: per-healpix entry buffers.
+    char** bufs;
+    size_t* nbuf;
+    size_t* cap;
+    size_t total;
+    size_t budget;
+    char* shardfn;
+    FILE* shard;
+    off_t shardsize;
+    bl* chunks;
+};
+
+void catalog_ingest_init(catalog_ingest_t* ci) {
+    memset(ci, 0, sizeof(catalog_ingest_t));
+    ci->nthreads = 1;
+    ci->tempdir = "/tmp";
+    ci->membudget = (size_t)256 * 1024 * 1024;
+}
+
+static void set_failed(struct ingest_state* st) {
+    pthread_mutex_lock(&st->lock);
+    st->failed = 1;
+    pthread_mutex_unlock(&st->lock);
+}
+
+static fitstable_t* open_output(struct ingest_state* st, int hp) {
+    catalog_ingest_t* ci = st->ci;
+    fitstable_t* tab;
+    char fn[1024];
+    snprintf(fn, sizeof(fn), ci->outfn, hp);
+    pthread_mutex_lock(&st->lock);
+    tab = ci->open_output(fn, hp, ci->token);
+    pthread_mutex_unlock(&st->lock);
+    if (!tab)
+        ERROR("Failed to open output file \"%s\" for healpix %i", fn, hp);
+    return tab;
+}
+
+static int close_output(struct ingest_state* st, fitstable_t* tab, int hp) {
+    catalog_ingest_t* ci = st->ci;
+    int rtn;
+    pthread_mutex_lock(&st->lock);
+    rtn = ci->close_output(tab, ci->token);
+    pthread_mutex_unlock(&st->lock);
+    if (rtn)
+        ERROR("Failed to close output file for healpix %i", hp);
+    return rtn;
+}
+
+static int shard_flush(catalog_ingest_worker_t* w) {
+    catalog_ingest_t* ci = w->st->ci;
+    int hp;
+    for (hp=0; hp<ci->nhp; hp++) {
+        struct chunk c;
+        if (!w->nbuf[hp])
+            continue;
+        if (fwrite(w->bufs[hp], 1, w->nbuf[hp], w->shard) != w->nbuf[hp]) {
+            SYSERROR("Failed to write shard file \"%s\"", w->shardfn);
+            return -1;
+        }
+        c.hp = hp;
+        c.filenum = w->filenum;
+        c.worker = w->index;
+        c.offset = w->shardsize;
+        c.n = w->nbuf[hp] / ci->entrysize;
+        bl_append(w->chunks, &c);
+        w->shardsize += w->nbuf[hp];
+        free(w->bufs[hp]);
+        w->bufs[hp] = NULL;
+        w->nbuf[hp] = w->cap[hp] = 0;
+    }
+    w->total = 0;
+    return 0;
+}
+
+int catalog_ingest_write(catalog_ingest_worker_t* w, int hp,
+                         const void* entry) {
+    struct ingest_state* st = w->st;
+    catalog_ingest_t* ci = st->ci;
+
+    if (hp < 0 || hp >= ci->nhp) {
+        ERROR("Healpix %i out of range [0, %i)", hp, ci->nhp);
+        return -1;
+    }
+    w->nwritten++;
+    if (!w->bufs) {
+        if (!st->outputs[hp]) {
+            st->outputs[hp] = open_output(st, hp);
+            if (!st->outputs[hp])
+                return -1;
+        }
+        return ci->write_entry(st->outputs[hp], entry, ci->token);
+    }
+    if (w->nbuf[hp] + ci->entrysize > w->cap[hp]) {
+        size_t newcap = MAX(w->cap[hp] * 2, 64 * (size_t)ci->entrysize);
+        char* newbuf = realloc(w->bufs[hp], newcap);
+        if (!newbuf) {
+            SYSERROR("Failed to grow healpix %i entry buffer", hp);
+            return -1;
+        }
+        w->total += newcap - w->cap[hp];
+        w->bufs[hp] = newbuf;
+        w->cap[hp] = newcap;
+    }
+    memcpy(w->bufs[hp] + w->nbuf[hp], entry, ci->entrysize);
+    w->nbuf[hp] += ci->entrysize;
+    if (w->total > w->budget)
+        return shard_flush(w);
+    return 0;
+}
+
+// Logs the files that have been read, in order.  Only the main thread
+// calls this, so the messages don't interleave.
+static void report_progress(struct ingest_state* st) {
+    pthread_mutex_lock(&st->lock);
+    while (st->nreported < st->ninfns && st->nread[st->nreported] >= 0) {
+        logmsg("Read file %i of %i: %s (%lld entries)\n", st->nreported + 1,
+               st->ninfns, st->infns[st->nreported],
+               (long long)st->nread[st->nreported]);
+        st->nreported++;
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void* worker_thread(void* v) {
+    catalog_ingest_worker_t* w = v;
+    struct ingest_state* st = w->st;
+    catalog_ingest_t* ci = st->ci;
+    for (;;) {
+        int f, failed;
+        int64_t n0 = w->nwritten;
+        pthread_mutex_lock(&st->lock);
+        f = st->nextfile++;
+        failed = st->failed;
+        pthread_mutex_unlock(&st->lock);
+        if (failed || f >= st->ninfns)
+            break;
+        w->filenum = f;
+        // Flush after each file so that every chunk holds entries
+        // from a single input file.
+        if (ci->read_file(w, st->infns[f], f, ci->token) ||
+            (w->bufs && shard_flush(w))) {
+            ERROR("Failed to convert input file \"%s\"", st->infns[f]);
+            set_failed(st);
+            break;
+        }
+        pthread_mutex_lock(&st->lock);
+        st->nread[f] = w->nwritten - n0;
+        pthread_mutex_unlock(&st->lock);
+        if (w->index == 0)
+            report_progress(st);
+    }
+    return NULL;
+}
+
+static int run_threads(void* (*func)(void*), void* args, size_t argsize,
+                       int nthreads) {
+    pthread_t* threads = malloc(nthreads * sizeof(pthread_t));
+    int i, nstarted = 0;
+    if (!threads) {
+        SYSERROR("Failed to allocate threads");
+        return -1;
+    }
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + nstarted, NULL, func,
+                           (char*)args + i * argsize)) {
+            SYSERROR("Failed to start worker thread");
+            break;
+        }
+        nstarted++;
+    }
+    // If some threads didn't start, the others pick up their work.
+    func(args);
+    for (i=0; i<nstarted; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    return 0;
+}
+
+static int compare_chunks(const void* v1, const void* v2) {
+    const struct chunk* c1 = v1;
+    const struct chunk* c2 = v2;
+    if (c1->hp != c2->hp)
+        return (c1->hp < c2->hp) ? -1 : 1;
+    if (c1->filenum != c2->filenum)
+        return (c1->filenum < c2->filenum) ? -1 : 1;
+    // (each file is read by one worker, so its chunks are in one shard)
+    if (c1->offset != c2->offset)
+        return (c1->offset < c2->offset) ? -1 : 1;
+    return 0;
+}
+
+static int merge_healpix(struct ingest_state* st, int hp, FILE** fids,
+                         char* buf, size_t bufsize) {
+    catalog_ingest_t* ci = st->ci;
+    fitstable_t* out;
+    size_t bufentries = MAX(1, bufsize / ci->entrysize);
+    size_t k;
+    int rtn = -1;
+
+    out = open_output(st, hp);
+    if (!out)
+        return -1;
+    for (k=st->hpstart[hp]; k<st->hpstart[hp+1]; k++) {
+        struct chunk* c = st->chunks + k;
+        catalog_ingest_worker_t* w = st->workers + c->worker;
+        int64_t i;
+        if (!fids[c->worker]) {
+            fids[c->worker] = fopen(w->shardfn, "rb");
+            if (!fids[c->worker]) {
+                SYSERROR("Failed to open shard file \"%s\"", w->shardfn);
+                goto bailout;
+            }
+        }
+        if (fseeko(fids[c->worker], c->offset, SEEK_SET)) {
+            SYSERROR("Failed to seek in shard file \"%s\"", w->shardfn);
+            goto bailout;
+        }
+        for (i=0; i<c->n;) {
+            size_t j, n = MIN(bufentries, (size_t)(c->n - i));
+            if (fread(buf, ci->entrysize, n, fids[c->worker]) != n) {
+                SYSERROR("Failed to read shard file \"%s\"", w->shardfn);
+                goto bailout;
+            }
+            for (j=0; j<n; j++)
+                if (ci->write_entry(out, buf + j * ci->entrysize, ci->token)) {
+                    ERROR("Failed to write an entry to healpix %i", hp);
+                    goto bailout;
+                }
+            i += n;
+        }
+    }
+    rtn = 0;
+ bailout:
+    if (close_output(st, out, hp))
+        rtn = -1;
+    return rtn;
+}
+
+static void* merge_thread(void* v) {
+    catalog_ingest_worker_t* w = v;
+    struct ingest_state* st = w->st;
+    FILE** fids = calloc(st->nworkers, sizeof(FILE*));
+    char* buf = malloc(w->budget);
+    int i;
+    if (!fids || !buf) {
+        SYSERROR("Failed to allocate merge buffer");
+        set_failed(st);
+        goto bailout;
+    }
+    for (;;) {
+        int hp, failed;
+        pthread_mutex_lock(&st->lock);
+        hp = st->nexthp++;
+        failed = st->failed;
+        pthread_mutex_unlock(&st->lock);
+        if (failed || hp >= st->ci->nhp)
+            break;
+        if (st->hpstart[hp] == st->hpstart[hp+1])
+            continue;
+        if (merge_healpix(st, hp, fids, buf, w->budget)) {
+            set_failed(st);
+            break;
+        }
+    }
+ bailout:
+    if (fids)
+        for (i=0; i<st->nworkers; i++)
+            if (fids[i])
+                fclose(fids[i]);
+    free(fids);
+    free(buf);
+    return NULL;
+}
+
+// Collects the workers' chunk lists and writes the outputs.
+static int merge_shards(struct ingest_state* st) {
+    catalog_ingest_t* ci = st->ci;
+    size_t nchunks = 0;
+    size_t k;
+    int i, hp;
+
+    for (i=0; i<st->nworkers; i++)
+        nchunks += bl_size(st->workers[i].chunks);
+    st->chunks = malloc(MAX(1, nchunks) * sizeof(struct chunk));
+    st->hpstart = calloc(ci->nhp + 1, sizeof(size_t));
+    if (!st->chunks || !st->hpstart) {
+        SYSERROR("Failed to allocate %zu chunks", nchunks);
+        return -1;
+    }
+    k = 0;
+    for (i=0; i<st->nworkers; i++) {
+        bl_copy(st->workers[i].chunks, 0, bl_size(st->workers[i].chunks),
+                st->chunks + k);
+        k += bl_size(st->workers[i].chunks);
+    }
+    qsort(st->chunks, nchunks, sizeof(struct chunk), compare_chunks);
+    for (k=0; k<nchunks; k++)
+        st->hpstart[st->chunks[k].hp + 1]++;
+    for (hp=0; hp<ci->nhp; hp++)
+        st->hpstart[hp+1] += st->hpstart[hp];
+
+    logverb("Merging %zu chunks from %i shards\n", nchunks, st->nworkers);
+    st->nexthp = 0;
+    if (run_threads(merge_thread, st->workers, sizeof(catalog_ingest_worker_t),
+                    st->nworkers))
+        return -1;
+    return st->failed ? -1 : 0;
+}
+
+int catalog_ingest_run(catalog_ingest_t* ci, char** infns, int ninfns) {
+    struct ingest_state st;
+    int i, hp;
+    int rtn = -1;
+
+    memset(&st, 0, sizeof(st));
+    st.ci = ci;
+    st.infns = infns;
+    st.ninfns = ninfns;
+    st.nworkers = MAX(1, MIN(ci->nthreads, ninfns));
+    pthread_mutex_init(&st.lock, NULL);
+    st.workers = calloc(st.nworkers, sizeof(catalog_ingest_worker_t));
+    st.nread = malloc(MAX(1, ninfns) * sizeof(int64_t));
+    if (!st.workers || !st.nread) {
+        SYSERROR("Failed to allocate workers");
+        goto bailout;
+    }
+    for (i=0; i<ninfns; i++)
+        st.nread[i] = -1;
+    ci->nwritten = 0;
+
+    if (st.nworkers == 1) {
+        st.outputs = calloc(ci->nhp, sizeof(fitstable_t*));
+        if (!st.outputs) {
+            SYSERROR("Failed to allocate output tables");
+            goto bailout;
+        }
+        st.workers[0].st = &st;
+        worker_thread(st.workers);
+        for (hp=0; hp<ci->nhp; hp++)
+            if (st.outputs[hp] && close_output(&st, st.outputs[hp], hp))
+                st.failed = 1;
+        ci->nwritten = st.workers[0].nwritten;
+        rtn = st.failed ? -1 : 0;
+        goto bailout;
+    }
+
+    logmsg("Reading %i files with %i threads\n", ninfns, st.nworkers);
+    for (i=0; i<st.nworkers; i++) {
+        catalog_ingest_worker_t* w = st.workers + i;
+        w->st = &st;
+        w->index = i;
+        w->budget = MAX(1, ci->membudget / st.nworkers);
+        w->bufs = calloc(ci->nhp, sizeof(char*));
+        w->nbuf = calloc(ci->nhp, sizeof(size_t));
+        w->cap = calloc(ci->nhp, sizeof(size_t));
+        w->chunks = bl_new(1024, sizeof(struct chunk));
+        if (!w->bufs || !w->nbuf || !w->cap) {
+            SYSERROR("Failed to allocate entry buffers");
+            goto bailout;
+        }
+        w->shardfn = create_temp_file("ingest", ci->tempdir);
+        w->shard = fopen(w->shardfn, "wb");
+        if (!w->shard) {
+            SYSERROR("Failed to open shard file \"%s\"", w->shardfn);
+            goto bailout;
+        }
+    }
+    if (run_threads(worker_thread, st.workers, sizeof(catalog_ingest_worker_t),
+                    st.nworkers))
+        goto bailout;
+    report_progress(&st);
+    for (i=0; i<st.nworkers; i++) {
+        catalog_ingest_worker_t* w = st.workers + i;
+        ci->nwritten += w->nwritten;
+        if (fclose(w->shard)) {
+            SYSERROR("Failed to close shard file \"%s\"", w->shardfn);
+            st.failed = 1;
+        }
+        w->shard = NULL;
+    }
+    if (st.failed)
+        goto bailout;
+    rtn = merge_shards(&st);
+
+ bailout:
+    if (st.workers) {
+        for (i=0; i<st.nworkers; i++) {
+            catalog_ingest_worker_t* w = st.workers + i;
+            if (w->bufs)
+                for (hp=0; hp<ci->nhp; hp++)
+                    free(w->bufs[hp]);
+            free(w->bufs);
+            free(w->nbuf);
+            free(w->cap);
+            if (w->chunks)
+                bl_free(w->chunks);
+            if (w->shard)
+                fclose(w->shard);
+            if (w->shardfn) {
+                if (unlink(w->shardfn))
+                    SYSERROR("Failed to delete shard file \"%s\"", w->shardfn);
+                free(w->shardfn);
+            }
+        }
+    }
+    free(st.workers);
+    free(st.nread);
+    free(st.outputs);
+    free(st.chunks);
+    free(st.hpstart);
+    pthread_mutex_destroy(&st.lock);
+    return rtn;
+}
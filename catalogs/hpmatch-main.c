@@ -0,0 +1,101 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "os-features.h"
+#include "hpmatch.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "errors.h"
+#include "log.h"
+#include "boilerplate.h"
+#include "fitsioutils.h"
+
+static const char* OPTIONS = "hvr:R:D:n:M:j:t:No:";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s [options] <catalog-1.fits> <catalog-2.fits>\n"
+           "    -o <output-filename>: FITS table of matches (ROW1, ROW2, DIST)\n"
+           "    -r <radius>: match radius, in arcsec\n"
+           "    [-R <ra-column-name>]: name of RA in FITS tables (default RA)\n"
+           "    [-D <dec-column-name>]: name of DEC in FITS tables (default DEC)\n"
+           "    [-N]: keep only the nearest match for each row of catalog 1\n"
+           "    [-M <MB>]: memory budget; default 1024\n"
+           "    [-n <healpix Nside>]: partition the sky at this Nside; default: chosen\n"
+           "              from the catalog sizes and the memory budget\n"
+           "    [-j <threads>]: match this many healpixes at once; default 1\n"
+           "    [-t <temp-dir>]: use the given temp dir; default is /tmp\n"
+           "    [-v]: +verbose\n"
+           "\n", progname);
+}
+
+
+int main(int argc, char *argv[]) {
+    int argchar;
+    char* progname = argv[0];
+    char* outfn = NULL;
+    double membudget = 1024;
+    int loglvl = LOG_MSG;
+    hpmatch_params_t p;
+
+    hpmatch_params_init(&p);
+    while ((argchar = getopt (argc, argv, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'o':
+            outfn = optarg;
+            break;
+        case 'r':
+            p.radius = arcsec2deg(atof(optarg));
+            break;
+        case 'R':
+            p.racol = optarg;
+            break;
+        case 'D':
+            p.deccol = optarg;
+            break;
+        case 'N':
+            p.nearest = TRUE;
+            break;
+        case 'M':
+            membudget = atof(optarg);
+            break;
+        case 'n':
+            p.nside = atoi(optarg);
+            break;
+        case 'j':
+            p.nthreads = atoi(optarg);
+            break;
+        case 't':
+            p.tempdir = optarg;
+            break;
+        case 'v':
+            loglvl++;
+            break;
+        case '?':
+            fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+        case 'h':
+            printHelp(progname);
+            return 0;
+        default:
+            return -1;
+        }
+
+    if (argc - optind != 2 || !outfn || p.radius <= 0) {
+        printHelp(progname);
+        printf("Need two input catalogs, an output filename and a radius!\n");
+        exit(-1);
+    }
+    log_init(loglvl);
+    fits_use_error_system();
+    p.membudget = (size_t)(membudget * 1024 * 1024);
+
+    if (hpmatch_run(&p, argv[optind], argv[optind + 1], outfn))
+        exit(-1);
+    return 0;
+}
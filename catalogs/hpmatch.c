@@ -0,0 +1,420 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "os-features.h"
+#include "hpmatch.h"
+#include "healpix.h"
+#include "hpspill.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "errors.h"
+#include "log.h"
+#include "fitsioutils.h"
+#include "fitstable.h"
+#include "kdtree.h"
+#include "dualtree_rangesearch.h"
+#include "bl.h"
+
+// A row of either catalog, as binned.
+struct hprow {
+    double ra;
+    double dec;
+    int64_t row;
+};
+typedef struct hprow hprow_t;
+
+struct match {
+    int64_t row1;
+    int64_t row2;
+    double dist;
+};
+typedef struct match match_t;
+
+struct hpmatch {
+    hpspill_t* spill1;
+    hpspill_t* spill2;
+    int NHP;
+    double radius;
+    anbool nearest;
+
+    fitstable_t* out;
+    int64_t nmatches;
+    int nexthp;
+    int failed;
+    pthread_mutex_t lock;
+};
+typedef struct hpmatch hpmatch_t;
+
+// Rough memory needed to match a row (binned row, xyz, kd-tree).
+#define BYTES_PER_ROW 96
+
+// By bit pattern: with -ffinite-math-only, isfinite() can be folded away.
+static anbool is_finite(double x) {
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return (u & 0x7ff0000000000000ULL) != 0x7ff0000000000000ULL;
+}
+
+// Reads the RA,Dec columns of "fn" in blocks, binning the rows into
+// "spill"; with "radius" > 0, rows also go into the neighbouring
+// healpixes within "radius" degrees.  Rows without a finite RA,Dec are
+// skipped, and counted in "nskipped".
+static int bin_catalog(const char* fn, const char* racol, const char* deccol,
+                       int nside, double radius, hpspill_t* spill,
+                       int64_t* nskipped) {
+    fitstable_t* tab;
+    int64_t N, off;
+    int B = 100000;
+    double* ra;
+    double* dec;
+    tfits_type dubl = fitscolumn_double_type();
+    double range = (radius > 0 ? deg2dist(radius) : 0);
+    int64_t nbad = 0;
+
+    tab = fitstable_open(fn);
+    if (!tab) {
+        ERROR("Failed to open catalog \"%s\"", fn);
+        return -1;
+    }
+    N = fitstable_nrows64(tab);
+    logmsg("Binning %lli rows of %s\n", (long long)N, fn);
+    ra = malloc(B * sizeof(double));
+    dec = malloc(B * sizeof(double));
+    assert(ra && dec);
+    for (off=0; off<N; off+=B) {
+        int i, n = (int)MIN((int64_t)B, N - off);
+        if (fitstable_read_column_offset_into(tab, racol, dubl, ra,
+                                              sizeof(double), off, n) ||
+            fitstable_read_column_offset_into(tab, deccol, dubl, dec,
+                                              sizeof(double), off, n)) {
+            ERROR("Failed to read columns \"%s\", \"%s\" from \"%s\"",
+                  racol, deccol, fn);
+            goto bailout;
+        }
+        for (i=0; i<n; i++) {
+            hprow_t r;
+            double xyz[3];
+            int k, nhp;
+            int hps[9];
+            if (!is_finite(ra[i]) || !is_finite(dec[i])) {
+                nbad++;
+                continue;
+            }
+            r.ra = ra[i];
+            r.dec = dec[i];
+            r.row = off + i;
+            radecdeg2xyzarr(r.ra, r.dec, xyz);
+            if (range == 0) {
+                hps[0] = xyzarrtohealpix(xyz, nside);
+                nhp = 1;
+            } else
+                nhp = healpix_get_neighbours_within_range(xyz, range, hps,
+                                                          nside);
+            for (k=0; k<nhp; k++)
+                if (hpspill_append(spill, hps[k], &r))
+                    goto bailout;
+        }
+        if (off && (off % (10 * B)) == 0)
+            logmsg("  %lli of %lli rows\n", (long long)off, (long long)N);
+    }
+    if (nbad)
+        logmsg("Warning: skipped %lli rows of %s without a finite RA,Dec\n",
+               (long long)nbad, fn);
+    *nskipped += nbad;
+    free(ra);
+    free(dec);
+    fitstable_close(tab);
+    return 0;
+ bailout:
+    free(ra);
+    free(dec);
+    fitstable_close(tab);
+    return -1;
+}
+
+static kdtree_t* build_tree(const hprow_t* rows, int N) {
+    double* xyz = malloc(N * 3 * sizeof(double));
+    kdtree_t* kd;
+    int i;
+    if (!xyz) {
+        SYSERROR("Failed to allocate %i points", N);
+        return NULL;
+    }
+    for (i=0; i<N; i++)
+        radecdeg2xyzarr(rows[i].ra, rows[i].dec, xyz + 3*i);
+    kd = kdtree_build(NULL, xyz, N, 3, 16, KDTT_DOUBLE, KD_BUILD_BBOX);
+    if (!kd) {
+        free(xyz);
+        return NULL;
+    }
+    kd->free_data = TRUE;
+    return kd;
+}
+
+struct partition {
+    kdtree_t* kd1;
+    kdtree_t* kd2;
+    const hprow_t* rows1;
+    const hprow_t* rows2;
+    bl* matches;
+    // for "nearest": best squared distance and kd2 index per kd1 point
+    double* bestd2;
+    int* best;
+};
+
+static void got_match(void* extra, int i1, int i2, double d2) {
+    struct partition* p = extra;
+    match_t m;
+    if (p->best) {
+        if (p->best[i1] == -1 || d2 < p->bestd2[i1]) {
+            p->best[i1] = i2;
+            p->bestd2[i1] = d2;
+        }
+        return;
+    }
+    m.row1 = p->rows1[kdtree_permute(p->kd1, i1)].row;
+    m.row2 = p->rows2[kdtree_permute(p->kd2, i2)].row;
+    m.dist = distsq2arcsec(d2);
+    bl_append(p->matches, &m);
+}
+
+static int match_healpix(hpmatch_t* hm, int hp, bl* matches) {
+    struct partition p;
+    hprow_t* rows1 = NULL;
+    hprow_t* rows2 = NULL;
+    int N1, N2, i;
+    int rtn = -1;
+
+    memset(&p, 0, sizeof(p));
+    N1 = hpspill_nrows(hm->spill1, hp);
+    N2 = hpspill_nrows(hm->spill2, hp);
+    if (!N1 || !N2)
+        return 0;
+    rows1 = hpspill_read(hm->spill1, hp);
+    rows2 = hpspill_read(hm->spill2, hp);
+    if (!rows1 || !rows2)
+        goto bailout;
+    p.rows1 = rows1;
+    p.rows2 = rows2;
+    p.matches = matches;
+    p.kd1 = build_tree(rows1, N1);
+    p.kd2 = build_tree(rows2, N2);
+    if (!p.kd1 || !p.kd2)
+        goto bailout;
+    if (hm->nearest) {
+        p.best = malloc(N1 * sizeof(int));
+        p.bestd2 = malloc(N1 * sizeof(double));
+        assert(p.best && p.bestd2);
+        for (i=0; i<N1; i++)
+            p.best[i] = -1;
+    }
+    dualtree_rangesearch(p.kd1, p.kd2, RANGESEARCH_NO_LIMIT,
+                         deg2dist(hm->radius), FALSE, NULL,
+                         got_match, &p, NULL, NULL);
+    if (hm->nearest) {
+        for (i=0; i<N1; i++) {
+            match_t m;
+            if (p.best[i] == -1)
+                continue;
+            m.row1 = rows1[kdtree_permute(p.kd1, i)].row;
+            m.row2 = rows2[kdtree_permute(p.kd2, p.best[i])].row;
+            m.dist = distsq2arcsec(p.bestd2[i]);
+            bl_append(matches, &m);
+        }
+    }
+    logverb("Healpix %i: %i x %i rows, %zu matches\n", hp, N1, N2,
+            bl_size(matches));
+    rtn = 0;
+ bailout:
+    kdtree_free(p.kd1);
+    kdtree_free(p.kd2);
+    free(p.best);
+    free(p.bestd2);
+    free(rows1);
+    free(rows2);
+    return rtn;
+}
+
+static int write_matches(hpmatch_t* hm, bl* matches) {
+    size_t i;
+    for (i=0; i<bl_size(matches); i++) {
+        match_t* m = bl_access(matches, i);
+        if (fitstable_write_row(hm->out, &m->row1, &m->row2, &m->dist)) {
+            ERROR("Failed to write match");
+            return -1;
+        }
+    }
+    hm->nmatches += bl_size(matches);
+    return 0;
+}
+
+static void* match_thread(void* v) {
+    hpmatch_t* hm = v;
+    bl* matches = bl_new(4096, sizeof(match_t));
+    for (;;) {
+        int hp, rtn;
+        pthread_mutex_lock(&hm->lock);
+        hp = hm->nexthp++;
+        pthread_mutex_unlock(&hm->lock);
+        if (hp >= hm->NHP)
+            break;
+        rtn = match_healpix(hm, hp, matches);
+        pthread_mutex_lock(&hm->lock);
+        if (rtn || write_matches(hm, matches))
+            hm->failed = 1;
+        // (hpspill_remove() isn't thread-safe)
+        hpspill_remove(hm->spill1, hp);
+        hpspill_remove(hm->spill2, hp);
+        pthread_mutex_unlock(&hm->lock);
+        bl_remove_all(matches);
+    }
+    bl_free(matches);
+    return NULL;
+}
+
+// The smallest Nside at which a healpix's worth of rows (allowing for
+// the sky density varying by a factor of 10) fits in each thread's
+// share of the memory budget.
+static int choose_nside(int64_t N, double radius, size_t budget,
+                        int nthreads) {
+    int nside = 1;
+    double perthread = (double)budget / nthreads;
+    while (10.0 * BYTES_PER_ROW * N / (12.0 * nside * nside) > perthread &&
+           healpix_side_length_arcmin(nside * 2) / 60.0 > 10.0 * radius)
+        nside *= 2;
+    return nside;
+}
+
+void hpmatch_params_init(hpmatch_params_t* p) {
+    memset(p, 0, sizeof(hpmatch_params_t));
+    p->racol = "RA";
+    p->deccol = "DEC";
+    p->nthreads = 1;
+    p->membudget = (size_t)1024 * 1024 * 1024;
+    p->tempdir = "/tmp";
+}
+
+int hpmatch_run(hpmatch_params_t* p, const char* fn1, const char* fn2,
+                const char* outfn) {
+    int nside = p->nside;
+    int nthreads = MAX(1, p->nthreads);
+    int64_t N;
+    hpmatch_t hm;
+    pthread_t* threads;
+    fitstable_t* tab;
+    int i, nstarted = 0;
+    int rtn = -1;
+
+    memset(&hm, 0, sizeof(hpmatch_t));
+    hm.nearest = p->nearest;
+    N = 0;
+    for (i=0; i<2; i++) {
+        tab = fitstable_open(i ? fn2 : fn1);
+        if (!tab) {
+            ERROR("Failed to open catalog \"%s\"", i ? fn2 : fn1);
+            return -1;
+        }
+        N += fitstable_nrows64(tab);
+        fitstable_close(tab);
+    }
+    if (!nside)
+        nside = choose_nside(N, p->radius, p->membudget, nthreads);
+    if (healpix_side_length_arcmin(nside) / 60.0 < 2.0 * p->radius) {
+        ERROR("Healpixes at Nside %i are too small for a %g-arcsec radius",
+              nside, deg2arcsec(p->radius));
+        return -1;
+    }
+    hm.NHP = 12 * nside * nside;
+    hm.radius = p->radius;
+    logmsg("Matching within %g arcsec, in %i healpixes (Nside %i)\n",
+           deg2arcsec(p->radius), hm.NHP, nside);
+
+    // Each catalog gets half of the budget for binning.
+    hm.spill1 = hpspill_new(hm.NHP, sizeof(hprow_t), p->membudget / 2,
+                            p->tempdir);
+    hm.spill2 = hpspill_new(hm.NHP, sizeof(hprow_t), p->membudget / 2,
+                            p->tempdir);
+    if (!hm.spill1 || !hm.spill2)
+        goto bailout;
+    p->nskipped = 0;
+    if (bin_catalog(fn1, p->racol, p->deccol, nside, 0.0, hm.spill1,
+                    &p->nskipped) ||
+        bin_catalog(fn2, p->racol, p->deccol, nside, p->radius, hm.spill2,
+                    &p->nskipped)) {
+        ERROR("Failed to bin the catalogs");
+        goto bailout;
+    }
+    // make room for the matching.
+    if (hpspill_flush(hm.spill1) || hpspill_flush(hm.spill2))
+        goto bailout;
+
+    hm.out = fitstable_open_for_writing(outfn);
+    if (!hm.out) {
+        ERROR("Failed to open output table \"%s\"", outfn);
+        goto bailout;
+    }
+    fitstable_add_write_column(hm.out, fitscolumn_i64_type(), "ROW1", NULL);
+    fitstable_add_write_column(hm.out, fitscolumn_i64_type(), "ROW2", NULL);
+    fitstable_add_write_column(hm.out, fitscolumn_double_type(), "DIST",
+                               "arcsec");
+    qfits_header_add(fitstable_get_primary_header(hm.out), "HPMATCH1", fn1,
+                     "First catalog", NULL);
+    qfits_header_add(fitstable_get_primary_header(hm.out), "HPMATCH2", fn2,
+                     "Second catalog", NULL);
+    if (fitstable_write_primary_header(hm.out) ||
+        fitstable_write_header(hm.out)) {
+        ERROR("Failed to write headers of \"%s\"", outfn);
+        goto bailout;
+    }
+
+    pthread_mutex_init(&hm.lock, NULL);
+    threads = malloc(nthreads * sizeof(pthread_t));
+    assert(threads);
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + nstarted, NULL, match_thread, &hm)) {
+            SYSERROR("Failed to start matching thread");
+            break;
+        }
+        nstarted++;
+    }
+    match_thread(&hm);
+    for (i=0; i<nstarted; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&hm.lock);
+    if (hm.failed) {
+        ERROR("Matching failed");
+        goto bailout;
+    }
+
+    if (fitstable_fix_header(hm.out) ||
+        fitstable_fix_primary_header(hm.out)) {
+        ERROR("Failed to fix the headers of \"%s\"", outfn);
+        goto bailout;
+    }
+    tab = hm.out;
+    hm.out = NULL;
+    if (fitstable_close(tab)) {
+        ERROR("Failed to close output table \"%s\"", outfn);
+        goto bailout;
+    }
+    logmsg("Wrote %lli matches to %s\n", (long long)hm.nmatches, outfn);
+    p->nmatches = hm.nmatches;
+    rtn = 0;
+
+ bailout:
+    if (hm.out)
+        fitstable_close(hm.out);
+    hpspill_free(hm.spill1);
+    hpspill_free(hm.spill2);
+    return rtn;
+}
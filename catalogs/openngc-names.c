@@ -0,0 +1,984 @@
+{ .is_ngc = FALSE,
+  .id = 348,
+  .name = "omi Per Cloud"
+},
+{ .is_ngc = FALSE,
+  .id = 349,
+  .name = "Barnard's Merope Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 405,
+  .name = "Flaming Star Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 434,
+  .name = "Orion B"
+},
+{ .is_ngc = FALSE,
+  .id = 434,
+  .name = "Flame Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 443,
+  .name = "Gem A"
+},
+{ .is_ngc = FALSE,
+  .id = 1318,
+  .name = "gam Cyg"
+},
+{ .is_ngc = FALSE,
+  .id = 2220,
+  .name = "Toby Jug Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 2391,
+  .name = "omi Vel Cluster"
+},
+{ .is_ngc = FALSE,
+  .id = 2574,
+  .name = "Coddington's Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 2602,
+  .name = "tet Car Cluster"
+},
+{ .is_ngc = FALSE,
+  .id = 2944,
+  .name = "lam Cen Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 4604,
+  .name = "rho Oph Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 4703,
+  .name = "Star Queen"
+},
+{ .is_ngc = FALSE,
+  .id = 4703,
+  .name = "Eagle Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 4715,
+  .name = "Small Sgr Star Cloud"
+},
+{ .is_ngc = FALSE,
+  .id = 4715,
+  .name = "M 24"
+},
+{ .is_ngc = FALSE,
+  .id = 4725,
+  .name = "M 25"
+},
+{ .is_ngc = FALSE,
+  .id = 5070,
+  .name = "Pelican Nebula"
+},
+{ .is_ngc = FALSE,
+  .id = 5146,
+  .name = "Cocoon Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 40,
+  .name = "Bow-Tie nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 104,
+  .name = "47 Tuc Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 205,
+  .name = "M 110"
+},
+{ .is_ngc = TRUE,
+  .id = 221,
+  .name = "M 32"
+},
+{ .is_ngc = TRUE,
+  .id = 224,
+  .name = "Andromeda Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 224,
+  .name = "M 31"
+},
+{ .is_ngc = TRUE,
+  .id = 253,
+  .name = "Silver Coin"
+},
+{ .is_ngc = TRUE,
+  .id = 253,
+  .name = "Sculptor Filament"
+},
+{ .is_ngc = TRUE,
+  .id = 292,
+  .name = "Small Magellanic Cloud"
+},
+{ .is_ngc = TRUE,
+  .id = 457,
+  .name = "Owl Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 581,
+  .name = "M 103"
+},
+{ .is_ngc = TRUE,
+  .id = 598,
+  .name = "Triangulum Pinwheel"
+},
+{ .is_ngc = TRUE,
+  .id = 598,
+  .name = "Triangulum Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 598,
+  .name = "M 33"
+},
+{ .is_ngc = TRUE,
+  .id = 628,
+  .name = "M 74"
+},
+{ .is_ngc = TRUE,
+  .id = 650,
+  .name = "Little Dumbbell Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 650,
+  .name = "Cork Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 650,
+  .name = "Barbell Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 650,
+  .name = "M 76"
+},
+{ .is_ngc = TRUE,
+  .id = 869,
+  .name = "h Persei Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 884,
+  .name = "chi Persei Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 1039,
+  .name = "M 34"
+},
+{ .is_ngc = TRUE,
+  .id = 1049,
+  .name = "Fornax Dwarf Cluster 3"
+},
+{ .is_ngc = TRUE,
+  .id = 1068,
+  .name = "M 77"
+},
+{ .is_ngc = TRUE,
+  .id = 1275,
+  .name = "Perseus A"
+},
+{ .is_ngc = TRUE,
+  .id = 1316,
+  .name = "Fornax A"
+},
+{ .is_ngc = TRUE,
+  .id = 1317,
+  .name = "Fornax B"
+},
+{ .is_ngc = TRUE,
+  .id = 1432,
+  .name = "Maia Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1435,
+  .name = "Merope Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1499,
+  .name = "California Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1555,
+  .name = "Hind's Variable Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1555,
+  .name = "Hind's Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1904,
+  .name = "M 79"
+},
+{ .is_ngc = TRUE,
+  .id = 1909,
+  .name = "the Witch Head Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1912,
+  .name = "M 38"
+},
+{ .is_ngc = TRUE,
+  .id = 1952,
+  .name = "M 1"
+},
+{ .is_ngc = TRUE,
+  .id = 1960,
+  .name = "M 36"
+},
+{ .is_ngc = TRUE,
+  .id = 1976,
+  .name = "Orion Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1976,
+  .name = "Great Orion Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1976,
+  .name = "M 42"
+},
+{ .is_ngc = TRUE,
+  .id = 1977,
+  .name = "the Running Man Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1980,
+  .name = "Lower Sword"
+},
+{ .is_ngc = TRUE,
+  .id = 1981,
+  .name = "Upper Sword"
+},
+{ .is_ngc = TRUE,
+  .id = 1982,
+  .name = "Mairan's Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 1982,
+  .name = "M 43"
+},
+{ .is_ngc = TRUE,
+  .id = 1990,
+  .name = "Alnilam"
+},
+{ .is_ngc = TRUE,
+  .id = 2068,
+  .name = "M 78"
+},
+{ .is_ngc = TRUE,
+  .id = 2070,
+  .name = "Tarantula Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2070,
+  .name = "30 Dor Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 2099,
+  .name = "M 37"
+},
+{ .is_ngc = TRUE,
+  .id = 2168,
+  .name = "M 35"
+},
+{ .is_ngc = TRUE,
+  .id = 2174,
+  .name = "Monkey Head Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2237,
+  .name = "Rosette A"
+},
+{ .is_ngc = TRUE,
+  .id = 2238,
+  .name = "Rosette Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2246,
+  .name = "Rosette B"
+},
+{ .is_ngc = TRUE,
+  .id = 2261,
+  .name = "Hubble's Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2264,
+  .name = "Christmas Tree Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 2287,
+  .name = "M 41"
+},
+{ .is_ngc = TRUE,
+  .id = 2301,
+  .name = "Great Bird Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 2323,
+  .name = "M 50"
+},
+{ .is_ngc = TRUE,
+  .id = 2360,
+  .name = "Caroline's Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 2392,
+  .name = "Eskimo Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2422,
+  .name = "M 47"
+},
+{ .is_ngc = TRUE,
+  .id = 2437,
+  .name = "M 46"
+},
+{ .is_ngc = TRUE,
+  .id = 2447,
+  .name = "M 93"
+},
+{ .is_ngc = TRUE,
+  .id = 2537,
+  .name = "Bear-Paw Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 2537,
+  .name = "Bear Claw Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 2548,
+  .name = "M 48"
+},
+{ .is_ngc = TRUE,
+  .id = 2632,
+  .name = "Praesepe Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 2632,
+  .name = "Beehive"
+},
+{ .is_ngc = TRUE,
+  .id = 2632,
+  .name = "M 44"
+},
+{ .is_ngc = TRUE,
+  .id = 2682,
+  .name = "M 67"
+},
+{ .is_ngc = TRUE,
+  .id = 2685,
+  .name = "Helix Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 2736,
+  .name = "Pencil Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3031,
+  .name = "Bode's Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 3031,
+  .name = "M 81"
+},
+{ .is_ngc = TRUE,
+  .id = 3034,
+  .name = "Cigar Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 3034,
+  .name = "M 82"
+},
+{ .is_ngc = TRUE,
+  .id = 3115,
+  .name = "Spindle Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 3132,
+  .name = "Eight-Burst Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3242,
+  .name = "Jupiter's Ghost Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3351,
+  .name = "M 95"
+},
+{ .is_ngc = TRUE,
+  .id = 3368,
+  .name = "M 96"
+},
+{ .is_ngc = TRUE,
+  .id = 3372,
+  .name = "eta Car Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3372,
+  .name = "Carina Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3379,
+  .name = "M 105"
+},
+{ .is_ngc = TRUE,
+  .id = 3532,
+  .name = "Wishing Well Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 3556,
+  .name = "M 108"
+},
+{ .is_ngc = TRUE,
+  .id = 3561,
+  .name = "the Guitar"
+},
+{ .is_ngc = TRUE,
+  .id = 3587,
+  .name = "Owl Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 3587,
+  .name = "M 97"
+},
+{ .is_ngc = TRUE,
+  .id = 3623,
+  .name = "M 65"
+},
+{ .is_ngc = TRUE,
+  .id = 3627,
+  .name = "M 66"
+},
+{ .is_ngc = TRUE,
+  .id = 3766,
+  .name = "Pearl Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 3928,
+  .name = "Miniature Spiral"
+},
+{ .is_ngc = TRUE,
+  .id = 3992,
+  .name = "M 109"
+},
+{ .is_ngc = TRUE,
+  .id = 4038,
+  .name = "Antennae Galaxies"
+},
+{ .is_ngc = TRUE,
+  .id = 4039,
+  .name = "Antennae Galaxies"
+},
+{ .is_ngc = TRUE,
+  .id = 4192,
+  .name = "M 98"
+},
+{ .is_ngc = TRUE,
+  .id = 4194,
+  .name = "Medusa Galaxy Merger"
+},
+{ .is_ngc = TRUE,
+  .id = 4254,
+  .name = "Virgo Cluster Pinwheel"
+},
+{ .is_ngc = TRUE,
+  .id = 4254,
+  .name = "Coma Pinwheel"
+},
+{ .is_ngc = TRUE,
+  .id = 4254,
+  .name = "M 99"
+},
+{ .is_ngc = TRUE,
+  .id = 4258,
+  .name = "M 106"
+},
+{ .is_ngc = TRUE,
+  .id = 4303,
+  .name = "M 61"
+},
+{ .is_ngc = TRUE,
+  .id = 4321,
+  .name = "M 100"
+},
+{ .is_ngc = TRUE,
+  .id = 4374,
+  .name = "M 84"
+},
+{ .is_ngc = TRUE,
+  .id = 4382,
+  .name = "M 85"
+},
+{ .is_ngc = TRUE,
+  .id = 4406,
+  .name = "M 86"
+},
+{ .is_ngc = TRUE,
+  .id = 4472,
+  .name = "M 49"
+},
+{ .is_ngc = TRUE,
+  .id = 4486,
+  .name = "Virgo Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4486,
+  .name = "M 87"
+},
+{ .is_ngc = TRUE,
+  .id = 4501,
+  .name = "M 88"
+},
+{ .is_ngc = TRUE,
+  .id = 4548,
+  .name = "M 91"
+},
+{ .is_ngc = TRUE,
+  .id = 4552,
+  .name = "M 89"
+},
+{ .is_ngc = TRUE,
+  .id = 4565,
+  .name = "Needle Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4569,
+  .name = "M 90"
+},
+{ .is_ngc = TRUE,
+  .id = 4579,
+  .name = "M 58"
+},
+{ .is_ngc = TRUE,
+  .id = 4590,
+  .name = "M 68"
+},
+{ .is_ngc = TRUE,
+  .id = 4594,
+  .name = "Sombrero Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4594,
+  .name = "M 104"
+},
+{ .is_ngc = TRUE,
+  .id = 4609,
+  .name = "Coalsack Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 4621,
+  .name = "M 59"
+},
+{ .is_ngc = TRUE,
+  .id = 4631,
+  .name = "Whale Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4649,
+  .name = "M 60"
+},
+{ .is_ngc = TRUE,
+  .id = 4651,
+  .name = "Umbrella Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4676,
+  .name = "Mice Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4736,
+  .name = "M 94"
+},
+{ .is_ngc = TRUE,
+  .id = 4755,
+  .name = "kappa Crucis Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 4755,
+  .name = "Herschel's Jewel Box"
+},
+{ .is_ngc = TRUE,
+  .id = 4826,
+  .name = "Evil Eye Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4826,
+  .name = "Black Eye Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 4826,
+  .name = "M 64"
+},
+{ .is_ngc = TRUE,
+  .id = 4990,
+  .name = "Cocoon Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 5024,
+  .name = "M 53"
+},
+{ .is_ngc = TRUE,
+  .id = 5055,
+  .name = "Sunflower Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 5055,
+  .name = "M 63"
+},
+{ .is_ngc = TRUE,
+  .id = 5128,
+  .name = "Centaurus A"
+},
+{ .is_ngc = TRUE,
+  .id = 5139,
+  .name = "Omega Centauri"
+},
+{ .is_ngc = TRUE,
+  .id = 5194,
+  .name = "Whirlpool Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 5194,
+  .name = "M 51"
+},
+{ .is_ngc = TRUE,
+  .id = 5236,
+  .name = "Southern Pinwheel Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 5236,
+  .name = "M 83"
+},
+{ .is_ngc = TRUE,
+  .id = 5272,
+  .name = "M 3"
+},
+{ .is_ngc = TRUE,
+  .id = 5457,
+  .name = "M 101"
+},
+{ .is_ngc = TRUE,
+  .id = 5904,
+  .name = "M 5"
+},
+{ .is_ngc = TRUE,
+  .id = 6087,
+  .name = "S Nor Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6093,
+  .name = "M 80"
+},
+{ .is_ngc = TRUE,
+  .id = 6121,
+  .name = "M 4"
+},
+{ .is_ngc = TRUE,
+  .id = 6171,
+  .name = "M 107"
+},
+{ .is_ngc = TRUE,
+  .id = 6188,
+  .name = "Rim Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6205,
+  .name = "Hercules Globular Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6205,
+  .name = "M 13"
+},
+{ .is_ngc = TRUE,
+  .id = 6218,
+  .name = "M 12"
+},
+{ .is_ngc = TRUE,
+  .id = 6254,
+  .name = "M 10"
+},
+{ .is_ngc = TRUE,
+  .id = 6266,
+  .name = "M 62"
+},
+{ .is_ngc = TRUE,
+  .id = 6273,
+  .name = "M 19"
+},
+{ .is_ngc = TRUE,
+  .id = 6302,
+  .name = "Bug Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6309,
+  .name = "Box Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6333,
+  .name = "M 9"
+},
+{ .is_ngc = TRUE,
+  .id = 6341,
+  .name = "M 92"
+},
+{ .is_ngc = TRUE,
+  .id = 6357,
+  .name = "the War and Peace Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6369,
+  .name = "Little Ghost Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6402,
+  .name = "M 14"
+},
+{ .is_ngc = TRUE,
+  .id = 6405,
+  .name = "Butterfly Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6405,
+  .name = "M 6"
+},
+{ .is_ngc = TRUE,
+  .id = 6445,
+  .name = "Little Gem"
+},
+{ .is_ngc = TRUE,
+  .id = 6475,
+  .name = "Ptolemy's Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6475,
+  .name = "M 7"
+},
+{ .is_ngc = TRUE,
+  .id = 6494,
+  .name = "M 23"
+},
+{ .is_ngc = TRUE,
+  .id = 6514,
+  .name = "Trifid Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6514,
+  .name = "M 20"
+},
+{ .is_ngc = TRUE,
+  .id = 6523,
+  .name = "Lagoon Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6523,
+  .name = "M 8"
+},
+{ .is_ngc = TRUE,
+  .id = 6531,
+  .name = "M 21"
+},
+{ .is_ngc = TRUE,
+  .id = 6537,
+  .name = "Red Spider Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6543,
+  .name = "Cat's Eye Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6611,
+  .name = "Eagle Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6611,
+  .name = "M 16"
+},
+{ .is_ngc = TRUE,
+  .id = 6613,
+  .name = "M 18"
+},
+{ .is_ngc = TRUE,
+  .id = 6618,
+  .name = "Swan Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6618,
+  .name = "Lobster Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6618,
+  .name = "Checkmark Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6618,
+  .name = "omega Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6618,
+  .name = "M 17"
+},
+{ .is_ngc = TRUE,
+  .id = 6626,
+  .name = "M 28"
+},
+{ .is_ngc = TRUE,
+  .id = 6637,
+  .name = "M 69"
+},
+{ .is_ngc = TRUE,
+  .id = 6656,
+  .name = "M 22"
+},
+{ .is_ngc = TRUE,
+  .id = 6681,
+  .name = "M 70"
+},
+{ .is_ngc = TRUE,
+  .id = 6694,
+  .name = "M 26"
+},
+{ .is_ngc = TRUE,
+  .id = 6705,
+  .name = "Wild Duck Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6705,
+  .name = "Amas de l'Ecu de Sobieski"
+},
+{ .is_ngc = TRUE,
+  .id = 6705,
+  .name = "M 11"
+},
+{ .is_ngc = TRUE,
+  .id = 6715,
+  .name = "M 54"
+},
+{ .is_ngc = TRUE,
+  .id = 6720,
+  .name = "Ring Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6720,
+  .name = "M 57"
+},
+{ .is_ngc = TRUE,
+  .id = 6741,
+  .name = "Phantom Streak Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6779,
+  .name = "M 56"
+},
+{ .is_ngc = TRUE,
+  .id = 6809,
+  .name = "M 55"
+},
+{ .is_ngc = TRUE,
+  .id = 6818,
+  .name = "Little Gem Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6819,
+  .name = "Foxhead Cluster"
+},
+{ .is_ngc = TRUE,
+  .id = 6822,
+  .name = "Barnard's Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 6826,
+  .name = "Blinking Planetary"
+},
+{ .is_ngc = TRUE,
+  .id = 6838,
+  .name = "M 71"
+},
+{ .is_ngc = TRUE,
+  .id = 6853,
+  .name = "Dumbbell Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6853,
+  .name = "M 27"
+},
+{ .is_ngc = TRUE,
+  .id = 6864,
+  .name = "M 75"
+},
+{ .is_ngc = TRUE,
+  .id = 6888,
+  .name = "Crescent Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6905,
+  .name = "Blue Flash Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6913,
+  .name = "M 29"
+},
+{ .is_ngc = TRUE,
+  .id = 6946,
+  .name = "Fireworks Galaxy"
+},
+{ .is_ngc = TRUE,
+  .id = 6960,
+  .name = "Veil Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 6981,
+  .name = "M 72"
+},
+{ .is_ngc = TRUE,
+  .id = 6994,
+  .name = "M 73"
+},
+{ .is_ngc = TRUE,
+  .id = 7000,
+  .name = "North America Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 7009,
+  .name = "Saturn Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 7023,
+  .name = "Iris Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 7078,
+  .name = "M 15"
+},
+{ .is_ngc = TRUE,
+  .id = 7089,
+  .name = "M 2"
+},
+{ .is_ngc = TRUE,
+  .id = 7092,
+  .name = "M 39"
+},
+{ .is_ngc = TRUE,
+  .id = 7099,
+  .name = "M 30"
+},
+{ .is_ngc = TRUE,
+  .id = 7114,
+  .name = "Schmidt's Nova Cygni"
+},
+{ .is_ngc = TRUE,
+  .id = 7293,
+  .name = "Helix Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 7635,
+  .name = "Bubble Nebula"
+},
+{ .is_ngc = TRUE,
+  .id = 7654,
+  .name = "M 52"
+},
+{ .is_ngc = TRUE,
+  .id = 7662,
+  .name = "Copeland's Blue Snowball"
+},
@@ -0,0 +1,63 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_read_raw(CuTest*);
+extern void test_read_usnob(CuTest*);
+extern void test_read_nomad(CuTest*);
+extern void test_read_2mass(CuTest*);
+extern void test_fits_empty(CuTest*);
+extern void test_hd_1(CuTest*);
+extern void test_bdy_1(CuTest*);
+extern void test_annotation_ngc(CuTest*);
+extern void test_annotation_bright_stars(CuTest*);
+extern void test_annotation_constellations(CuTest*);
+extern void test_catalog_ingest_threads(CuTest*);
+extern void test_hpmatch_brute_force(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_read_raw);
+    SUITE_ADD_TEST(suite, test_read_usnob);
+    SUITE_ADD_TEST(suite, test_read_nomad);
+    SUITE_ADD_TEST(suite, test_read_2mass);
+    SUITE_ADD_TEST(suite, test_fits_empty);
+    SUITE_ADD_TEST(suite, test_hd_1);
+    SUITE_ADD_TEST(suite, test_bdy_1);
+    SUITE_ADD_TEST(suite, test_annotation_ngc);
+    SUITE_ADD_TEST(suite, test_annotation_bright_stars);
+    SUITE_ADD_TEST(suite, test_annotation_constellations);
+    SUITE_ADD_TEST(suite, test_catalog_ingest_threads);
+    SUITE_ADD_TEST(suite, test_hpmatch_brute_force);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+#include "annotation-catalogs.h"
+#include "openngc.h"
+#include "brightstars.h"
+#include "constellations.h"
+#include "starutil.h"
+#include "bl.h"
+
+static double ras[] = { 10.68, 83.8, 201.3, 0.1, 270.0 };
+static double decs[] = { 41.27, -5.4, -43.0, 89.0, -66.5 };
+static double radii[] = { 0.5, 3.0, 20.0 };
+
+void test_annotation_ngc(CuTest* tc) {
+    int c, r, i;
+    for (c=0; c<sizeof(ras)/sizeof(double); c++) {
+        for (r=0; r<sizeof(radii)/sizeof(double); r++) {
+            il* inds = il_new(256);
+            il* brute = il_new(256);
+            int N = annotation_catalogs_ngc(ras[c], decs[c], radii[r], inds);
+            CuAssertIntEquals(tc, il_size(inds), N);
+            for (i=0; i<ngc_num_entries(); i++) {
+                ngc_entry* ngc = ngc_get_entry(i);
+                if (deg_between_radecdeg(ras[c], decs[c], ngc->ra, ngc->dec)
+                    <= radii[r])
+                    il_append(brute, i);
+            }
+            CuAssertIntEquals(tc, il_size(brute), N);
+            for (i=0; i<N; i++)
+                CuAssertIntEquals(tc, il_get(brute, i), il_get(inds, i));
+            il_free(inds);
+            il_free(brute);
+        }
+    }
+}
+
+void test_annotation_bright_stars(CuTest* tc) {
+    int c, r, i;
+    for (c=0; c<sizeof(ras)/sizeof(double); c++) {
+        for (r=0; r<sizeof(radii)/sizeof(double); r++) {
+            il* inds = il_new(256);
+            il* brute = il_new(256);
+            int N = annotation_catalogs_bright_stars(ras[c], decs[c],
+                                                     radii[r], inds);
+            for (i=0; i<bright_stars_n(); i++) {
+                const brightstar_t* bs = bright_stars_get(i);
+                if (deg_between_radecdeg(ras[c], decs[c], bs->ra, bs->dec)
+                    <= radii[r])
+                    il_append(brute, i);
+            }
+            CuAssertIntEquals(tc, il_size(brute), N);
+            for (i=0; i<N; i++)
+                CuAssertIntEquals(tc, il_get(brute, i), il_get(inds, i));
+            il_free(inds);
+            il_free(brute);
+        }
+    }
+}
+
+void test_annotation_constellations(CuTest* tc) {
+    int c, r, i, j;
+    for (c=0; c<sizeof(ras)/sizeof(double); c++) {
+        for (r=0; r<sizeof(radii)/sizeof(double); r++) {
+            il* inds = il_new(16);
+            annotation_catalogs_constellations(ras[c], decs[c], radii[r], inds);
+            // every constellation with a star in the cone is found.
+            for (i=0; i<constellations_n(); i++) {
+                il* stars = constellations_get_unique_stars(i);
+                for (j=0; j<il_size(stars); j++) {
+                    double ra, dec;
+                    constellations_get_star_radec(il_get(stars, j), &ra, &dec);
+                    if (deg_between_radecdeg(ras[c], decs[c], ra, dec)
+                        > radii[r])
+                        continue;
+                    CuAssert(tc, "constellation", il_contains(inds, i));
+                    break;
+                }
+                il_free(stars);
+            }
+            il_free(inds);
+        }
+    }
+    // the whole sky
+    {
+        il* inds = il_new(16);
+        annotation_catalogs_constellations(0, 0, 180, inds);
+        CuAssertIntEquals(tc, constellations_n(), il_size(inds));
+        il_free(inds);
+    }
+    annotation_catalogs_free();
+}
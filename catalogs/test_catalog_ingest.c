@@ -0,0 +1,163 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "os-features.h"
+#include "cutest.h"
+#include "catalog-ingest.h"
+#include "fitstable.h"
+#include "fitsioutils.h"
+#include "healpix.h"
+#include "ioutils.h"
+#include "mathutil.h"
+#include "log.h"
+
+#define NFILES 10
+#define NPERFILE 500
+#define NSIDE 1
+
+struct entry {
+    double ra;
+    double dec;
+    int64_t id;
+};
+
+static fitstable_t* open_output(const char* fn, int hp, void* token) {
+    fitstable_t* tab = fitstable_open_for_writing(fn);
+    if (!tab)
+        return NULL;
+    fitstable_add_write_column(tab, fitscolumn_double_type(), "RA", "deg");
+    fitstable_add_write_column(tab, fitscolumn_double_type(), "DEC", "deg");
+    fitstable_add_write_column(tab, fitscolumn_i64_type(), "ID", "");
+    if (fitstable_write_primary_header(tab) ||
+        fitstable_write_header(tab)) {
+        fitstable_close(tab);
+        return NULL;
+    }
+    return tab;
+}
+
+static int write_entry(fitstable_t* tab, const void* v, void* token) {
+    const struct entry* e = v;
+    return fitstable_write_row(tab, &e->ra, &e->dec, &e->id);
+}
+
+static int close_output(fitstable_t* tab, void* token) {
+    if (fitstable_fix_header(tab)) {
+        fitstable_close(tab);
+        return -1;
+    }
+    return fitstable_close(tab);
+}
+
+// Input files are lines of "id ra dec".
+static int read_file(catalog_ingest_worker_t* w, const char* infn,
+                     int filenum, void* token) {
+    FILE* f = fopen(infn, "r");
+    struct entry e;
+    long long id;
+    if (!f)
+        return -1;
+    while (fscanf(f, "%lld %lf %lf", &id, &e.ra, &e.dec) == 3) {
+        e.id = id;
+        if (catalog_ingest_write(w, radecdegtohealpix(e.ra, e.dec, NSIDE),
+                                 &e)) {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int run(char** infns, const char* outfn, int nthreads) {
+    catalog_ingest_t ci;
+    catalog_ingest_init(&ci);
+    ci.outfn = outfn;
+    ci.nhp = 12 * NSIDE * NSIDE;
+    ci.entrysize = sizeof(struct entry);
+    ci.nthreads = nthreads;
+    // small enough that each file is spilled in several pieces.
+    ci.membudget = 4096;
+    ci.open_output = open_output;
+    ci.write_entry = write_entry;
+    ci.close_output = close_output;
+    ci.read_file = read_file;
+    if (catalog_ingest_run(&ci, infns, NFILES))
+        return -1;
+    return (ci.nwritten == NFILES * NPERFILE) ? 0 : -1;
+}
+
+void test_catalog_ingest_threads(CuTest* tc) {
+    char* infns[NFILES];
+    char fn1[256], fn2[256];
+    unsigned int seed = 42;
+    int i, j, k, hp, ntotal = 0;
+
+    log_init(LOG_ERROR);
+    for (i=0; i<NFILES; i++) {
+        FILE* f;
+        infns[i] = create_temp_file("test-ingest", "/tmp");
+        CuAssertPtrNotNull(tc, infns[i]);
+        f = fopen(infns[i], "w");
+        CuAssertPtrNotNull(tc, f);
+        for (j=0; j<NPERFILE; j++)
+            fprintf(f, "%i %.12f %.12f\n", i * NPERFILE + j,
+                    uniform_sample_r(&seed, 0, 360),
+                    uniform_sample_r(&seed, -90, 90));
+        fclose(f);
+    }
+
+    CuAssertIntEquals(tc, 0, run(infns, "/tmp/test-ingest-1-%02i.fits", 1));
+    CuAssertIntEquals(tc, 0, run(infns, "/tmp/test-ingest-4-%02i.fits", 4));
+
+    for (hp=0; hp<12 * NSIDE * NSIDE; hp++) {
+        fitstable_t *t1, *t2;
+        int N;
+        sprintf(fn1, "/tmp/test-ingest-1-%02i.fits", hp);
+        sprintf(fn2, "/tmp/test-ingest-4-%02i.fits", hp);
+        // (the headers carry the time they were written, so compare
+        // the rows rather than the files.)
+        t1 = fitstable_open(fn1);
+        t2 = fitstable_open(fn2);
+        CuAssertPtrNotNull(tc, t1);
+        CuAssertPtrNotNull(tc, t2);
+        N = fitstable_nrows(t1);
+        CuAssertIntEquals(tc, N, fitstable_nrows(t2));
+        for (k=0; k<3; k++) {
+            const char* cols[] = { "RA", "DEC", "ID" };
+            tfits_type type = (k == 2) ? fitscolumn_i64_type() :
+                fitscolumn_double_type();
+            char* col1 = fitstable_read_column(t1, cols[k], type);
+            char* col2 = fitstable_read_column(t2, cols[k], type);
+            CuAssertPtrNotNull(tc, col1);
+            CuAssertPtrNotNull(tc, col2);
+            CuAssert(tc, "same output", memcmp(col1, col2, N * 8) == 0);
+            // rows are in input order.
+            if (k == 2) {
+                int64_t* id = (int64_t*)col1;
+                for (j=1; j<N; j++)
+                    CuAssert(tc, "input order", id[j-1] < id[j]);
+            }
+            free(col1);
+            free(col2);
+        }
+        ntotal += N;
+        fitstable_close(t1);
+        fitstable_close(t2);
+        unlink(fn1);
+        unlink(fn2);
+    }
+    CuAssertIntEquals(tc, NFILES * NPERFILE, ntotal);
+
+    for (i=0; i<NFILES; i++) {
+        unlink(infns[i]);
+        free(infns[i]);
+    }
+}
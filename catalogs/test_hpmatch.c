@@ -0,0 +1,181 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "os-features.h"
+#include "cutest.h"
+#include "hpmatch.h"
+#include "fitstable.h"
+#include "healpix.h"
+#include "ioutils.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "permutedsort.h"
+#include "log.h"
+
+#define N1 800
+#define N2 1000
+#define NSIDE 64
+// arcsec
+#define RADIUS 300.0
+
+// Rows without a finite position, appended to both catalogs.
+#define NBAD 4
+
+static char* write_catalog(const double* ra, const double* dec, int N) {
+    char* fn = create_temp_file("test-hpmatch", "/tmp");
+    fitstable_t* tab = fitstable_open_for_writing(fn);
+    double badra[NBAD]  = { NAN, INFINITY, 45.0, -INFINITY };
+    double baddec[NBAD] = { 42.0, 42.0, NAN, NAN };
+    int i;
+    if (!tab)
+        return NULL;
+    fitstable_add_write_column(tab, fitscolumn_double_type(), "RA", "deg");
+    fitstable_add_write_column(tab, fitscolumn_double_type(), "DEC", "deg");
+    if (fitstable_write_primary_header(tab) ||
+        fitstable_write_header(tab))
+        return NULL;
+    for (i=0; i<N; i++)
+        if (fitstable_write_row(tab, ra + i, dec + i))
+            return NULL;
+    for (i=0; i<NBAD; i++)
+        if (fitstable_write_row(tab, badra + i, baddec + i))
+            return NULL;
+    if (fitstable_fix_header(tab) || fitstable_close(tab))
+        return NULL;
+    return fn;
+}
+
+// Reads the matches as sorted (row1 * N2 + row2) keys.
+static int64_t* read_matches(const char* fn, int* pN) {
+    fitstable_t* tab = fitstable_open(fn);
+    int64_t* row1;
+    int64_t* row2;
+    int64_t* keys;
+    int* perm;
+    int i, N;
+    if (!tab)
+        return NULL;
+    N = fitstable_nrows(tab);
+    row1 = fitstable_read_column(tab, "ROW1", fitscolumn_i64_type());
+    row2 = fitstable_read_column(tab, "ROW2", fitscolumn_i64_type());
+    fitstable_close(tab);
+    keys = malloc(MAX(N, 1) * sizeof(int64_t));
+    for (i=0; i<N; i++)
+        keys[i] = row1[i] * N2 + row2[i];
+    perm = permuted_sort(keys, sizeof(int64_t), compare_int64_asc, NULL, N);
+    permutation_apply(perm, N, keys, keys, sizeof(int64_t));
+    free(perm);
+    free(row1);
+    free(row2);
+    *pN = N;
+    return keys;
+}
+
+static void check_match(CuTest* tc, const char* fn1, const char* fn2,
+                        anbool nearest, int nthreads, size_t budget,
+                        const int64_t* truth, int Ntruth) {
+    hpmatch_params_t p;
+    char* outfn = create_temp_file("test-hpmatch-out", "/tmp");
+    int64_t* got;
+    int i, N = 0;
+
+    hpmatch_params_init(&p);
+    p.radius = arcsec2deg(RADIUS);
+    p.nearest = nearest;
+    p.nside = NSIDE;
+    p.nthreads = nthreads;
+    p.membudget = budget;
+    CuAssertIntEquals(tc, 0, hpmatch_run(&p, fn1, fn2, outfn));
+    CuAssertIntEquals(tc, Ntruth, (int)p.nmatches);
+    CuAssertIntEquals(tc, 2 * NBAD, (int)p.nskipped);
+    got = read_matches(outfn, &N);
+    CuAssertPtrNotNull(tc, got);
+    CuAssertIntEquals(tc, Ntruth, N);
+    for (i=0; i<N; i++)
+        CuAssertIntEquals(tc, (int)truth[i], (int)got[i]);
+    free(got);
+    unlink(outfn);
+    free(outfn);
+}
+
+void test_hpmatch_brute_force(CuTest* tc) {
+    double ra1[N1], dec1[N1], ra2[N2], dec2[N2];
+    double xyz1[N1*3], xyz2[N2*3];
+    int64_t all[N1*8], near[N1];
+    int nall = 0, nnear = 0, ncross = 0;
+    double r2 = arcsec2distsq(RADIUS);
+    unsigned int seed = 42;
+    char *fn1, *fn2;
+    int i, j;
+
+    log_init(LOG_ERROR);
+    // A 10x10-degree patch, covering many Nside-64 healpixes, so that
+    // many matches straddle cell boundaries.
+    for (i=0; i<N1; i++) {
+        ra1[i] = uniform_sample_r(&seed, 40, 50);
+        dec1[i] = uniform_sample_r(&seed, 37, 47);
+    }
+    // The second catalog: jittered copies of the first, some beyond the
+    // radius, plus some unrelated stars.
+    for (i=0; i<N2; i++) {
+        if (i < N1) {
+            double d = arcsec2deg(1.5 * RADIUS);
+            ra2[i] = ra1[i] + uniform_sample_r(&seed, -d, d);
+            dec2[i] = dec1[i] + uniform_sample_r(&seed, -d, d);
+        } else {
+            ra2[i] = uniform_sample_r(&seed, 40, 50);
+            dec2[i] = uniform_sample_r(&seed, 37, 47);
+        }
+    }
+    for (i=0; i<N1; i++)
+        radecdeg2xyzarr(ra1[i], dec1[i], xyz1 + 3*i);
+    for (i=0; i<N2; i++)
+        radecdeg2xyzarr(ra2[i], dec2[i], xyz2 + 3*i);
+
+    // brute force, in (row1, row2) order.
+    for (i=0; i<N1; i++) {
+        int best = -1;
+        double bestd2 = 0;
+        for (j=0; j<N2; j++) {
+            double d2 = distsq(xyz1 + 3*i, xyz2 + 3*j, 3);
+            if (d2 > r2)
+                continue;
+            CuAssert(tc, "room for matches", nall < N1*8);
+            all[nall++] = (int64_t)i * N2 + j;
+            if (xyzarrtohealpix(xyz1 + 3*i, NSIDE) !=
+                xyzarrtohealpix(xyz2 + 3*j, NSIDE))
+                ncross++;
+            if (best == -1 || d2 < bestd2) {
+                best = j;
+                bestd2 = d2;
+            }
+        }
+        if (best != -1)
+            near[nnear++] = (int64_t)i * N2 + best;
+    }
+    CuAssert(tc, "matches", nall > N1 / 2);
+    CuAssert(tc, "matches across healpix boundaries", ncross > 10);
+
+    fn1 = write_catalog(ra1, dec1, N1);
+    fn2 = write_catalog(ra2, dec2, N2);
+    CuAssertPtrNotNull(tc, fn1);
+    CuAssertPtrNotNull(tc, fn2);
+
+    check_match(tc, fn1, fn2, FALSE, 1, 1 << 20, all, nall);
+    // several threads, and a budget small enough to spill.
+    check_match(tc, fn1, fn2, FALSE, 4, 8192, all, nall);
+    check_match(tc, fn1, fn2, TRUE, 3, 8192, near, nnear);
+
+    unlink(fn1);
+    unlink(fn2);
+    free(fn1);
+    free(fn2);
+}
@@ -18,8 +18,10 @@
 #include "healpix.h"
 #include "boilerplate.h"
 #include "fitsioutils.h"
+#include "catalog-ingest.h"
+#include "log.h"
 
-#define OPTIONS "ho:HN:"
+#define OPTIONS "ho:HN:j:M:t:"
 
 void print_help(char* progname) {
     BOILERPLATE_HELP_HEADER(stdout);
@@ -27,20 +29,176 @@ void print_help(char* progname) {
            "  %s -o <output-filename(-template)>   (eg, tycho2_hp%%02i.fits if you use the -H option)\n"
            "  [-H]: do healpixification\n"
            "  [-N <healpix-nside>]\n"
+           "  [-j <threads>]  (default = 1)\n"
+           "  [-M <memory budget in MB>]  (with -j; default = 256)\n"
+           "  [-t <temp dir>]  (with -j; default = /tmp)\n"
            "  <input-file> [<input-file> ...]\n\n"
            "(Healpixification isn't usually necessary because the Tycho-2 catalog is small.)\n\n",
            progname);
 }
 
 
+struct tycho2_token {
+    int Nside;
+    int do_hp;
+    int argc;
+    char** args;
+    // per input file
+    int* nrecords;
+    int* nobs;
+};
+
+static fitstable_t* open_output(const char* fn, int hp, void* token) {
+    struct tycho2_token* tt = token;
+    tycho2_fits* tyc;
+    qfits_header* hdr;
+
+    tyc = tycho2_fits_open_for_writing((char*)fn);
+    if (!tyc) {
+        fprintf(stderr, "Failed to initialized FITS output file %s.\n", fn);
+        return NULL;
+    }
+    hdr = tycho2_fits_get_header(tyc);
+
+    // header remarks...
+    qfits_header_add(hdr, "HEALPIXD", (tt->do_hp ? "T" : "F"), "Is this catalog healpixified?", NULL);
+    if (tt->do_hp) {
+        fits_header_add_int(hdr, "HEALPIX", hp, "The healpix number of this catalog.");
+        fits_header_add_int(hdr, "NSIDE", tt->Nside, "The healpix resolution.");
+    }
+
+    BOILERPLATE_ADD_FITS_HEADERS(hdr);
+
+    qfits_header_add(hdr, "HISTORY", "Created by the program \"tycho2tofits\"", NULL, NULL);
+    qfits_header_add(hdr, "HISTORY", "tycho2tofits command line:", NULL, NULL);
+    fits_add_args(hdr, tt->args, tt->argc);
+    qfits_header_add(hdr, "HISTORY", "(end of command line)", NULL, NULL);
+
+    if (tycho2_fits_write_headers(tyc)) {
+        fprintf(stderr, "Failed to write header for FITS file %s.\n", fn);
+        tycho2_fits_close(tyc);
+        return NULL;
+    }
+    return tyc;
+}
+
+static int write_entry(fitstable_t* tab, const void* entry, void* token) {
+    if (tycho2_fits_write_entry(tab, (tycho2_entry*)entry)) {
+        fprintf(stderr, "Failed to write Tycho-2 FITS entry.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int close_output(fitstable_t* tab, void* token) {
+    if (tycho2_fits_fix_headers(tab) ||
+        tycho2_fits_close(tab)) {
+        fprintf(stderr, "Failed to close Tycho-2 FITS file.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int read_file(catalog_ingest_worker_t* w, const char* infn,
+                     int filenum, void* token) {
+    struct tycho2_token* tt = token;
+    FILE* fid;
+    char* map;
+    size_t map_size;
+    int i;
+    anbool supplement;
+    int recsize;
+    int rtn = -1;
+
+    fid = fopen(infn, "rb");
+    if (!fid) {
+        fprintf(stderr, "Couldn't open input file %s: %s\n", infn, strerror(errno));
+        return -1;
+    }
+
+    if (fseeko(fid, 0, SEEK_END)) {
+        fprintf(stderr, "Couldn't seek to end of input file %s: %s\n", infn, strerror(errno));
+        fclose(fid);
+        return -1;
+    }
+    map_size = ftello(fid);
+    fseeko(fid, 0, SEEK_SET);
+    map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fileno(fid), 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Couldn't mmap input file %s: %s\n", infn, strerror(errno));
+        fclose(fid);
+        return -1;
+    }
+    fclose(fid);
+
+    supplement = tycho2_guess_is_supplement(map);
+
+    if (supplement) {
+        recsize = TYCHO_SUPPLEMENT_RECORD_SIZE_RAW;
+    } else {
+        recsize = TYCHO_RECORD_SIZE_RAW;
+    }
+
+    if ((map_size % recsize) && (map_size % (recsize+1)) && (map_size % (recsize+2))) {
+        fprintf(stderr, "Warning, input file %s has size %u which is not divisible into %i-, %i-, or %i-byte records.\n",
+                infn, (uint)map_size, recsize, recsize+1, recsize+2);
+    }
+
+    for (i=0; i<map_size;) {
+        tycho2_entry entry;
+        int hp;
+
+        if (supplement) {
+            if (tycho2_supplement_parse_entry(map + i, &entry)) {
+                fprintf(stderr, "Failed to parse TYCHO-2 supplement entry: offset %i in file %s.\n",
+                        i, infn);
+                goto bailout;
+            }
+        } else {
+            if (tycho2_parse_entry(map + i, &entry)) {
+                fprintf(stderr, "Failed to parse TYCHO-2 entry: offset %i in file %s.\n",
+                        i, infn);
+                goto bailout;
+            }
+        }
+        //printf("RA, DEC (%g, %g)\n", entry.RA, entry.DEC);
+
+        i += recsize;
+        // skip past "\r" and "\n".
+        while ((i < map_size) &&
+               ((map[i] == '\r') || (map[i] == '\n')))
+            i++;
+
+        if (tt->do_hp) {
+            hp = radectohealpix(deg2rad(entry.ra), deg2rad(entry.dec), tt->Nside);
+        } else {
+            hp = 0;
+        }
+
+        if (catalog_ingest_write(w, hp, &entry))
+            goto bailout;
+
+        tt->nrecords[filenum]++;
+        tt->nobs[filenum] += entry.nobs;
+    }
+    rtn = 0;
+ bailout:
+    munmap(map, map_size);
+    return rtn;
+}
+
 int main(int argc, char** args) {
     char* outfn = NULL;
     int c;
     int nrecords, nobs;
     int Nside = 8;
-    tycho2_fits** tycs;
-    int i, HP;
+    int i, ninfns;
     int do_hp = 0;
+    int nthreads = 1;
+    double membudget = 0;
+    char* tempdir = NULL;
+    struct tycho2_token tt;
+    catalog_ingest_t ci;
 
     while ((c = getopt(argc, args, OPTIONS)) != -1) {
         switch (c) {
@@ -57,6 +215,15 @@ int main(int argc, char** args) {
         case 'o':
             outfn = optarg;
             break;
+        case 'j':
+            nthreads = atoi(optarg);
+            break;
+        case 'M':
+            membudget = atof(optarg);
+            break;
+        case 't':
+            tempdir = optarg;
+            break;
         }
     }
 
@@ -71,161 +238,45 @@ int main(int argc, char** args) {
         exit(-1);
     }
 
-    if (do_hp) {
-        HP = 12 * Nside * Nside;
-    } else {
-        HP = 1;
-    }
-		
-    tycs = malloc(HP * sizeof(tycho2_fits*));
-    memset(tycs, 0, HP * sizeof(tycho2_fits*));
-
-    nrecords = 0;
-    nobs = 0;
-
-    printf("Reading Tycho-2 files... \n");
-    fflush(stdout);
-
-    for (; optind<argc; optind++) {
-        char* infn;
-        FILE* fid;
-        char* map;
-        size_t map_size;
-        int i;
-        anbool supplement;
-        int recsize;
-
-        infn = args[optind];
-        fid = fopen(infn, "rb");
-        if (!fid) {
-            fprintf(stderr, "Couldn't open input file %s: %s\n", infn, strerror(errno));
-            exit(-1);
-        }
-
-        if (fseeko(fid, 0, SEEK_END)) {
-            fprintf(stderr, "Couldn't seek to end of input file %s: %s\n", infn, strerror(errno));
-            exit(-1);
-        }
-        map_size = ftello(fid);
-        fseeko(fid, 0, SEEK_SET);
-        map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fileno(fid), 0);
-        if (map == MAP_FAILED) {
-            fprintf(stderr, "Couldn't mmap input file %s: %s\n", infn, strerror(errno));
-            exit(-1);
-        }
-        fclose(fid);
-
-        supplement = tycho2_guess_is_supplement(map);
-        printf("File %s: supplement format: %s\n", infn, (supplement ? "Yes" : "No"));
-
-        if (supplement) {
-            recsize = TYCHO_SUPPLEMENT_RECORD_SIZE_RAW;
-        } else {
-            recsize = TYCHO_RECORD_SIZE_RAW;
-        }
-
-        if ((map_size % recsize) && (map_size % (recsize+1)) && (map_size % (recsize+2))) {
-            fprintf(stderr, "Warning, input file %s has size %u which is not divisible into %i-, %i-, or %i-byte records.\n",
-                    infn, (uint)map_size, recsize, recsize+1, recsize+2);
-        }
-
-        for (i=0; i<map_size;) {
-            tycho2_entry entry;
-            int hp;
-
-            if (supplement) {
-                if (tycho2_supplement_parse_entry(map + i, &entry)) {
-                    fprintf(stderr, "Failed to parse TYCHO-2 supplement entry: offset %i in file %s.\n",
-                            i, infn);
-                    exit(-1);
-                }
-            } else {
-                if (tycho2_parse_entry(map + i, &entry)) {
-                    fprintf(stderr, "Failed to parse TYCHO-2 entry: offset %i in file %s.\n",
-                            i, infn);
-                    exit(-1);
-                }
-            }
-            //printf("RA, DEC (%g, %g)\n", entry.RA, entry.DEC);
-
-            i += recsize;
-            // skip past "\r" and "\n".
-            while ((i < map_size) &&
-                   ((map[i] == '\r') || (map[i] == '\n')))
-                i++;
-
-            if (do_hp) {
-                hp = radectohealpix(deg2rad(entry.ra), deg2rad(entry.dec), Nside);
-            } else {
-                hp = 0;
-            }
-
-            if (!tycs[hp]) {
-                char fn[256];
-                qfits_header* hdr;
-                sprintf(fn, outfn, hp);
-                tycs[hp] = tycho2_fits_open_for_writing(fn);
-                if (!tycs[hp]) {
-                    fprintf(stderr, "Failed to initialized FITS output file %s.\n", fn);
-                    exit(-1);
-                }
-                hdr = tycho2_fits_get_header(tycs[hp]);
-
-                // header remarks...
-                qfits_header_add(hdr, "HEALPIXD", (do_hp ? "T" : "F"), "Is this catalog healpixified?", NULL);
-                if (do_hp) {
-                    fits_header_add_int(hdr, "HEALPIX", hp, "The healpix number of this catalog.");
-                    fits_header_add_int(hdr, "NSIDE", Nside, "The healpix resolution.");
-                }
-
-                BOILERPLATE_ADD_FITS_HEADERS(hdr);
-
-                qfits_header_add(hdr, "HISTORY", "Created by the program \"tycho2tofits\"", NULL, NULL);
-                qfits_header_add(hdr, "HISTORY", "tycho2tofits command line:", NULL, NULL);
-                fits_add_args(hdr, args, argc);
-                qfits_header_add(hdr, "HISTORY", "(end of command line)", NULL, NULL);
-
-                if (tycho2_fits_write_headers(tycs[hp])) {
-                    fprintf(stderr, "Failed to write header for FITS file %s.\n", fn);
-                    exit(-1);
-                }
-            }
-
-            if (tycho2_fits_write_entry(tycs[hp], &entry)) {
-                fprintf(stderr, "Failed to write Tycho-2 FITS entry.\n");
-                exit(-1);
-            }
-
-            if (i && ((i/recsize) % 100000 == 0)) {
-                printf(".");
-                fflush(stdout);
-            }
-
-            nrecords++;
-            nobs += entry.nobs;
-        }
-
-        munmap(map, map_size);
-
-        printf(".");
-        fflush(stdout);
+    ninfns = argc - optind;
+    tt.Nside = Nside;
+    tt.do_hp = do_hp;
+    tt.argc = argc;
+    tt.args = args;
+    tt.nrecords = calloc(ninfns, sizeof(int));
+    tt.nobs = calloc(ninfns, sizeof(int));
+
+    catalog_ingest_init(&ci);
+    ci.outfn = outfn;
+    ci.nhp = (do_hp ? 12 * Nside * Nside : 1);
+    ci.entrysize = sizeof(tycho2_entry);
+    ci.nthreads = nthreads;
+    if (membudget > 0)
+        ci.membudget = (size_t)(membudget * 1024 * 1024);
+    if (tempdir)
+        ci.tempdir = tempdir;
+    ci.open_output = open_output;
+    ci.write_entry = write_entry;
+    ci.close_output = close_output;
+    ci.read_file = read_file;
+    ci.token = &tt;
+
+    printf("Reading Tycho-2 files...\n");
+    log_init(LOG_MSG);
+
+    if (catalog_ingest_run(&ci, args + optind, ninfns)) {
+        fprintf(stderr, "Failed to convert Tycho-2 files.\n");
+        exit(-1);
     }
-    printf("\n");
 
-    // close all the files...
-    for (i=0; i<HP; i++) {
-        if (!tycs[i])
-            continue;
-        if (tycho2_fits_fix_headers(tycs[i]) ||
-            tycho2_fits_close(tycs[i])) {
-            fprintf(stderr, "Failed to close Tycho-2 FITS file.\n");
-            exit(-1);
-        }
+    nrecords = nobs = 0;
+    for (i=0; i<ninfns; i++) {
+        nrecords += tt.nrecords[i];
+        nobs += tt.nobs[i];
     }
-	
     printf("Read %u records, %u observations.\n", nrecords, nobs);
-	
-    free(tycs);
+
+    free(tt.nrecords);
+    free(tt.nobs);
     return 0;
 }
-
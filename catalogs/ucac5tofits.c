@@ -28,8 +28,9 @@
 #include "log.h"
 #include "errors.h"
 #include "boilerplate.h"
+#include "catalog-ingest.h"
 
-#define OPTIONS "ho:N:e:m:f:"
+#define OPTIONS "ho:N:e:m:f:j:M:t:"
 
 void print_help(char* progname) {
     BOILERPLATE_HELP_HEADER(stdout);
@@ -39,6 +40,9 @@ void print_help(char* progname) {
            "  [-e <epoch in years>]             (default = UCAC epoch)\n"
            "  [-m <margin in degrees>]          (default = 0)\n"
            "  [-f <1 = include tag-along data>] (default = 0)\n"
+           "  [-j <threads>]                    (default = 1)\n"
+           "  [-M <memory budget in MB>]        (with -j; default = 256)\n"
+           "  [-t <temp dir>]                   (with -j; default = /tmp)\n"
            "  <input-file> [<input-file> ...]\n"
            "\n"
            "The output-filename-template should contain a \"printf\" sequence like \"%%03i\";\n"
@@ -52,19 +56,140 @@ void print_help(char* progname) {
 }
 
 
+struct ucac5_token {
+    int Nside;
+    float epoch;
+    double margin;
+    anbool full;
+    int argc;
+    char** args;
+    int ninfns;
+};
+
+static fitstable_t* open_output(const char* fn, int hp, void* token) {
+    struct ucac5_token* ut = token;
+    ucac5_fits* ucac;
+
+    ucac = ucac5_fits_open_for_writing((char*)fn, ut->full);
+    if (!ucac) {
+        ERROR("Failed to initialize FITS file %i (filename %s)", hp, fn);
+        return NULL;
+    }
+    fits_header_add_int(ucac->header, "HEALPIX", hp, "The healpix number of this catalog.");
+    fits_header_add_int(ucac->header, "NSIDE", ut->Nside ? ut->Nside : 1, "The healpix resolution.");
+    BOILERPLATE_ADD_FITS_HEADERS(ucac->header);
+    qfits_header_add(ucac->header, "HISTORY", "Created by the program \"ucac5tofits\"", NULL, NULL);
+    qfits_header_add(ucac->header, "HISTORY", "ucac5tofits command line:", NULL, NULL);
+    fits_add_args(ucac->header, ut->args, ut->argc);
+    qfits_header_add(ucac->header, "HISTORY", "(end of command line)", NULL, NULL);
+    if (ucac5_fits_write_headers(ucac)) {
+        ERROR("Failed to write header for FITS file %s", fn);
+        ucac5_fits_close(ucac);
+        return NULL;
+    }
+    return ucac;
+}
+
+static int write_entry(fitstable_t* tab, const void* entry, void* token) {
+    if (ucac5_fits_write_entry(tab, (ucac5_entry*)entry)) {
+        ERROR("Failed to write FITS entry");
+        return -1;
+    }
+    return 0;
+}
+
+static int close_output(fitstable_t* tab, void* token) {
+    if (ucac5_fits_fix_headers(tab) ||
+        ucac5_fits_close(tab)) {
+        ERROR("Failed to close FITS file");
+        return -1;
+    }
+    return 0;
+}
+
+#define NRECBUF 4096
+
+static int read_file(catalog_ingest_worker_t* w, const char* infn,
+                     int filenum, void* token) {
+    struct ucac5_token* ut = token;
+    FILE* fid;
+    char* buf;
+    int i = 0;
+    int rtn = -1;
+
+    fid = fopen(infn, "rb");
+    if (!fid) {
+        SYSERROR("Couldn't open input file \"%s\"", infn);
+        return -1;
+    }
+    buf = malloc(NRECBUF * UCAC5_RECORD_SIZE);
+    if (!buf) {
+        SYSERROR("Failed to allocate read buffer");
+        fclose(fid);
+        return -1;
+    }
+
+    for (;;) {
+        size_t j, nr;
+
+        nr = fread(buf, UCAC5_RECORD_SIZE, NRECBUF, fid);
+        if (nr < NRECBUF && ferror(fid)) {
+            SYSERROR("Error reading input file \"%s\".", infn);
+            goto bailout;
+        }
+        for (j=0; j<nr; j++, i++) {
+            ucac5_entry entry;
+            int ihp;
+            il *hplist;
+
+            if (ucac5_parse_entry(&entry, buf + j * UCAC5_RECORD_SIZE, ut->epoch)) {
+                ERROR("Failed to parse UCAC5 entry %i in file \"%s\".", i, infn);
+                goto bailout;
+            }
+
+            if (ut->Nside) {
+                if (ut->margin > 0.0)
+                    hplist = healpix_rangesearch_radec(entry.ra, entry.dec, ut->margin, ut->Nside, NULL);
+                else {
+                    int hp = radecdegtohealpix(entry.ra, entry.dec, ut->Nside);
+                    hplist = il_new(1);
+                    il_append(hplist, hp);
+                }
+            }
+            else {
+                hplist = il_new(1);
+                il_append(hplist, 0);
+            }
+            for (ihp=0; ihp<il_size(hplist); ihp++) {
+                if (catalog_ingest_write(w, il_get(hplist, ihp), &entry)) {
+                    il_free(hplist);
+                    goto bailout;
+                }
+            }
+            il_free(hplist);
+        }
+        if (nr < NRECBUF)
+            break;
+    }
+    rtn = 0;
+ bailout:
+    free(buf);
+    fclose(fid);
+    return rtn;
+}
+
 int main(int argc, char** args) {
     char* outfn = "ucac5_%02i.fits";
     int c;
-    int startoptind;
-    int nrecords, nfiles;
     int Nside = 0;
     float epoch = 0.0;
     double margin = 0.0;
     anbool full = FALSE;
-
-    ucac5_fits** ucacs;
-
-    int i, HP;
+    int nthreads = 1;
+    double membudget = 0;
+    char* tempdir = NULL;
+    struct ucac5_token ut;
+    catalog_ingest_t ci;
 
     while ((c = getopt(argc, args, OPTIONS)) != -1) {
         switch (c) {
@@ -87,6 +212,15 @@ int main(int argc, char** args) {
             case 'o':
                 outfn = optarg;
                 break;
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 'M':
+                membudget = atof(optarg);
+                break;
+            case 't':
+                tempdir = optarg;
+                break;
         }
     }
 
@@ -101,124 +235,42 @@ int main(int argc, char** args) {
         print_help(args[0]);
         exit(-1);
     }
+
+    catalog_ingest_init(&ci);
     if (Nside) {
-        HP = 12 * Nside * Nside;
-        printf("Nside = %i, using %i healpixes.\n", Nside, HP);
+        ci.nhp = 12 * Nside * Nside;
+        printf("Nside = %i, using %i healpixes.\n", Nside, ci.nhp);
     }
     else {
-        HP = 1;
+        ci.nhp = 1;
         printf("Using one all-sky healpix.\n");
     }
-    ucacs = calloc(HP, sizeof(ucac5_fits*));
-    nrecords = 0;
-    nfiles = 0;
-
-    startoptind = optind;
-    for (; optind<argc; optind++) {
-        char* infn;
-        FILE* fid;
-        int i;
-
-        infn = args[optind];
-        printf("Reading %s\n", infn);
-        if ((optind > startoptind) && ((optind - startoptind) % 100 == 0)) {
-            printf("\nReading file %i of %i: %s\n", optind - startoptind,
-                   argc - startoptind, infn);
-        }
-        fflush(stdout);
 
-        fid = fopen(infn, "rb");
-        if (!fid) {
-            SYSERROR("Couldn't open input file \"%s\"", infn);
-            exit(-1);
-        }
+    ut.Nside = Nside;
+    ut.epoch = epoch;
+    ut.margin = margin;
+    ut.full = full;
+    ut.argc = argc;
+    ut.args = args;
+    ut.ninfns = argc - optind;
 
-        for (i=0;; i++) {
-            ucac5_entry entry;
-            il *hplist;
-            char buf[UCAC5_RECORD_SIZE];
-            int nr;
-            anbool eof = 0;
-
-            nr = fread(buf, UCAC5_RECORD_SIZE, 1, fid);
-            if (!nr) {
-                if (feof(fid))
-                    eof = TRUE;
-                else {
-                    SYSERROR("Error reading input file \"%s\".", infn);
-                    exit(-1);
-                }
-            }
+    ci.outfn = outfn;
+    ci.entrysize = sizeof(ucac5_entry);
+    ci.nthreads = nthreads;
+    if (membudget > 0)
+        ci.membudget = (size_t)(membudget * 1024 * 1024);
+    if (tempdir)
+        ci.tempdir = tempdir;
+    ci.open_output = open_output;
+    ci.write_entry = write_entry;
+    ci.close_output = close_output;
+    ci.read_file = read_file;
+    ci.token = &ut;
 
-            if (ucac5_parse_entry(&entry, buf, epoch)) {
-                ERROR("Failed to parse UCAC5 entry %i in file \"%s\".", i, infn);
-                exit(-1);
-            }
-
-            if (Nside) {
-                if (margin > 0.0)
-                    hplist = healpix_rangesearch_radec(entry.ra, entry.dec, margin, Nside, NULL);
-                else {
-                    int hp = radecdegtohealpix(entry.ra, entry.dec, Nside);
-                    hplist = il_new(1);
-                    il_append(hplist, hp);
-                }
-            }
-            else {
-                hplist = il_new(1);
-                il_append(hplist, 0);
-            }
-            for (int ihp=0; ihp<il_size(hplist); ihp++) {
-                int hp = il_get(hplist, ihp);
-                if (!ucacs[hp]) {
-                    char fn[256];
-                    sprintf(fn, outfn, hp);
-                    ucacs[hp] = ucac5_fits_open_for_writing(fn, full);
-                    if (!ucacs[hp]) {
-                        ERROR("Failed to initialize FITS file %i (filename %s)", hp, fn);
-                        exit(-1);
-                    }
-                    fits_header_add_int(ucacs[hp]->header, "HEALPIX", hp, "The healpix number of this catalog.");
-                    fits_header_add_int(ucacs[hp]->header, "NSIDE", Nside ? Nside : 1, "The healpix resolution.");
-                    BOILERPLATE_ADD_FITS_HEADERS(ucacs[hp]->header);
-                    qfits_header_add(ucacs[hp]->header, "HISTORY", "Created by the program \"ucac5tofits\"", NULL, NULL);
-                    qfits_header_add(ucacs[hp]->header, "HISTORY", "ucac5tofits command line:", NULL, NULL);
-                    fits_add_args(ucacs[hp]->header, args, argc);
-                    qfits_header_add(ucacs[hp]->header, "HISTORY", "(end of command line)", NULL, NULL);
-                    if (ucac5_fits_write_headers(ucacs[hp])) {
-                        ERROR("Failed to write header for FITS file %s", fn);
-                        exit(-1);
-                    }
-                }
-                if (ucac5_fits_write_entry(ucacs[hp], &entry)) {
-                    ERROR("Failed to write FITS entry");
-                    exit(-1);
-                }
-                nrecords++;
-            }
-            il_free(hplist);
-
-            if (eof)
-                break;
-        }
-
-        fclose(fid);
-
-        nfiles++;
-        printf("\n");
-    }
-    printf("\n");
-
-    // close all the files...
-    for (i=0; i<HP; i++) {
-        if (!ucacs[i])
-            continue;
-        if (ucac5_fits_fix_headers(ucacs[i]) ||
-            ucac5_fits_close(ucacs[i])) {
-            ERROR("Failed to close file %i", i);
-        }
+    if (catalog_ingest_run(&ci, args + optind, argc - optind)) {
+        ERROR("Failed to convert UCAC5 files");
+        exit(-1);
     }
-    printf("Read %u files, %u records.\n", nfiles, nrecords);
-    free(ucacs);
+    printf("Read %i files, %lld records.\n", ut.ninfns, (long long)ci.nwritten);
     return 0;
 }
@@ -0,0 +1,56 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef ANNOTATION_CATALOGS_H
+#define ANNOTATION_CATALOGS_H
+
+#include "astrometry/bl.h"
+#include "astrometry/hd.h"
+
+/**
+ Cone searches of the catalogs used to annotate plots (OpenNGC, bright
+ stars, constellations, Henry Draper).
+
+ Each catalog is indexed the first time it is searched -- a kd-tree of
+ its positions, or for constellations, a bounding circle per
+ constellation -- and the index is kept for the life of the process, so
+ that repeated plots only pay for the objects near their field.  Safe
+ to call from several threads.
+
+ The searches append to "inds" the indices of the objects within
+ "radius" degrees of (ra, dec), in increasing order, and return how
+ many they appended.
+ */
+
+// Indices for ngc_get_entry().
+int annotation_catalogs_ngc(double ra, double dec, double radius, il* inds);
+
+// Indices for bright_stars_get().
+int annotation_catalogs_bright_stars(double ra, double dec, double radius,
+                                     il* inds);
+
+// Constellations (indices for constellations_get_*()) any of whose stars
+// may be within "radius".
+int annotation_catalogs_constellations(double ra, double dec, double radius,
+                                       il* inds);
+
+// Center of constellation "con"'s bounding circle (the mean direction of
+// its stars).
+void annotation_catalogs_constellation_center(int con, double* ra,
+                                              double* dec);
+
+/**
+ Returns the Henry Draper catalog in file "fn", opening it the first time
+ it's asked for.  It stays open and belongs to this module -- don't
+ henry_draper_close() it.
+ */
+hd_catalog_t* annotation_catalogs_hd(const char* fn);
+
+/**
+ Frees all the indices and closes the HD catalogs.  Not thread-safe;
+ later searches re-build the indices.
+ */
+void annotation_catalogs_free(void);
+
+#endif
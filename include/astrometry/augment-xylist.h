@@ -62,6 +62,8 @@ struct augment_xylist_s {
     char* scampfn;
     char* wcsfn;
     char* corrfn;
+    // solver instrumentation report (JSON lines)
+    char* statsfn;
     char* keepxylsfn;
     char* pnmfn;
 
@@ -137,6 +139,8 @@ struct augment_xylist_s {
 
     anbool verify_uniformize;
     anbool verify_dedup;
+    // stars in the coarse verification pass; 0 to disable.
+    int verify_coarse;
 
     // try to verify FITS input images?
     anbool try_verify;
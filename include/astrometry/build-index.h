@@ -46,6 +46,9 @@ struct index_params {
     int dimquads;
     int indexid;
 
+    // store the healpix -> quad map (quadmap.h) in the index?
+    anbool quadmap;
+
     // general options
     anbool inmemory;
     anbool delete_tempfiles;
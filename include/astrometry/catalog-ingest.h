@@ -0,0 +1,77 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef CATALOG_INGEST_H
+#define CATALOG_INGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "astrometry/fitstable.h"
+
+/**
+ Shared driver for the "*tofits" catalog converters: reads a list of
+ input files with a pool of worker threads, each of which parses whole
+ files and bins the entries by healpix, and writes one FITS table per
+ healpix using the catalog's own "*-fits" writer.
+
+ With one thread, entries are written straight to the output tables.
+ With more, each worker buffers its entries per healpix and spills them
+ to its own shard file; when all the inputs have been read, the shards
+ are merged into the outputs (also in parallel, one healpix at a time),
+ keeping the rows in input-file order, so the outputs are the same as
+ in the single-threaded case.
+ */
+
+typedef struct catalog_ingest_worker catalog_ingest_worker_t;
+
+struct catalog_ingest {
+    // printf-style filename template, given the healpix number.
+    const char* outfn;
+    // Number of output healpixes (healpix numbers are 0 to nhp-1).
+    int nhp;
+    // Size of the entry structs passed to catalog_ingest_write().
+    int entrysize;
+    int nthreads;
+    // Directory for the shard files; default "/tmp".
+    const char* tempdir;
+    // Total memory for buffered entries (divided among the workers).
+    size_t membudget;
+
+    // Creates output file "fn" for healpix "hp" and writes its headers.
+    fitstable_t* (*open_output)(const char* fn, int hp, void* token);
+    // Writes one entry.
+    int (*write_entry)(fitstable_t* tab, const void* entry, void* token);
+    // Fixes the headers of, and closes, an output file.
+    int (*close_output)(fitstable_t* tab, void* token);
+    // Reads input file number "filenum", calling catalog_ingest_write()
+    // for each entry.  Called from the worker threads, so it must only
+    // touch per-file state, and shouldn't print: the driver logs each
+    // file, in order, as it is finished.
+    int (*read_file)(catalog_ingest_worker_t* w, const char* infn,
+                     int filenum, void* token);
+    void* token;
+
+    // Out: number of entries written, over all healpixes.
+    int64_t nwritten;
+};
+typedef struct catalog_ingest catalog_ingest_t;
+
+/**
+ Sets the defaults: one thread, "/tmp", 256 MB.
+ */
+void catalog_ingest_init(catalog_ingest_t* ci);
+
+/**
+ Converts the "ninfns" files "infns".  Returns 0 on success.
+ */
+int catalog_ingest_run(catalog_ingest_t* ci, char** infns, int ninfns);
+
+/**
+ Adds "entry" to the output for healpix "hp"; for use in read_file().
+ */
+int catalog_ingest_write(catalog_ingest_worker_t* w, int hp,
+                         const void* entry);
+
+#endif
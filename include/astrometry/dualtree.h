@@ -25,6 +25,7 @@
 
 #include "astrometry/starutil.h"
 #include "astrometry/kdtree.h"
+#include "astrometry/bl.h"
 
 typedef anbool (*decision_function)(void* extra, kdtree_t* searchtree, int searchnode,
                                     kdtree_t* querytree, int querynode);
@@ -48,4 +49,33 @@ typedef struct dualtree_callbacks dualtree_callbacks;
 void dualtree_search(kdtree_t* search, kdtree_t* query,
                      dualtree_callbacks* callbacks);
 
+/**
+ A point in the recursion: a query node and the search nodes and leaves
+ still in play for it.
+ */
+struct dualtree_task {
+    int ynode;
+    il* nodes;
+    il* leaves;
+};
+typedef struct dualtree_task dualtree_task_t;
+
+/**
+ Runs the search down to depth "depth" in the query tree (or to a query
+ leaf, if that comes first), and returns the points reached there: a
+ pl of dualtree_task_t*, in left-to-right order.  Only the decision
+ callback is used.
+
+ Running the tasks with dualtree_run_task(), in that order, is the same
+ as dualtree_search(); the tasks are independent, so they can also be
+ run in parallel.
+ */
+pl* dualtree_split(kdtree_t* search, kdtree_t* query, int depth,
+                   dualtree_callbacks* callbacks);
+
+void dualtree_run_task(kdtree_t* search, kdtree_t* query,
+                       dualtree_task_t* task, dualtree_callbacks* callbacks);
+
+void dualtree_free_tasks(pl* tasks);
+
 
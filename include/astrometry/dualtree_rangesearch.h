@@ -8,6 +8,8 @@
 
 extern double RANGESEARCH_NO_LIMIT;
 
+#include <stddef.h>
+
 #include "astrometry/kdtree.h"
 
 // note, 'xind' and 'yind' are indices IN THE KDTREE; to get back to
@@ -28,6 +30,24 @@ void dualtree_rangesearch(kdtree_t* xtree, kdtree_t* ytree,
                           progress_callback progress,
                           void* progress_param);
 
+/**
+ Like dualtree_rangesearch(), but collects the matches instead of
+ calling back, using "nthreads" threads: the query tree is split into
+ subtrees that the threads take in turn, and each subtree's matches go
+ into its own buffer.
+
+ On success, "*pN" is the number of matches, "*pinds" holds their
+ (xind, yind) pairs (2 * N ints) and "*pdist2" their squared distances,
+ in the same order dualtree_rangesearch() would report them.  The
+ arrays must be free()d by the caller.  Returns 0 on success.
+ */
+int dualtree_rangesearch_pairs(kdtree_t* xtree, kdtree_t* ytree,
+                               double mindist, double maxdist,
+                               int notself,
+                               dist2_function distsquared,
+                               int nthreads,
+                               size_t* pN, int** pinds, double** pdist2);
+
 /*
  void dualtree_rangecount(kdtree_t* x, kdtree_t* y,
  double mindist, double maxdist,
@@ -12,6 +12,8 @@
 #include "astrometry/bl.h"
 #include "astrometry/an-bool.h"
 #include "astrometry/index.h"
+#include "astrometry/index-schedule.h"
+#include "astrometry/tracking.h"
 
 struct engine {
     // search paths (directories)
@@ -38,6 +40,17 @@ struct engine {
     float cpulimit;
     char* cancelfn;
     char* solvedfn;
+
+    // If non-NULL, indexes are tried in order of expected time-to-solve
+    // rather than in config-file order.
+    index_schedule_t* schedule;
+    // If > 0, open-ended depth ranges are split into quantums of this
+    // many stars (doubling each time), so that every index gets a look
+    // at the brightest stars before any of them is run to completion.
+    int quantum;
+    // If non-NULL, the jobs are frames of a sequence, and each one
+    // starts from the solution of the previous one.
+    tracking_t* tracking;
 };
 typedef struct engine engine_t;
 
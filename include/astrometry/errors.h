@@ -40,6 +40,12 @@ struct errors {
 
 /***    Global functions    ***/
 
+/*
+ The error-handling state is a stack of err_t; each thread has its own
+ stack, created on first use with the default state (print to stderr).
+ Settings made with errors_log_to(), errors_use_function() etc. apply
+ only to the calling thread.
+ */
 err_t* errors_get_state();
 
 // takes a (deep) snapshot of the current error handling state and pushes it onto the
@@ -72,7 +78,7 @@ void errors_clear_stack();
 
 int errors_print_on_exit(FILE* fid);
 
-// free globals.
+// free the calling thread's error stack.
 void errors_free();
 
 /*
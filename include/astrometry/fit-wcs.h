@@ -18,6 +18,23 @@ int fit_sip_coefficients(const double* starxyz,
                          int inv_order,
                          sip_t* sipout);
 
+/**
+ The SIP fits solve the normal equations by Cholesky, falling back to
+ QR when they look ill-conditioned.  The _flags variants take
+ FIT_SIP_QR to always use QR.
+ */
+#define FIT_SIP_QR 1
+
+int fit_sip_coefficients_flags(const double* starxyz,
+                               const double* fieldxy,
+                               const double* weights,
+                               int M,
+                               const tan_t* tanin1,
+                               int sip_order,
+                               int inv_order,
+                               int flags,
+                               sip_t* sipout);
+
 void wcs_shift(tan_t* wcs, double xs, double ys);
 
 /**
@@ -39,6 +56,17 @@ int fit_sip_wcs(const double* starxyz,
                 sip_t* sipout
                 );
 
+int fit_sip_wcs_flags(const double* starxyz,
+                      const double* fieldxy,
+                      const double* weights,
+                      int M,
+                      const tan_t* tanin,
+                      int sip_order,
+                      int inv_order,
+                      int doshift,
+                      int flags,
+                      sip_t* sipout);
+
 int fit_sip_wcs_2(const double* starxyz,
                   const double* fieldxy,
                   const double* weights,
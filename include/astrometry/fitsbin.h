@@ -168,6 +168,26 @@ qfits_header* fitsbin_get_header(const fitsbin_t* fb, int ext);
 // Reading: how many extensions in this file?  (-> *qfits_query_n_ext)
 int fitsbin_n_ext(const fitsbin_t* fb);
 
+/**
+ How table data is brought into memory when a fitsbin (and so a kd-tree,
+ quad file or index) is read.  This is a process-wide setting.
+
+ FITSBIN_MAP_LAZY (default): mmap; pages are read from disk on first
+   touch.
+ FITSBIN_MAP_POPULATE: mmap, asking the kernel to read the pages in
+   immediately (MAP_POPULATE, or madvise(MADV_WILLNEED) where that
+   isn't available).
+ FITSBIN_MAP_PRELOAD: read the tables into anonymous memory; nothing
+   refers to the file afterward.
+ */
+enum {
+    FITSBIN_MAP_LAZY,
+    FITSBIN_MAP_POPULATE,
+    FITSBIN_MAP_PRELOAD
+};
+void fitsbin_set_map_policy(int policy);
+int fitsbin_get_map_policy(void);
+
 fitsbin_t* fitsbin_open(const char* fn);
 
 fitsbin_t* fitsbin_open_fits(anqfits_t* fits);
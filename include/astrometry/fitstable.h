@@ -254,8 +254,12 @@ int  fitstable_close(fitstable_t*);
 
 int fitstable_ncols(const fitstable_t* t);
 
+// Returns -1 (and reports an error) if the table has more than
+// INT_MAX rows; use fitstable_nrows64() for tables that may be that big.
 int fitstable_nrows(const fitstable_t* t);
 
+int64_t fitstable_nrows64(const fitstable_t* t);
+
 // Returns the size of the row in FITS format.
 int fitstable_row_size(const fitstable_t* t);
 
@@ -350,7 +354,7 @@ void* fitstable_read_column_array_inds(const fitstable_t* tab,
 
 int fitstable_read_column_offset_into(const fitstable_t* tab,
                                       const char* colname, tfits_type read_as_type,
-                                      void* dest, int stride, int start, int N);
+                                      void* dest, int stride, int64_t start, int N);
 
 void* fitstable_read_column(const fitstable_t* tab,
                             const char* colname, tfits_type t);
@@ -378,11 +382,12 @@ int fitstable_write_row_noflip(fitstable_t* table, ...);
 
  (these inputs are not "const" because they update the file offsets)
  */
-int fitstable_read_nrows_data(fitstable_t* table, int row0, int nrows, void* dest);
-int fitstable_read_row_data(fitstable_t* table, int row, void* dest);
+int fitstable_read_nrows_data(fitstable_t* table, int64_t row0, int nrows, void* dest);
+int fitstable_read_row_data(fitstable_t* table, int64_t row, void* dest);
 int fitstable_write_row_data(fitstable_t* table, void* data);
 int fitstable_copy_row_data(fitstable_t* table, int row, fitstable_t* outtable);
 int fitstable_copy_rows_data(fitstable_t* table, int* rows, int Nrows, fitstable_t* outtable);
+int fitstable_copy_rows_data64(fitstable_t* table, const int64_t* rows, int64_t Nrows, fitstable_t* outtable);
 
 /**
  Endian-flips a row of data, IF NECESSARY, according to the current
@@ -0,0 +1,62 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef HPMATCH_H
+#define HPMATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "astrometry/an-bool.h"
+
+/**
+ Cross-matches two FITS catalogs by RA,Dec, without holding either one
+ in memory.
+
+ The rows of both catalogs are binned by healpix (with hpspill, in at
+ most the memory budget); the second catalog's rows also go into the
+ neighbouring healpixes they are within the match radius of.  Then each
+ healpix is matched on its own, by several threads: kd-trees of its
+ rows of the two catalogs, and a dual-tree range search.  Each match is
+ found in exactly one healpix, the one that owns the first catalog's row.
+
+ The output is a FITS table of (ROW1, ROW2, DIST) -- 0-based row numbers
+ in the two catalogs and the distance in arcsec -- grouped by healpix,
+ in the order the threads finish them.
+ */
+struct hpmatch_params {
+    // Names of the RA and Dec columns; default "RA", "DEC".
+    const char* racol;
+    const char* deccol;
+    // Match radius, in degrees.
+    double radius;
+    // Keep only the nearest match for each row of the first catalog.
+    anbool nearest;
+    // Healpix Nside of the partition; 0 to choose it from the catalog
+    // sizes and the memory budget.
+    int nside;
+    int nthreads;
+    // Memory for binning and matching, in bytes.
+    size_t membudget;
+    // Directory for the spill files; default "/tmp".
+    const char* tempdir;
+
+    // Out: number of matches written.
+    int64_t nmatches;
+    // Out: rows of either catalog skipped because their RA or Dec
+    // isn't finite.
+    int64_t nskipped;
+};
+typedef struct hpmatch_params hpmatch_params_t;
+
+void hpmatch_params_init(hpmatch_params_t* p);
+
+/**
+ Matches catalogs "fn1" and "fn2", writing the matches to "outfn".
+ Returns 0 on success.
+ */
+int hpmatch_run(hpmatch_params_t* p, const char* fn1, const char* fn2,
+                const char* outfn);
+
+#endif
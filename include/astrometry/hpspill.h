@@ -0,0 +1,66 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef HPSPILL_H
+#define HPSPILL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ Fixed-size rows sorted into per-healpix bins, in bounded memory: rows
+ are appended to per-healpix memory buffers, and when the buffers hold
+ more than "budget" bytes in total, all of them are appended to
+ per-healpix spill files (each opened only while it's being written, so
+ the number of open files stays small) and freed.
+
+ Used by hpsplit and hpmatch to partition catalogs that don't fit in
+ memory.
+ */
+typedef struct hpspill hpspill_t;
+
+hpspill_t* hpspill_new(int NHP, int rowsize, size_t budget,
+                       const char* tempdir);
+
+/**
+ Frees the buffers and deletes the spill files.
+ */
+void hpspill_free(hpspill_t* sp);
+
+/**
+ Adds a row to healpix "hp".  Returns -1 if "hp" is out of range or the
+ row couldn't be stored.
+ */
+int hpspill_append(hpspill_t* sp, int hp, const void* row);
+
+/**
+ Writes all the buffered rows to the spill files.
+ */
+int hpspill_flush(hpspill_t* sp);
+
+int64_t hpspill_nrows(const hpspill_t* sp, int hp);
+
+/**
+ Opens the spill file of healpix "hp" for reading.  After
+ hpspill_flush(), it holds all hpspill_nrows() rows of the healpix.
+ Returns NULL if there is no spill file (ie, no rows had been spilled).
+ */
+FILE* hpspill_open(const hpspill_t* sp, int hp);
+
+/**
+ Returns all the rows of healpix "hp", spilled and buffered, in the
+ order they were appended, in a new array (NULL if there are none, or
+ on error).  Can be called from several threads at once for different
+ healpixes.
+ */
+void* hpspill_read(const hpspill_t* sp, int hp);
+
+/**
+ Deletes the spill file of healpix "hp" and frees its buffer, leaving
+ it empty.
+ */
+int hpspill_remove(hpspill_t* sp, int hp);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef INDEX_PROFILE_H
+#define INDEX_PROFILE_H
+
+#include <stdint.h>
+
+#include "astrometry/index.h"
+
+#define AN_FILETYPE_INDEXPROFILE "INDEXPROF"
+
+// Maximum number of code tolerances in a profile.
+#define INDEX_PROFILE_MAX_TOLS 8
+
+/**
+ A description of how expensive an index is to query, measured by
+ index-profile and read by the engine to order or skip indexes.
+
+ The code-tree query costs are estimated by searching the code tree
+ around the codes of a sample of the index's own quads (so the counts
+ include the quad itself), at each of the code tolerances.
+ */
+struct index_profile {
+    // file name (possibly truncated) and identity of the index.
+    char indexname[128];
+    int indexid;
+    int healpix;
+    int hpnside;
+    // quad sizes, in arcseconds.
+    double scale_lo;
+    double scale_hi;
+    int nstars;
+    int nquads;
+    int dimquads;
+    int64_t filesize;
+
+    // code kd-tree shape.
+    int ck_nnodes;
+    int ck_nleaves;
+    int leaf_min;
+    double leaf_mean;
+    int leaf_max;
+
+    // number of quads (by the center of their AB diameter) per healpix
+    // at "qhp_nside", over the healpixes that have any.
+    int qhp_nside;
+    int qhp_ncells;
+    double qhp_mean;
+    int qhp_max;
+
+    // expected number of code-tree results, and of distinct pages of
+    // code data plus quad list touched, per query at each tolerance.
+    int ntols;
+    double codetol[INDEX_PROFILE_MAX_TOLS];
+    double nresults[INDEX_PROFILE_MAX_TOLS];
+    double npages[INDEX_PROFILE_MAX_TOLS];
+};
+typedef struct index_profile index_profile_t;
+
+/**
+ Profiles a loaded index, running "nsamples" code-tree queries at each
+ of the "ntols" code tolerances "codetols".  If "qhp_nside" is zero,
+ one is chosen from the index's quad scale.
+
+ Returns 0 on success.
+ */
+int index_profile_compute(index_t* index, const double* codetols,
+                          int ntols, int nsamples, int qhp_nside,
+                          index_profile_t* prof);
+
+/**
+ Writes "N" profiles to a FITS table.  Returns 0 on success.
+ */
+int index_profile_write(const char* fn, const index_profile_t* profs,
+                        int N);
+
+/**
+ Reads all the profiles in a FITS table, returning a newly-allocated
+ array, or NULL on error.
+ */
+index_profile_t* index_profile_read(const char* fn, int* N);
+
+/**
+ Returns the profile of the index with the given id and healpix, or
+ NULL if there isn't one.
+ */
+const index_profile_t* index_profile_find(const index_profile_t* profs,
+                                          int N, int indexid, int healpix);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef INDEX_SCHEDULE_H
+#define INDEX_SCHEDULE_H
+
+#include "astrometry/an-bool.h"
+#include "astrometry/bl.h"
+#include "astrometry/index.h"
+#include "astrometry/index-profile.h"
+
+/**
+ Orders the indexes the engine tries by expected time-to-solve: the
+ expected cost of running an index, divided by the probability that it
+ solves the field.
+
+ The probability starts from a prior -- how much of the field's range of
+ quad sizes the index covers, times the fraction of the sky it covers
+ (unless the job gives a position) -- and is updated with the solve
+ statistics recorded for the index in earlier runs.  The cost comes from
+ the CPU time the index has used per run in earlier runs, or failing
+ that from its profile (see index-profile.h), relative to the other
+ indexes.
+
+ The history is kept in a text file with one line per index:
+ "indexid healpix runs solved cputime".
+ */
+typedef struct index_schedule index_schedule_t;
+
+index_schedule_t* index_schedule_new(void);
+
+void index_schedule_free(index_schedule_t* s);
+
+/**
+ Reads index profiles written by index-profile.  Returns 0 on success.
+ */
+int index_schedule_load_profiles(index_schedule_t* s, const char* fn);
+
+/**
+ Sets the history file, reading it if it exists.  Returns 0 on success.
+ */
+int index_schedule_load_history(index_schedule_t* s, const char* fn);
+
+/**
+ Writes the history file, if it has changed.  Returns 0 on success.
+ */
+int index_schedule_save_history(index_schedule_t* s);
+
+/**
+ Records that "index" was run, taking "cputime" seconds, and whether it
+ solved the field.
+ */
+void index_schedule_record(index_schedule_t* s, const index_t* index,
+                           double cputime, anbool solved);
+
+/**
+ The expected time-to-solve of "index" (in arbitrary units) for a field
+ whose quads are between "quadlo" and "quadhi" arcsec, searched with code
+ tolerance "codetol"; "sky_prior" says whether the job gives a position
+ (in which case the index is assumed to be near it).
+ */
+double index_schedule_cost(const index_schedule_t* s, const index_t* index,
+                           double quadlo, double quadhi, double codetol,
+                           anbool sky_prior);
+
+/**
+ Sorts "indlist", a list of indices into the "indexes" list of index_t
+ pointers, by index_schedule_cost(), keeping the original order for
+ equal costs.
+ */
+void index_schedule_order(const index_schedule_t* s, pl* indexes,
+                          il* indlist, double quadlo, double quadhi,
+                          double codetol, anbool sky_prior);
+
+#endif
@@ -9,6 +9,7 @@
 #include "astrometry/quadfile.h"
 #include "astrometry/starkd.h"
 #include "astrometry/codekd.h"
+#include "astrometry/quadmap.h"
 #include "astrometry/an-bool.h"
 #include "astrometry/anqfits.h"
 
@@ -33,6 +34,9 @@ typedef struct {
     quadfile_t* quads;
     startree_t* starkd;
 
+    // Healpix -> quad map, built on demand by index_get_quadmap().
+    quadmap_t* quadmap;
+
     // FITS file access
     anqfits_t* fits;
 
@@ -119,6 +123,14 @@ int index_nquads(const index_t* index);
 
 int index_nstars(const index_t* index);
 
+/**
+ Returns the healpix -> quad map of this index (see quadmap.h): the
+ one stored in the index file, if any, or else one built the first
+ time it is asked for; NULL on error.  The map is freed when the index
+ is unloaded.  Thread-safe: threads sharing an index get the same map.
+ */
+quadmap_t* index_get_quadmap(index_t* index);
+
 index_t* index_build_from(codetree_t* codekd, quadfile_t* quads, startree_t* starkd);
 
 /**
@@ -154,6 +166,13 @@ void index_unload(index_t* index);
 
 int index_reload(index_t* index);
 
+/**
+ Checks that the parts of a loaded index agree: one code per quad, and
+ every quad's stars in the star tree.  Reads every quad.  Returns 0 if
+ all is well.
+ */
+int index_check(const index_t* index);
+
 /**
  Closes the FILE*s in this index.  Once you have index_reload()ed,
  you can call this function and the index will remain valid.
@@ -35,14 +35,31 @@ double vector_length_squared_3(double* v);
 
 double inverse_3by3(double *matrix);
 
+/**
+ Solves A X = B, where A is an N x N symmetric positive-definite matrix
+ and B is N x NB, both row-major; eg, the normal equations of a
+ least-squares fit.  A is overwritten by its Cholesky factor (in its
+ lower triangle) and B by X.  Only the lower triangle of A is read.
+ Returns -1 if A isn't (numerically) positive definite.
+ */
+int cholesky_solve(double* A, int N, double* B, int NB);
+
 void image_to_xyz(double uu, double vv, double* s, double* transform);
 
 void fit_transform(double* star, double* field, int N, double* trans);
 
+// These use rand() and (for gaussian_sample) a static cache, so they
+// are not reentrant; see the _r versions below.
 double uniform_sample(double low, double high);
 
 double gaussian_sample(double mean, double stddev);
 
+// Reentrant versions: all state is in "*seed" (see rand_r), so a given
+// seed always produces the same sequence, whatever other threads do.
+double uniform_sample_r(unsigned int* seed, double low, double high);
+
+double gaussian_sample_r(unsigned int* seed, double mean, double stddev);
+
 // just drop partial blocks off the end.
 #define EDGE_TRUNCATE 0
 // just average the pixels in partial blocks.
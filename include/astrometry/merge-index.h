@@ -22,4 +22,11 @@ int merge_index_open_files(const char* quadfn, const char* ckdtfn, const char* s
 int merge_index(quadfile_t* quads, codetree_t* codekd, startree_t* starkd,
                 const char* indexfn);
 
+/**
+ Appends the healpix -> quad map (see quadmap.h) of the given quads to
+ an index file written by merge_index().
+ */
+int merge_index_add_quadmap(quadfile_t* quads, startree_t* starkd,
+                            const char* indexfn);
+
 #endif
@@ -33,6 +33,8 @@ struct onefield_params {
     char *indexrdlsfname;
     char *corr_fname;
     char* scamp_fname;
+    // Solver instrumentation report (JSON lines, appended per field).
+    char* stats_fname;
 
     // WCS filename template (sprintf format with %i for field number)
     char* wcs_template;
@@ -121,6 +123,21 @@ struct onefield_params {
     anbool cancelled;
 
     anbool best_hit_only;
+
+    // internal: open handle on "stats_fname".
+    FILE* stats_fid;
+
+    // If set, called after each index has been tried (when not running
+    // the indexes in parallel), with the CPU time it took and whether
+    // it solved the field.
+    void (*index_done)(const index_t* index, double cputime, anbool solved,
+                       void* userdata);
+    void* index_done_userdata;
+
+    // If set, called at the end of onefield_run() with the best solution
+    // of each field that solved.
+    void (*field_solved)(const MatchObj* mo, void* userdata);
+    void* field_solved_userdata;
 };
 typedef struct onefield_params onefield_t;
 
@@ -133,6 +150,7 @@ void onefield_set_match_file(onefield_t* bp, const char* fn);
 void onefield_set_rdls_file(onefield_t* bp, const char* fn);
 void onefield_set_scamp_file(onefield_t* bp, const char* fn);
 void onefield_set_corr_file(onefield_t* bp, const char* fn);
+void onefield_set_stats_file(onefield_t* bp, const char* fn);
 void onefield_set_wcs_file(onefield_t* bp, const char* fn);
 void onefield_set_xcol(onefield_t* bp, const char* x);
 void onefield_set_ycol(onefield_t* bp, const char* x);
@@ -0,0 +1 @@
+#define HAVE_NETPBM 0
@@ -6,6 +6,8 @@
 #ifndef PERMUTED_SORT_H
 #define PERMUTED_SORT_H
 
+#include <stdint.h>
+
 // for QSORT_COMPARISON_FUNCTION
 #include "ioutils.h"
 
@@ -25,6 +27,18 @@
  Note that if you pass in a non-NULL "perm" array, its existing values will
  be used!  You probably want to initialize it with "permutation_init()" to
  set it to the identity permutation.
+
+ The sort is stable for any comparator and any N: equal elements keep
+ their order in "perm".  (The one exception: if a temporary array of N
+ indices can't be allocated, it falls back to qsort with ties broken by
+ index, which is stable only if "perm" starts out in increasing order,
+ as it does when "perm" is NULL.)
+
+ If "compare" is one of the compare_{doubles,floats,ints,int64}_{asc,desc}
+ functions below and N >= 256, a (multi-threaded, for big arrays) radix
+ sort is used; otherwise, a merge sort.  Either way, the built-in double
+ and float comparators put NaNs last (they test for NaN by bit pattern,
+ so this holds with -ffinite-math-only too).
  */
 int* permuted_sort(const void* realarray, int array_stride,
                    int (*compare)(const void*, const void*),
@@ -42,6 +56,22 @@ int* permutation_init(int* perm, int Nperm);
 void permutation_apply(const int* perm, int Nperm, const void* inarray,
 					   void* outarray, int elemsize);
 
+/*
+ 64-bit versions of the above, for arrays with more than 2^31 elements
+ (eg, whole-sky catalogs in uniformize-catalog).  "perm" holds int64_t
+ indices.  permuted_sort_64 returns NULL only if it can't allocate
+ "perm"; for N = 0 it returns a (non-NULL) array that must be freed.
+ */
+int64_t* permuted_sort_64(const void* realarray, int array_stride,
+                          int (*compare)(const void*, const void*),
+                          int64_t* perm, int64_t Nperm);
+
+int64_t* permutation_init_64(int64_t* perm, int64_t Nperm);
+
+void permutation_apply_64(const int64_t* perm, int64_t Nperm,
+                          const void* inarray, void* outarray,
+                          int elemsize);
+
 /*
   Some sort functions that might come in handy:
  */
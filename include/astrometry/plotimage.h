@@ -91,10 +91,15 @@ void plot_image_add_to_pixels(plotimage_t* args, int rgb[3]);
 
 unsigned char* plot_image_scale_float(plotimage_t* args, const float* fimg);
 
+// Same, splitting the rows between "nthreads" threads.
+unsigned char* plot_image_scale_float_threaded(plotimage_t* args,
+                                               const float* fimg,
+                                               int nthreads);
+
 void plot_image_rgba_data(cairo_t* cairo, plotimage_t* args);
 
 // After setting filename, actually open and read the image file.
-int plot_image_read(const plot_args_t* pargs, plotimage_t* args);
+int plot_image_read(plot_args_t* pargs, plotimage_t* args);
 
 void plot_image_make_color_transparent(plotimage_t* args, unsigned char r, unsigned char g, unsigned char b);
 
@@ -77,6 +77,13 @@ struct plot_args {
 
     // step size in pixels for drawing curved lines in RA,Dec; default 10
     float linestep;
+
+    // threads to use for rendering image layers; default 1
+    int nthreads;
+
+    // cached sky positions of the output pixels, for resampling images;
+    // see plotstuff_get_resample_grid().
+    struct resample_grid* resample_grid;
 };
 typedef struct plot_args plot_args_t;
 
@@ -132,6 +139,9 @@ void cairo_set_rgba(cairo_t* cairo, const float* rgba);
 
 plot_args_t* plotstuff_new(void);
 int plotstuff_init(plot_args_t* plotargs);
+// Creates the drawing surface (of size W x H); the first plotting
+// command does this if it hasn't been done.
+int plotstuff_init2(plot_args_t* pargs);
 int plotstuff_read_and_run_command(plot_args_t* pargs, FILE* f);
 int plotstuff_run_command(plot_args_t* pargs, const char* cmd);
 
@@ -177,6 +187,13 @@ int plotstuff_set_wcs_tan(plot_args_t* pargs, tan_t* wcs);
 
 int plotstuff_set_wcs_sip(plot_args_t* pargs, sip_t* wcs);
 
+/**
+ Returns the sky positions of a grid of output pixels, for
+ resample_wcs_rgba_grid() etc.  It's kept until the plot size or WCS
+ changes, so image layers drawn onto the same plot share it.
+ */
+struct resample_grid* plotstuff_get_resample_grid(plot_args_t* pargs);
+
 void plotstuff_builtin_apply(cairo_t* cairo, plot_args_t* args);
 
 // Would a marker plotted with the current markersize at x,y appear in the image?
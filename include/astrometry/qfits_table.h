@@ -39,6 +39,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <stdint.h>
     
 #include "astrometry/qfits_header.h"
 
@@ -219,8 +220,8 @@ typedef struct qfits_table
     int                tab_w;            
     /** Number of columns */
     int                nc;            
-    /** Number of rows */
-    int                nr;
+    /** Number of rows (64-bit: NAXIS2 may exceed 2^31) */
+    int64_t            nr;
     /** Array of qfits_col objects */
     qfits_col    *    col;            
 } qfits_table;
@@ -233,7 +234,7 @@ qfits_table* qfits_table_copy(const qfits_table* t);
 
 qfits_header * qfits_table_prim_header_default(void);
 qfits_header * qfits_table_ext_header_default(const qfits_table *);
-qfits_table * qfits_table_new(const char *, int, int, int, int);
+qfits_table * qfits_table_new(const char *, int, int, int, int64_t);
 int qfits_col_fill(qfits_col *, int, int, int, tfits_type, const char *, 
         const char *, const char *, const char *, int, float, int, float, int);
 
@@ -257,8 +258,8 @@ int qfits_query_column_seq_to_array_inds(const qfits_table	    *   th,
 
 int qfits_query_column_seq_to_array(const qfits_table	    *   th,
 									int                 colnum,
-									int                 start_ind,
-									int                 nb_rows,
+									int64_t             start_ind,
+									int64_t             nb_rows,
 									unsigned char*      destination,
 									int                 dest_stride);
 
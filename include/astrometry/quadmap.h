@@ -0,0 +1,90 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef QUADMAP_H
+#define QUADMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "astrometry/quadfile.h"
+#include "astrometry/starkd.h"
+#include "astrometry/fitsbin.h"
+#include "astrometry/anqfits.h"
+#include "astrometry/bl.h"
+
+/**
+ A healpix -> quad list map: the quads of an index, grouped by the
+ healpix (in the XY scheme, at a power-of-two "nside" with cells about
+ twice the size of the largest quads) containing the center of their
+ AB diameter.  Used to find the quads inside a search cone without
+ looking at the rest of the index.
+
+ It can be stored in an index file as two extra tables, "quadmap_cells"
+ and "quadmap_quads" (see build-index -Q); they are then mmap()ed
+ rather than recomputed.
+ */
+typedef struct {
+    int32_t hp;
+    // index in "quads" of the first quad in this healpix.
+    int32_t start;
+} quadmap_cell_t;
+
+typedef struct {
+    int nside;
+    // number of non-empty healpixes.
+    int ncells;
+    int nquads;
+    // "ncells" + 1 entries in increasing healpix order; the quads in
+    // cell i are quads[cells[i].start] to quads[cells[i+1].start - 1].
+    quadmap_cell_t* cells;
+    // quad ids, increasing within each healpix.
+    int32_t* quads;
+
+    // when read from a file: the arrays live in its mmap()ed chunks.
+    fitsbin_t* fb;
+} quadmap_t;
+
+/**
+ The map nside for an index whose largest quads are "scale_upper"
+ arcsec.
+ */
+int quadmap_nside_for_scale(double scale_upper);
+
+quadmap_t* quadmap_build(const quadfile_t* qf, startree_t* skdt,
+                         int nside);
+
+/**
+ Reads the quad map tables of an index file.  Returns NULL, without
+ complaint, if the file doesn't have them.
+ */
+quadmap_t* quadmap_open_fits(anqfits_t* fits);
+
+/**
+ Checks that "qm" is a well-formed map of a quad file with "nquads"
+ quads: every quad appears once, in healpix order.  A map read from an
+ index file that was rebuilt (or copied from another index) fails this.
+ Returns 0 if the map is good, -1 if not.
+ */
+int quadmap_check(const quadmap_t* qm, int nquads);
+
+/**
+ Writes the quad map tables to "fid", which must be positioned at the
+ end of a (padded) FITS file.
+ */
+int quadmap_append_to(const quadmap_t* qm, FILE* fid);
+
+void quadmap_free(quadmap_t* qm);
+
+/**
+ Appends to "quads" the ids of the quads all of whose stars are within
+ squared distance "r2" of "xyz" (the test the solver applies to quad
+ matches when it has an RA,Dec constraint), grouped by healpix and in
+ increasing order within each one.  Returns the number appended.
+ */
+int quadmap_search(const quadmap_t* qm, const quadfile_t* qf,
+                   startree_t* skdt, const double* xyz, double r2,
+                   il* quads);
+
+#endif
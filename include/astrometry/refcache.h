@@ -0,0 +1,54 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef REFCACHE_H
+#define REFCACHE_H
+
+#include <stdint.h>
+
+#include "astrometry/starkd.h"
+
+/**
+ A small LRU cache of reference-star searches, used by verify_hit().
+
+ The candidate matches for a field tend to land on the same few places
+ on the sky, so rather than searching the star kd-tree for each one,
+ we search once around the center of a healpix cell (whose size goes
+ with the query radius), wide enough to cover any query circle of
+ about that radius centered in the cell, and answer later queries by
+ filtering the cached stars.  A cell is only filled (evicting the
+ least-recently used entry) the second time it is missed, so one-off
+ queries cost no more than a plain search and don't evict cells that are
+ in use.
+ The results are the same stars that startree_search_for() returns, but
+ sorted by sweep number (then star id).  Without the cache,
+ verify_hit() keeps the kd-tree's order within a sweep, which depends on
+ the query point, so the two can break ties differently; this is why the
+ cache is off by default.
+
+ Entries are keyed by the star tree's address, so the cache must not
+ outlive the indexes it was used with.  Not thread-safe.
+ */
+typedef struct refcache refcache_t;
+
+refcache_t* refcache_new(int maxentries);
+
+void refcache_free(refcache_t* rc);
+
+/**
+ Like startree_search_for(): finds the stars within squared distance
+ "radius2" of "xyzcenter", returning newly-allocated arrays of their
+ positions and star ids, in sweep order.  Either of the outputs may be
+ NULL.  If no stars are found, the arrays are set to NULL.
+
+ Returns 1 if the query was answered from the cache, 0 if not.
+ */
+int refcache_search(refcache_t* rc, const startree_t* skdt,
+                    const double* xyzcenter, double radius2,
+                    double** xyzresults, int** starinds, int* nresults);
+
+void refcache_get_stats(const refcache_t* rc, int64_t* hits,
+                        int64_t* misses);
+
+#endif
@@ -97,6 +97,8 @@ int simplexy_run(simplexy_t* s);
 
 void simplexy_free_contents(simplexy_t* s);
 
+// Frees the calling thread's cached scratch space (each thread running
+// simplexy keeps its own; it is also freed when the thread exits).
 void simplexy_clean_cache();
 
 #endif
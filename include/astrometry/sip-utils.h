@@ -29,6 +29,39 @@ int sip_compute_inverse_polynomials(sip_t* sip, int NX, int NY,
                                     double xlo, double xhi,
                                     double ylo, double yhi);
 
+/**
+ Fits inverse SIP polynomials, like sip_compute_inverse_polynomials()
+ (which uses one of these per thread), keeping its sample grid and
+ work space between fits: refitting the inverse for each frame of a
+ sequence with the same image bounds and orders only evaluates the new
+ forward polynomial on the grid and solves, and refitting an unchanged
+ forward polynomial just returns the previous answer.
+ */
+typedef struct sip_inverse_fitter sip_inverse_fitter_t;
+
+sip_inverse_fitter_t* sip_inverse_fitter_new(void);
+void sip_inverse_fitter_free(sip_inverse_fitter_t* fitter);
+
+/**
+ Computes sip->ap and sip->bp, as sip_compute_inverse_polynomials().
+
+ If "tolerance" > 0, NX and NY are ignored: the fit starts from a
+ coarse grid, and each refinement of the grid (adding the points
+ halfway between the existing ones) is first used to check the fit,
+ stopping once the inverse round-trips those points to within
+ "tolerance" pixels, the grid reaches 257 x 257 points, or a finer grid
+ stops reducing the error.  In the last case the inverse order is too
+ low to reach "tolerance", and the returned "p_maxerr" is above it.
+
+ If "p_maxerr" is non-NULL, the largest round-trip error (in pixels)
+ of the points checked -- or, for a fixed grid, of the grid points --
+ is returned in it.
+ */
+int sip_inverse_fitter_fit(sip_inverse_fitter_t* fitter, sip_t* sip,
+                           int NX, int NY,
+                           double xlo, double xhi, double ylo, double yhi,
+                           double tolerance, double* p_maxerr);
+
 /*
  Finds stars that are inside the bounds of a given field (wcs).
 
@@ -163,6 +163,14 @@ double sip_pixel_scale(const sip_t* sip);
 // these take *relative* pixel coords (WRT crpix)
 void   sip_calc_inv_distortion(const sip_t* sip, double U, double V, double* u, double *v);
 void   sip_calc_distortion(const sip_t* sip, double u, double v, double* U, double *V);
+
+// Array versions of the above, for N points: faster than calling them
+// point by point.  The outputs may be the same arrays as the inputs.
+void sip_calc_distortion_array(const sip_t* sip, const double* u,
+                               const double* v, int N, double* U, double* V);
+void sip_calc_inv_distortion_array(const sip_t* sip, const double* U,
+                                   const double* V, int N,
+                                   double* u, double* v);
       
 // Applies forward SIP distortion to pixel coords.
 // This applies the A,B matrix terms;
@@ -178,6 +186,15 @@ void sip_pixel_distortion(const sip_t* sip, double x, double y,
 void sip_pixel_undistortion(const sip_t* sip, double x, double y,
                             double *p_x, double *p_y);
 
+// Array versions of sip_pixel_distortion() and sip_pixel_undistortion(),
+// for N points; the outputs may be the same arrays as the inputs.
+void sip_pixel_distortion_array(const sip_t* sip, const double* x,
+                                const double* y, int N,
+                                double* X, double* Y);
+void sip_pixel_undistortion_array(const sip_t* sip, const double* x,
+                                  const double* y, int N,
+                                  double* X, double* Y);
+
 // Pixels to XYZ unit vector.
 void   tan_pixelxy2xyzarr(const tan_t* tan, double px, double py, double *xyz);
 
@@ -0,0 +1,102 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef SOLVER_BATCH_H
+#define SOLVER_BATCH_H
+
+#include "astrometry/an-bool.h"
+#include "astrometry/sip.h"
+#include "astrometry/index.h"
+
+/**
+ Solves many fields at once, from star lists in memory, against a set
+ of loaded indexes, in several threads -- without any files.  This is
+ what the Python solver module's solve_fields() calls.
+
+ Each thread runs its own solver_t over the fields it takes from a
+ shared counter; the indexes are shared read-only, so they must be
+ fully loaded (see the thread-safety notes in solver.h); a metadata-only
+ index is rejected.  If any field
+ has an RA,Dec constraint, the indexes' quad maps are built before the
+ threads start.
+ */
+
+// Settings shared by all the fields.
+typedef struct {
+    // Pixel scale range to search, in arcsec/pixel (required).
+    double scale_lo;
+    double scale_hi;
+    // PARITY_NORMAL, PARITY_FLIP or PARITY_BOTH (default).
+    int parity;
+    // Log-odds to accept a solution; default log(1e9).
+    double logodds_solve;
+    // Field quads to try per field; 0 (default) for no limit.
+    int maxquads;
+    // Positional noise in pixels; default DEFAULT_VERIFY_PIX.
+    double verify_pix;
+    // SIP order of the tweaked solution; 0 or 1 for TAN only.  Default 2.
+    int tweak_order;
+    // Put CRPIX at the center of the image?
+    anbool crpix_center;
+    // Default 1.
+    int nthreads;
+} solver_batch_args_t;
+
+// Initialize with solver_batch_field_init() (or zero) before the first
+// run: each run frees the previous outputs.
+typedef struct {
+    // INPUTS
+    // Star positions (pixels) and optional fluxes, length N.  With
+    // fluxes, the stars are tried brightest first; otherwise in the
+    // order given.  Not owned.
+    const double* x;
+    const double* y;
+    const double* flux;
+    int N;
+    // Image size; if 0, the bounds of the stars.
+    int W;
+    int H;
+    // Optional: only accept solutions within "radius" deg of (ra, dec).
+    anbool use_radec;
+    double ra;
+    double dec;
+    double radius;
+
+    // OUTPUTS
+    anbool solved;
+    double logodds;
+    // the solution (with a_order = 0 if it's TAN only).
+    sip_t wcs;
+    // the index that solved it (one of the caller's).
+    index_t* index;
+    // Matched stars: for match i, the field star (an index into x, y),
+    // the reference star's RA,Dec (deg) and its row in the index's
+    // star kd-tree, and the weight of the match in [0, 1].  Owned by
+    // the field; see solver_batch_field_free().
+    int nmatch;
+    int* match_field;
+    double* match_radec;
+    int* match_refid;
+    double* match_weight;
+} solver_batch_field_t;
+
+void solver_batch_args_init(solver_batch_args_t* args);
+
+void solver_batch_field_init(solver_batch_field_t* field);
+
+/**
+ Solves "fields" against all "indexes".  Returns 0 if the batch ran
+ (whether or not the fields solved), -1 on bad arguments or if an index
+ isn't fully loaded.
+ */
+int solver_batch_run(const solver_batch_args_t* args,
+                     index_t** indexes, int nindexes,
+                     solver_batch_field_t* fields, int nfields);
+
+/**
+ Frees the outputs of a field (not the field itself).
+ */
+void solver_batch_field_free(solver_batch_field_t* field);
+
+#endif
@@ -20,6 +20,7 @@
 #include "astrometry/verify.h"
 #include "astrometry/sip.h"
 #include "astrometry/an-bool.h"
+#include "astrometry/solverstats.h"
 
 enum {
     PARITY_NORMAL,
@@ -34,6 +35,30 @@ enum {
 #define DEFAULT_DISTRACTOR_RATIO 0.25
 #define DEFAULT_VERIFY_PIX 1.0
 #define DEFAULT_BAIL_THRESHOLD 1e-100
+#define DEFAULT_COARSE_BAIL_THRESHOLD 1e-6
+#define DEFAULT_VERIFY_REFCACHE 0
+#define DEFAULT_RADEC_QUAD_SUBSET 0.25
+
+/**
+ Thread safety.
+
+ All per-solve state lives in the solver_t (and the verify_field_t,
+ MatchObjs and solver_stats_t hanging off it), so several solvers can
+ run at once, one per thread.  The rules:
+
+ - Never share a solver_t between threads.
+ - An index_t may be shared by any number of solvers once it is fully
+   loaded (index_load() without INDEX_ONLY_LOAD_METADATA, or after
+   index_reload()); the solver only reads it.  Don't load, reload or
+   close it while solvers are using it.
+ - Error state (errors.h) is per thread.  Logging (log.h) is shared
+   unless log_set_thread_specific() is called before starting threads;
+   either way, lines from different threads are not interleaved.
+ - Callbacks (record_match_callback, timer_callback) run in the
+   solver's thread, with that solver's userdata.
+
+ See solver/test_solver_threads.c.
+ */
 
 struct verify_field_t;
 struct solver_t {
@@ -78,6 +103,20 @@ struct solver_t {
     anbool verify_uniformize;
     anbool verify_dedup;
 
+    // If > 0, check this many field stars (bright ones near the matched
+    // quad first) in a cheap coarse pass before full verification;
+    // matches whose log-odds stay below "logratio_coarse_bail" in that
+    // pass are rejected.  Default 0 (off).
+    int verify_coarse;
+    double logratio_coarse_bail;
+
+    // Number of reference-star searches to keep in the per-field LRU
+    // cache used by verification (see refcache.h); 0 (the default)
+    // disables it.  Within a sweep, the cache returns stars in star-id
+    // order rather than kd-tree order, so enabling it can change which
+    // of several equally-good matches verification picks.
+    int verify_refcache;
+
     anbool do_tweak;
 
     int tweak_aborder;
@@ -113,6 +152,11 @@ struct solver_t {
     anbool use_radec;
     double centerxyz[3];
     double r2;
+
+    // With "use_radec", if the quads inside the RA,Dec circle are at
+    // most this fraction of an index, search a code tree built from just
+    // those quads instead of the whole index; 0 disables.  Default 0.25.
+    double radec_quad_subset;
 	
     // During verification, if the log-odds ratio drops to this level, we bail out and
     // assume it's not a match.  Default log(1e-100).
@@ -141,6 +185,10 @@ struct solver_t {
     // calling again.  The parameter is "userdata".
     time_t (*timer_callback)(void*);
 
+    // If non-NULL, per-stage timings and histograms are accumulated
+    // here (see solverstats.h).  Not owned by the solver.
+    solver_stats_t* stats;
+
     // FIELDS THAT AFFECT THE RUNNING SOLVER ON CALLBACK
     // =================================================
 
@@ -172,6 +220,22 @@ struct solver_t {
     // The index we're currently dealing with.
     index_t* index;
 
+    // With "radec_quad_subset": per index, the code tree of the quads
+    // inside the RA,Dec circle (or NULL), and the quad id of each of
+    // its codes; and those of the current index.  They are kept until
+    // the RA,Dec circle or the index list changes, so that repeated
+    // solver_run() calls with the same constraint (eg, several fields
+    // or depth ranges of one job) build them only once.
+    kdtree_t** subset_codekd;
+    int** subset_quads;
+    index_t** subset_indexes;
+    int subset_nindexes;
+    double subset_centerxyz[3];
+    double subset_r2;
+    double subset_frac;
+    kdtree_t* cur_subset_codekd;
+    int* cur_subset_quads;
+
     // The extreme limits of quad size, for all indexes, in pixels^2.
     double minminAB2;
     double maxmaxAB2;
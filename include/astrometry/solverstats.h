@@ -0,0 +1,173 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#ifndef SOLVERSTATS_H
+#define SOLVERSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "astrometry/an-bool.h"
+
+/**
+ Low-overhead instrumentation of the solver hot paths: solver_run,
+ try_permutations, the code-tree and star-tree searches,
+ resolve_matches, verify_hit and tweak2.
+
+ The probes are only active when a solver_stats_t is attached to the
+ solver (solver->stats); otherwise each costs a single NULL test.
+ Build with -DAN_SOLVER_STATS=0 to compile them out entirely.
+
+ Stage times are inclusive: "resolve_matches" includes the
+ "verify_hit" calls it makes, which include "startree_search".
+ */
+#ifndef AN_SOLVER_STATS
+#define AN_SOLVER_STATS 1
+#endif
+
+enum solver_stage {
+    SOLVER_STAGE_RUN = 0,
+    SOLVER_STAGE_PERMUTATIONS,
+    SOLVER_STAGE_CODEKD,
+    SOLVER_STAGE_RESOLVE,
+    SOLVER_STAGE_VERIFY,
+    SOLVER_STAGE_STARKD,
+    SOLVER_STAGE_TWEAK,
+    SOLVER_STAGE_N
+};
+
+// Histograms have power-of-two bins: bin 0 holds zero, bin k holds
+// values in [2^(k-1), 2^k).
+#define SOLVER_STATS_NBINS 24
+
+struct solver_index_stats {
+    // not owned; only used to look up the entry.
+    const void* index;
+    char* name;
+    uint64_t ticks;
+    int64_t ntries;
+    int64_t nmatches;
+    int64_t nverified;
+};
+typedef struct solver_index_stats solver_index_stats_t;
+
+struct solver_stats_t {
+    uint64_t ticks[SOLVER_STAGE_N];
+    int64_t calls[SOLVER_STAGE_N];
+
+    // number of results from each code-tree range search.
+    int64_t codekd_nres[SOLVER_STATS_NBINS];
+    // number of reference stars returned by each star-tree search.
+    int64_t starkd_nres[SOLVER_STATS_NBINS];
+    // number of test stars examined before verification bailed out.
+    int64_t verify_bail[SOLVER_STATS_NBINS];
+    // verifications that did not bail out.
+    int64_t verify_nobail;
+    // matches rejected by the coarse verification pass.
+    int64_t verify_coarse_rejected;
+    // reference-star cache (refcache.h) lookups.
+    int64_t refcache_hits;
+    int64_t refcache_misses;
+
+    // per-index totals; array of solver_index_stats_t.
+    int nindexes;
+    int indexcap;
+    solver_index_stats_t* indexes;
+
+    // for converting ticks to seconds.
+    uint64_t tick0;
+    double wall0;
+};
+typedef struct solver_stats_t solver_stats_t;
+
+struct solver_t;
+
+solver_stats_t* solver_stats_new(void);
+
+/**
+ Zeroes all counters and histograms; call at the start of each field.
+ */
+void solver_stats_reset(solver_stats_t* st);
+
+void solver_stats_free(solver_stats_t* st);
+
+void solver_stats_add_hist(int64_t* hist, int64_t val);
+
+/**
+ Returns the entry for the given index (an index_t*), creating it if
+ necessary.
+ */
+solver_index_stats_t* solver_stats_get_index(solver_stats_t* st,
+                                             const void* index,
+                                             const char* name);
+
+/**
+ Returns the number of timer ticks per second, estimated from the
+ wall-clock time elapsed since the stats object was created.
+ */
+double solver_stats_ticks_per_second(const solver_stats_t* st);
+
+const char* solver_stats_stage_name(int stage);
+
+/**
+ Writes a single-line JSON object describing the stats for one field
+ (and the solver's own counters) to "fid".
+
+ Returns 0 on success.
+ */
+int solver_stats_write_json(const solver_stats_t* st,
+                            const struct solver_t* sp,
+                            int fieldnum, FILE* fid);
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t solver_stats_ticks(void) {
+    return __rdtsc();
+}
+#else
+static inline uint64_t solver_stats_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#if AN_SOLVER_STATS
+
+#define SOLVER_STATS_START(st, tvar)                            \
+    uint64_t tvar = ((st) ? solver_stats_ticks() : 0)
+
+#define SOLVER_STATS_STOP(st, stage, tvar)                      \
+    do {                                                        \
+        if (st) {                                               \
+            (st)->ticks[stage] += solver_stats_ticks() - (tvar); \
+            (st)->calls[stage]++;                               \
+        }                                                       \
+    } while (0)
+
+#define SOLVER_STATS_HIST(st, hist, val)                        \
+    do {                                                        \
+        if (st)                                                 \
+            solver_stats_add_hist((st)->hist, (val));           \
+    } while (0)
+
+#define SOLVER_STATS_DO(st, stmt)                               \
+    do {                                                        \
+        if (st) {                                               \
+            stmt;                                               \
+        }                                                       \
+    } while (0)
+
+#else
+
+#define SOLVER_STATS_START(st, tvar)
+#define SOLVER_STATS_STOP(st, stage, tvar)
+#define SOLVER_STATS_HIST(st, hist, val)
+#define SOLVER_STATS_DO(st, stmt)
+
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#ifndef SYNTHFIELD_H
+#define SYNTHFIELD_H
+
+#include "astrometry/starkd.h"
+#include "astrometry/starxy.h"
+#include "astrometry/sip.h"
+#include "astrometry/an-bool.h"
+
+/**
+ Synthetic fields for testing and benchmarking the solver.
+
+ A field is made by drawing a random TAN WCS (center uniform on the
+ sphere, or within "radius" degrees of a given center; random
+ rotation; pixel scale uniform in [scale_lo, scale_hi] arcsec/pixel),
+ projecting the reference stars of a star kd-tree into it, and then
+ degrading the star list: real stars are dropped with probability
+ "dropout", Gaussian positional noise of "noise" pixels is added,
+ and distractors (uniformly placed false stars) are mixed in.
+
+ Fluxes are assigned from the stars' sweep numbers (brighter sweeps
+ first), so after sorting by flux the field resembles the ordering
+ the index builder used.  Distractors are given fluxes at random
+ ranks.
+
+ Everything is driven by "seed" (with rand_r, not the global rand()
+ state) so a (tree, args, seed) triple always produces the same field,
+ and fields can be generated from several threads at once.
+ */
+typedef struct {
+    int W;
+    int H;
+    // arcsec/pixel
+    double scale_lo;
+    double scale_hi;
+    // If radius > 0, the field center is drawn within "radius" degrees
+    // of (ra, dec); otherwise anywhere on the sky.
+    double ra;
+    double dec;
+    double radius;
+    // Fraction of real stars to drop, in [0, 1).
+    double dropout;
+    // Number of distractors, as a fraction of the real stars kept.
+    double distractors;
+    // Positional noise, in pixels (standard deviation).
+    double noise;
+    // Allow negative-parity (flipped) fields?
+    anbool flip;
+    // Keep at most this many stars (brightest first); 0 for no limit.
+    int maxstars;
+    unsigned int seed;
+} synthfield_args_t;
+
+void synthfield_args_init(synthfield_args_t* args);
+
+/**
+ Generates a field, returning a new starxy_t (with fluxes) sorted by
+ flux, brightest first.  The true WCS is written to "wcs" if non-NULL.
+
+ Returns NULL on error.  The field may contain zero stars if the WCS
+ landed in an empty part of the tree.
+ */
+starxy_t* synthfield_generate(startree_t* skdt,
+                              const synthfield_args_t* args,
+                              tan_t* wcs);
+
+#endif
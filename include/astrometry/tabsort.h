@@ -6,7 +6,18 @@
 #ifndef TABSORT_H
 #define TABSORT_H
 
+#include <stddef.h>
+
 int tabsort(const char* infn, const char* outfn, const char* colname,
             int descending);
 
+/**
+ Like tabsort(), but tables whose data is larger than "memlimit" bytes
+ are sorted out-of-core: sorted runs are spilled to a temp file (in
+ "tempdir", or $TMP if NULL) and merged.  The sort is stable.
+ "memlimit" = 0 means no limit.
+ */
+int tabsort2(const char* infn, const char* outfn, const char* colname,
+             int descending, size_t memlimit, const char* tempdir);
+
 #endif
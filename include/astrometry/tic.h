@@ -9,6 +9,8 @@
 #include <time.h>
 #include <sys/time.h>
 
+// tic() records the start time for the calling thread; toc() logs the
+// time elapsed since that thread's last tic().
 void tic();
 int get_resource_stats(double* p_usertime, double* p_systime, long* p_maxrss);
 void toc();
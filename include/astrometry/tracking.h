@@ -0,0 +1,84 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#ifndef TRACKING_H
+#define TRACKING_H
+
+#include "astrometry/an-bool.h"
+#include "astrometry/sip.h"
+
+/**
+ State for solving a sequence of frames from the same camera (eg, a
+ telescope tracking or slewing slowly), where each frame starts from
+ the previous solution.
+
+ The prior for a frame is the last solution with its reference point
+ moved by the drift: the per-frame motion of the image center seen
+ between the last two solved frames (times the number of frames since
+ the last solution).  The engine tries to verify (and tweak) this
+ predicted WCS first, then falls back to a blind solve restricted to a
+ circle around the predicted center and to the prior's pixel scale.
+ After "maxmissed" frames in a row fail to solve, the prior is dropped
+ and frames are solved blind again.
+
+ The state can be kept in a file between runs: a FITS header holding
+ the last WCS plus the TRK* drift cards.
+ */
+typedef struct {
+    // is there a prior?
+    anbool valid;
+    // the last solution, and the RA,Dec of its image center (deg).
+    sip_t wcs;
+    double ra;
+    double dec;
+    // drift of the image center per frame (deg), if "have_drift".
+    anbool have_drift;
+    double dra;
+    double ddec;
+    // frames since the last solution.
+    int nmissed;
+
+    // radius of the restricted search (deg); 0 means twice the radius
+    // of the field.
+    double radius;
+    // fractional pixel scale range of the restricted search.
+    double scale_slop;
+    int maxmissed;
+
+    char* statefn;
+} tracking_t;
+
+tracking_t* tracking_new(void);
+
+void tracking_free(tracking_t* t);
+
+/**
+ Sets the state file, reading it if it exists.  Returns 0 on success.
+ */
+int tracking_load_state(tracking_t* t, const char* fn);
+
+/**
+ Writes the state file, if one is set.  Returns 0 on success.
+ */
+int tracking_save_state(const tracking_t* t);
+
+/**
+ Fills "wcs" with the predicted WCS for the next frame, and "ra", "dec"
+ and "radius" (deg) with the circle to search in if it doesn't verify.
+ Returns FALSE if there is no prior.
+ */
+anbool tracking_predict(const tracking_t* t, sip_t* wcs,
+                        double* ra, double* dec, double* radius);
+
+/**
+ Records the solution of the current frame.
+ */
+void tracking_solved(tracking_t* t, const sip_t* wcs);
+
+/**
+ Records that the current frame did not solve.
+ */
+void tracking_missed(tracking_t* t);
+
+#endif
@@ -13,14 +13,16 @@
 #include "astrometry/sip.h"
 #include "astrometry/bl.h"
 #include "astrometry/starxy.h"
+#include "astrometry/solverstats.h"
+#include "astrometry/xygrid.h"
+#include "astrometry/refcache.h"
 
 struct verify_field_t {
     const starxy_t* field;
-    // this copy is normal.
+    // copy of the field star positions.
     double* xy;
-    // this copy is permuted by the kdtree
-    double* fieldcopy;
-    kdtree_t* ftree;
+    // grid over "xy", for deduplication.
+    xygrid_t* fgrid;
 
     // should this field be spatially uniformized at the index's scale?
     anbool do_uniformize;
@@ -28,14 +30,27 @@ struct verify_field_t {
     anbool do_dedup;
     // apply radius-of-relevance filtering
     anbool do_ror;
+
+    // If > 0, run a coarse pass over this many test stars before full
+    // verification, rejecting matches whose log-odds stay below
+    // "coarse_logbail"; the first test stars of the full pass are then
+    // also taken in order of expected information.
+    int coarse_n;
+    double coarse_logbail;
+
+    // instrumentation; may be NULL.  Not owned.
+    solver_stats_t* stats;
+    // If non-NULL, reference-star searches go through this cache.  Owned;
+    // freed by verify_field_free().
+    refcache_t* refcache;
 };
 typedef struct verify_field_t verify_field_t;
 
 
 /*
  This function must be called once for each field before verification
- begins.  We build a kdtree out of the field stars (in pixel space)
- which will be used during deduplication.
+ begins.  We build a grid over the field stars (in pixel space) which
+ will be used during deduplication.
  */
 verify_field_t* verify_field_preprocess(const starxy_t* fieldxy);
 
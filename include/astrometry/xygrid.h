@@ -0,0 +1,74 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#ifndef XYGRID_H
+#define XYGRID_H
+
+#include "astrometry/bl.h"
+
+/**
+ A uniform grid ("cell list") over a set of 2-D points, for
+ nearest-neighbour and range queries.
+
+ This is meant for the build-once, query-a-few-hundred-times pattern
+ of verification and tweaking, where the point sets are small (tens
+ to thousands of points in pixel space) and the search radius is
+ roughly known in advance.  Construction is a single counting sort,
+ O(N) with no comparisons; a query looks at the cells overlapping
+ the search radius.
+
+ The grid does not copy the points: "xy" must stay alive (and
+ unchanged) for as long as the grid is used.  Query results are
+ indices into "xy".
+ */
+struct xygrid_t {
+    // not owned.
+    const double* xy;
+    int N;
+
+    // lower-left corner and cell size.
+    double x0, y0;
+    double cell;
+    int nx, ny;
+
+    // point indices, grouped by cell: cell "c" holds
+    // inds[cellstart[c]] to inds[cellstart[c+1]-1].
+    int* cellstart;
+    int* inds;
+};
+typedef struct xygrid_t xygrid_t;
+
+/**
+ Builds a grid over the "N" points "xy" (x,y pairs).  If "inds" is
+ non-NULL, the grid holds only points xy[2*inds[i]], i in [0, N);
+ otherwise points 0 to N-1.  Within a cell, points keep the order in
+ which they were given.
+
+ "cellsize" is the smallest cell size to use; pass the typical search
+ radius.  The cells are made larger if necessary so that there are
+ not many more cells than points.
+ */
+xygrid_t* xygrid_new(const double* xy, const int* inds, int N,
+                     double cellsize);
+
+void xygrid_free(xygrid_t* g);
+
+/**
+ Returns the index of the point nearest "pt" with squared distance
+ at most "maxd2", or -1 if there is none.  If found and "p_d2" is
+ non-NULL, the squared distance is placed there.
+ */
+int xygrid_nearest_within(const xygrid_t* g, const double* pt,
+                          double maxd2, double* p_d2);
+
+/**
+ Appends to "results" the indices of all points within squared
+ distance "maxd2" of "pt" (in no particular order).  Returns the
+ number of points appended.
+ */
+int xygrid_range(const xygrid_t* g, const double* pt, double maxd2,
+                 il* results);
+
+#endif
@@ -3,6 +3,8 @@
  # Licensed under a 3-clause BSD style license - see LICENSE
  */
 
+#include <stdlib.h>
+
 #include "dualtree.h"
 #include "bl.h"
 
@@ -22,6 +24,35 @@
  The search order is depth-first, left-to-right in the "y" tree.
 
  */
+// Puts the children of the search nodes that pass the decision function
+// into "childnodes", or "leaves" if they're leaves.
+static void expand_nodes(kdtree_t* xtree, kdtree_t* ytree,
+                         il* nodes, il* leaves, int ynode,
+                         dualtree_callbacks* callbacks, il* childnodes) {
+    decision_function decision = callbacks->decision;
+    void* decision_extra = callbacks->decision_extra;
+    int i, N;
+
+    N = il_size(nodes);
+    for (i=0; i<N; i++) {
+        int child1, child2;
+        int xnode = il_get(nodes, i);
+        if (!decision(decision_extra, xtree, xnode, ytree, ynode))
+            continue;
+
+        child1 = KD_CHILD_LEFT(xnode);
+        child2 = KD_CHILD_RIGHT(xnode);
+
+        if (KD_IS_LEAF(xtree, child1)) {
+            il_append(leaves, child1);
+            il_append(leaves, child2);
+        } else {
+            il_append(childnodes, child1);
+            il_append(childnodes, child2);
+        }
+    }
+}
+
 static void dualtree_recurse(kdtree_t* xtree, kdtree_t* ytree,
                              il* nodes, il* leaves,
                              int ynode, dualtree_callbacks* callbacks) {
@@ -39,8 +70,6 @@ static void dualtree_recurse(kdtree_t* xtree, kdtree_t* ytree,
     //    everything after it when we're done.
     int leafmarker;
     il* childnodes;
-    decision_function decision;
-    void* decision_extra;
     int i, N;
 
     // if the query node is a leaf...
@@ -92,28 +121,7 @@ static void dualtree_recurse(kdtree_t* xtree, kdtree_t* ytree,
 
     leafmarker = il_size(leaves);
     childnodes = il_new(32);
-    decision = callbacks->decision;
-    decision_extra = callbacks->decision_extra;
-
-
-    N = il_size(nodes);
-    for (i=0; i<N; i++) {
-        int child1, child2;
-        int xnode = il_get(nodes, i);
-        if (!decision(decision_extra, xtree, xnode, ytree, ynode))
-            continue;
-
-        child1 = KD_CHILD_LEFT(xnode);
-        child2 = KD_CHILD_RIGHT(xnode);
-
-        if (KD_IS_LEAF(xtree, child1)) {
-            il_append(leaves, child1);
-            il_append(leaves, child2);
-        } else {
-            il_append(childnodes, child1);
-            il_append(childnodes, child2);
-        }
-    }
+    expand_nodes(xtree, ytree, nodes, leaves, ynode, callbacks, childnodes);
 
     //printf("dualtree: start left child of y node %i is %i\n", ynode, KD_CHILD_LEFT(ynode));
     // recurse on the Y children!
@@ -148,3 +156,67 @@ void dualtree_search(kdtree_t* xtree, kdtree_t* ytree,
     il_free(leaves);
 }
 
+// Same walk as dualtree_recurse(), but stops at "depth" and records
+// where it got to.
+static void dualtree_split_recurse(kdtree_t* xtree, kdtree_t* ytree,
+                                   il* nodes, il* leaves, int ynode,
+                                   int depth, dualtree_callbacks* callbacks,
+                                   pl* tasks) {
+    int leafmarker;
+    il* childnodes;
+
+    if (depth == 0 || KD_IS_LEAF(ytree, ynode) || !il_size(nodes)) {
+        dualtree_task_t* task = malloc(sizeof(dualtree_task_t));
+        task->ynode = ynode;
+        task->nodes = il_dupe(nodes);
+        task->leaves = il_dupe(leaves);
+        pl_append(tasks, task);
+        return;
+    }
+
+    leafmarker = il_size(leaves);
+    childnodes = il_new(32);
+    expand_nodes(xtree, ytree, nodes, leaves, ynode, callbacks, childnodes);
+    dualtree_split_recurse(xtree, ytree, childnodes, leaves,
+                           KD_CHILD_LEFT(ynode), depth - 1, callbacks, tasks);
+    dualtree_split_recurse(xtree, ytree, childnodes, leaves,
+                           KD_CHILD_RIGHT(ynode), depth - 1, callbacks, tasks);
+    il_remove_index_range(leaves, leafmarker, il_size(leaves)-leafmarker);
+    il_free(childnodes);
+}
+
+pl* dualtree_split(kdtree_t* xtree, kdtree_t* ytree, int depth,
+                   dualtree_callbacks* callbacks) {
+    pl* tasks = pl_new(256);
+    il* nodes = il_new(32);
+    il* leaves = il_new(32);
+    if (KD_IS_LEAF(xtree, 0))
+        il_append(leaves, 0);
+    else
+        il_append(nodes, 0);
+    dualtree_split_recurse(xtree, ytree, nodes, leaves, 0, depth, callbacks,
+                           tasks);
+    il_free(nodes);
+    il_free(leaves);
+    return tasks;
+}
+
+void dualtree_run_task(kdtree_t* xtree, kdtree_t* ytree,
+                       dualtree_task_t* task, dualtree_callbacks* callbacks) {
+    dualtree_recurse(xtree, ytree, task->nodes, task->leaves, task->ynode,
+                     callbacks);
+}
+
+void dualtree_free_tasks(pl* tasks) {
+    size_t i;
+    if (!tasks)
+        return;
+    for (i=0; i<pl_size(tasks); i++) {
+        dualtree_task_t* task = pl_get(tasks, i);
+        il_free(task->nodes);
+        il_free(task->leaves);
+        free(task);
+    }
+    pl_free(tasks);
+}
+
@@ -3,11 +3,15 @@
  # Licensed under a 3-clause BSD style license - see LICENSE
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
+#include "os-features.h"
 #include "dualtree_rangesearch.h"
 #include "dualtree.h"
 #include "mathutil.h"
+#include "errors.h"
 
 double RANGESEARCH_NO_LIMIT = 1.12345e308;
 
@@ -50,35 +54,19 @@ static double mydistsq(void* v1, void* v2, int D) {
     return distsq((double*)v1, (double*)v2, D);
 }
 
-void dualtree_rangesearch(kdtree_t* xtree, kdtree_t* ytree,
-                          double mindist, double maxdist,
-                          int notself,
-                          dist2_function distsquared,
-                          result_callback callback,
-                          void* param,
-                          progress_callback progress,
-                          void* progress_param) {
-    // dual-tree search callback functions
-    dualtree_callbacks callbacks;
-    rs_params params;
-
-    memset(&callbacks, 0, sizeof(dualtree_callbacks));
-    callbacks.decision = rs_within_range;
-    callbacks.decision_extra = &params;
-    callbacks.result = rs_handle_result;
-    callbacks.result_extra = &params;
-
-    // set search params
-    memset(&params, 0, sizeof(params));
+static void rs_init_params(rs_params* params, kdtree_t* xtree, kdtree_t* ytree,
+                           double mindist, double maxdist, int notself,
+                           dist2_function distsquared) {
+    memset(params, 0, sizeof(rs_params));
     if ((mindist == RANGESEARCH_NO_LIMIT) || (mindist == 0.0)) {
-        params.usemin = FALSE;
+        params->usemin = FALSE;
     } else {
-        params.usemin = TRUE;
-        params.mindistsq = mindist * mindist;
+        params->usemin = TRUE;
+        params->mindistsq = mindist * mindist;
     }
 
     if (maxdist == RANGESEARCH_NO_LIMIT) {
-        params.usemax = FALSE;
+        params->usemax = FALSE;
     } else {
         double d = maxdist;
         /*
@@ -88,20 +76,43 @@ void dualtree_rangesearch(kdtree_t* xtree, kdtree_t* ytree,
          d = kdtree_get_conservative_query_radius(ytree, d);
          printf("Conservative distance in tree 2: %.16g\n", d);
          */
-        params.usemax = TRUE;
-        params.maxdistsq = d*d;
+        params->usemax = TRUE;
+        params->maxdistsq = d*d;
     }
-    params.notself = notself;
+    params->notself = notself;
 
     if (distsquared)
-        params.distsquared = distsquared;
+        params->distsquared = distsquared;
     else
-        params.distsquared = mydistsq;
+        params->distsquared = mydistsq;
+
+    params->xtree = xtree;
+    params->ytree = ytree;
+}
 
+void dualtree_rangesearch(kdtree_t* xtree, kdtree_t* ytree,
+                          double mindist, double maxdist,
+                          int notself,
+                          dist2_function distsquared,
+                          result_callback callback,
+                          void* param,
+                          progress_callback progress,
+                          void* progress_param) {
+    // dual-tree search callback functions
+    dualtree_callbacks callbacks;
+    rs_params params;
+
+    memset(&callbacks, 0, sizeof(dualtree_callbacks));
+    callbacks.decision = rs_within_range;
+    callbacks.decision_extra = &params;
+    callbacks.result = rs_handle_result;
+    callbacks.result_extra = &params;
+
+    // set search params
+    rs_init_params(&params, xtree, ytree, mindist, maxdist, notself,
+                   distsquared);
     params.user_callback = callback;
     params.user_callback_param = param;
-    params.xtree = xtree;
-    params.ytree = ytree;
     if (progress) {
         callbacks.start_results = rs_start_results;
         callbacks.start_extra = &params;
@@ -113,6 +124,146 @@ void dualtree_rangesearch(kdtree_t* xtree, kdtree_t* ytree,
     dualtree_search(xtree, ytree, &callbacks);
 }
 
+// One subtree of the query tree, and its matches.
+struct rs_task {
+    dualtree_task_t* task;
+    // (xind, yind) pairs
+    il* inds;
+    dl* dist2;
+};
+
+struct rs_threads {
+    const rs_params* params;
+    struct rs_task* tasks;
+    int ntasks;
+    int next;
+    pthread_mutex_t lock;
+};
+
+static void rs_collect(void* extra, int xind, int yind, double dist2) {
+    struct rs_task* t = extra;
+    il_append(t->inds, xind);
+    il_append(t->inds, yind);
+    dl_append(t->dist2, dist2);
+}
+
+static void* rs_thread(void* v) {
+    struct rs_threads* rt = v;
+    while (1) {
+        struct rs_task* t;
+        dualtree_callbacks callbacks;
+        rs_params params;
+        pthread_mutex_lock(&rt->lock);
+        if (rt->next >= rt->ntasks) {
+            pthread_mutex_unlock(&rt->lock);
+            break;
+        }
+        t = rt->tasks + rt->next;
+        rt->next++;
+        pthread_mutex_unlock(&rt->lock);
+
+        memcpy(&params, rt->params, sizeof(rs_params));
+        params.user_callback = rs_collect;
+        params.user_callback_param = t;
+        memset(&callbacks, 0, sizeof(dualtree_callbacks));
+        callbacks.decision = rs_within_range;
+        callbacks.decision_extra = &params;
+        callbacks.result = rs_handle_result;
+        callbacks.result_extra = &params;
+        t->inds = il_new(1024);
+        t->dist2 = dl_new(512);
+        dualtree_run_task(params.xtree, params.ytree, t->task, &callbacks);
+    }
+    return NULL;
+}
+
+int dualtree_rangesearch_pairs(kdtree_t* xtree, kdtree_t* ytree,
+                               double mindist, double maxdist,
+                               int notself,
+                               dist2_function distsquared,
+                               int nthreads,
+                               size_t* pN, int** pinds, double** pdist2) {
+    dualtree_callbacks callbacks;
+    rs_params params;
+    struct rs_threads rt;
+    pthread_t* threads;
+    pl* tasks;
+    int i, depth, nstarted = 0;
+    size_t N;
+    int* inds;
+    double* dist2;
+
+    nthreads = MAX(1, nthreads);
+    rs_init_params(&params, xtree, ytree, mindist, maxdist, notself,
+                   distsquared);
+    memset(&callbacks, 0, sizeof(dualtree_callbacks));
+    callbacks.decision = rs_within_range;
+    callbacks.decision_extra = &params;
+
+    // aim for several subtrees per thread, so that the load balances.
+    depth = 0;
+    if (nthreads > 1)
+        while ((1 << depth) < 8 * nthreads)
+            depth++;
+    tasks = dualtree_split(xtree, ytree, depth, &callbacks);
+
+    memset(&rt, 0, sizeof(rt));
+    rt.params = &params;
+    rt.ntasks = pl_size(tasks);
+    rt.tasks = calloc(rt.ntasks, sizeof(struct rs_task));
+    for (i=0; i<rt.ntasks; i++)
+        rt.tasks[i].task = pl_get(tasks, i);
+    pthread_mutex_init(&rt.lock, NULL);
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    for (i=1; i<MIN(nthreads, rt.ntasks); i++) {
+        if (pthread_create(threads + nstarted, NULL, rs_thread, &rt)) {
+            SYSERROR("Failed to start range-search thread");
+            break;
+        }
+        nstarted++;
+    }
+    // this thread works too.
+    rs_thread(&rt);
+    for (i=0; i<nstarted; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&rt.lock);
+
+    N = 0;
+    for (i=0; i<rt.ntasks; i++)
+        N += dl_size(rt.tasks[i].dist2);
+    inds = malloc(MAX(1, 2 * N) * sizeof(int));
+    dist2 = malloc(MAX(1, N) * sizeof(double));
+    if (!inds || !dist2) {
+        SYSERROR("Failed to allocate %zu range-search results", N);
+        free(inds);
+        free(dist2);
+        inds = NULL;
+        dist2 = NULL;
+    }
+    N = 0;
+    for (i=0; i<rt.ntasks; i++) {
+        struct rs_task* t = rt.tasks + i;
+        size_t n = dl_size(t->dist2);
+        if (inds) {
+            il_copy(t->inds, 0, 2 * n, inds + 2 * N);
+            dl_copy(t->dist2, 0, n, dist2 + N);
+        }
+        N += n;
+        il_free(t->inds);
+        dl_free(t->dist2);
+    }
+    free(rt.tasks);
+    dualtree_free_tasks(tasks);
+    if (!inds)
+        return -1;
+    *pN = N;
+    *pinds = inds;
+    *pdist2 = dist2;
+    return 0;
+}
+
 static void rs_start_results(void* vparams,
                              kdtree_t* ytree, int ynode) {
     rs_params* p = (rs_params*)vparams;
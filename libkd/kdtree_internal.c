@@ -14,6 +14,7 @@
 #include "kdtree_mem.h"
 #include "keywords.h"
 #include "errors.h"
+#include "ioutils.h"
 
 #define KDTREE_MAX_RESULTS 1000
 #define KDTREE_MAX_DIM 100
@@ -410,7 +411,7 @@ static void compute_splitbits(kdtree_t* kd) {
 /* Sorts results by kq->sdists */
 static int kdtree_qsort_results(kdtree_qres_t *kq, int D) {
     int beg[KDTREE_MAX_RESULTS], end[KDTREE_MAX_RESULTS], i = 0, j, L, R;
-    static etype piv_vec[KDTREE_MAX_DIM];
+    etype piv_vec[KDTREE_MAX_DIM];
     unsigned int piv_perm;
     double piv;
 
@@ -1437,17 +1438,20 @@ static void copy_data_double(const kdtree_t* kd, int start, int N,
 #endif
 }
 
-static dtype* kdqsort_arr;
-static int kdqsort_D;
+struct kdqsort_token {
+    const dtype* arr;
+    int D;
+};
 
-static int kdqsort_compare(const void* v1, const void* v2)
+static int QSORT_COMPARISON_FUNCTION(kdqsort_compare, void* token, const void* v1, const void* v2)
 {
+    const struct kdqsort_token* tok = token;
     int i1, i2;
     dtype val1, val2;
     i1 = *((int*)v1);
     i2 = *((int*)v2);
-    val1 = kdqsort_arr[(size_t)i1 * (size_t)kdqsort_D];
-    val2 = kdqsort_arr[(size_t)i2 * (size_t)kdqsort_D];
+    val1 = tok->arr[(size_t)i1 * (size_t)tok->D];
+    val2 = tok->arr[(size_t)i2 * (size_t)tok->D];
     if (val1 < val2)
         return -1;
     else if (val1 > val2)
@@ -1461,6 +1465,7 @@ static int kdtree_qsort(dtype *arr, unsigned int *parr, int l, int r, int D, int
     int i, j, N;
     dtype* tmparr;
     int* tmpparr;
+    struct kdqsort_token tok;
 
     N = r - l + 1;
     permute = MALLOC((size_t)N * sizeof(int));
@@ -1470,10 +1475,10 @@ static int kdtree_qsort(dtype *arr, unsigned int *parr, int l, int r, int D, int
     }
     for (i = 0; i < N; i++)
         permute[i] = i;
-    kdqsort_arr = arr + (size_t)l * (size_t)D + (size_t)d;
-    kdqsort_D = D;
+    tok.arr = arr + (size_t)l * (size_t)D + (size_t)d;
+    tok.D = D;
 
-    qsort(permute, N, sizeof(int), kdqsort_compare);
+    QSORT_R(permute, N, sizeof(int), &tok, kdqsort_compare);
 
     // permute the data one dimension at a time...
     tmparr = MALLOC(N * sizeof(dtype));
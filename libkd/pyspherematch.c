@@ -11,6 +11,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
@@ -563,84 +564,68 @@ static PyObject* spherematch_match2(PyObject* self, PyObject* args) {
     return indlist;
 }
 
-struct dualtree_results {
-    il* inds1;
-    il* inds2;
-    dl* dists;
-};
-
-static void callback_dualtree(void* v, int ind1, int ind2, double dist2) {
-    struct dualtree_results* dtresults = v;
-    il_append(dtresults->inds1, ind1);
-    il_append(dtresults->inds2, ind2);
-    dl_append(dtresults->dists, sqrt(dist2));
-}
-
 static PyObject* spherematch_match(PyObject* self, PyObject* args) {
     size_t i, N;
     KdObject *kdobj1 = NULL, *kdobj2 = NULL;
     kdtree_t *kd1, *kd2;
     double rad;
-    struct dualtree_results dtresults;
     PyArrayObject* inds;
     npy_intp dims[2];
     PyArrayObject* dists;
     anbool notself;
     anbool permute;
-    PyObject* rtn;
+    int nthreads = 1;
+    int* pairs = NULL;
+    double* dist2 = NULL;
+    int rtn;
+    PyObject* result;
 	
     // So that ParseTuple("b") with a C "anbool" works
     assert(sizeof(anbool) == sizeof(unsigned char));
 
-    if (!PyArg_ParseTuple(args, "O!O!dbb",
+    if (!PyArg_ParseTuple(args, "O!O!dbb|i",
                           &KdType, &kdobj1, &KdType, &kdobj2,
-                          &rad, &notself, &permute)) {
-        PyErr_SetString(PyExc_ValueError, "spherematch_c.match: need five args: two KdTree objects, search radius (float), notself (boolean), permuted (boolean)");
+                          &rad, &notself, &permute, &nthreads)) {
+        PyErr_SetString(PyExc_ValueError, "spherematch_c.match: need five args: two KdTree objects, search radius (float), notself (boolean), permuted (boolean); optional: number of threads (int)");
         return NULL;
     }
     kd1 = kdobj1->kd;
     kd2 = kdobj2->kd;
 
-    dtresults.inds1 = il_new(256);
-    dtresults.inds2 = il_new(256);
-    dtresults.dists = dl_new(256);
-    dualtree_rangesearch(kd1, kd2, 0.0, rad, notself, NULL,
-                         callback_dualtree, &dtresults,
-                         NULL, NULL);
+    // The search only reads the trees, so other Python threads can run.
+    Py_BEGIN_ALLOW_THREADS
+    rtn = dualtree_rangesearch_pairs(kd1, kd2, 0.0, rad, notself, NULL,
+                                     nthreads, &N, &pairs, &dist2);
+    if (!rtn) {
+        for (i=0; i<N; i++) {
+            if (permute) {
+                pairs[2*i]   = kdtree_permute(kd1, pairs[2*i]);
+                pairs[2*i+1] = kdtree_permute(kd2, pairs[2*i+1]);
+            }
+            dist2[i] = sqrt(dist2[i]);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (rtn) {
+        PyErr_SetString(PyExc_MemoryError, "spherematch_c.match: failed to collect matches");
+        return NULL;
+    }
 
-    N = il_size(dtresults.inds1);
     dims[0] = N;
     dims[1] = 2;
-
     inds =  (PyArrayObject*)PyArray_SimpleNew(2, dims, NPY_INT);
     dims[1] = 1;
     dists = (PyArrayObject*)PyArray_SimpleNew(2, dims, NPY_DOUBLE);
-    for (i=0; i<N; i++) {
-        int index;
-        int* iptr;
-        double* dptr;
-        iptr = PyArray_GETPTR2(inds, i, 0);
-        index = il_get(dtresults.inds1, i);
-        if (permute)
-            index = kdtree_permute(kd1, index);
-        *iptr = index;
-        iptr = PyArray_GETPTR2(inds, i, 1);
-        index = il_get(dtresults.inds2, i);
-        if (permute)
-            index = kdtree_permute(kd2, index);
-        *iptr = index;
-        dptr = PyArray_GETPTR2(dists, i, 0);
-        *dptr = dl_get(dtresults.dists, i);
-    }
-
-    il_free(dtresults.inds1);
-    il_free(dtresults.inds2);
-    dl_free(dtresults.dists);
-
-    rtn = Py_BuildValue("(OO)", inds, dists);
+    // new arrays are C-contiguous.
+    memcpy(PyArray_DATA(inds), pairs, 2 * N * sizeof(int));
+    memcpy(PyArray_DATA(dists), dist2, N * sizeof(double));
+    free(pairs);
+    free(dist2);
+
+    result = Py_BuildValue("(OO)", inds, dists);
     Py_DECREF(inds);
     Py_DECREF(dists);
-    return rtn;
+    return result;
 }
 
 static PyObject* spherematch_nn(PyObject* self, PyObject* args) {
@@ -16,7 +16,7 @@ def match_xy(x1,y1, x2,y2, R, **kwargs):
     
 # Copied from "celestial.py" by Sjoert van Velzen.
 def match_radec(ra1, dec1, ra2, dec2, radius_in_deg, notself=False,
-                nearest=False, indexlist=False, count=False):
+                nearest=False, indexlist=False, count=False, nthreads=1):
     '''
     Cross-matches numpy arrays of RA,Dec points.
 
@@ -41,7 +41,10 @@ def match_radec(ra1, dec1, ra2, dec2, radius_in_deg, notself=False,
     indexlist : boolean
         If True, returns a list of length *len(ra1)*, containing *None*
         or a list of ints of matched points in *ra2,dec2*.
-        
+
+    nthreads : int
+        Number of threads to use for the (non-*nearest*, non-*indexlist*)
+        search; see *match*.
 
     Returns
     -------
@@ -78,7 +81,8 @@ def match_radec(ra1, dec1, ra2, dec2, radius_in_deg, notself=False,
             print('J', J.shape, J.dtype)
             print('counts', counts.shape, counts.dtype)
     else:
-        X = match(xyz1, xyz2, r, notself=notself, indexlist=indexlist)
+        X = match(xyz1, xyz2, r, notself=notself, indexlist=indexlist,
+                  nthreads=nthreads)
         if indexlist:
             return X
         (inds,dists) = X
@@ -176,7 +180,8 @@ def _buildtrees(x1, x2):
         kd2 = spherematch_c.KdTree(fx2)
     return (kd1, kd2)
 
-def match(x1, x2, radius, notself=False, permuted=True, indexlist=False):
+def match(x1, x2, radius, notself=False, permuted=True, indexlist=False,
+          nthreads=1):
     '''
     ::
 
@@ -274,6 +279,11 @@ def match(x1, x2, radius, notself=False, permuted=True, indexlist=False):
 
     radius : float
         Scalar Euclidean distance to match
+
+    nthreads : int
+        Number of threads to search with (not used with *indexlist*).
+        The matches come out in the same order whatever the number of
+        threads.  The search runs without holding the GIL.
         
     Returns
     -------
@@ -295,7 +305,8 @@ def match(x1, x2, radius, notself=False, permuted=True, indexlist=False):
     if indexlist:
         inds = spherematch_c.match2(kd1, kd2, radius, notself, permuted)
     else:
-        (inds,dists) = spherematch_c.match(kd1, kd2, radius, notself, permuted)
+        (inds,dists) = spherematch_c.match(kd1, kd2, radius, notself, permuted,
+                                           nthreads)
     if indexlist:
         return inds
     return (inds,dists)
@@ -421,7 +432,7 @@ def tree_search_radec(kd, ra, dec, radius, getdists=False, sortdists=False):
     return tree_search(kd, pos, rad, getdists=getdists, sortdists=sortdists)
 
 def trees_match(kd1, kd2, radius, nearest=False, notself=False,
-                permuted=True, count=False):
+                permuted=True, count=False, nthreads=1):
     '''
     Runs rangesearch or nearest-neighbour matching on given kdtrees.
 
@@ -434,6 +445,8 @@ def trees_match(kd1, kd2, radius, nearest=False, notself=False,
     as well as returning the nearest neighbor of each point in "kd1";
     the return value becomes I,J,d,counts , counts a numpy array of ints.
 
+    The range search (not 'nearest') uses 'nthreads' threads.
+
     Returns (I, J, d), where
       I are indices into kd1
       J are indices into kd2
@@ -469,7 +482,8 @@ def trees_match(kd1, kd2, radius, nearest=False, notself=False,
         rtn = (rtn[1], rtn[0], np.sqrt(rtn[2])) + rtn[3:]
         #distsq2deg(rtn[2]),
     else:
-        (inds,dists) = spherematch_c.match(kd1, kd2, radius, notself, permuted)
+        (inds,dists) = spherematch_c.match(kd1, kd2, radius, notself, permuted,
+                                           nthreads)
         #d = dist2deg(dists[:,0])
         d = dists[:,0]
         I,J = inds[:,0], inds[:,1]
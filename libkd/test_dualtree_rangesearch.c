@@ -0,0 +1,86 @@
+/*
+ # This file is part of libkd.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+#include "dualtree_rangesearch.h"
+#include "mathutil.h"
+#include "an-bool.h"
+#include "bl.h"
+
+static void collect(void* extra, int xind, int yind, double dist2) {
+    il* inds = extra;
+    il_append(inds, xind);
+    il_append(inds, yind);
+}
+
+void test_rangesearch_pairs(CuTest* tc) {
+    int NX = 3000;
+    int NY = 2000;
+    int D = 3;
+    int Nleaf = 8;
+    double maxr = 0.05;
+    int threads[] = { 1, 4 };
+    double* xdata;
+    double* ydata;
+    kdtree_t* xkd;
+    kdtree_t* ykd;
+    il* serial;
+    int i, j, t, nbrute;
+
+    srand(0);
+    xdata = malloc(NX * D * sizeof(double));
+    ydata = malloc(NY * D * sizeof(double));
+    for (i=0; i<(NX*D); i++)
+        xdata[i] = rand() / (double)RAND_MAX;
+    for (i=0; i<(NY*D); i++)
+        ydata[i] = rand() / (double)RAND_MAX;
+
+    nbrute = 0;
+    for (j=0; j<NY; j++)
+        for (i=0; i<NX; i++)
+            if (distsq(xdata + i*D, ydata + j*D, D) <= maxr*maxr)
+                nbrute++;
+
+    xkd = kdtree_build(NULL, xdata, NX, D, Nleaf, KDTT_DOUBLE, KD_BUILD_BBOX);
+    ykd = kdtree_build(NULL, ydata, NY, D, Nleaf, KDTT_DOUBLE, KD_BUILD_BBOX);
+
+    serial = il_new(1024);
+    dualtree_rangesearch(xkd, ykd, RANGESEARCH_NO_LIMIT, maxr, FALSE, NULL,
+                         collect, serial, NULL, NULL);
+    CuAssertIntEquals(tc, nbrute, il_size(serial) / 2);
+
+    for (t=0; t<sizeof(threads)/sizeof(int); t++) {
+        size_t N;
+        int* inds;
+        double* dist2;
+        CuAssertIntEquals(tc, 0, dualtree_rangesearch_pairs
+                          (xkd, ykd, RANGESEARCH_NO_LIMIT, maxr, FALSE, NULL,
+                           threads[t], &N, &inds, &dist2));
+        // same matches, in the same order.
+        CuAssertIntEquals(tc, nbrute, N);
+        for (i=0; i<2*N; i++)
+            CuAssertIntEquals(tc, il_get(serial, i), inds[i]);
+        for (i=0; i<N; i++) {
+            double pxy[3], py[3];
+            kdtree_copy_data_double(xkd, inds[2*i], 1, pxy);
+            kdtree_copy_data_double(ykd, inds[2*i+1], 1, py);
+            CuAssertDblEquals(tc, distsq(pxy, py, D), dist2[i], 1e-12);
+        }
+        free(inds);
+        free(dist2);
+    }
+
+    il_free(serial);
+    kdtree_free(xkd);
+    kdtree_free(ykd);
+    free(xdata);
+    free(ydata);
+}
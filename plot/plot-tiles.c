@@ -0,0 +1,387 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "os-features.h"
+#include "plotstuff.h"
+#include "plotimage.h"
+#include "sip.h"
+#include "sip-utils.h"
+#include "sip_qfits.h"
+#include "cairoutils.h"
+#include "boilerplate.h"
+#include "ioutils.h"
+#include "mathutil.h"
+#include "fitsioutils.h"
+#include "log.h"
+#include "errors.h"
+
+/**
+ Cuts a WCS-solved image into a pyramid of tiles for a web viewer.
+
+ Level "maxlevel" is the image at full resolution, and each level below
+ it is half the size of the one above, down to level 0, which fits in a
+ single tile.  Tile (x, y) of level z is written to
+ <outdir>/z/x/y.png; with -A, an annotation layer (NGC/IC objects,
+ bright stars, constellations), transparent except for the labels, is
+ written next to it as y-ann.png.  The WCS of the full-resolution image
+ goes in <outdir>/wcs.fits.
+
+ The image is read and scaled once; each level is made by averaging
+ 2x2 blocks of the level above it, and the WCS of each level and tile
+ is derived from the image's WCS rather than re-read or re-fit.
+ */
+
+static const char* OPTIONS = "hvw:e:o:t:Aa:L:H:j:";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s [options] <image>\n"
+           "    -o <output-directory>\n"
+           "    [-w <wcs-file>]: WCS of the image; default: the image's header\n"
+           "    [-e <extension>]: FITS extension of the image and WCS; default 0\n"
+           "    [-t <pixels>]: tile size; default 256\n"
+           "    [-A]: also write annotation tiles\n"
+           "    [-a <level>]: coarsest level to annotate; default 0\n"
+           "    [-L <value>]: FITS pixel value to make black\n"
+           "    [-H <value>]: FITS pixel value to make white\n"
+           "              (default: scale between percentiles of the image)\n"
+           "    [-j <threads>]: default 1\n"
+           "    [-v]: +verbose\n"
+           "\n", progname);
+}
+
+struct level {
+    int z;
+    unsigned char* img;
+    int W, H;
+    int T;
+    int NX, NY;
+    const char* outdir;
+};
+
+struct tile_job {
+    const struct level* level;
+    pthread_mutex_t lock;
+    int next;
+    int nfailed;
+};
+
+static void get_tile(const struct level* level, int tx, int ty,
+                     unsigned char* tile) {
+    int T = level->T;
+    int x0 = tx * T;
+    int y0 = ty * T;
+    int w = MIN(T, level->W - x0);
+    int h = MIN(T, level->H - y0);
+    int j;
+    // pad edge tiles with transparent pixels.
+    if (w < T || h < T)
+        memset(tile, 0, T * T * 4);
+    for (j=0; j<h; j++)
+        memcpy(tile + 4 * j * T,
+               level->img + 4 * ((size_t)(y0 + j) * level->W + x0), 4 * w);
+}
+
+// Creates the <outdir>/<z>/<x> directories of a level.  This is done
+// before the tile threads start, so they never race to create them.
+static int make_tile_dirs(const struct level* level) {
+    int tx;
+    for (tx=0; tx<level->NX; tx++) {
+        char* dir;
+        asprintf_safe(&dir, "%s/%i/%i", level->outdir, level->z, tx);
+        if (mkdir_p(dir)) {
+            ERROR("Failed to create directory %s", dir);
+            free(dir);
+            return -1;
+        }
+        free(dir);
+    }
+    return 0;
+}
+
+static char* tile_filename(const struct level* level, int tx, int ty,
+                           const char* suffix) {
+    char* fn;
+    asprintf_safe(&fn, "%s/%i/%i/%i%s.png", level->outdir, level->z, tx, ty,
+                  suffix);
+    return fn;
+}
+
+static void* tile_thread(void* vjob) {
+    struct tile_job* job = vjob;
+    const struct level* level = job->level;
+    unsigned char* tile = malloc(level->T * level->T * 4);
+    for (;;) {
+        int t;
+        char* fn;
+        pthread_mutex_lock(&job->lock);
+        t = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (t >= level->NX * level->NY)
+            break;
+        get_tile(level, t % level->NX, t / level->NX, tile);
+        fn = tile_filename(level, t % level->NX, t / level->NX, "");
+        if (cairoutils_write_png(fn, tile, level->T, level->T)) {
+            ERROR("Failed to write tile %i/%i/%i", level->z,
+                  t % level->NX, t / level->NX);
+            pthread_mutex_lock(&job->lock);
+            job->nfailed++;
+            pthread_mutex_unlock(&job->lock);
+        }
+        free(fn);
+    }
+    free(tile);
+    return NULL;
+}
+
+static int write_image_tiles(const struct level* level, int nthreads) {
+    struct tile_job job;
+    pthread_t* threads;
+    int i;
+    if (make_tile_dirs(level))
+        return -1;
+    memset(&job, 0, sizeof(job));
+    job.level = level;
+    pthread_mutex_init(&job.lock, NULL);
+    nthreads = MAX(1, MIN(nthreads, level->NX * level->NY));
+    threads = calloc(nthreads, sizeof(pthread_t));
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + i, NULL, tile_thread, &job)) {
+            SYSERROR("Failed to create thread");
+            nthreads = i;
+            break;
+        }
+    }
+    tile_thread(&job);
+    for (i=1; i<nthreads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&job.lock);
+    return job.nfailed ? -1 : 0;
+}
+
+static int write_annotation_tiles(const struct level* level,
+                                  const sip_t* levelwcs,
+                                  plot_args_t* ann) {
+    int tx, ty;
+    for (ty=0; ty<level->NY; ty++) {
+        for (tx=0; tx<level->NX; tx++) {
+            sip_t tilewcs;
+            int x0 = tx * level->T;
+            int y0 = ty * level->T;
+            sip_shift(levelwcs, &tilewcs, x0 + 1, x0 + level->T,
+                      y0 + 1, y0 + level->T);
+            plotstuff_set_wcs_sip(ann, &tilewcs);
+            if (!ann->cairo && plotstuff_init2(ann))
+                return -1;
+            plotstuff_clear(ann);
+            if (plotstuff_plot_layer(ann, "annotations"))
+                return -1;
+            ann->outfn = tile_filename(level, tx, ty, "-ann");
+            if (plotstuff_output(ann)) {
+                free(ann->outfn);
+                ann->outfn = NULL;
+                return -1;
+            }
+            free(ann->outfn);
+            ann->outfn = NULL;
+        }
+    }
+    return 0;
+}
+
+// Halves "img" (in place): each output pixel is the average of a 2x2
+// block, with the colors weighted by alpha so transparent pixels don't
+// darken the edges.
+static void downsample_rgba(unsigned char* img, int W, int H,
+                            int* pW, int* pH) {
+    int W2 = (W + 1) / 2;
+    int H2 = (H + 1) / 2;
+    int i, j, di, dj, k;
+    for (j=0; j<H2; j++) {
+        for (i=0; i<W2; i++) {
+            double sum[3] = { 0, 0, 0 };
+            double asum = 0;
+            int n = 0;
+            unsigned char* out = img + 4 * (j * W2 + i);
+            for (dj=0; dj<2; dj++) {
+                if (2*j + dj >= H)
+                    continue;
+                for (di=0; di<2; di++) {
+                    const unsigned char* in;
+                    if (2*i + di >= W)
+                        continue;
+                    in = img + 4 * ((size_t)(2*j + dj) * W + 2*i + di);
+                    for (k=0; k<3; k++)
+                        sum[k] += in[k] * (double)in[3];
+                    asum += in[3];
+                    n++;
+                }
+            }
+            // (in place is safe: every later output pixel's inputs come
+            // after this one.)
+            for (k=0; k<3; k++)
+                out[k] = asum ? (unsigned char)(sum[k] / asum + 0.5) : 0;
+            out[3] = (unsigned char)(asum / n + 0.5);
+        }
+    }
+    *pW = W2;
+    *pH = H2;
+}
+
+int main(int argc, char** args) {
+    int argchar;
+    char* progname = args[0];
+    char* imgfn;
+    char* wcsfn = NULL;
+    char* outdir = NULL;
+    int ext = 0;
+    int T = 256;
+    anbool annotate = FALSE;
+    int minann = 0;
+    double lo = 0, hi = 0;
+    int nthreads = 1;
+    int loglvl = LOG_MSG;
+    plot_args_t pargs;
+    plot_args_t ann;
+    plotimage_t* img;
+    sip_t wcs;
+    struct level level;
+    int maxlevel, z;
+    char* fn;
+
+    while ((argchar = getopt(argc, args, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'v':
+            loglvl++;
+            break;
+        case 'w':
+            wcsfn = optarg;
+            break;
+        case 'e':
+            ext = atoi(optarg);
+            break;
+        case 'o':
+            outdir = optarg;
+            break;
+        case 't':
+            T = atoi(optarg);
+            break;
+        case 'A':
+            annotate = TRUE;
+            break;
+        case 'a':
+            minann = atoi(optarg);
+            break;
+        case 'L':
+            lo = atof(optarg);
+            break;
+        case 'H':
+            hi = atof(optarg);
+            break;
+        case 'j':
+            nthreads = atoi(optarg);
+            break;
+        case 'h':
+            printHelp(progname);
+            exit(0);
+        case '?':
+        default:
+            printHelp(progname);
+            exit(-1);
+        }
+
+    if (optind != argc - 1 || !outdir || T < 1) {
+        printHelp(progname);
+        exit(-1);
+    }
+    imgfn = args[optind];
+    if (!wcsfn)
+        wcsfn = imgfn;
+    log_init(loglvl);
+    errors_log_to(stderr);
+    fits_use_error_system();
+
+    if (!sip_read_tan_or_sip_header_file_ext(wcsfn, ext, &wcs, FALSE)) {
+        ERROR("Failed to read WCS from file \"%s\" extension %i", wcsfn, ext);
+        exit(-1);
+    }
+
+    plotstuff_init(&pargs);
+    pargs.nthreads = nthreads;
+    img = plotstuff_get_config(&pargs, "image");
+    plot_image_set_filename(img, imgfn);
+    img->fitsext = ext;
+    if (lo == 0 && hi == 0)
+        img->auto_scale = TRUE;
+    img->image_low = lo;
+    img->image_high = hi;
+    if (plot_image_read(&pargs, img)) {
+        ERROR("Failed to read image \"%s\"", imgfn);
+        exit(-1);
+    }
+    logmsg("Read image %s: %i x %i\n", imgfn, img->W, img->H);
+
+    if (mkdir_p(outdir)) {
+        ERROR("Failed to create output directory %s", outdir);
+        exit(-1);
+    }
+    asprintf_safe(&fn, "%s/wcs.fits", outdir);
+    if (sip_write_to_file(&wcs, fn)) {
+        ERROR("Failed to write WCS to %s", fn);
+        exit(-1);
+    }
+    free(fn);
+
+    if (annotate) {
+        plotstuff_init(&ann);
+        ann.outformat = PLOTSTUFF_FORMAT_PNG;
+        ann.W = ann.H = T;
+    }
+
+    maxlevel = 0;
+    while ((T << maxlevel) < MAX(img->W, img->H))
+        maxlevel++;
+    logmsg("Writing levels 0 to %i\n", maxlevel);
+
+    level.img = img->img;
+    level.W = img->W;
+    level.H = img->H;
+    level.T = T;
+    level.outdir = outdir;
+    for (z=maxlevel; z>=0; z--) {
+        level.z = z;
+        level.NX = (level.W + T - 1) / T;
+        level.NY = (level.H + T - 1) / T;
+        logverb("Level %i: %i x %i pixels, %i x %i tiles\n", z,
+                level.W, level.H, level.NX, level.NY);
+        if (write_image_tiles(&level, nthreads))
+            exit(-1);
+        if (annotate && z >= minann) {
+            sip_t levelwcs;
+            sip_scale(&wcs, &levelwcs, 1.0 / (double)(1 << (maxlevel - z)));
+            if (write_annotation_tiles(&level, &levelwcs, &ann)) {
+                ERROR("Failed to write annotation tiles for level %i", z);
+                exit(-1);
+            }
+        }
+        if (z)
+            downsample_rgba(level.img, level.W, level.H, &level.W, &level.H);
+    }
+
+    if (annotate)
+        plotstuff_free(&ann);
+    plotstuff_free(&pargs);
+    return 0;
+}
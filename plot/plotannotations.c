@@ -12,6 +12,7 @@
 #include "os-features.h"
 #include "plotannotations.h"
 #include "hd.h"
+#include "annotation-catalogs.h"
 #include "openngc.h"
 #include "brightstars.h"
 #include "cairoutils.h"
@@ -173,55 +174,28 @@ static void color_for_radec(double ra, double dec, float* r, float* g, float* b)
 }
 
 static void plot_constellations(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
-    int i, N;
+    int i, c;
     double ra,dec,radius;
-    double xyzf[3];
+    il* cons;
     // Find the field center and radius
     anwcs_get_radec_center_and_radius(pargs->wcs, &ra, &dec, &radius);
     logverb("Plotting constellations: field center %g,%g, radius %g\n",
             ra, dec, radius);
-    radecdeg2xyzarr(ra, dec, xyzf);
-    radius = deg2dist(radius);
+    cons = il_new(16);
+    annotation_catalogs_constellations(ra, dec, radius, cons);
+    logverb("%zu constellations overlap the field\n", il_size(cons));
 
-    N = constellations_n();
-    for (i=0; i<N; i++) {
+    for (c=0; c<il_size(cons); c++) {
         int j, k;
-        // Find the approximate center and radius of this constellation
-        // and see if it overlaps with the field.
-        il* stars = constellations_get_unique_stars(i);
         double xyzj[3];
         double xyzc[3];
-        double maxr2 = 0;
+        il* stars;
         dl* rds;
-        xyzc[0] = xyzc[1] = xyzc[2] = 0.0;
-        xyzj[0] = xyzj[1] = xyzj[2] = 0.0;
-        for (j=0; j<il_size(stars); j++) {
-            constellations_get_star_radec(il_get(stars, j), &ra, &dec);
-            radecdeg2xyzarr(ra, dec, xyzj);
-            for (k=0; k<3; k++)
-                xyzc[k] += xyzj[k];
-        }
-        normalize_3(xyzc);
-        for (j=0; j<il_size(stars); j++) {
-            constellations_get_star_radec(il_get(stars, j), &ra, &dec);
-            maxr2 = MAX(maxr2, distsq(xyzc, xyzj, 3));
-        }
-        il_free(stars);
-        maxr2 = square(sqrt(maxr2) + radius);
-        if (distsq(xyzf, xyzc, 3) > maxr2) {
-            xyzarr2radecdeg(xyzc, &ra, &dec);
-            logverb("Constellation %s (center %g,%g, radius %g) out of bounds\n",
-                    constellations_get_shortname(i), ra, dec,
-                    dist2deg(sqrt(maxr2) - radius));
-            logverb("  dist from field center to constellation center is %g deg\n",
-                    distsq2deg(distsq(xyzf, xyzc, 3)));
-            logverb("  max radius: %g\n", distsq2deg(maxr2));
-            continue;
-        }
+        i = il_get(cons, c);
 
         if (ann->constellation_pastel) {
             float r,g,b;
-            xyzarr2radecdeg(xyzc, &ra, &dec);
+            annotation_catalogs_constellation_center(i, &ra, &dec);
             color_for_radec(ra, dec, &r,&g,&b);
             plotstuff_set_rgba2(pargs, r,g,b, 0.8);
             plotstuff_builtin_apply(cairo, pargs);
@@ -288,26 +262,26 @@ static void plot_constellations(cairo_t* cairo, plot_args_t* pargs, plotann_t* a
             il_free(stars);
         }
     }
+    il_free(cons);
 }
 
 static void plot_brightstars(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
-    int i, N;
+    int i;
+    il* inds;
 
     // Get plot center, to use in trimming bright stars
     double rc,dc,radius;
     plotstuff_get_radec_center_and_radius(pargs, &rc, &dc, &radius);
 
-    N = bright_stars_n();
-    for (i=0; i<N; i++) {
+    inds = il_new(256);
+    annotation_catalogs_bright_stars(rc, dc, radius * 1.2, inds);
+    for (i=0; i<il_size(inds); i++) {
         double px, py;
         char* label;
-        const brightstar_t* bs = bright_stars_get(i);
+        const brightstar_t* bs = bright_stars_get(il_get(inds, i));
         // skip unnamed
         if (!strlen(bs->name) && !strlen(bs->common_name))
             continue;
-        // skip stars too far away
-        if (deg_between_radecdeg(rc, dc, bs->ra, bs->dec) > radius * 1.2)
-            continue;
         if (!plotstuff_radec2xy(pargs, bs->ra, bs->dec, &px, &py))
             continue;
         logverb("Bright star %s/%s at RA,Dec (%g,%g) -> xy (%g, %g)\n",
@@ -329,6 +303,7 @@ static void plot_brightstars(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann)
             plotstuff_stack_text(pargs, cairo, label, px, py);
         }
     }
+    il_free(inds);
 }
 
 int plot_annotations_set_hd_catalog(plotann_t* ann, const char* hdfn) {
@@ -346,7 +321,7 @@ static void plot_hd(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
 
     if (!ann->hd_catalog)
         return;
-    hdcat = henry_draper_open(ann->hd_catalog);
+    hdcat = annotation_catalogs_hd(ann->hd_catalog);
     if (!hdcat) {
         ERROR("Failed to open Henry Draper catalog file \"%s\"", ann->hd_catalog);
         return;
@@ -379,13 +354,13 @@ static void plot_hd(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
         }
     }
     bl_free(hdlist);
-    henry_draper_close(hdcat);
 }
 
 static void plot_ngc(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
     double imscale;
     double imsize;
     int i, N;
+    il* inds;
 
     // arcsec/pixel
     imscale = plotstuff_pixel_scale(pargs);
@@ -403,7 +378,8 @@ static void plot_ngc(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
     // bit of margin
     radius_deg *= 1.1;
 
-    N = ngc_num_entries();
+    inds = il_new(256);
+    N = annotation_catalogs_ngc(ra_center, dec_center, radius_deg, inds);
     logverb("Checking %i NGC/IC objects.\n", N);
 
     for (i=0; i<N; i++) {
@@ -413,13 +389,7 @@ static void plot_ngc(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
         double px, py;
         double r;
 
-        ngc = ngc_get_entry(i);
-        if (!ngc)
-            break;
-
-        // Quick filter
-        if (deg_between_radecdeg(ra_center, dec_center, ngc->ra, ngc->dec) > radius_deg)
-            continue;
+        ngc = ngc_get_entry(il_get(inds, i));
 
         if (ngc->size < imsize * ann->ngc_fraction) {
             // FIXME -- just plot an X-mark with label.
@@ -472,6 +442,7 @@ static void plot_ngc(cairo_t* cairo, plot_args_t* pargs, plotann_t* ann) {
          }
          */
     }
+    il_free(inds);
 }
 
 void* plot_annotations_init(plot_args_t* args) {
@@ -5,6 +5,8 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "os-features.h"
 #include "plotimage.h"
@@ -129,10 +131,14 @@ void plot_image_wcs(cairo_t* cairo, unsigned char* img, int W, int H,
             unsigned char* img2 = NULL;
             //int Nin = args->W * args->H;
             int Nout = pargs->W * pargs->H;
+            resample_grid_t* grid = plotstuff_get_resample_grid(pargs);
             img2 = calloc(Nout * 4, 1);
-            if (resample_wcs_rgba(args->wcs, args->img, args->W, args->H,
-                                  pargs->wcs, img2, pargs->W, pargs->H)) {
+            if (!grid ||
+                resample_wcs_rgba_grid(grid, args->wcs, args->img,
+                                       args->W, args->H, img2,
+                                       pargs->nthreads)) {
                 ERROR("Failed to resample image");
+                free(img2);
                 return;
             }
             plot_rgba_data(cairo, img2, pargs->W, pargs->H, args->alpha);
@@ -289,7 +295,7 @@ void plot_image_wcs(cairo_t* cairo, unsigned char* img, int W, int H,
     cairo_restore(cairo);
 }
 
-static unsigned char* read_fits_image(const plot_args_t* pargs, plotimage_t* args) {
+static unsigned char* read_fits_image(plot_args_t* pargs, plotimage_t* args) {
     float* fimg;
     anqfits_t* anq;
     unsigned char* img;
@@ -321,6 +327,7 @@ static unsigned char* read_fits_image(const plot_args_t* pargs, plotimage_t* arg
     }
 
     if (args->resample) {
+        resample_grid_t* grid;
         // resample onto the output grid...
         //rimg = calloc(pargs->W * pargs->H, sizeof(float));
         rimg = malloc(pargs->W * pargs->H * sizeof(float));
@@ -328,8 +335,10 @@ static unsigned char* read_fits_image(const plot_args_t* pargs, plotimage_t* arg
         for (i=0; i<(pargs->W * pargs->H); i++) {
             rimg[i] = args->image_null;
         }
-        if (resample_wcs(args->wcs, fimg, args->W, args->H,
-                         pargs->wcs, rimg, pargs->W, pargs->H, 0, 0)) {
+        grid = plotstuff_get_resample_grid(pargs);
+        if (!grid ||
+            resample_wcs_grid(grid, args->wcs, fimg, args->W, args->H,
+                              rimg, pargs->nthreads)) {
             ERROR("Failed to resample image");
             return NULL;
         }
@@ -351,7 +360,7 @@ static unsigned char* read_fits_image(const plot_args_t* pargs, plotimage_t* arg
         fimg = rimg;
     }
 
-    img = plot_image_scale_float(args, fimg);
+    img = plot_image_scale_float_threaded(args, fimg, pargs->nthreads);
 
     free(fimg);
     free(rimg);
@@ -359,9 +368,112 @@ static unsigned char* read_fits_image(const plot_args_t* pargs, plotimage_t* arg
     return img;
 }
 
-unsigned char* plot_image_scale_float(plotimage_t* args, const float* fimg) {
+struct scale_job {
+    plotimage_t* args;
+    const float* fimg;
     float offset, scale;
+    unsigned char* img;
+    int j0, j1;
+    int n_invalid_null, n_invalid_low, n_invalid_high;
+};
+
+static void* scale_rows(void* vjob) {
+    struct scale_job* job = vjob;
+    plotimage_t* args = job->args;
+    const float* fimg = job->fimg;
+    unsigned char* img = job->img;
+    float offset = job->offset;
+    float scale = job->scale;
     int i,j;
+    for (j=job->j0; j<job->j1; j++) {
+        for (i=0; i<args->W; i++) {
+            int k;
+            double v;
+            double pval = fimg[j*args->W + i];
+            k = 4*(j*args->W + i);
+            if ((args->image_null == pval) ||
+                (isnan(args->image_null) && isnan(pval)) ||
+                ((args->image_valid_low != 0.0) && (pval < args->image_valid_low)) ||
+                ((args->image_valid_high != 0.0) && (pval > args->image_valid_high))) {
+                img[k+0] = 0;
+                img[k+1] = 0;
+                img[k+2] = 0;
+                img[k+3] = 0;
+
+                if ((pval == args->image_null) ||
+                    (isnan(args->image_null) && isnan(pval))) {
+                    job->n_invalid_null++;
+                }
+                if (pval < args->image_valid_low) {
+                    job->n_invalid_low++;
+                }
+                if (pval > args->image_valid_high) {
+                    job->n_invalid_high++;
+                }
+
+            } else {
+                v = (pval - offset) * scale;
+                if (args->arcsinh != 0) {
+                    v = (255. / args->arcsinh) * asinh((v / 255.) * args->arcsinh);
+                    v /= (asinh(args->arcsinh) / args->arcsinh);
+                }
+                img[k+0] = MIN(255, MAX(0, v * args->rgbscale[0]));
+                img[k+1] = MIN(255, MAX(0, v * args->rgbscale[1]));
+                img[k+2] = MIN(255, MAX(0, v * args->rgbscale[2]));
+                img[k+3] = 255;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Scales "fimg" into "img" in bands of rows, one per thread.
+static void scale_rows_threaded(plotimage_t* args, const float* fimg,
+                                float offset, float scale,
+                                unsigned char* img, int nthreads) {
+    struct scale_job* jobs;
+    pthread_t* threads;
+    int t;
+    nthreads = MAX(1, MIN(nthreads, args->H));
+    jobs = calloc(nthreads, sizeof(struct scale_job));
+    threads = calloc(nthreads, sizeof(pthread_t));
+    for (t=0; t<nthreads; t++) {
+        jobs[t].args = args;
+        jobs[t].fimg = fimg;
+        jobs[t].offset = offset;
+        jobs[t].scale = scale;
+        jobs[t].img = img;
+        jobs[t].j0 = (int)((int64_t)args->H *  t    / nthreads);
+        jobs[t].j1 = (int)((int64_t)args->H * (t+1) / nthreads);
+    }
+    for (t=1; t<nthreads; t++) {
+        if (pthread_create(threads + t, NULL, scale_rows, jobs + t)) {
+            SYSERROR("Failed to create thread");
+            // do it in this thread instead.
+            scale_rows(jobs + t);
+            jobs[t].j0 = jobs[t].j1 = -1;
+        }
+    }
+    scale_rows(jobs);
+    for (t=0; t<nthreads; t++) {
+        if (t && jobs[t].j0 != -1)
+            pthread_join(threads[t], NULL);
+        args->n_invalid_null += jobs[t].n_invalid_null;
+        args->n_invalid_low  += jobs[t].n_invalid_low;
+        args->n_invalid_high += jobs[t].n_invalid_high;
+    }
+    free(threads);
+    free(jobs);
+}
+
+unsigned char* plot_image_scale_float(plotimage_t* args, const float* fimg) {
+    return plot_image_scale_float_threaded(args, fimg, 1);
+}
+
+unsigned char* plot_image_scale_float_threaded(plotimage_t* args,
+                                               const float* fimg,
+                                               int nthreads) {
+    float offset, scale;
     unsigned char* img = NULL;
     if (args->image_low == 0 && args->image_high == 0) {
         if (args->auto_scale) {
@@ -404,45 +516,7 @@ unsigned char* plot_image_scale_float(plotimage_t* args, const float* fimg) {
     }
 
     img = malloc(args->W * args->H * 4);
-    for (j=0; j<args->H; j++) {
-        for (i=0; i<args->W; i++) {
-            int k;
-            double v;
-            double pval = fimg[j*args->W + i];
-            k = 4*(j*args->W + i);
-            if ((args->image_null == pval) ||
-                (isnan(args->image_null) && isnan(pval)) ||
-                ((args->image_valid_low != 0.0) && (pval < args->image_valid_low)) ||
-                ((args->image_valid_high != 0.0) && (pval > args->image_valid_high))) {
-                img[k+0] = 0;
-                img[k+1] = 0;
-                img[k+2] = 0;
-                img[k+3] = 0;
-
-                if ((pval == args->image_null) ||
-                    (isnan(args->image_null) && isnan(pval))) {
-                    args->n_invalid_null++;
-                }
-                if (pval < args->image_valid_low) {
-                    args->n_invalid_low++;
-                }
-                if (pval > args->image_valid_high) {
-                    args->n_invalid_high++;
-                }
-
-            } else {
-                v = (pval - offset) * scale;
-                if (args->arcsinh != 0) {
-                    v = (255. / args->arcsinh) * asinh((v / 255.) * args->arcsinh);
-                    v /= (asinh(args->arcsinh) / args->arcsinh);
-                }
-                img[k+0] = MIN(255, MAX(0, v * args->rgbscale[0]));
-                img[k+1] = MIN(255, MAX(0, v * args->rgbscale[1]));
-                img[k+2] = MIN(255, MAX(0, v * args->rgbscale[2]));
-                img[k+3] = 255;
-            }
-        }
-    }
+    scale_rows_threaded(args, fimg, offset, scale, img, nthreads);
     return img;
 }
 
@@ -459,7 +533,7 @@ void plot_image_make_color_transparent(plotimage_t* args, unsigned char r, unsig
 }
 
 
-int plot_image_read(const plot_args_t* pargs, plotimage_t* args) {
+int plot_image_read(plot_args_t* pargs, plotimage_t* args) {
     set_format(args);
     switch (args->format) {
     case PLOTSTUFF_FORMAT_JPG:
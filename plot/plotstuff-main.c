@@ -20,6 +20,7 @@
  plot_bglw <linewidth>
  plot_marker <marker-shape>
  plot_markersize <radius>
+ plot_threads <n>  -- threads for rendering image layers
  plot_wcs <filename>
  plot_wcs_setsize
  plot_wcs_box <ra> <dec> <width>  -- center on RA,Dec with width in deg.
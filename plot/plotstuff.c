@@ -36,6 +36,7 @@
 #include "log.h"
 #include "errors.h"
 #include "anwcs.h"
+#include "wcs-resample.h"
 
 
 enum cmdtype {
@@ -369,6 +370,7 @@ static void* plot_builtin_init(plot_args_t* args) {
     args->marker = CAIROUTIL_MARKER_CIRCLE;
     args->markersize = 5.0;
     args->linestep = 10;
+    args->nthreads = 1;
     args->op = CAIRO_OPERATOR_OVER;
     args->fontsize = 20;
     args->halign = 'C';
@@ -439,9 +441,27 @@ int plotstuff_set_wcs(plot_args_t* pargs, anwcs_t* wcs) {
         anwcs_free(pargs->wcs);
     }
     pargs->wcs = wcs;
+    resample_grid_free(pargs->resample_grid);
+    pargs->resample_grid = NULL;
     return 0;
 }
 
+resample_grid_t* plotstuff_get_resample_grid(plot_args_t* pargs) {
+    if (!pargs->wcs) {
+        ERROR("No WCS has been set");
+        return NULL;
+    }
+    if (pargs->resample_grid &&
+        resample_grid_matches(pargs->resample_grid, pargs->wcs,
+                              pargs->W, pargs->H))
+        return pargs->resample_grid;
+    // the plot size or WCS changed (or this is the first image layer).
+    resample_grid_free(pargs->resample_grid);
+    pargs->resample_grid = resample_grid_new(pargs->wcs, pargs->W, pargs->H,
+                                             32);
+    return pargs->resample_grid;
+}
+
 int plotstuff_set_wcs_box(plot_args_t* pargs, float ra, float dec, float width) {
     logverb("Setting WCS to a box centered at (%g,%g) with width %g deg.\n", ra, dec, width);
     anwcs_t* wcs = anwcs_create_box_upsidedown(ra, dec, width, pargs->W, pargs->H);
@@ -493,6 +513,8 @@ static int plot_builtin_command(const char* cmd, const char* cmdargs,
             return -1;
         }
         plotstuff_set_size(pargs, W, H);
+    } else if (streq(cmd, "plot_threads")) {
+        pargs->nthreads = MAX(1, atoi(cmdargs));
     } else if (streq(cmd, "plot_wcs")) {
         if (plotstuff_set_wcs_file(pargs, cmdargs, 0)) {
             return -1;
@@ -829,6 +851,7 @@ int plotstuff_plot_stack(plot_args_t* pargs, cairo_t* cairo) {
 
 static void plot_builtin_free(plot_args_t* pargs, void* baton) {
     anwcs_free(pargs->wcs);
+    resample_grid_free(pargs->resample_grid);
     bl_free(pargs->cairocmds);
 }
 
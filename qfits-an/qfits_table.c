@@ -182,7 +182,7 @@ qfits_header * qfits_table_ext_header_default(const qfits_table * t)
         qfits_header_append(fh, "NAXIS", "2","Tables are 2-D char. array",NULL);
         sprintf(str_val, "%d", tab_width);
         qfits_header_append(fh, "NAXIS1", str_val, "Bytes in row", NULL);
-        sprintf(str_val, "%d", (int)(t->nr));        
+        sprintf(str_val, "%lld", (long long)(t->nr));
         qfits_header_append(fh, "NAXIS2", str_val, "No. of rows in table",NULL);
         qfits_header_append(fh, "PCOUNT", "0", "Parameter count always 0",NULL);
         qfits_header_append(fh, "GCOUNT", "1", "Group count always 1", NULL);
@@ -238,7 +238,7 @@ qfits_header * qfits_table_ext_header_default(const qfits_table * t)
         /* Fill the header  */
         sprintf(str_val, "%d", tab_width);
         qfits_header_append(fh, "NAXIS1", str_val, "Characters in a row", NULL);
-        sprintf(str_val, "%d", (int)(t->nr));        
+        sprintf(str_val, "%lld", (long long)(t->nr));
         qfits_header_append(fh, "NAXIS2", str_val, "No. of rows in table",NULL);
         qfits_header_append(fh, "PCOUNT", "0", "No group parameters", NULL);    
         qfits_header_append(fh, "GCOUNT", "1", "Only one group", NULL);
@@ -313,7 +313,7 @@ qfits_table * qfits_table_new(
                               int             table_type,
                               int             table_width,
                               int             nb_cols,
-                              int             nb_raws)
+                              int64_t         nb_raws)
 {
     qfits_table    *    qt;
     qt = qfits_malloc(sizeof(qfits_table));
@@ -426,7 +426,8 @@ qfits_table * qfits_table_open2(const qfits_header* hdr, off_t offset_beg, size_
     int                 table_type;
     int                 nb_col;
     int                 table_width;
-    int                 nb_rows;
+    int64_t             nb_rows;
+    char            *   str;
     /* Column infos */
     char                label[FITSVALSZ];
     char                unit[FITSVALSZ];
@@ -472,7 +473,15 @@ qfits_table * qfits_table_open2(const qfits_header* hdr, off_t offset_beg, size_
     }
     
     /* Get the number of rows */
-    nb_rows = qfits_header_getint(hdr, "NAXIS2", -1);
+    // (not qfits_header_getint: catalogs can have more than 2^31 rows)
+    nb_rows = -1;
+    str = qfits_header_getstr(hdr, "NAXIS2");
+    if (str) {
+        char* endp;
+        nb_rows = strtoll(str, &endp, 10);
+        if (endp == str || nb_rows < 0)
+            nb_rows = -1;
+    }
     if (nb_rows == -1) {
         qfits_error("cannot read NAXIS2 in [%s]:[%d]", filename, xtnum);
         return NULL;
@@ -617,7 +626,7 @@ qfits_table * qfits_table_open2(const qfits_header* hdr, off_t offset_beg, size_
     /* one by more than 2880 */
     theory_size = (size_t)qfits_compute_table_width(tload) * (size_t)tload->nr;
     if (data_size < theory_size) {
-        qfits_error("Inconsistent data sizes: found %i, expected %i.", data_size, theory_size);
+        qfits_error("Inconsistent data sizes: found %zu, expected %zu.", data_size, theory_size);
         qfits_table_close(tload);
         return NULL;
     }
@@ -863,9 +872,9 @@ unsigned char * qfits_query_column_seq(
 static int qfits_query_column_seq_to_array_endian(
                                                   const qfits_table	    *   th,
                                                   int                 colnum,
-                                                  int                 start_ind,
+                                                  int64_t             start_ind,
                                                   const int* indices,
-                                                  int                 nb_rows,
+                                                  int64_t             nb_rows,
                                                   unsigned char*      destination,
                                                   int                 dest_stride,
                                                   int swap_endian)
@@ -875,10 +884,10 @@ static int qfits_query_column_seq_to_array_endian(
     unsigned char   *   r;
     unsigned char   *   inbuf;
     int                 table_width;
-    int                 i;
+    int64_t             i;
     int do_swap;
 
-    int maxind;
+    int64_t maxind;
 
     char* freeaddr;
     size_t freesize;
@@ -904,7 +913,7 @@ static int qfits_query_column_seq_to_array_endian(
     col = th->col + colnum;
 
     /* Test if column is empty */
-    if (nb_rows * col->atom_size * col->atom_nb == 0) col->readable = 0;
+    if (nb_rows * (int64_t)col->atom_size * col->atom_nb == 0) col->readable = 0;
 	
     /* Test if column is readable */
     if (col->readable == 0)  return -1;
@@ -917,7 +926,7 @@ static int qfits_query_column_seq_to_array_endian(
     if (indices) {
         maxind = 0;
         for (i=0; i<nb_rows; i++)
-            maxind = MAX(maxind, indices[i]);
+            maxind = MAX(maxind, (int64_t)indices[i]);
     } else
         maxind = nb_rows - 1;
 
@@ -958,7 +967,7 @@ static int qfits_query_column_seq_to_array_endian(
     for (i=0; i<nb_rows; i++) {
         /* Copy all atoms on this field into array */
         if (indices) {
-            memcpy(r, inbuf + (indices[i]*table_width), field_size);
+            memcpy(r, inbuf + ((size_t)indices[i] * (size_t)table_width), field_size);
         } else {
             memcpy(r, inbuf, field_size);
             /* Jump to next line */
@@ -989,8 +998,8 @@ static int qfits_query_column_seq_to_array_endian(
 int qfits_query_column_seq_to_array(
                                     const qfits_table	    *   th,
                                     int                 colnum,
-                                    int                 start_ind,
-                                    int                 nb_rows,
+                                    int64_t             start_ind,
+                                    int64_t             nb_rows,
                                     unsigned char*      destination,
                                     int                 dest_stride)
 {
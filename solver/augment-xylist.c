@@ -182,6 +182,9 @@ static an_option_t options[] = {
      "don't uniformize the field stars during verification"},
     {'\x83', "no-verify-dedup", no_argument, NULL,
      "don't deduplicate the field stars during verification"},
+    {'\x96', "verify-coarse", required_argument, "int",
+     "before full verification, check this many bright field stars near the quad "
+     "and reject hopeless matches early (0=disable; default 0)"},
     {'C', "cancel",                required_argument, "filename",
      "filename whose creation signals the process to stop"},
     {'S', "solved",                required_argument, "filename",
@@ -203,6 +206,8 @@ static an_option_t options[] = {
      "output filename for SCAMP reference catalog"},
     {'B', "corr",          required_argument, "filename",
      "output filename for correspondences"},
+    {'\x95', "solver-stats", required_argument, "filename",
+     "append per-field solver timing/profiling stats (JSON lines) to this file"},
     {'W', "wcs",                   required_argument, "filename",
      "output filename for WCS file"},
     {'P', "pnm",                   required_argument, "filename",
@@ -287,6 +292,9 @@ int augment_xylist_parse_option(char argchar, char* optarg,
     case '\x83':
         axy->verify_dedup = FALSE;
         break;
+    case '\x96':
+        axy->verify_coarse = atoi(optarg);
+        break;
     case '\x86':
         axy->predistort = sip_read_header_file(optarg, NULL);
         if (!axy->predistort) {
@@ -386,6 +394,9 @@ int augment_xylist_parse_option(char argchar, char* optarg,
     case 'B':
         axy->corrfn = optarg;
         break;
+    case '\x95':
+        axy->statsfn = optarg;
+        break;
     case 'y':
         axy->try_verify = FALSE;
         break;
@@ -1203,6 +1214,8 @@ int augment_xylist(augment_xylist_t* axy,
 
     qfits_header_add(hdr, "ANVERUNI", axy->verify_uniformize ? "T":"F", "Uniformize field during verification", NULL);
     qfits_header_add(hdr, "ANVERDUP", axy->verify_dedup ? "T":"F", "Deduplicate field during verification", NULL);
+    if (axy->verify_coarse > 0)
+        fits_header_add_int(hdr, "ANVERCRS", axy->verify_coarse, "Stars in coarse verification pass");
 
     if (axy->odds_to_tune_up)
         fits_header_add_double(hdr, "ANODDSTU", axy->odds_to_tune_up, "Odds ratio to tune up a match");
@@ -1301,6 +1314,8 @@ int augment_xylist(augment_xylist_t* axy,
         fits_header_addf_longstring(hdr, "ANWCS", "WCS header output filename", "%s", axy->wcsfn);
     if (axy->corrfn)
         fits_header_addf_longstring(hdr, "ANCORR", "Correspondences output filename", "%s", axy->corrfn);
+    if (axy->statsfn)
+        fits_header_addf_longstring(hdr, "ANSTATS", "Solver stats output filename", "%s", axy->statsfn);
     if (axy->codetol > 0.0)
         fits_header_add_double(hdr, "ANCTOL", axy->codetol, "code tolerance");
     if (axy->pixelerr > 0.0)
@@ -1525,6 +1540,7 @@ static void delete_existing_an_headers(qfits_header* hdr) {
     qfits_header_del(hdr, "ANRDSORT");
     qfits_header_del(hdr, "ANVERUNI");
     qfits_header_del(hdr, "ANVERDUP");
+    qfits_header_del(hdr, "ANVERCRS");
     qfits_header_del(hdr, "ANODDSTU");
     qfits_header_del(hdr, "ANODDSSL");
     qfits_header_del(hdr, "ANODDSBL");
@@ -1544,6 +1560,7 @@ static void delete_existing_an_headers(qfits_header* hdr) {
     qfits_header_del(hdr, "ANSCAMP");
     qfits_header_del(hdr, "ANWCS");
     qfits_header_del(hdr, "ANCORR");
+    qfits_header_del(hdr, "ANSTATS");
     qfits_header_del(hdr, "ANCTOL");
     qfits_header_del(hdr, "ANPOSERR");
     qfits_header_del(hdr, "ANPARITY");
@@ -20,7 +20,7 @@
 #include "log.h"
 #include "starutil.h"
 
-const char* OPTIONS = "hvi:o:N:l:u:S:fU:H:s:m:n:r:d:p:R:L:EI:MTj:1:P:B:A:D:Kt:e:";
+const char* OPTIONS = "hvi:o:N:l:u:S:fU:H:s:m:n:r:d:p:R:L:EI:MTj:1:P:B:A:D:Kt:e:Q";
 
 static void print_help(char* progname) {
     BOILERPLATE_HELP_HEADER(stdout);
@@ -71,6 +71,7 @@ static void print_help(char* progname) {
            "      [-E]: scan through the catalog, checking which healpixes are occupied.\n"
            "\n"
            "      [-I <unique-id>] set the unique ID of this index\n"
+           "      [-Q]: also store a healpix -> quad map, for faster solving near a known position\n"
            "\n"
            "      [-M]: in-memory (don't use temp files)\n"
            "      [-T]: don't delete temp files\n"
@@ -142,6 +143,9 @@ int main(int argc, char** argv) {
         case 'M':
             p->inmemory = TRUE;
             break;
+        case 'Q':
+            p->quadmap = TRUE;
+            break;
         case 'U':
             p->UNside = atoi(optarg);
             break;
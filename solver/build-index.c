@@ -239,6 +239,8 @@ static int step_merge_index(index_params_t* p,
             ERROR("Failed to write merged index");
             return -1;
         }
+        if (p->quadmap && merge_index_add_quadmap(quad, star, indexfn))
+            return -1;
         codetree_close(code);
         startree_close(star);
         quadfile_close(quad);
@@ -667,6 +669,9 @@ int build_index_files(const char* infn, int ext, const char* indexfn,
             ERROR("Failed to write index file");
             return -1;
         }
+        if (p->quadmap &&
+            merge_index_add_quadmap(index->quads, index->starkd, indexfn))
+            return -1;
         kdtree_free(index->codekd->tree);
         index->codekd->tree = NULL;
         index_close(index);
@@ -702,6 +707,9 @@ int build_index_shared_skdt_files(const char* starkdfn, const char* indexfn,
             ERROR("Failed to write index file \"%s\"", indexfn);
             return -1;
         }
+        if (p->quadmap &&
+            merge_index_add_quadmap(index->quads, index->starkd, indexfn))
+            return -1;
         // FIXME?  Why close codekd independently?
         kdtree_free(index->codekd->tree);
         index->codekd->tree = NULL;
@@ -35,11 +35,17 @@
 #include "anqfits.h"
 #include "errors.h"
 #include "engine.h"
+#include "tracking.h"
 #include "tic.h"
 #include "healpix.h"
 #include "sip-utils.h"
 #include "multiindex.h"
 #include "indexset.h"
+#include "index-schedule.h"
+
+// Number of doubling quantums an open-ended depth range is split into
+// (see engine_t.quantum) before the open-ended tail.
+#define ENGINE_MAX_QUANTUMS 8
 
 void engine_add_search_path(engine_t* engine, const char* path) {
     sl_append(engine->index_paths, path);
@@ -229,6 +235,104 @@ static void add_index_to_onefield(engine_t* engine, onefield_t* bp,
     }
 }
 
+static index_schedule_t* get_schedule(engine_t* engine) {
+    if (!engine->schedule)
+        engine->schedule = index_schedule_new();
+    return engine->schedule;
+}
+
+// An index can be run several times for one job (once per depth range
+// and scale range); its history gets one run per job, with the total
+// CPU time.  onefield loads its own copy of the index for each run, so
+// the runs are matched up by index id and healpix.
+struct schedule_job {
+    // index_t (just the id and healpix are used)
+    bl* indexes;
+    dl* cputime;
+    il* solved;
+};
+
+static void schedule_index_done(const index_t* index, double cputime,
+                                anbool solved, void* userdata) {
+    struct schedule_job* sj = userdata;
+    size_t i;
+    for (i=0; i<bl_size(sj->indexes); i++) {
+        index_t* ind = bl_access(sj->indexes, i);
+        if (ind->indexid == index->indexid && ind->healpix == index->healpix)
+            break;
+    }
+    if (i == bl_size(sj->indexes)) {
+        index_t ind;
+        memset(&ind, 0, sizeof(index_t));
+        ind.indexid = index->indexid;
+        ind.healpix = index->healpix;
+        bl_append(sj->indexes, &ind);
+        dl_append(sj->cputime, 0.0);
+        il_append(sj->solved, FALSE);
+    }
+    dl_set(sj->cputime, i, dl_get(sj->cputime, i) + cputime);
+    if (solved)
+        il_set(sj->solved, i, TRUE);
+}
+
+static tracking_t* get_tracking(engine_t* engine) {
+    if (!engine->tracking)
+        engine->tracking = tracking_new();
+    return engine->tracking;
+}
+
+struct track_job {
+    tracking_t* tracking;
+    double imagew;
+    double imageh;
+    anbool solved;
+};
+
+static void track_field_solved(const MatchObj* mo, void* userdata) {
+    struct track_job* tj = userdata;
+    sip_t wcs;
+    // one field per frame.
+    if (tj->solved)
+        return;
+    if (mo->sip)
+        memcpy(&wcs, mo->sip, sizeof(sip_t));
+    else
+        sip_wrap_tan(&mo->wcstan, &wcs);
+    if (wcs.wcstan.imagew == 0 || wcs.wcstan.imageh == 0) {
+        wcs.wcstan.imagew = tj->imagew;
+        wcs.wcstan.imageh = tj->imageh;
+    }
+    tracking_solved(tj->tracking, &wcs);
+    tj->solved = TRUE;
+}
+
+// Splits the open-ended depth ranges into quantums of "quantum" stars,
+// doubling in size, then an open-ended tail.
+static il* split_depths(il* depths, int quantum) {
+    il* out = il_new(16);
+    int i, k;
+    for (i=0; i<il_size(depths)/2; i++) {
+        int lo = il_get(depths, i*2);
+        int hi = il_get(depths, i*2+1);
+        int w = quantum;
+        if (hi) {
+            il_append(out, lo);
+            il_append(out, hi);
+            continue;
+        }
+        lo = MAX(lo, 1);
+        for (k=0; k<ENGINE_MAX_QUANTUMS; k++) {
+            il_append(out, lo);
+            il_append(out, lo + w - 1);
+            lo += w;
+            w *= 2;
+        }
+        il_append(out, lo);
+        il_append(out, 0);
+    }
+    return out;
+}
+
 int engine_parse_config_file(engine_t* engine, const char* fn) {
     FILE* fconf;
     int rtn;
@@ -291,6 +395,31 @@ int engine_parse_config_file_stream(engine_t* engine, FILE* fconf) {
             auto_index = TRUE;
         } else if (is_word(line, "inparallel", &nextword)) {
             engine->inparallel = TRUE;
+        } else if (is_word(line, "schedule", &nextword)) {
+            get_schedule(engine);
+        } else if (is_word(line, "profiles ", &nextword)) {
+            if (index_schedule_load_profiles(get_schedule(engine), nextword)) {
+                rtn = -1;
+                goto done;
+            }
+        } else if (is_word(line, "history ", &nextword)) {
+            if (index_schedule_load_history(get_schedule(engine), nextword)) {
+                rtn = -1;
+                goto done;
+            }
+        } else if (is_word(line, "track_state ", &nextword)) {
+            if (tracking_load_state(get_tracking(engine), nextword)) {
+                rtn = -1;
+                goto done;
+            }
+        } else if (is_word(line, "track_radius ", &nextword)) {
+            get_tracking(engine)->radius = atof(nextword);
+        } else if (is_word(line, "track_maxmissed ", &nextword)) {
+            get_tracking(engine)->maxmissed = atoi(nextword);
+        } else if (is_word(line, "track", &nextword)) {
+            get_tracking(engine);
+        } else if (is_word(line, "quantum ", &nextword)) {
+            engine->quantum = atoi(nextword);
         } else if (is_word(line, "minwidth ", &nextword)) {
             engine->minwidth = atof(nextword);
         } else if (is_word(line, "maxwidth ", &nextword)) {
@@ -480,6 +609,9 @@ int engine_run_job(engine_t* engine, job_t* job) {
     double app_min_default;
     double app_max_default;
     anbool solved = FALSE;
+    il* depths;
+    struct track_job tj;
+    struct schedule_job sj;
 
     if (onefield_is_run_obsolete(bp, sp)) {
         goto finish;
@@ -491,15 +623,60 @@ int engine_run_job(engine_t* engine, job_t* job) {
     if (engine->inparallel)
         bp->indexes_inparallel = TRUE;
 
+    memset(&tj, 0, sizeof(struct track_job));
+    if (engine->tracking) {
+        sip_t wcs;
+        double ra, dec, radius;
+        tj.tracking = engine->tracking;
+        tj.imagew = job_imagew(job);
+        tj.imageh = job_imageh(job);
+        bp->field_solved = track_field_solved;
+        bp->field_solved_userdata = &tj;
+        if (tracking_predict(engine->tracking, &wcs, &ra, &dec, &radius)) {
+            double scale = sip_pixel_scale(&wcs);
+            double slop = engine->tracking->scale_slop;
+            logmsg("Tracking: trying the predicted WCS centered at RA,Dec "
+                   "(%g, %g)\n", ra, dec);
+            // verified (and tweaked) before the blind solve starts.
+            wcs.wcstan.imagew = job_imagew(job);
+            wcs.wcstan.imageh = job_imageh(job);
+            onefield_add_verify_wcs(bp, &wcs);
+            // if it doesn't verify, search near the prediction, at the
+            // prior's pixel scale.
+            if (!job->use_radec_center) {
+                job->use_radec_center = TRUE;
+                job->ra_center = ra;
+                job->dec_center = dec;
+                job->search_radius = radius;
+            }
+            dl_remove_all(job->scales);
+            dl_append(job->scales, scale / (1.0 + slop));
+            dl_append(job->scales, scale * (1.0 + slop));
+        }
+    }
+
     if (job->use_radec_center) {
         logmsg("Only searching for solutions within %g degrees of RA,Dec (%g,%g)\n",
                job->search_radius, job->ra_center, job->dec_center);
         solver_set_radec(sp, job->ra_center, job->dec_center, job->search_radius);
     }
 
-    for (i=0; i<il_size(job->depths)/2; i++) {
-        int startobj = il_get(job->depths, i*2);
-        int endobj = il_get(job->depths, i*2+1);
+    if (engine->schedule) {
+        sj.indexes = bl_new(16, sizeof(index_t));
+        sj.cputime = dl_new(16);
+        sj.solved = il_new(16);
+        bp->index_done = schedule_index_done;
+        bp->index_done_userdata = &sj;
+    }
+
+    if (engine->quantum > 0 && !engine->inparallel)
+        depths = split_depths(job->depths, engine->quantum);
+    else
+        depths = il_dupe(job->depths);
+
+    for (i=0; i<il_size(depths)/2; i++) {
+        int startobj = il_get(depths, i*2);
+        int endobj = il_get(depths, i*2+1);
         int j;
 
         if (startobj || endobj) {
@@ -529,9 +706,9 @@ int engine_run_job(engine_t* engine, job_t* job) {
             sp->funits_lower = app_min;
             sp->funits_upper = app_max;
 
+            // (endobj = 0, "no limit", must replace the previous range's.)
             sp->startobj = startobj;
-            if (endobj)
-                sp->endobj = endobj;
+            sp->endobj = endobj;
 
             // minimum quad size to try (in pixels)
             sp->quadsize_min = bp->quad_size_fraction_lo *
@@ -575,11 +752,20 @@ int engine_run_job(engine_t* engine, job_t* job) {
                 if (!inrange) {
                     logverb("Not using index %s because it's not within %g degrees of (RA,Dec) = (%g,%g)\n",
                             index->indexname, job->search_radius, job->ra_center, job->dec_center);
+                    il_remove(indexlist, k);
+                    k--;
                     continue;
                 }
-                add_index_to_onefield(engine, bp, ii);
             }
 
+            if (engine->schedule)
+                index_schedule_order(engine->schedule, engine->indexes,
+                                     indexlist, fmin, fmax, sp->codetol,
+                                     job->use_radec_center);
+
+            for (k=0; k<il_size(indexlist); k++)
+                add_index_to_onefield(engine, bp, il_get(indexlist, k));
+
             il_free(indexlist);
 
             logverb("Running solver:\n");
@@ -602,6 +788,25 @@ int engine_run_job(engine_t* engine, job_t* job) {
         if (solved)
             break;
     }
+    il_free(depths);
+
+    if (engine->schedule) {
+        for (i=0; i<bl_size(sj.indexes); i++)
+            index_schedule_record(engine->schedule, bl_access(sj.indexes, i),
+                                  dl_get(sj.cputime, i), il_get(sj.solved, i));
+        index_schedule_save_history(engine->schedule);
+        bl_free(sj.indexes);
+        dl_free(sj.cputime);
+        il_free(sj.solved);
+        bp->index_done = NULL;
+    }
+
+    if (engine->tracking) {
+        if (!tj.solved)
+            tracking_missed(engine->tracking);
+        tracking_save_state(engine->tracking);
+        bp->field_solved = NULL;
+    }
 
     logverb("cx<=dx constraints: %i\n", sp->num_cxdx_skipped);
     logverb("meanx constraints: %i\n", sp->num_meanx_skipped);
@@ -690,6 +895,7 @@ static anbool parse_job_from_qfits_header(const qfits_header* hdr, job_t* job) {
 
     sp->verify_uniformize = qfits_header_getboolean(hdr, "ANVERUNI", sp->verify_uniformize);
     sp->verify_dedup = qfits_header_getboolean(hdr, "ANVERDUP", sp->verify_dedup);
+    sp->verify_coarse = qfits_header_getint(hdr, "ANVERCRS", sp->verify_coarse);
 
     val = qfits_header_getdouble(hdr, "ANPOSERR", 0.0);
     if (val > 0.0)
@@ -715,6 +921,8 @@ static anbool parse_job_from_qfits_header(const qfits_header* hdr, job_t* job) {
     free(fn);
     onefield_set_corr_file    (bp, fn=fits_get_long_string(hdr, "ANCORR"  ));
     free(fn);
+    onefield_set_stats_file   (bp, fn=fits_get_long_string(hdr, "ANSTATS" ));
+    free(fn);
     onefield_set_cancel_file  (bp, fn=fits_get_long_string(hdr, "ANCANCEL"));
     free(fn);
 
@@ -1018,6 +1226,8 @@ void engine_free(engine_t* engine) {
         il_free(engine->default_depths);
     if (engine->index_paths)
         sl_free2(engine->index_paths);
+    index_schedule_free(engine->schedule);
+    tracking_free(engine->tracking);
     free(engine);
 }
 
@@ -1149,6 +1359,11 @@ int job_set_output_base_dir(job_t* job, const char* dir) {
         logverb("Changing %s to %s\n", bp->corr_fname, path);
         onefield_set_corr_file(bp, path);
     }
+    if (bp->stats_fname) {
+        path = resolve_path(bp->stats_fname, dir);
+        logverb("Changing %s to %s\n", bp->stats_fname, path);
+        onefield_set_stats_file(bp, path);
+    }
     if (bp->wcs_template) {
         path = resolve_path(bp->wcs_template, dir);
         logverb("Changing %s to %s\n", bp->wcs_template, path);
@@ -0,0 +1,325 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+/**
+ Measures what it costs to load a set of index files: the time to parse
+ the FITS headers, to index_load() each index, and then to touch every
+ page of its tables (which is where a lazily-mmapped index pays for its
+ disk reads), with the page faults and resident memory of each step.
+ Each file is loaded under each of the fitsbin mapping policies (see
+ fitsbin.h), optionally after asking the kernel to drop it from the
+ page cache, and checked with index_check().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "os-features.h"
+#include "index.h"
+#include "quadfile.h"
+#include "codekd.h"
+#include "starkd.h"
+#include "fitsbin.h"
+#include "anqfits.h"
+#include "ioutils.h"
+#include "tic.h"
+#include "bl.h"
+#include "log.h"
+#include "errors.h"
+#include "boilerplate.h"
+
+static const char* OPTIONS = "hvp:r:cknC";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s [options] <index-file or directory> [...]\n"
+           "    [-p <policies>]: comma-separated mapping policies to try:\n"
+           "          lazy, populate, preload (default: all three)\n"
+           "    [-r <passes>]: loads of each file per policy (default 2)\n"
+           "    [-c]: cold: evict each file from the page cache before its\n"
+           "          first load under each policy\n"
+           "    [-k]: keep each pass's indexes loaded until the end of the pass,\n"
+           "          to see the total resident size of the set\n"
+           "    [-n]: don't run the integrity check\n"
+           "    [-C]: also report each table\n"
+           "    [-v]: +verbose\n"
+           "\n", progname);
+}
+
+static const char* policy_names[] = { "lazy", "populate", "preload" };
+
+struct usage {
+    double t;
+    long minflt;
+    long majflt;
+};
+
+static void usage_now(struct usage* u) {
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    u->minflt = r.ru_minflt;
+    u->majflt = r.ru_majflt;
+    u->t = timenow();
+}
+
+// Fills "d" with the cost since "u0".
+static void usage_since(const struct usage* u0, struct usage* d) {
+    usage_now(d);
+    d->t = 1000.0 * (d->t - u0->t);
+    d->minflt -= u0->minflt;
+    d->majflt -= u0->majflt;
+}
+
+// Resident set size in MB, or -1 if not available.
+static double rss_mb(void) {
+    long size, resident;
+    FILE* f = fopen("/proc/self/statm", "r");
+    int n;
+    if (!f)
+        return -1;
+    n = fscanf(f, "%li %li", &size, &resident);
+    fclose(f);
+    if (n != 2)
+        return -1;
+    return resident * (double)getpagesize() * 1e-6;
+}
+
+static void evict(const char* fn) {
+#ifdef POSIX_FADV_DONTNEED
+    int fd = open(fn, O_RDONLY);
+    if (fd < 0) {
+        SYSERROR("Failed to open %s to evict it", fn);
+        return;
+    }
+    if (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED))
+        logmsg("Warning: failed to evict %s from the page cache\n", fn);
+    close(fd);
+#else
+    logmsg("Warning: can't evict %s from the page cache on this system\n", fn);
+#endif
+}
+
+static volatile unsigned char touch_sink;
+
+// Reads one byte per page of each table of "fb", adding the cost to "total".
+static void touch_fitsbin(fitsbin_t* fb, const char* what, anbool perchunk,
+                          struct usage* total) {
+    int i, pagesize = getpagesize();
+    if (!fb)
+        return;
+    for (i=0; i<fitsbin_n_chunks(fb); i++) {
+        fitsbin_chunk_t* chunk = fitsbin_get_chunk(fb, i);
+        const unsigned char* data = chunk->data;
+        size_t j, nbytes = (size_t)chunk->itemsize * chunk->nrows;
+        unsigned char sum = 0;
+        struct usage u0, d;
+        if (!data)
+            continue;
+        usage_now(&u0);
+        for (j=0; j<nbytes; j+=pagesize)
+            sum += data[j];
+        touch_sink = sum;
+        usage_since(&u0, &d);
+        total->t += d.t;
+        total->minflt += d.minflt;
+        total->majflt += d.majflt;
+        if (perchunk)
+            printf("    %-5s %-24s %10.1f MB %9.2f ms %8li minor %6li major\n",
+                   what, chunk->tablename, nbytes * 1e-6, d.t,
+                   d.minflt, d.majflt);
+    }
+}
+
+static void touch_index(index_t* index, anbool perchunk, struct usage* total) {
+    memset(total, 0, sizeof(struct usage));
+    touch_fitsbin(index->quads->fb, "quad", perchunk, total);
+    touch_fitsbin(index->codekd->tree->io, "ckdt", perchunk, total);
+    touch_fitsbin(index->starkd->tree->io, "skdt", perchunk, total);
+}
+
+static void add_indexes(const char* path, sl* fns) {
+    DIR* dir;
+    struct dirent* de;
+    sl* names;
+    int i;
+    if (!path_is_dir(path)) {
+        sl_append(fns, path);
+        return;
+    }
+    dir = opendir(path);
+    if (!dir) {
+        SYSERROR("Failed to open directory %s", path);
+        exit(-1);
+    }
+    names = sl_new(16);
+    while ((de = readdir(dir))) {
+        char* fn;
+        if (de->d_name[0] == '.')
+            continue;
+        asprintf_safe(&fn, "%s/%s", path, de->d_name);
+        if (!path_is_dir(fn) && index_is_file_index(fn))
+            sl_insert_sorted(names, fn);
+        free(fn);
+    }
+    closedir(dir);
+    for (i=0; i<sl_size(names); i++)
+        sl_append(fns, sl_get(names, i));
+    sl_free2(names);
+}
+
+int main(int argc, char** argv) {
+    int argchar;
+    int loglvl = LOG_MSG;
+    char* policystr = "lazy,populate,preload";
+    int npasses = 2;
+    anbool cold = FALSE;
+    anbool keep = FALSE;
+    anbool check = TRUE;
+    anbool perchunk = FALSE;
+    sl* fns = sl_new(16);
+    sl* pols;
+    int i, p, pass, nbad = 0;
+    index_t** loaded;
+
+    while ((argchar = getopt(argc, argv, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'p':
+            policystr = optarg;
+            break;
+        case 'r':
+            npasses = atoi(optarg);
+            break;
+        case 'c':
+            cold = TRUE;
+            break;
+        case 'k':
+            keep = TRUE;
+            break;
+        case 'n':
+            check = FALSE;
+            break;
+        case 'C':
+            perchunk = TRUE;
+            break;
+        case 'v':
+            loglvl++;
+            break;
+        case 'h':
+        default:
+            printHelp(argv[0]);
+            exit(-1);
+        }
+    if (optind == argc || npasses < 1) {
+        printHelp(argv[0]);
+        exit(-1);
+    }
+    log_init(loglvl);
+
+    pols = sl_split(NULL, policystr, ",");
+    for (p=0; p<sl_size(pols); p++) {
+        for (i=0; i<3; i++)
+            if (!strcasecmp(sl_get(pols, p), policy_names[i]))
+                break;
+        if (i == 3) {
+            ERROR("Unknown mapping policy \"%s\"", sl_get(pols, p));
+            exit(-1);
+        }
+    }
+    for (i=optind; i<argc; i++)
+        add_indexes(argv[i], fns);
+    if (!sl_size(fns)) {
+        ERROR("No index files found");
+        exit(-1);
+    }
+    loaded = calloc(sl_size(fns), sizeof(index_t*));
+
+    printf("%-32s %-8s %4s %8s %9s %8s %6s %9s %8s %6s %9s %5s\n",
+           "# file", "policy", "pass", "hdr_ms", "load_ms", "minflt",
+           "majflt", "touch_ms", "minflt", "majflt", "rss_MB", "check");
+    for (p=0; p<sl_size(pols); p++) {
+        int policy;
+        for (policy=0; policy<3; policy++)
+            if (!strcasecmp(sl_get(pols, p), policy_names[policy]))
+                break;
+        fitsbin_set_map_policy(policy);
+
+        for (pass=0; pass<npasses; pass++) {
+            struct usage passtotal;
+            memset(&passtotal, 0, sizeof(struct usage));
+            for (i=0; i<sl_size(fns); i++) {
+                const char* fn = sl_get(fns, i);
+                struct usage u0, hdr, load, touch;
+                anqfits_t* fits;
+                index_t* index;
+                const char* checked = "-";
+
+                if (cold && pass == 0)
+                    evict(fn);
+
+                usage_now(&u0);
+                fits = anqfits_open(fn);
+                usage_since(&u0, &hdr);
+                if (!fits) {
+                    ERROR("Failed to read FITS headers from \"%s\"", fn);
+                    nbad++;
+                    continue;
+                }
+                anqfits_close(fits);
+
+                usage_now(&u0);
+                index = index_load(fn, 0, NULL);
+                usage_since(&u0, &load);
+                if (!index) {
+                    ERROR("Failed to load index \"%s\"", fn);
+                    nbad++;
+                    continue;
+                }
+                if (perchunk)
+                    printf("  %s:\n", fn);
+                touch_index(index, perchunk, &touch);
+                if (check) {
+                    if (index_check(index)) {
+                        checked = "FAIL";
+                        nbad++;
+                    } else
+                        checked = "ok";
+                }
+                printf("%-32s %-8s %4i %8.2f %9.2f %8li %6li %9.2f %8li %6li %9.1f %5s\n",
+                       fn, policy_names[policy], pass + 1, hdr.t,
+                       load.t, load.minflt, load.majflt,
+                       touch.t, touch.minflt, touch.majflt,
+                       rss_mb(), checked);
+                passtotal.t += hdr.t + load.t + touch.t;
+                passtotal.minflt += load.minflt + touch.minflt;
+                passtotal.majflt += load.majflt + touch.majflt;
+                if (keep)
+                    loaded[i] = index;
+                else
+                    index_free(index);
+            }
+            printf("# %s pass %i: %i files, %.1f ms, %li minor + %li major faults, %.1f MB resident\n",
+                   policy_names[policy], pass + 1, (int)sl_size(fns), passtotal.t,
+                   passtotal.minflt, passtotal.majflt, rss_mb());
+            for (i=0; i<sl_size(fns); i++) {
+                if (loaded[i])
+                    index_free(loaded[i]);
+                loaded[i] = NULL;
+            }
+        }
+    }
+    fitsbin_set_map_policy(FITSBIN_MAP_LAZY);
+
+    free(loaded);
+    sl_free2(pols);
+    sl_free2(fns);
+    return nbad ? -1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+/**
+ Measures how expensive each of a set of index files is to query (see
+ index-profile.h), printing a summary and writing a FITS table with one
+ row per index.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "os-features.h"
+#include "index-profile.h"
+#include "index.h"
+#include "solver.h"
+#include "bl.h"
+#include "log.h"
+#include "errors.h"
+#include "boilerplate.h"
+
+static const char* OPTIONS = "hvo:t:n:N:";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s -o <output-file> [options] <index-file> [<index-file> ...]\n"
+           "    [-t <code tolerance>]: query tolerance; may be repeated, up to %i times\n"
+           "          (default: 0.5, 1 and 2 times the solver's default, %g)\n"
+           "    [-n <samples>]: code-tree queries per tolerance (default 1000)\n"
+           "    [-N <nside>]: healpix nside for the quads-per-healpix counts\n"
+           "          (default: about the largest quad size)\n"
+           "    [-v]: +verbose\n"
+           "\n", progname, INDEX_PROFILE_MAX_TOLS, DEFAULT_CODE_TOL);
+}
+
+int main(int argc, char** argv) {
+    int argchar;
+    int loglvl = LOG_MSG;
+    char* outfn = NULL;
+    dl* tols = dl_new(4);
+    int nsamples = 1000;
+    int nside = 0;
+    index_profile_t* profs;
+    int nprofs = 0;
+    int i, t;
+
+    while ((argchar = getopt(argc, argv, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'o':
+            outfn = optarg;
+            break;
+        case 't':
+            dl_append(tols, atof(optarg));
+            break;
+        case 'n':
+            nsamples = atoi(optarg);
+            break;
+        case 'N':
+            nside = atoi(optarg);
+            break;
+        case 'v':
+            loglvl++;
+            break;
+        case 'h':
+        default:
+            printHelp(argv[0]);
+            exit(-1);
+        }
+    if (!outfn || optind == argc) {
+        printHelp(argv[0]);
+        exit(-1);
+    }
+    if (dl_size(tols) > INDEX_PROFILE_MAX_TOLS) {
+        ERROR("At most %i tolerances are supported", INDEX_PROFILE_MAX_TOLS);
+        exit(-1);
+    }
+    if (!dl_size(tols)) {
+        dl_append(tols, 0.5 * DEFAULT_CODE_TOL);
+        dl_append(tols, DEFAULT_CODE_TOL);
+        dl_append(tols, 2.0 * DEFAULT_CODE_TOL);
+    }
+    log_init(loglvl);
+
+    profs = calloc(argc - optind, sizeof(index_profile_t));
+    for (i=optind; i<argc; i++) {
+        index_t* index;
+        index_profile_t* p = profs + nprofs;
+        double codetols[INDEX_PROFILE_MAX_TOLS];
+
+        logverb("Reading index %s\n", argv[i]);
+        index = index_load(argv[i], 0, NULL);
+        if (!index) {
+            ERROR("Failed to load index \"%s\"", argv[i]);
+            exit(-1);
+        }
+        dl_copy(tols, 0, dl_size(tols), codetols);
+        if (index_profile_compute(index, codetols, dl_size(tols), nsamples,
+                                  nside, p)) {
+            ERROR("Failed to profile index \"%s\"", argv[i]);
+            exit(-1);
+        }
+        index_free(index);
+        nprofs++;
+
+        logmsg("%s: id %i, healpix %i, %i stars, %i quads, %.1f MB\n",
+               argv[i], p->indexid, p->healpix, p->nstars, p->nquads,
+               p->filesize * 1e-6);
+        logmsg("  code tree: %i nodes, %i leaves of %i to %i (mean %.1f) codes\n",
+               p->ck_nnodes, p->ck_nleaves, p->leaf_min, p->leaf_max,
+               p->leaf_mean);
+        logmsg("  quads per nside-%i healpix: %i cells, mean %.1f, max %i\n",
+               p->qhp_nside, p->qhp_ncells, p->qhp_mean, p->qhp_max);
+        for (t=0; t<p->ntols; t++)
+            logmsg("  code tolerance %g: %.2f results, %.2f pages per query\n",
+                   p->codetol[t], p->nresults[t], p->npages[t]);
+    }
+
+    if (index_profile_write(outfn, profs, nprofs)) {
+        ERROR("Failed to write index profiles to \"%s\"", outfn);
+        exit(-1);
+    }
+    free(profs);
+    dl_free(tols);
+    return 0;
+}
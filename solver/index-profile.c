@@ -0,0 +1,316 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "index-profile.h"
+#include "index.h"
+#include "kdtree.h"
+#include "codekd.h"
+#include "starkd.h"
+#include "quadfile.h"
+#include "healpix.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "fitstable.h"
+#include "fitsioutils.h"
+#include "permutedsort.h"
+#include "log.h"
+#include "errors.h"
+
+// Upper limit on the quads-per-healpix grid (12 * 512^2 cells).
+#define QHP_MAX_NSIDE 512
+
+static void leaf_stats(const kdtree_t* kd, index_profile_t* prof) {
+    int i;
+    int64_t sum = 0;
+    prof->ck_nnodes = kd->nnodes;
+    prof->ck_nleaves = kd->nbottom;
+    prof->leaf_min = kd->ndata;
+    prof->leaf_max = 0;
+    for (i=kd->ninterior; i<kd->nnodes; i++) {
+        int n = kdtree_npoints(kd, i);
+        prof->leaf_min = MIN(prof->leaf_min, n);
+        prof->leaf_max = MAX(prof->leaf_max, n);
+        sum += n;
+    }
+    prof->leaf_mean = (kd->nbottom ? (double)sum / kd->nbottom : 0.0);
+}
+
+static int quads_per_healpix(index_t* index, int nside,
+                             index_profile_t* prof) {
+    int64_t nhp = 12 * (int64_t)nside * nside;
+    int* counts;
+    int i;
+    int64_t ncells = 0, sum = 0;
+
+    counts = calloc(nhp, sizeof(int));
+    if (!counts) {
+        SYSERROR("Failed to allocate quads-per-healpix grid for nside %i", nside);
+        return -1;
+    }
+    for (i=0; i<index->nquads; i++) {
+        unsigned int stars[DQMAX];
+        double xyzA[3], xyzB[3], mid[3];
+        int d;
+        quadfile_get_stars(index->quads, i, stars);
+        startree_get(index->starkd, stars[0], xyzA);
+        startree_get(index->starkd, stars[1], xyzB);
+        for (d=0; d<3; d++)
+            mid[d] = xyzA[d] + xyzB[d];
+        normalize_3(mid);
+        counts[xyzarrtohealpix(mid, nside)]++;
+    }
+    prof->qhp_nside = nside;
+    prof->qhp_max = 0;
+    for (i=0; i<nhp; i++) {
+        if (!counts[i])
+            continue;
+        ncells++;
+        sum += counts[i];
+        prof->qhp_max = MAX(prof->qhp_max, counts[i]);
+    }
+    prof->qhp_ncells = ncells;
+    prof->qhp_mean = (ncells ? (double)sum / ncells : 0.0);
+    free(counts);
+    return 0;
+}
+
+static int count_pages(const int* offsets, int N, int* scratch) {
+    int i, n = 0;
+    // offsets are page numbers; count the distinct ones.
+    memcpy(scratch, offsets, N * sizeof(int));
+    qsort(scratch, N, sizeof(int), compare_ints_asc);
+    for (i=0; i<N; i++)
+        if (i == 0 || scratch[i] != scratch[i-1])
+            n++;
+    return n;
+}
+
+int index_profile_compute(index_t* index, const double* codetols,
+                          int ntols, int nsamples, int qhp_nside,
+                          index_profile_t* prof) {
+    const kdtree_t* kd;
+    struct stat st;
+    int* inverse = NULL;
+    size_t datasize;
+    long pagesize;
+    int i, t;
+
+    if (!index->codekd || !index->quads || !index->starkd) {
+        ERROR("Index \"%s\" is not loaded", index->indexname);
+        return -1;
+    }
+    if (ntols > INDEX_PROFILE_MAX_TOLS) {
+        ERROR("At most %i code tolerances are supported", INDEX_PROFILE_MAX_TOLS);
+        return -1;
+    }
+    memset(prof, 0, sizeof(index_profile_t));
+    snprintf(prof->indexname, sizeof(prof->indexname), "%s",
+             index->indexname);
+    prof->indexid = index->indexid;
+    prof->healpix = index->healpix;
+    prof->hpnside = index->hpnside;
+    prof->scale_lo = index->index_scale_lower;
+    prof->scale_hi = index->index_scale_upper;
+    prof->nstars = index->nstars;
+    prof->nquads = index->nquads;
+    prof->dimquads = index->dimquads;
+    if (index->indexfn && stat(index->indexfn, &st) == 0)
+        prof->filesize = st.st_size;
+
+    kd = index->codekd->tree;
+    leaf_stats(kd, prof);
+
+    if (!qhp_nside)
+        qhp_nside = (int)ceil(healpix_nside_for_side_length_arcmin
+                              (index->index_scale_upper / 60.0));
+    qhp_nside = MAX(1, MIN(qhp_nside, QHP_MAX_NSIDE));
+    if (quads_per_healpix(index, qhp_nside, prof))
+        return -1;
+
+    // Range-search results are quad numbers; the code data is stored
+    // in tree order.
+    if (kd->perm) {
+        inverse = malloc(kd->ndata * sizeof(int));
+        for (i=0; i<kd->ndata; i++)
+            inverse[kd->perm[i]] = i;
+    }
+    datasize = kdtree_sizeof_data(kd) / MAX(1, kd->ndata);
+    pagesize = sysconf(_SC_PAGESIZE);
+    nsamples = MIN(nsamples, index->nquads);
+
+    prof->ntols = ntols;
+    for (t=0; t<ntols; t++) {
+        int64_t nres = 0, npages = 0;
+        prof->codetol[t] = codetols[t];
+        for (i=0; i<nsamples; i++) {
+            double code[DCMAX];
+            kdtree_qres_t* res;
+            int* pages;
+            int* scratch;
+            int j, quad, N;
+            // spread the samples evenly over the quads.
+            quad = (int)((int64_t)i * index->nquads / nsamples);
+            codetree_get(index->codekd, quad, code);
+            res = kdtree_rangesearch_options(kd, code, square(codetols[t]),
+                                             KD_OPTIONS_SMALL_RADIUS |
+                                             KD_OPTIONS_USE_SPLIT);
+            N = res->nres;
+            nres += N;
+            if (N) {
+                pages = malloc(N * sizeof(int));
+                scratch = malloc(N * sizeof(int));
+                for (j=0; j<N; j++) {
+                    int q = res->inds[j];
+                    int pos = (inverse ? inverse[q] : q);
+                    pages[j] = (int)((int64_t)pos * datasize / pagesize);
+                }
+                npages += count_pages(pages, N, scratch);
+                for (j=0; j<N; j++)
+                    pages[j] = (int)((int64_t)res->inds[j] * prof->dimquads *
+                                     sizeof(uint32_t) / pagesize);
+                npages += count_pages(pages, N, scratch);
+                free(pages);
+                free(scratch);
+            }
+            kdtree_free_query(res);
+        }
+        prof->nresults[t] = (nsamples ? (double)nres / nsamples : 0.0);
+        prof->npages[t] = (nsamples ? (double)npages / nsamples : 0.0);
+    }
+    free(inverse);
+    return 0;
+}
+
+// This is a naughty preprocessor function because it uses variables
+// declared in the calling scope.
+#define ADDARR(ctype, ftype, col, units, member, arraysize)             \
+    if (write) {                                                        \
+        fitstable_add_column_struct                                     \
+            (tab, ctype, arraysize, offsetof(index_profile_t, member),  \
+             ftype, col, units, TRUE);                                  \
+    } else {                                                            \
+        fitstable_add_column_struct                                     \
+            (tab, ctype, arraysize, offsetof(index_profile_t, member),  \
+             any, col, units, FALSE);                                   \
+    }
+
+#define ADDCOL(ctype, ftype, col, units, member)        \
+    ADDARR(ctype, ftype, col, units, member, 1)
+
+static void add_columns(fitstable_t* tab, anbool write) {
+    tfits_type any = fitscolumn_any_type();
+    tfits_type d = fitscolumn_double_type();
+    tfits_type i32 = fitscolumn_i32_type();
+    tfits_type i64 = fitscolumn_i64_type();
+    tfits_type i = fitscolumn_int_type();
+    tfits_type c = fitscolumn_char_type();
+    char* nil = " ";
+    index_profile_t p;
+
+    ADDARR(c,  c,   "INDEXNAME", nil, indexname, sizeof(p.indexname)-1);
+    ADDCOL(i,  i32, "INDEXID",   nil, indexid);
+    ADDCOL(i,  i32, "HEALPIX",   nil, healpix);
+    ADDCOL(i,  i32, "HPNSIDE",   nil, hpnside);
+    ADDCOL(d,  d,   "SCALE_LO",  "arcsec", scale_lo);
+    ADDCOL(d,  d,   "SCALE_HI",  "arcsec", scale_hi);
+    ADDCOL(i,  i32, "NSTARS",    nil, nstars);
+    ADDCOL(i,  i32, "NQUADS",    nil, nquads);
+    ADDCOL(i,  i32, "DIMQUADS",  nil, dimquads);
+    ADDCOL(i64,i64, "FILESIZE",  "bytes", filesize);
+    ADDCOL(i,  i32, "CK_NNODES", nil, ck_nnodes);
+    ADDCOL(i,  i32, "CK_NLEAVES",nil, ck_nleaves);
+    ADDCOL(i,  i32, "LEAF_MIN",  nil, leaf_min);
+    ADDCOL(d,  d,   "LEAF_MEAN", nil, leaf_mean);
+    ADDCOL(i,  i32, "LEAF_MAX",  nil, leaf_max);
+    ADDCOL(i,  i32, "QHP_NSIDE", nil, qhp_nside);
+    ADDCOL(i,  i32, "QHP_NCELLS",nil, qhp_ncells);
+    ADDCOL(d,  d,   "QHP_MEAN",  nil, qhp_mean);
+    ADDCOL(i,  i32, "QHP_MAX",   nil, qhp_max);
+    ADDCOL(i,  i32, "NTOLS",     nil, ntols);
+    ADDARR(d,  d,   "CODETOL",   nil, codetol, INDEX_PROFILE_MAX_TOLS);
+    ADDARR(d,  d,   "NRESULTS",  nil, nresults, INDEX_PROFILE_MAX_TOLS);
+    ADDARR(d,  d,   "NPAGES",    nil, npages, INDEX_PROFILE_MAX_TOLS);
+}
+#undef ADDCOL
+#undef ADDARR
+
+int index_profile_write(const char* fn, const index_profile_t* profs,
+                        int N) {
+    fitstable_t* tab;
+    qfits_header* hdr;
+    int i;
+
+    tab = fitstable_open_for_writing(fn);
+    if (!tab) {
+        ERROR("Failed to open index profile file \"%s\" for writing", fn);
+        return -1;
+    }
+    add_columns(tab, TRUE);
+    hdr = fitstable_get_primary_header(tab);
+    qfits_header_add(hdr, "AN_FILE", AN_FILETYPE_INDEXPROFILE,
+                     "Astrometry.net file type", NULL);
+    if (fitstable_write_primary_header(tab) ||
+        fitstable_write_header(tab)) {
+        ERROR("Failed to write index profile headers");
+        fitstable_close(tab);
+        return -1;
+    }
+    for (i=0; i<N; i++) {
+        if (fitstable_write_struct(tab, profs + i)) {
+            ERROR("Failed to write index profile %i", i);
+            fitstable_close(tab);
+            return -1;
+        }
+    }
+    if (fitstable_fix_header(tab) || fitstable_close(tab)) {
+        ERROR("Failed to close index profile file \"%s\"", fn);
+        return -1;
+    }
+    return 0;
+}
+
+index_profile_t* index_profile_read(const char* fn, int* N) {
+    fitstable_t* tab;
+    index_profile_t* profs;
+
+    tab = fitstable_open(fn);
+    if (!tab) {
+        ERROR("Failed to open index profile file \"%s\"", fn);
+        return NULL;
+    }
+    add_columns(tab, FALSE);
+    if (fitstable_read_extension(tab, 1)) {
+        ERROR("Index profile file \"%s\" is missing required columns", fn);
+        fitstable_close(tab);
+        return NULL;
+    }
+    *N = fitstable_nrows(tab);
+    profs = calloc(MAX(1, *N), sizeof(index_profile_t));
+    if (*N && fitstable_read_structs(tab, profs, sizeof(index_profile_t),
+                                     0, *N)) {
+        ERROR("Failed to read index profiles from \"%s\"", fn);
+        free(profs);
+        fitstable_close(tab);
+        return NULL;
+    }
+    fitstable_close(tab);
+    return profs;
+}
+
+const index_profile_t* index_profile_find(const index_profile_t* profs,
+                                          int N, int indexid, int healpix) {
+    int i;
+    for (i=0; i<N; i++)
+        if (profs[i].indexid == indexid && profs[i].healpix == healpix)
+            return profs + i;
+    return NULL;
+}
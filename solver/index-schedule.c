@@ -0,0 +1,277 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include "index-schedule.h"
+#include "index-profile.h"
+#include "index.h"
+#include "bl.h"
+#include "ioutils.h"
+#include "mathutil.h"
+#include "log.h"
+#include "errors.h"
+
+// Weight of the prior, in runs, against the recorded solve statistics.
+#define SCHEDULE_PRIOR_RUNS 2.0
+// Smallest solve probability we assign: even an index that has never
+// solved anything eventually gets its turn.
+#define SCHEDULE_MIN_PROB 1e-3
+
+struct history_entry {
+    int indexid;
+    int healpix;
+    int64_t runs;
+    int64_t solved;
+    double cputime;
+};
+
+struct index_schedule {
+    index_profile_t* profiles;
+    int nprofiles;
+    char* historyfn;
+    // struct history_entry
+    bl* history;
+    anbool dirty;
+};
+
+index_schedule_t* index_schedule_new(void) {
+    index_schedule_t* s = calloc(1, sizeof(index_schedule_t));
+    s->history = bl_new(64, sizeof(struct history_entry));
+    return s;
+}
+
+void index_schedule_free(index_schedule_t* s) {
+    if (!s)
+        return;
+    free(s->profiles);
+    free(s->historyfn);
+    bl_free(s->history);
+    free(s);
+}
+
+int index_schedule_load_profiles(index_schedule_t* s, const char* fn) {
+    index_profile_t* profs;
+    int N;
+    profs = index_profile_read(fn, &N);
+    if (!profs)
+        return -1;
+    free(s->profiles);
+    s->profiles = profs;
+    s->nprofiles = N;
+    logverb("Read %i index profiles from %s\n", N, fn);
+    return 0;
+}
+
+static struct history_entry* find_history(const index_schedule_t* s,
+                                          int indexid, int healpix) {
+    size_t i;
+    for (i=0; i<bl_size(s->history); i++) {
+        struct history_entry* h = bl_access(s->history, i);
+        if (h->indexid == indexid && h->healpix == healpix)
+            return h;
+    }
+    return NULL;
+}
+
+int index_schedule_load_history(index_schedule_t* s, const char* fn) {
+    FILE* f;
+    char line[256];
+    free(s->historyfn);
+    s->historyfn = strdup(fn);
+    bl_remove_all(s->history);
+    f = fopen(fn, "r");
+    if (!f) {
+        if (errno == ENOENT) {
+            logverb("Index history file %s does not exist yet\n", fn);
+            return 0;
+        }
+        SYSERROR("Failed to open index history file \"%s\"", fn);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        struct history_entry h;
+        long long runs, solved;
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%i %i %lld %lld %lf", &h.indexid, &h.healpix,
+                   &runs, &solved, &h.cputime) != 5) {
+            ERROR("Failed to parse index history line \"%s\" in %s", line, fn);
+            fclose(f);
+            return -1;
+        }
+        h.runs = runs;
+        h.solved = solved;
+        bl_append(s->history, &h);
+    }
+    fclose(f);
+    logverb("Read history for %zu indexes from %s\n", bl_size(s->history), fn);
+    return 0;
+}
+
+int index_schedule_save_history(index_schedule_t* s) {
+    FILE* f;
+    char* tmpfn;
+    size_t i;
+    if (!s->historyfn || !s->dirty)
+        return 0;
+    // write to a temp file and rename it, so a crash can't truncate the
+    // history.
+    asprintf_safe(&tmpfn, "%s.tmp", s->historyfn);
+    f = fopen(tmpfn, "w");
+    if (!f) {
+        SYSERROR("Failed to open index history file \"%s\" for writing", tmpfn);
+        free(tmpfn);
+        return -1;
+    }
+    fprintf(f, "# indexid healpix runs solved cputime\n");
+    for (i=0; i<bl_size(s->history); i++) {
+        struct history_entry* h = bl_access(s->history, i);
+        fprintf(f, "%i %i %lld %lld %.6f\n", h->indexid, h->healpix,
+                (long long)h->runs, (long long)h->solved, h->cputime);
+    }
+    if (fclose(f) || rename(tmpfn, s->historyfn)) {
+        SYSERROR("Failed to write index history file \"%s\"", s->historyfn);
+        free(tmpfn);
+        return -1;
+    }
+    free(tmpfn);
+    s->dirty = FALSE;
+    return 0;
+}
+
+void index_schedule_record(index_schedule_t* s, const index_t* index,
+                           double cputime, anbool solved) {
+    struct history_entry* h = find_history(s, index->indexid, index->healpix);
+    if (!h) {
+        struct history_entry newh;
+        memset(&newh, 0, sizeof(newh));
+        newh.indexid = index->indexid;
+        newh.healpix = index->healpix;
+        h = bl_append(s->history, &newh);
+    }
+    h->runs++;
+    if (solved)
+        h->solved++;
+    h->cputime += cputime;
+    s->dirty = TRUE;
+}
+
+// Fraction of the (log) range of field quad sizes that the index covers.
+static double scale_fit(const index_t* index, double quadlo, double quadhi) {
+    double lo = MAX(quadlo, index->index_scale_lower);
+    double hi = MIN(quadhi, index->index_scale_upper);
+    if (quadhi <= quadlo || quadlo <= 0)
+        return 1.0;
+    if (hi <= lo)
+        return 0.0;
+    return log(hi / lo) / log(quadhi / quadlo);
+}
+
+// Expected code-tree results per query, at the profiled tolerance
+// closest to "codetol".
+static double profile_results(const index_profile_t* p, double codetol) {
+    int t, best = -1;
+    for (t=0; t<p->ntols; t++)
+        if (best == -1 || fabs(log(p->codetol[t] / codetol)) <
+            fabs(log(p->codetol[best] / codetol)))
+            best = t;
+    if (best == -1)
+        return 0.0;
+    return p->nresults[best];
+}
+
+// Cost of running an index, relative to the average index.
+static double relative_cost(const index_schedule_t* s, const index_t* index,
+                            double codetol) {
+    const struct history_entry* h;
+    const index_profile_t* p;
+    double sum = 0.0;
+    int i, n = 0;
+
+    h = find_history(s, index->indexid, index->healpix);
+    if (h && h->runs && h->cputime > 0) {
+        for (i=0; i<bl_size(s->history); i++) {
+            const struct history_entry* hi = bl_access(s->history, i);
+            if (!hi->runs)
+                continue;
+            sum += hi->cputime / hi->runs;
+            n++;
+        }
+        return (h->cputime / h->runs) / (sum / n);
+    }
+    p = index_profile_find(s->profiles, s->nprofiles, index->indexid,
+                           index->healpix);
+    if (p) {
+        for (i=0; i<s->nprofiles; i++)
+            sum += 1.0 + profile_results(s->profiles + i, codetol);
+        return (1.0 + profile_results(p, codetol)) / (sum / s->nprofiles);
+    }
+    return 1.0;
+}
+
+double index_schedule_cost(const index_schedule_t* s, const index_t* index,
+                           double quadlo, double quadhi, double codetol,
+                           anbool sky_prior) {
+    const struct history_entry* h;
+    double prior, prob;
+
+    prior = scale_fit(index, quadlo, quadhi);
+    if (index->healpix >= 0 && index->hpnside > 0 && !sky_prior)
+        prior /= (12.0 * index->hpnside * index->hpnside);
+    h = find_history(s, index->indexid, index->healpix);
+    if (h)
+        prob = (h->solved + SCHEDULE_PRIOR_RUNS * prior) /
+            (h->runs + SCHEDULE_PRIOR_RUNS);
+    else
+        prob = prior;
+    prob = MAX(prob, SCHEDULE_MIN_PROB);
+    return relative_cost(s, index, codetol) / prob;
+}
+
+struct sched_item {
+    int ind;
+    int order;
+    double cost;
+};
+
+static int compare_items(const void* v1, const void* v2) {
+    const struct sched_item* i1 = v1;
+    const struct sched_item* i2 = v2;
+    if (i1->cost < i2->cost)
+        return -1;
+    if (i1->cost > i2->cost)
+        return 1;
+    return i1->order - i2->order;
+}
+
+void index_schedule_order(const index_schedule_t* s, pl* indexes,
+                          il* indlist, double quadlo, double quadhi,
+                          double codetol, anbool sky_prior) {
+    int i, N = il_size(indlist);
+    struct sched_item* items;
+    if (N < 2)
+        return;
+    items = malloc(N * sizeof(struct sched_item));
+    for (i=0; i<N; i++) {
+        index_t* index;
+        items[i].ind = il_get(indlist, i);
+        items[i].order = i;
+        index = pl_get(indexes, items[i].ind);
+        items[i].cost = index_schedule_cost(s, index, quadlo, quadhi,
+                                            codetol, sky_prior);
+    }
+    qsort(items, N, sizeof(struct sched_item), compare_items);
+    for (i=0; i<N; i++) {
+        index_t* index = pl_get(indexes, items[i].ind);
+        il_set(indlist, i, items[i].ind);
+        debug("Schedule: %i: %s (cost %g)\n", i, index->indexname,
+              items[i].cost);
+    }
+    free(items);
+}
@@ -12,6 +12,7 @@
 #include "quadfile.h"
 #include "codekd.h"
 #include "starkd.h"
+#include "quadmap.h"
 #include "fitstable.h"
 #include "fitsioutils.h"
 #include "errors.h"
@@ -80,6 +81,41 @@ int merge_index(quadfile_t* quad, codetree_t* code, startree_t* star,
     return 0;
 }
 
+int merge_index_add_quadmap(quadfile_t* quad, startree_t* star,
+                            const char* indexfn) {
+    quadmap_t* qm;
+    FILE* fout;
+    int nside;
+
+    nside = quadmap_nside_for_scale(quadfile_get_index_scale_upper_arcsec(quad));
+    logverb("Building nside-%i quad map\n", nside);
+    qm = quadmap_build(quad, star, nside);
+    if (!qm) {
+        ERROR("Failed to build quad map");
+        return -1;
+    }
+    fout = fopen(indexfn, "r+b");
+    if (!fout) {
+        SYSERROR("Failed to open index file %s to add the quad map", indexfn);
+        quadmap_free(qm);
+        return -1;
+    }
+    if (fseeko(fout, 0, SEEK_END) ||
+        quadmap_append_to(qm, fout) ||
+        fits_pad_file(fout)) {
+        ERROR("Failed to write quad map to index file %s", indexfn);
+        fclose(fout);
+        quadmap_free(qm);
+        return -1;
+    }
+    quadmap_free(qm);
+    if (fclose(fout)) {
+        SYSERROR("Failed to close index file %s", indexfn);
+        return -1;
+    }
+    return 0;
+}
+
 int merge_index_open_files(const char* quadfn, const char* ckdtfn, const char* skdtfn,
                            quadfile_t** quad, codetree_t** code, startree_t** star) {
     logmsg("Reading code tree from %s ...\n", ckdtfn);
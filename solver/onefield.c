@@ -250,6 +250,11 @@ void onefield_set_corr_file(onefield_t* bp, const char* fn) {
     bp->corr_fname = strdup_safe(fn);
 }
 
+void onefield_set_stats_file(onefield_t* bp, const char* fn) {
+    free(bp->stats_fname);
+    bp->stats_fname = strdup_safe(fn);
+}
+
 void onefield_set_wcs_file(onefield_t* bp, const char* fn) {
     free(bp->wcs_template);
     bp->wcs_template = strdup_safe(fn);
@@ -353,6 +358,15 @@ void onefield_run(onefield_t* bp) {
 
     remove_invalid_fields(bp->fieldlist, xylist_n_fields(bp->xyls));
 
+    if (bp->stats_fname) {
+        bp->stats_fid = fopen(bp->stats_fname, "a");
+        if (!bp->stats_fid) {
+            SYSERROR("Failed to open solver stats file \"%s\" for writing", bp->stats_fname);
+            exit(-1);
+        }
+        sp->stats = solver_stats_new();
+    }
+
     Nindexes = n_indexes(bp);
 
     // Verify any WCS estimates we have.
@@ -457,6 +471,7 @@ void onefield_run(onefield_t* bp) {
 
         for (I=0; I<Nindexes; I++) {
             index_t* index;
+            anbool was_solved;
 
             if (bp->hit_total_timelimit || bp->hit_total_cpulimit)
                 break;
@@ -476,7 +491,12 @@ void onefield_run(onefield_t* bp) {
             bp->time_start = time(NULL);
 
             // Do it!
+            was_solved = bp->single_field_solved;
             solve_fields(bp, NULL);
+            if (bp->index_done)
+                bp->index_done(index, get_cpu_usage() - bp->cpu_start,
+                               bp->single_field_solved && !was_solved,
+                               bp->index_done_userdata);
 
             // Clean up this index...
             done_with_index(bp, I, index);
@@ -488,11 +508,22 @@ void onefield_run(onefield_t* bp) {
     // Clean up.
     xylist_close(bp->xyls);
 
+    if (bp->stats_fid) {
+        if (fclose(bp->stats_fid))
+            SYSERROR("Failed to close solver stats file \"%s\"", bp->stats_fname);
+        bp->stats_fid = NULL;
+    }
+    solver_stats_free(sp->stats);
+    sp->stats = NULL;
+
     if (write_solutions(bp))
         exit(-1);
 
     for (i=0; i<bl_size(bp->solutions); i++) {
         MatchObj* mo = bl_access(bp->solutions, i);
+        // write_solutions() left only the best solution of each field.
+        if (bp->field_solved && mo->logodds >= bp->logratio_tosolve)
+            bp->field_solved(mo, bp->field_solved_userdata);
         verify_free_matchobj(mo);
         onefield_free_matchobj(mo);
     }
@@ -651,6 +682,7 @@ void onefield_cleanup(onefield_t* bp) {
     free(bp->indexrdlsfname);
     free(bp->scamp_fname);
     free(bp->corr_fname);
+    free(bp->stats_fname);
     free(bp->matchfname);
     free(bp->solved_in);
     free(bp->solved_out);
@@ -929,6 +961,8 @@ static void solve_fields(onefield_t* bp, sip_t* verify_wcs) {
 
         solver_reset_counters(sp);
         solver_reset_best_match(sp);
+        if (sp->stats)
+            solver_stats_reset(sp->stats);
 
         sp->mo_template = &template;
         sp->record_match_callback = record_match_callback;
@@ -994,6 +1028,13 @@ static void solve_fields(onefield_t* bp, sip_t* verify_wcs) {
             }
         }
 
+        if (bp->stats_fid && sp->stats) {
+            if (solver_stats_write_json(sp->stats, sp, fieldnum, bp->stats_fid))
+                ERROR("Failed to write solver stats for field %i to \"%s\"",
+                      fieldnum, bp->stats_fname);
+            fflush(bp->stats_fid);
+        }
+
         solver_free_field(sp);
 
         get_resource_stats(&utime, &stime, NULL);
@@ -0,0 +1,297 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "refcache.h"
+#include "starkd.h"
+#include "healpix.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "permutedsort.h"
+#include "log.h"
+
+// Query radii are rounded up to powers of 2^(1/4) radians.
+#define REFCACHE_LEVELS_PER_OCTAVE 4
+#define REFCACHE_MAX_NSIDE 8192
+
+struct refcache_key {
+    const startree_t* skdt;
+    int level;
+    int hp;
+};
+
+struct refcache_entry {
+    const startree_t* skdt;
+    int level;
+    int hp;
+    int N;
+    // in sweep order.
+    double* xyz;
+    int* starids;
+    int64_t lastuse;
+};
+
+struct refcache {
+    int maxentries;
+    int nentries;
+    struct refcache_entry* entries;
+    // Ring of recently-missed keys.  A cell only gets an entry (possibly
+    // evicting another) when it is missed a second time, so one-off
+    // queries (most false matches) go straight to the kd-tree and don't
+    // push out cells that are in use.
+    int nseen;
+    int seenpos;
+    struct refcache_key* seen;
+    int64_t tick;
+    int64_t hits;
+    int64_t misses;
+};
+
+static double level_radius(int level) {
+    return pow(2.0, (double)level / REFCACHE_LEVELS_PER_OCTAVE);
+}
+
+// Healpix cells about half the (rounded-up) query radius across.
+static int level_nside(int level) {
+    double nside = healpix_nside_for_side_length_arcmin
+        (rad2arcmin(level_radius(level)) / 2.0);
+    if (nside > REFCACHE_MAX_NSIDE)
+        return REFCACHE_MAX_NSIDE;
+    return MAX(1, (int)ceil(nside));
+}
+
+// Distance from "center" to the farthest point on the boundary of
+// healpix "hp", with a margin since we only sample the boundary.
+static double cell_radius(int hp, int nside, const double* center) {
+    double maxd2 = 0.0;
+    int i, j;
+    for (i=0; i<=8; i++)
+        for (j=0; j<=8; j++) {
+            double xyz[3];
+            if (i && i<8 && j && j<8)
+                continue;
+            healpix_to_xyzarr(hp, nside, i/8.0, j/8.0, xyz);
+            maxd2 = MAX(maxd2, distsq(center, xyz, 3));
+        }
+    return 1.1 * distsq2rad(maxd2);
+}
+
+refcache_t* refcache_new(int maxentries) {
+    refcache_t* rc = calloc(1, sizeof(refcache_t));
+    rc->maxentries = MAX(1, maxentries);
+    rc->entries = calloc(rc->maxentries, sizeof(struct refcache_entry));
+    rc->nseen = 2 * rc->maxentries;
+    rc->seen = calloc(rc->nseen, sizeof(struct refcache_key));
+    return rc;
+}
+
+static void free_entry(struct refcache_entry* e) {
+    free(e->xyz);
+    free(e->starids);
+    memset(e, 0, sizeof(struct refcache_entry));
+}
+
+void refcache_free(refcache_t* rc) {
+    int i;
+    if (!rc)
+        return;
+    logverb("Reference-star cache: %lli hits, %lli misses\n",
+            (long long)rc->hits, (long long)rc->misses);
+    for (i=0; i<rc->nentries; i++)
+        free_entry(rc->entries + i);
+    free(rc->entries);
+    free(rc->seen);
+    free(rc);
+}
+
+void refcache_get_stats(const refcache_t* rc, int64_t* hits,
+                        int64_t* misses) {
+    if (hits)
+        *hits = rc->hits;
+    if (misses)
+        *misses = rc->misses;
+}
+
+// Returns TRUE if the key was missed recently (and forgets it); otherwise
+// remembers it and returns FALSE.
+static anbool seen_before(refcache_t* rc, const startree_t* skdt,
+                          int level, int hp) {
+    struct refcache_key* k;
+    int i;
+    for (i=0; i<rc->nseen; i++) {
+        k = rc->seen + i;
+        if (k->skdt == skdt && k->level == level && k->hp == hp) {
+            k->skdt = NULL;
+            return TRUE;
+        }
+    }
+    k = rc->seen + rc->seenpos;
+    rc->seenpos = (rc->seenpos + 1) % rc->nseen;
+    k->skdt = skdt;
+    k->level = level;
+    k->hp = hp;
+    return FALSE;
+}
+
+static struct refcache_entry* new_entry(refcache_t* rc,
+                                        const startree_t* skdt,
+                                        int level, int hp) {
+    struct refcache_entry* e;
+    int i;
+    if (rc->nentries < rc->maxentries) {
+        e = rc->entries + rc->nentries;
+        rc->nentries++;
+    } else {
+        // evict the least-recently used entry.
+        e = rc->entries;
+        for (i=1; i<rc->nentries; i++)
+            if (rc->entries[i].lastuse < e->lastuse)
+                e = rc->entries + i;
+        free_entry(e);
+    }
+    e->skdt = skdt;
+    e->level = level;
+    e->hp = hp;
+    return e;
+}
+
+// Puts the stars found by startree_search_for() in sweep order, breaking
+// ties by star id.  (The kd-tree returns them in an order that depends on
+// the query point, so this is what lets us answer from a superset.)
+static void sort_by_sweep(const startree_t* skdt, double* xyz, int* starids,
+                          int N) {
+    int64_t* keys;
+    int* perm;
+    double* tmpxyz;
+    int* tmpids;
+    int i;
+    if (N < 2)
+        return;
+    keys = calloc(N, sizeof(int64_t));
+    for (i=0; i<N; i++)
+        keys[i] = ((int64_t)skdt->sweep[starids[i]] << 32) | (uint32_t)starids[i];
+    perm = permuted_sort(keys, sizeof(int64_t), compare_int64_asc, NULL, N);
+    free(keys);
+    tmpids = malloc(N * sizeof(int));
+    for (i=0; i<N; i++)
+        tmpids[i] = starids[perm[i]];
+    memcpy(starids, tmpids, N * sizeof(int));
+    free(tmpids);
+    if (xyz) {
+        tmpxyz = malloc(N * 3 * sizeof(double));
+        for (i=0; i<N; i++)
+            memcpy(tmpxyz + 3*i, xyz + 3*perm[i], 3 * sizeof(double));
+        memcpy(xyz, tmpxyz, N * 3 * sizeof(double));
+        free(tmpxyz);
+    }
+    free(perm);
+}
+
+static void fill_entry(struct refcache_entry* e) {
+    const startree_t* skdt = e->skdt;
+    double center[3];
+    double r;
+    int nside;
+
+    nside = level_nside(e->level);
+    healpix_to_xyzarr(e->hp, nside, 0.5, 0.5, center);
+    r = level_radius(e->level) + cell_radius(e->hp, nside, center);
+    startree_search_for(skdt, center, rad2distsq(MIN(r, M_PI)),
+                        &e->xyz, NULL, &e->starids, &e->N);
+    sort_by_sweep(skdt, e->xyz, e->starids, e->N);
+}
+
+int refcache_search(refcache_t* rc, const startree_t* skdt,
+                    const double* xyzcenter, double radius2,
+                    double** xyzresults, int** starinds, int* nresults) {
+    struct refcache_entry* e = NULL;
+    double rad;
+    int level, hp, i, N, hit;
+    double* xyz = NULL;
+    int* ids = NULL;
+
+    assert(skdt->sweep);
+    rad = MAX(distsq2rad(radius2), arcsec2rad(1e-3));
+    level = (int)ceil(REFCACHE_LEVELS_PER_OCTAVE * log2(rad));
+    hp = xyzarrtohealpix(xyzcenter, level_nside(level));
+
+    for (i=0; i<rc->nentries; i++) {
+        struct refcache_entry* ei = rc->entries + i;
+        if (ei->skdt == skdt && ei->level == level && ei->hp == hp) {
+            e = ei;
+            break;
+        }
+    }
+    hit = (e != NULL);
+    if (hit)
+        rc->hits++;
+    else
+        rc->misses++;
+    if (!e && !seen_before(rc, skdt, level, hp)) {
+        startree_search_for(skdt, xyzcenter, radius2, &xyz, NULL,
+                            &ids, nresults);
+        sort_by_sweep(skdt, xyz, ids, *nresults);
+        if (xyzresults)
+            *xyzresults = xyz;
+        else
+            free(xyz);
+        if (starinds)
+            *starinds = ids;
+        else
+            free(ids);
+        return 0;
+    }
+    if (!e) {
+        e = new_entry(rc, skdt, level, hp);
+        fill_entry(e);
+    }
+    e->lastuse = ++rc->tick;
+
+    // Same test as the kd-tree range search, so we get the same stars;
+    // filtering keeps them in sweep order.
+    N = 0;
+    if (e->N) {
+        if (xyzresults)
+            xyz = malloc(e->N * 3 * sizeof(double));
+        if (starinds)
+            ids = malloc(e->N * sizeof(int));
+    }
+    for (i=0; i<e->N; i++) {
+        const double* p = e->xyz + 3*i;
+        double d2 = 0.0;
+        int d;
+        for (d=0; d<3; d++) {
+            double delta = xyzcenter[d] - p[d];
+            d2 += delta * delta;
+        }
+        if (d2 > radius2)
+            continue;
+        if (xyz)
+            memcpy(xyz + 3*N, p, 3 * sizeof(double));
+        if (ids)
+            ids[N] = e->starids[i];
+        N++;
+    }
+    if (!N) {
+        free(xyz);
+        free(ids);
+        xyz = NULL;
+        ids = NULL;
+    } else if (N < e->N) {
+        if (xyz)
+            xyz = realloc(xyz, N * 3 * sizeof(double));
+        if (ids)
+            ids = realloc(ids, N * sizeof(int));
+    }
+    if (xyzresults)
+        *xyzresults = xyz;
+    if (starinds)
+        *starinds = ids;
+    *nresults = N;
+    return hit;
+}
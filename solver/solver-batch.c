@@ -0,0 +1,243 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "os-features.h"
+#include "solver-batch.h"
+#include "solver.h"
+#include "onefield.h"
+#include "verify.h"
+#include "starxy.h"
+#include "permutedsort.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "log.h"
+#include "errors.h"
+
+struct batch_job {
+    const solver_batch_args_t* args;
+    index_t** indexes;
+    int nindexes;
+    solver_batch_field_t* fields;
+    int nfields;
+    pthread_mutex_t lock;
+    int next;
+};
+
+void solver_batch_args_init(solver_batch_args_t* args) {
+    memset(args, 0, sizeof(solver_batch_args_t));
+    args->parity = PARITY_BOTH;
+    args->logodds_solve = log(1e9);
+    args->verify_pix = DEFAULT_VERIFY_PIX;
+    args->tweak_order = 2;
+    args->nthreads = 1;
+}
+
+void solver_batch_field_init(solver_batch_field_t* f) {
+    memset(f, 0, sizeof(solver_batch_field_t));
+}
+
+void solver_batch_field_free(solver_batch_field_t* f) {
+    free(f->match_field);
+    free(f->match_radec);
+    free(f->match_refid);
+    free(f->match_weight);
+    f->match_field = NULL;
+    f->match_radec = NULL;
+    f->match_refid = NULL;
+    f->match_weight = NULL;
+    f->nmatch = 0;
+}
+
+static solver_t* new_solver(const struct batch_job* job) {
+    const solver_batch_args_t* args = job->args;
+    solver_t* sp = solver_new();
+    int i;
+    sp->funits_lower = args->scale_lo;
+    sp->funits_upper = args->scale_hi;
+    solver_set_parity(sp, args->parity);
+    solver_set_keep_logodds(sp, args->logodds_solve);
+    sp->logratio_stoplooking = args->logodds_solve;
+    sp->maxquads = args->maxquads;
+    sp->verify_pix = args->verify_pix;
+    if (args->tweak_order >= 2) {
+        sp->do_tweak = TRUE;
+        sp->tweak_aborder = sp->tweak_abporder = args->tweak_order;
+    }
+    sp->set_crpix_center = args->crpix_center;
+    for (i=0; i<job->nindexes; i++)
+        solver_add_index(sp, job->indexes[i]);
+    return sp;
+}
+
+// "theta" is indexed by field star, for all "nfield" of them -- not
+// just the "nbest" that were verified.
+static void get_matches(const MatchObj* mo, const int* perm,
+                        solver_batch_field_t* f) {
+    int i, n, N = mo->nfield;
+    f->match_field  = malloc(MAX(N, 1) * sizeof(int));
+    f->match_radec  = malloc(MAX(N, 1) * 2 * sizeof(double));
+    f->match_refid  = malloc(MAX(N, 1) * sizeof(int));
+    f->match_weight = malloc(MAX(N, 1) * sizeof(double));
+    n = 0;
+    for (i=0; i<N; i++) {
+        int r = mo->theta[i];
+        if (r < 0)
+            continue;
+        f->match_field[n] = perm ? perm[i] : i;
+        xyzarr2radecdegarr(mo->refxyz + 3*r, f->match_radec + 2*n);
+        f->match_refid[n] = mo->refstarid ? mo->refstarid[r] : -1;
+        f->match_weight[n] = verify_logodds_to_weight(mo->matchodds[i]);
+        n++;
+    }
+    f->nmatch = n;
+}
+
+static void solve_field(solver_t* sp, solver_batch_field_t* f) {
+    starxy_t* xy;
+    int* perm = NULL;
+    int i;
+    double W, H;
+
+    f->solved = FALSE;
+    f->logodds = 0;
+    f->index = NULL;
+    solver_batch_field_free(f);
+    memset(&f->wcs, 0, sizeof(sip_t));
+    if (f->N < 1)
+        return;
+
+    if (f->flux)
+        perm = permuted_sort(f->flux, sizeof(double), compare_doubles_desc,
+                             NULL, f->N);
+    xy = starxy_new(f->N, FALSE, FALSE);
+    for (i=0; i<f->N; i++) {
+        int k = perm ? perm[i] : i;
+        starxy_set(xy, i, f->x[k], f->y[k]);
+    }
+    solver_set_field(sp, xy);
+    if (f->W > 0 && f->H > 0)
+        solver_set_field_bounds(sp, 0, f->W, 0, f->H);
+    else {
+        double xlo = HUGE_VAL, xhi = -HUGE_VAL, ylo = HUGE_VAL, yhi = -HUGE_VAL;
+        for (i=0; i<f->N; i++) {
+            xlo = MIN(xlo, f->x[i]);
+            xhi = MAX(xhi, f->x[i]);
+            ylo = MIN(ylo, f->y[i]);
+            yhi = MAX(yhi, f->y[i]);
+        }
+        solver_set_field_bounds(sp, xlo, xhi, ylo, yhi);
+    }
+    solver_set_quad_size_fraction(sp, DEFAULT_QSF_LO, DEFAULT_QSF_HI);
+    if (f->use_radec)
+        solver_set_radec(sp, f->ra, f->dec, f->radius);
+    else
+        solver_clear_radec(sp);
+
+    solver_run(sp);
+
+    if (sp->have_best_match && solver_did_solve(sp)) {
+        MatchObj* mo = solver_get_best_match(sp);
+        f->solved = TRUE;
+        f->logodds = mo->logodds;
+        f->index = mo->index;
+        if (mo->sip)
+            memcpy(&f->wcs, mo->sip, sizeof(sip_t));
+        else
+            sip_wrap_tan(&mo->wcstan, &f->wcs);
+        W = solver_field_width(sp);
+        H = solver_field_height(sp);
+        f->wcs.wcstan.imagew = (f->W > 0) ? f->W : W;
+        f->wcs.wcstan.imageh = (f->H > 0) ? f->H : H;
+        get_matches(mo, perm, f);
+    }
+    if (sp->have_best_match) {
+        free(sp->best_match.sip);
+        sp->best_match.sip = NULL;
+        verify_free_matchobj(&sp->best_match);
+    }
+    solver_cleanup_field(sp);
+    free(perm);
+}
+
+static void* batch_thread(void* v) {
+    struct batch_job* job = v;
+    solver_t* sp = new_solver(job);
+    for (;;) {
+        int i;
+        pthread_mutex_lock(&job->lock);
+        i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->nfields)
+            break;
+        solve_field(sp, job->fields + i);
+        debug("Batch field %i: %s\n", i,
+              job->fields[i].solved ? "solved" : "did not solve");
+    }
+    solver_free(sp);
+    return NULL;
+}
+
+int solver_batch_run(const solver_batch_args_t* args,
+                     index_t** indexes, int nindexes,
+                     solver_batch_field_t* fields, int nfields) {
+    struct batch_job job;
+    pthread_t* threads;
+    int i, nthreads;
+
+    if (args->scale_lo <= 0 || args->scale_hi < args->scale_lo) {
+        ERROR("Batch solve: need 0 < scale_lo <= scale_hi (got %g, %g)",
+              args->scale_lo, args->scale_hi);
+        return -1;
+    }
+    if (nindexes < 1) {
+        ERROR("Batch solve: no indexes");
+        return -1;
+    }
+    for (i=0; i<nindexes; i++) {
+        index_t* index = indexes[i];
+        if (!index->codekd || !index->starkd || !index->quads) {
+            ERROR("Batch solve: index %s is not fully loaded",
+                  index->indexname);
+            return -1;
+        }
+    }
+    memset(&job, 0, sizeof(job));
+    job.args = args;
+    job.indexes = indexes;
+    job.nindexes = nindexes;
+    job.fields = fields;
+    job.nfields = nfields;
+    pthread_mutex_init(&job.lock, NULL);
+
+    // RA,Dec-constrained fields search each index's quad map.  Build (or
+    // read) the maps now, once, rather than have the threads queue up
+    // on the lock in index_get_quadmap() for the first field.
+    for (i=0; i<nfields; i++)
+        if (fields[i].use_radec)
+            break;
+    if (i < nfields)
+        for (i=0; i<nindexes; i++)
+            index_get_quadmap(indexes[i]);
+
+    nthreads = MAX(1, MIN(args->nthreads, nfields));
+    threads = calloc(nthreads, sizeof(pthread_t));
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + i, NULL, batch_thread, &job)) {
+            SYSERROR("Failed to create thread");
+            nthreads = i;
+            break;
+        }
+    }
+    batch_thread(&job);
+    for (i=1; i<nthreads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&job.lock);
+    return 0;
+}
@@ -0,0 +1,338 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+/**
+ Solver benchmark: generates synthetic fields from the star kd-tree
+ of an index (see synthfield.h) over a fixed set of random seeds, runs
+ the solver on each, and reports solve rate, time-to-first-solve,
+ quads tried and peak memory use.
+
+ With the same index files and options, two runs see exactly the same
+ fields, so their numbers can be compared directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "os-features.h"
+#include "solver.h"
+#include "solverstats.h"
+#include "synthfield.h"
+#include "index.h"
+#include "starutil.h"
+#include "permutedsort.h"
+#include "tic.h"
+#include "bl.h"
+#include "log.h"
+#include "errors.h"
+#include "boilerplate.h"
+
+static const char* OPTIONS = "hvi:n:s:W:H:L:U:d:D:e:m:q:o:c:C:R:";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s -i <index-file> [-i <index-file> ...] [options]\n"
+           "    [-n <number of fields>] (default 200)\n"
+           "    [-s <first seed>] (default 1); field k uses seed s+k\n"
+           "    [-W <width>] [-H <height>] image size in pixels (default 1000 x 1000)\n"
+           "    [-L <scale-low>] [-U <scale-high>] pixel scale range, arcsec/pixel;\n"
+           "          default: fields 1.5 times the largest quad scale in the first index\n"
+           "    [-d <distractors>]: distractor fraction (default 0.25)\n"
+           "    [-D <dropout>]: fraction of real stars to drop (default 0.1)\n"
+           "    [-e <noise>]: positional noise, pixels (default 1)\n"
+           "    [-m <max stars>]: keep only the brightest N stars (default 100)\n"
+           "    [-q <max quads>]: give up after trying this many quads (default 0: no limit)\n"
+           "    [-c <N>]: coarse verification pass over N stars (default 0: off)\n"
+           "    [-C <odds>]: coarse-pass rejection odds (default %g)\n"
+           "    [-R <N>]: reference-star cache entries (default %i; 0: off)\n"
+           "    [-o <stats-file>]: append per-field solver stats, as JSON lines\n"
+           "    [-v]: +verbose (solver log messages)\n"
+           "\n", progname, DEFAULT_COARSE_BAIL_THRESHOLD,
+           DEFAULT_VERIFY_REFCACHE);
+}
+
+typedef struct {
+    unsigned int seed;
+    int nstars;
+    double t_first;
+    double t_total;
+    int numtries;
+} bench_field_t;
+
+struct bench_userdata {
+    double t0;
+    double t_first;
+};
+
+static anbool record_match(MatchObj* mo, void* userdata) {
+    struct bench_userdata* bu = userdata;
+    if (bu->t_first < 0)
+        bu->t_first = timenow() - bu->t0;
+    return TRUE;
+}
+
+// Does the solution agree with the true WCS at the center of the image?
+static anbool solution_is_correct(const MatchObj* mo, const tan_t* truewcs,
+                                  double tolpix) {
+    double ra, dec, x, y;
+    double cx = 0.5 * truewcs->imagew;
+    double cy = 0.5 * truewcs->imageh;
+    tan_pixelxy2radec(&mo->wcstan, cx, cy, &ra, &dec);
+    if (!tan_radec2pixelxy(truewcs, ra, dec, &x, &y))
+        return FALSE;
+    // the synthetic field is 0-indexed; the true WCS is 1-indexed.
+    return (hypot(x - 1.0 - cx, y - 1.0 - cy) < tolpix);
+}
+
+static int compare_bench_tfirst(const void* v1, const void* v2) {
+    const bench_field_t* f1 = v1;
+    const bench_field_t* f2 = v2;
+    return compare_doubles_asc(&f1->t_first, &f2->t_first);
+}
+
+int main(int argc, char** argv) {
+    int argchar;
+    int loglvl = LOG_ERROR;
+    sl* indexfns = sl_new(4);
+    pl* indexes = pl_new(4);
+    int nfields = 200;
+    unsigned int seed0 = 1;
+    synthfield_args_t sargs;
+    int maxquads = 0;
+    int ncoarse = 0;
+    int nrefcache = DEFAULT_VERIFY_REFCACHE;
+    double coarsebail = DEFAULT_COARSE_BAIL_THRESHOLD;
+    char* statsfn = NULL;
+    FILE* statsfid = NULL;
+    solver_t* sp;
+    bl* solved;
+    int i, k;
+    int nsolved = 0, ncorrect = 0;
+    double t_all = 0, t_solved = 0;
+    int64_t tries_all = 0;
+    long maxrss = 0;
+    double t_start;
+
+    synthfield_args_init(&sargs);
+    sargs.W = sargs.H = 1000;
+    sargs.scale_lo = sargs.scale_hi = 0;
+    sargs.distractors = 0.25;
+    sargs.dropout = 0.1;
+    sargs.noise = 1.0;
+    sargs.maxstars = 100;
+
+    while ((argchar = getopt(argc, argv, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'i':
+            sl_append(indexfns, optarg);
+            break;
+        case 'n':
+            nfields = atoi(optarg);
+            break;
+        case 's':
+            seed0 = strtoul(optarg, NULL, 0);
+            break;
+        case 'W':
+            sargs.W = atoi(optarg);
+            break;
+        case 'H':
+            sargs.H = atoi(optarg);
+            break;
+        case 'L':
+            sargs.scale_lo = atof(optarg);
+            break;
+        case 'U':
+            sargs.scale_hi = atof(optarg);
+            break;
+        case 'd':
+            sargs.distractors = atof(optarg);
+            break;
+        case 'D':
+            sargs.dropout = atof(optarg);
+            break;
+        case 'e':
+            sargs.noise = atof(optarg);
+            break;
+        case 'm':
+            sargs.maxstars = atoi(optarg);
+            break;
+        case 'q':
+            maxquads = atoi(optarg);
+            break;
+        case 'c':
+            ncoarse = atoi(optarg);
+            break;
+        case 'R':
+            nrefcache = atoi(optarg);
+            break;
+        case 'C':
+            coarsebail = atof(optarg);
+            break;
+        case 'o':
+            statsfn = optarg;
+            break;
+        case 'v':
+            loglvl++;
+            break;
+        case '?':
+        case 'h':
+        default:
+            printHelp(argv[0]);
+            exit(-1);
+        }
+    if (optind != argc || !sl_size(indexfns) || nfields <= 0) {
+        printHelp(argv[0]);
+        exit(-1);
+    }
+    log_init(loglvl);
+
+    for (i=0; i<sl_size(indexfns); i++) {
+        index_t* index = index_load(sl_get(indexfns, i), 0, NULL);
+        if (!index) {
+            ERROR("Failed to load index \"%s\"", sl_get(indexfns, i));
+            exit(-1);
+        }
+        pl_append(indexes, index);
+    }
+
+    if (sargs.scale_lo == 0) {
+        // By default, make the image diagonal 1.5 times the largest quad
+        // in the first index.
+        index_t* index = pl_get(indexes, 0);
+        sargs.scale_lo = sargs.scale_hi = 1.5 * index->index_scale_upper /
+            hypot(sargs.W, sargs.H);
+    }
+    if (sargs.scale_hi < sargs.scale_lo)
+        sargs.scale_hi = sargs.scale_lo;
+
+    if (statsfn) {
+        statsfid = fopen(statsfn, "a");
+        if (!statsfid) {
+            SYSERROR("Failed to open solver stats file \"%s\"", statsfn);
+            exit(-1);
+        }
+    }
+
+    printf("Benchmark: %i fields (seeds %u to %u), %i x %i pixels, "
+           "%g to %g arcsec/pixel\n", nfields, seed0, seed0 + nfields - 1,
+           sargs.W, sargs.H, sargs.scale_lo, sargs.scale_hi);
+    printf("  distractors %g, dropout %g, noise %g pixels, max stars %i\n",
+           sargs.distractors, sargs.dropout, sargs.noise, sargs.maxstars);
+    printf("%6s %6s %6s %8s %10s %10s %8s\n", "seed", "stars", "solved",
+           "correct", "t_first", "t_total", "quads");
+
+    sp = solver_new();
+    sp->funits_lower = 0.95 * sargs.scale_lo;
+    sp->funits_upper = 1.05 * sargs.scale_hi;
+    sp->maxquads = maxquads;
+    sp->verify_coarse = ncoarse;
+    sp->verify_refcache = nrefcache;
+    sp->logratio_coarse_bail = log(coarsebail);
+    sp->record_match_callback = record_match;
+    solver_set_keep_logodds(sp, log(1e9));
+    sp->logratio_stoplooking = sp->logratio_tokeep;
+    if (statsfid)
+        sp->stats = solver_stats_new();
+    for (i=0; i<pl_size(indexes); i++)
+        solver_add_index(sp, pl_get(indexes, i));
+
+    solved = bl_new(16, sizeof(bench_field_t));
+    t_start = timenow();
+
+    for (k=0; k<nfields; k++) {
+        starxy_t* field;
+        tan_t truewcs;
+        struct bench_userdata bu;
+        bench_field_t bf;
+        anbool correct = FALSE;
+
+        sargs.seed = seed0 + k;
+        field = synthfield_generate(((index_t*)pl_get(indexes, 0))->starkd,
+                                    &sargs, &truewcs);
+        if (!field) {
+            ERROR("Failed to generate field for seed %u", sargs.seed);
+            exit(-1);
+        }
+        bf.seed = sargs.seed;
+        bf.nstars = starxy_n(field);
+
+        solver_set_field(sp, field);
+        solver_set_field_bounds(sp, 0, sargs.W, 0, sargs.H);
+        solver_reset_counters(sp);
+        solver_reset_best_match(sp);
+        if (sp->stats)
+            solver_stats_reset(sp->stats);
+        bu.t_first = -1;
+        sp->userdata = &bu;
+        solver_preprocess_field(sp);
+
+        bu.t0 = timenow();
+        solver_run(sp);
+        bf.t_total = timenow() - bu.t0;
+        bf.t_first = bu.t_first;
+        bf.numtries = sp->numtries;
+
+        if (sp->best_match_solves) {
+            correct = solution_is_correct(&sp->best_match, &truewcs,
+                                          10.0 + 5.0 * sargs.noise);
+            nsolved++;
+            if (correct)
+                ncorrect++;
+            t_solved += bf.t_first;
+            bl_insert_sorted(solved, &bf, compare_bench_tfirst);
+        }
+        t_all += bf.t_total;
+        tries_all += bf.numtries;
+
+        if (sp->best_match_solves)
+            printf("%6u %6i %6s %8s %10.4f %10.4f %8i\n", bf.seed, bf.nstars,
+                   "yes", (correct ? "yes" : "NO"), bf.t_first, bf.t_total,
+                   bf.numtries);
+        else
+            printf("%6u %6i %6s %8s %10s %10.4f %8i\n", bf.seed, bf.nstars,
+                   "no", "-", "-", bf.t_total, bf.numtries);
+
+        if (statsfid) {
+            if (solver_stats_write_json(sp->stats, sp, sargs.seed, statsfid))
+                ERROR("Failed to write solver stats to \"%s\"", statsfn);
+        }
+        if (sp->have_best_match)
+            verify_free_matchobj(&sp->best_match);
+        solver_cleanup_field(sp);
+    }
+
+    get_resource_stats(NULL, NULL, &maxrss);
+
+    printf("\n");
+    printf("Solved:              %i / %i (%.1f %%), %i correct\n",
+           nsolved, nfields, 100.0 * nsolved / nfields, ncorrect);
+    if (nsolved) {
+        bench_field_t* f;
+        f = bl_access(solved, bl_size(solved) / 2);
+        printf("Time to first solve: mean %.4f s, median %.4f s\n",
+               t_solved / nsolved, f->t_first);
+    }
+    printf("Solver time:         total %.3f s, mean %.4f s per field\n",
+           t_all, t_all / nfields);
+    printf("Quads tried:         total %lld, mean %.1f per field\n",
+           (long long)tries_all, (double)tries_all / nfields);
+    printf("Wall time:           %.3f s (including field generation)\n",
+           timenow() - t_start);
+    printf("Peak RSS:            %.1f MB\n", maxrss / 1024.0);
+
+    bl_free(solved);
+    solver_stats_free(sp->stats);
+    sp->stats = NULL;
+    solver_free(sp);
+    if (statsfid && fclose(statsfid))
+        SYSERROR("Failed to close solver stats file \"%s\"", statsfn);
+    for (i=0; i<pl_size(indexes); i++)
+        index_free(pl_get(indexes, i));
+    pl_free(indexes);
+    sl_free2(indexfns);
+    return 0;
+}
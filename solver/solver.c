@@ -141,6 +141,7 @@ void solver_tweak2(solver_t* sp, MatchObj* mo, int order, sip_t* verifysip) {
     int nm, nc, nd;
     int besti;
     int startorder;
+    SOLVER_STATS_START(sp->stats, tstart);
 
     indexjitter = mo->index_jitter; // ref cat positional error, in arcsec.
     xy = starxy_to_xy_array(sp->fieldxy, NULL);
@@ -220,6 +221,7 @@ void solver_tweak2(solver_t* sp, MatchObj* mo, int order, sip_t* verifysip) {
         matchobj_compute_derived(mo);
     }
     free(xy);
+    SOLVER_STATS_STOP(sp->stats, SOLVER_STAGE_TWEAK, tstart);
 }
 
 void solver_log_params(const solver_t* sp) {
@@ -235,6 +237,8 @@ void solver_log_params(const solver_t* sp) {
         xyzarr2radecdeg(sp->centerxyz, &ra, &dec);
         rad = distsq2deg(sp->r2);
         logverb("  Use_radec? yes, (%g, %g), radius %g deg\n", ra, dec, rad);
+        logverb("  RA,Dec quad subset: up to %g of each index\n",
+                sp->radec_quad_subset);
     } else {
         logverb("  Use_radec? no\n");
     }
@@ -351,6 +355,38 @@ static void update_timeused(solver_t* sp) {
         sp->timeused = 0.0;
 }
 
+// Per-index bookkeeping for solver->stats.
+typedef struct {
+    uint64_t t0;
+    int numtries;
+    int nummatches;
+    int num_verified;
+} index_probe_t;
+
+static inline void index_probe_start(const solver_t* sp, index_probe_t* p) {
+#if AN_SOLVER_STATS
+    p->t0 = (sp->stats ? solver_stats_ticks() : 0);
+    p->numtries = sp->numtries;
+    p->nummatches = sp->nummatches;
+    p->num_verified = sp->num_verified;
+#endif
+}
+
+static inline void index_probe_stop(solver_t* sp, const index_probe_t* p) {
+#if AN_SOLVER_STATS
+    solver_index_stats_t* ist;
+    if (likely(!sp->stats))
+        return;
+    ist = solver_stats_get_index(sp->stats, sp->index, sp->index->indexname);
+    if (!ist)
+        return;
+    ist->ticks += solver_stats_ticks() - p->t0;
+    ist->ntries += sp->numtries - p->numtries;
+    ist->nmatches += sp->nummatches - p->nummatches;
+    ist->nverified += sp->num_verified - p->num_verified;
+#endif
+}
+
 static void set_matchobj_template(solver_t* solver, MatchObj* mo) {
     if (solver->mo_template)
         memcpy(mo, solver->mo_template, sizeof(MatchObj));
@@ -421,6 +457,115 @@ static void set_index(solver_t* s, index_t* index) {
     s->rel_index_noise2 = square(index->index_jitter / index->index_scale_lower);
 }
 
+// Builds a code tree from the quads inside the RA,Dec circle, or
+// returns NULL if there are too many of them for it to pay off.
+static kdtree_t* build_quad_subset(solver_t* solver, index_t* index,
+                                   int** pquads) {
+    quadmap_t* qm;
+    il* quads;
+    kdtree_t* kd = NULL;
+    double* codes;
+    int i, N, D;
+
+    qm = index_get_quadmap(index);
+    if (!qm)
+        return NULL;
+    quads = il_new(1024);
+    N = quadmap_search(qm, index->quads, index->starkd, solver->centerxyz,
+                       solver->r2, quads);
+    logverb("Index %s: %i of %i quads are within the RA,Dec circle\n",
+            index->indexname, N, index->nquads);
+    if (N == 0 || N > solver->radec_quad_subset * index->nquads) {
+        il_free(quads);
+        return NULL;
+    }
+    D = index_get_code_dim(index);
+    codes = malloc((size_t)N * D * sizeof(double));
+    *pquads = malloc(N * sizeof(int));
+    for (i=0; i<N; i++) {
+        (*pquads)[i] = il_get(quads, i);
+        codetree_get(index->codekd, (*pquads)[i], codes + (size_t)i * D);
+    }
+    il_free(quads);
+    // try_permutations() searches with KD_OPTIONS_USE_SPLIT.
+    kd = kdtree_build(NULL, codes, N, D, 8, KDTT_DOUBLE, KD_BUILD_SPLIT);
+    if (!kd) {
+        ERROR("Failed to build code tree of the quads in the RA,Dec circle");
+        free(codes);
+        free(*pquads);
+        *pquads = NULL;
+        return NULL;
+    }
+    kd->free_data = TRUE;
+    return kd;
+}
+
+static void free_quad_subsets(solver_t* solver) {
+    int i;
+    if (!solver->subset_codekd)
+        return;
+    for (i=0; i<solver->subset_nindexes; i++) {
+        kdtree_free(solver->subset_codekd[i]);
+        free(solver->subset_quads[i]);
+    }
+    free(solver->subset_codekd);
+    free(solver->subset_quads);
+    free(solver->subset_indexes);
+    solver->subset_codekd = NULL;
+    solver->subset_quads = NULL;
+    solver->subset_indexes = NULL;
+    solver->subset_nindexes = 0;
+    solver->cur_subset_codekd = NULL;
+    solver->cur_subset_quads = NULL;
+}
+
+// Were the quad subsets built for the current RA,Dec circle and indexes?
+static anbool quad_subsets_current(const solver_t* solver) {
+    int i;
+    if (!solver->subset_codekd ||
+        solver->subset_nindexes != (int)pl_size(solver->indexes) ||
+        solver->subset_r2 != solver->r2 ||
+        solver->subset_frac != solver->radec_quad_subset)
+        return FALSE;
+    for (i=0; i<3; i++)
+        if (solver->subset_centerxyz[i] != solver->centerxyz[i])
+            return FALSE;
+    for (i=0; i<solver->subset_nindexes; i++)
+        if (solver->subset_indexes[i] != pl_get(solver->indexes, i))
+            return FALSE;
+    return TRUE;
+}
+
+static void build_quad_subsets(solver_t* solver) {
+    size_t i, N = pl_size(solver->indexes);
+    if (quad_subsets_current(solver)) {
+        logverb("Reusing the quad subsets for this RA,Dec circle\n");
+        return;
+    }
+    free_quad_subsets(solver);
+    solver->subset_codekd = calloc(N, sizeof(kdtree_t*));
+    solver->subset_quads = calloc(N, sizeof(int*));
+    solver->subset_indexes = malloc(N * sizeof(index_t*));
+    solver->subset_nindexes = N;
+    memcpy(solver->subset_centerxyz, solver->centerxyz, 3 * sizeof(double));
+    solver->subset_r2 = solver->r2;
+    solver->subset_frac = solver->radec_quad_subset;
+    for (i=0; i<N; i++) {
+        solver->subset_indexes[i] = pl_get(solver->indexes, i);
+        solver->subset_codekd[i] = build_quad_subset
+            (solver, solver->subset_indexes[i], solver->subset_quads + i);
+    }
+}
+
+// set_index() for index number "i" of the solver's list.
+static void set_solver_index(solver_t* s, int i) {
+    set_index(s, pl_get(s->indexes, i));
+    if (s->subset_codekd) {
+        s->cur_subset_codekd = s->subset_codekd[i];
+        s->cur_subset_quads = s->subset_quads[i];
+    }
+}
+
 static void set_diag(solver_t* s) {
     s->field_diag = hypot(solver_field_width(s), solver_field_height(s));
 }
@@ -659,14 +804,10 @@ void solver_preprocess_field(solver_t* solver) {
     } else if (solver->predistort) {
         logverb("Applying undistortion to %i stars\n", starxy_n(solver->fieldxy_orig));
         // Apply the *un*distortion
-        for (i=0; i<starxy_n(solver->fieldxy); i++) {
-            double dx, dy;
-            sip_pixel_undistortion(solver->predistort,
-                                   solver->fieldxy->x[i], solver->fieldxy->y[i],
-                                   &dx, &dy);
-            solver->fieldxy->x[i] = dx;
-            solver->fieldxy->y[i] = dy;
-        }
+        sip_pixel_undistortion_array(solver->predistort,
+                                     solver->fieldxy->x, solver->fieldxy->y,
+                                     starxy_n(solver->fieldxy),
+                                     solver->fieldxy->x, solver->fieldxy->y);
     }
 
     find_field_boundaries(solver);
@@ -675,6 +816,11 @@ void solver_preprocess_field(solver_t* solver) {
 
     solver->vf->do_uniformize = solver->verify_uniformize;
     solver->vf->do_dedup = solver->verify_dedup;
+    solver->vf->coarse_n = solver->verify_coarse;
+    solver->vf->coarse_logbail = solver->logratio_coarse_bail;
+    solver->vf->stats = solver->stats;
+    if (solver->verify_refcache > 0)
+        solver->vf->refcache = refcache_new(solver->verify_refcache);
 
     if (solver->set_crpix && solver->set_crpix_center) {
         solver->crpix[0] = wcs_pixel_center_for_size(solver_field_width(solver));
@@ -795,6 +941,7 @@ void solver_run(solver_t* solver) {
 
     num_indexes = pl_size(solver->indexes);
     {
+        SOLVER_STATS_START(solver->stats, trun);
         double minAB2s[num_indexes];
         double maxAB2s[num_indexes];
         solver->minminAB2 = HUGE_VAL;
@@ -836,6 +983,11 @@ void solver_run(solver_t* solver) {
          MIN(M_PI, arcsec2rad(field_diag * solver->funits_upper)) ...
          */
 
+        if (solver->use_radec && solver->radec_quad_subset > 0)
+            build_quad_subsets(solver);
+        else
+            free_quad_subsets(solver);
+
         pquads = calloc(numxy * numxy, sizeof(pquad));
 
         /* We maintain an array of "potential quads" (pquad) structs, where
@@ -951,8 +1103,10 @@ void solver_run(solver_t* solver) {
             for (i = 0; i < num_indexes; i++) {
                 index_t* index = pl_get(solver->indexes, i);
                 int dimquads;
-                set_index(solver, index);
+                index_probe_t probe;
+                set_solver_index(solver, i);
                 dimquads = index_dimquads(index);
+                index_probe_start(solver, &probe);
                 for (field[A] = 0; field[A] < newpoint; field[A]++) {
                     // initialize the "pquad" struct for this AB combo.
                     pquad* pq = pquads + field[B] * numxy + field[A];
@@ -968,8 +1122,11 @@ void solver_run(solver_t* solver) {
                     // ("dimquads - 2" because we've set stars A and B at this point)
                     add_stars(pq, field, C, dimquads-2, 0, newpoint, dimquads, solver, tol2);
                     if (solver->quit_now)
-                        goto quitnow;
+                        break;
                 }
+                index_probe_stop(solver, &probe);
+                if (solver->quit_now)
+                    goto quitnow;
             }
 
             if (solver->quit_now)
@@ -1004,21 +1161,24 @@ void solver_run(solver_t* solver) {
 
                     for (i = 0; i < pl_size(solver->indexes); i++) {
                         int dimquads;
+                        index_probe_t probe;
                         index_t* index = pl_get(solver->indexes, i);
                         if ((pq->scale < minAB2s[i]) ||
                             (pq->scale > maxAB2s[i]))
                             continue;
-                        set_index(solver, index);
+                        set_solver_index(solver, i);
                         dimquads = index_dimquads(index);
 
                         tol2 = get_tolerance(solver);
 
+                        index_probe_start(solver, &probe);
                         if (dimquads > 3) {
                             // ("dimquads - 3" because we've set stars A, B, and C at this point)
                             add_stars(pq, field, D, dimquads-3, 0, newpoint, dimquads, solver, tol2);
                         } else {
                             TRY_ALL_CODES(pq, field, dimquads, solver, tol2);
                         }
+                        index_probe_stop(solver, &probe);
                         if (solver->quit_now)
                             goto quitnow;
                     }
@@ -1040,6 +1200,7 @@ void solver_run(solver_t* solver) {
             free(pq->xy);
         }
         free(pquads);
+        SOLVER_STATS_STOP(solver->stats, SOLVER_STAGE_RUN, trun);
     }
 }
 
@@ -1112,6 +1273,8 @@ static void try_all_codes_2(const int* fieldstars, int dimquad,
     stars[0] = fieldstars[0];
     stars[1] = fieldstars[1];
 
+    SOLVER_STATS_START(solver->stats, tperm);
+
     for (i=0; i<DQMAX; i++)
         placed[i] = FALSE;
 
@@ -1135,6 +1298,7 @@ static void try_all_codes_2(const int* fieldstars, int dimquad,
 
  bailout:
     kdtree_free_query(result);
+    SOLVER_STATS_STOP(solver->stats, SOLVER_STAGE_PERMUTATIONS, tperm);
 }
 
 /**
@@ -1241,20 +1405,32 @@ static void try_permutations(const int* origstars, int dimquad,
 #endif
 				
             // Search with the code we've built.
-            *presult = kdtree_rangesearch_options_reuse
-                (solver->index->codekd->tree, *presult, code, tol2, options);
+            SOLVER_STATS_START(solver->stats, tkd);
+            if (solver->cur_subset_codekd) {
+                int j;
+                *presult = kdtree_rangesearch_options_reuse
+                    (solver->cur_subset_codekd, *presult, code, tol2, options);
+                for (j=0; j<(*presult)->nres; j++)
+                    (*presult)->inds[j] = solver->cur_subset_quads[(*presult)->inds[j]];
+            } else
+                *presult = kdtree_rangesearch_options_reuse
+                    (solver->index->codekd->tree, *presult, code, tol2, options);
+            SOLVER_STATS_STOP(solver->stats, SOLVER_STAGE_CODEKD, tkd);
+            SOLVER_STATS_HIST(solver->stats, codekd_nres, (*presult)->nres);
             //debug("      trying ABCD = [%i %i %i %i]: %i results.\n",
             //fstars[A], fstars[B], fstars[C], fstars[D], result->nres);
 
             if ((*presult)->nres) {
                 double pixvals[DQMAX*2];
                 int j;
+                SOLVER_STATS_START(solver->stats, tres);
                 for (j=0; j<dimquad; j++) {
                     setx(pixvals, j, field_getx(solver, stars[j]));
                     sety(pixvals, j, field_gety(solver, stars[j]));
                 }
                 resolve_matches(*presult, pixvals, stars, dimquad, solver,
                                 current_parity);
+                SOLVER_STATS_STOP(solver->stats, SOLVER_STAGE_RESOLVE, tres);
             }
             if (unlikely(solver->quit_now))
                 return;
@@ -1385,12 +1561,16 @@ static int solver_handle_hit(solver_t* sp, MatchObj* mo, sip_t* verifysip,
 
     logaccept = MIN(sp->logratio_tokeep, sp->logratio_totune);
 
-    verify_hit(sp->index->starkd, sp->index->cutnside,
-               mo, verifysip, sp->vf, match_distance_in_pixels2,
-               sp->distractor_ratio, sp->field_maxx, sp->field_maxy,
-               sp->logratio_bail_threshold, logaccept,
-               sp->logratio_stoplooking,
-               sp->distance_from_quad_bonus, fake_match);
+    {
+        SOLVER_STATS_START(sp->stats, tver);
+        verify_hit(sp->index->starkd, sp->index->cutnside,
+                   mo, verifysip, sp->vf, match_distance_in_pixels2,
+                   sp->distractor_ratio, sp->field_maxx, sp->field_maxy,
+                   sp->logratio_bail_threshold, logaccept,
+                   sp->logratio_stoplooking,
+                   sp->distance_from_quad_bonus, fake_match);
+        SOLVER_STATS_STOP(sp->stats, SOLVER_STAGE_VERIFY, tver);
+    }
     mo->nverified = sp->num_verified++;
 
     if (mo->logodds >= sp->best_logodds) {
@@ -1650,18 +1830,23 @@ void solver_set_default_values(solver_t* solver) {
     solver->verify_pix = DEFAULT_VERIFY_PIX;
     solver->verify_uniformize = TRUE;
     solver->verify_dedup = TRUE;
+    solver->logratio_coarse_bail = log(DEFAULT_COARSE_BAIL_THRESHOLD);
+    solver->verify_refcache = DEFAULT_VERIFY_REFCACHE;
+    solver->radec_quad_subset = DEFAULT_RADEC_QUAD_SUBSET;
     solver->distance_from_quad_bonus = TRUE;
     solver->tweak_aborder = DEFAULT_TWEAK_ABORDER;
     solver->tweak_abporder = DEFAULT_TWEAK_ABPORDER;
 }
 
 void solver_clear_indexes(solver_t* solver) {
+    free_quad_subsets(solver);
     pl_remove_all(solver->indexes);
     solver->index = NULL;
 }
 
 void solver_cleanup(solver_t* solver) {
     solver_free_field(solver);
+    free_quad_subsets(solver);
     pl_free(solver->indexes);
     solver->indexes = NULL;
     if (solver->have_best_match) {
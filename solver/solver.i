@@ -18,6 +18,8 @@
 
 #include "os-features.h"
 #include "verify.h"
+#include "solver-batch.h"
+#include "index.h"
 %}
 
 %init %{
@@ -111,3 +113,277 @@ static PyObject* verify_star_lists_np(PyObject* pyrefxy,
  }
 
  %}
+
+
+%inline %{
+
+// Converts "obj" (a sequence of N array-likes) to contiguous double
+// arrays, appended to "arrs" (new references).  Returns 0 on success.
+static int batch_get_arrays(PyObject* obj, Py_ssize_t N, const char* name,
+                            PyObject* arrs) {
+    int req = NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED |
+        NPY_ARRAY_NOTSWAPPED | NPY_ARRAY_ELEMENTSTRIDES;
+    Py_ssize_t i;
+    if (!PySequence_Check(obj) || PySequence_Size(obj) != N) {
+        PyErr_Format(PyExc_ValueError, "Expected %s to be a list of %zd arrays",
+                     name, N);
+        return -1;
+    }
+    for (i=0; i<N; i++) {
+        PyObject* item = PySequence_GetItem(obj, i);
+        PyObject* arr;
+        if (!item)
+            return -1;
+        arr = PyArray_FromAny(item, PyArray_DescrFromType(NPY_DOUBLE),
+                              1, 1, req, NULL);
+        Py_DECREF(item);
+        if (!arr) {
+            PyErr_Format(PyExc_ValueError,
+                         "Expected %s[%zd] to be a 1-d double array", name, i);
+            return -1;
+        }
+        PyList_Append(arrs, arr);
+        Py_DECREF(arr);
+    }
+    return 0;
+}
+
+static PyObject* batch_array(const void* data, int n, int ncols, int type) {
+    npy_intp dims[2];
+    PyObject* arr;
+    dims[0] = n;
+    dims[1] = ncols;
+    arr = PyArray_SimpleNew(ncols > 1 ? 2 : 1, dims, type);
+    if (arr && n)
+        memcpy(PyArray_DATA((PyArrayObject*)arr), data,
+               (size_t)n * ncols * PyArray_ITEMSIZE((PyArrayObject*)arr));
+    return arr;
+}
+
+/*
+ Solves fields given as numpy arrays against loaded indexes (see
+ solver-batch.h); solve_fields() below is the friendlier interface.
+
+ xs, ys: lists of 1-d arrays; fluxes: a list of arrays or None; Ws, Hs:
+ lists of ints; ras, decs, radii: lists of floats (radius <= 0 for no
+ RA,Dec constraint); indexes: a list of index_t (from index_load()).
+
+ Returns a list with, for each field, None or a tuple (sip_t,
+ logodds, position in "indexes", match_field, match_radec,
+ match_refid, match_weight).  The solving happens without the GIL.
+ */
+static PyObject* solve_fields_np(PyObject* xs, PyObject* ys,
+                                 PyObject* fluxes,
+                                 PyObject* Ws, PyObject* Hs,
+                                 PyObject* ras, PyObject* decs,
+                                 PyObject* radii,
+                                 PyObject* pyindexes,
+                                 double scale_lo, double scale_hi,
+                                 int parity, double logodds_solve,
+                                 int maxquads, int tweak_order,
+                                 int crpix_center, int nthreads) {
+    swig_type_info* index_type = SWIG_TypeQuery("index_t *");
+    swig_type_info* sip_type = SWIG_TypeQuery("sip_t *");
+    solver_batch_args_t args;
+    solver_batch_field_t* fields = NULL;
+    index_t** indexes = NULL;
+    PyObject* arrs = NULL;
+    PyObject* results = NULL;
+    Py_ssize_t i, j, N, NI;
+    int rtn;
+
+    if (!PySequence_Check(xs) || !PySequence_Check(pyindexes)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Expected lists of x arrays and of indexes");
+        return NULL;
+    }
+    N = PySequence_Size(xs);
+    NI = PySequence_Size(pyindexes);
+    if (!PyList_Check(Ws) || !PyList_Check(Hs) || !PyList_Check(ras) ||
+        !PyList_Check(decs) || !PyList_Check(radii) ||
+        PyList_Size(Ws) != N || PyList_Size(Hs) != N ||
+        PyList_Size(ras) != N || PyList_Size(decs) != N ||
+        PyList_Size(radii) != N) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Expected Ws, Hs, ras, decs, radii to be lists with "
+                        "one element per field");
+        return NULL;
+    }
+
+    indexes = calloc(NI ? NI : 1, sizeof(index_t*));
+    for (j=0; j<NI; j++) {
+        PyObject* item = PySequence_GetItem(pyindexes, j);
+        void* ptr = NULL;
+        int ok = (item && SWIG_IsOK(SWIG_ConvertPtr(item, &ptr, index_type, 0)));
+        Py_XDECREF(item);
+        if (!ok || !ptr) {
+            PyErr_Format(PyExc_ValueError, "indexes[%zd] is not an index_t", j);
+            goto bailout;
+        }
+        indexes[j] = ptr;
+    }
+
+    // xs, ys, [fluxes]: arrs[i], arrs[N+i], [arrs[2N+i]]
+    arrs = PyList_New(0);
+    if (batch_get_arrays(xs, N, "xs", arrs) ||
+        batch_get_arrays(ys, N, "ys", arrs) ||
+        (fluxes != Py_None && batch_get_arrays(fluxes, N, "fluxes", arrs)))
+        goto bailout;
+
+    fields = calloc(N ? N : 1, sizeof(solver_batch_field_t));
+    for (i=0; i<N; i++) {
+        solver_batch_field_t* f = fields + i;
+        PyArrayObject* x = (PyArrayObject*)PyList_GET_ITEM(arrs, i);
+        PyArrayObject* y = (PyArrayObject*)PyList_GET_ITEM(arrs, N + i);
+        f->N = (int)PyArray_DIM(x, 0);
+        if (PyArray_DIM(y, 0) != f->N) {
+            PyErr_Format(PyExc_ValueError,
+                         "Field %zd: x and y have different lengths", i);
+            goto bailout;
+        }
+        f->x = PyArray_DATA(x);
+        f->y = PyArray_DATA(y);
+        if (fluxes != Py_None) {
+            PyArrayObject* fl = (PyArrayObject*)PyList_GET_ITEM(arrs, 2*N + i);
+            if (PyArray_DIM(fl, 0) != f->N) {
+                PyErr_Format(PyExc_ValueError,
+                             "Field %zd: x and flux have different lengths", i);
+                goto bailout;
+            }
+            f->flux = PyArray_DATA(fl);
+        }
+        f->W = (int)PyLong_AsLong(PyList_GET_ITEM(Ws, i));
+        f->H = (int)PyLong_AsLong(PyList_GET_ITEM(Hs, i));
+        f->radius = PyFloat_AsDouble(PyList_GET_ITEM(radii, i));
+        if (f->radius > 0) {
+            f->use_radec = TRUE;
+            f->ra  = PyFloat_AsDouble(PyList_GET_ITEM(ras, i));
+            f->dec = PyFloat_AsDouble(PyList_GET_ITEM(decs, i));
+        }
+        if (PyErr_Occurred())
+            goto bailout;
+    }
+
+    solver_batch_args_init(&args);
+    args.scale_lo = scale_lo;
+    args.scale_hi = scale_hi;
+    args.parity = parity;
+    args.logodds_solve = logodds_solve;
+    args.maxquads = maxquads;
+    args.tweak_order = tweak_order;
+    args.crpix_center = crpix_center;
+    args.nthreads = nthreads;
+
+    Py_BEGIN_ALLOW_THREADS
+    rtn = solver_batch_run(&args, indexes, (int)NI, fields, (int)N);
+    Py_END_ALLOW_THREADS
+    if (rtn) {
+        PyErr_SetString(PyExc_ValueError, "solver_batch_run() failed");
+        goto bailout;
+    }
+
+    results = PyList_New(N);
+    for (i=0; i<N; i++) {
+        solver_batch_field_t* f = fields + i;
+        sip_t* sip;
+        if (!f->solved) {
+            Py_INCREF(Py_None);
+            PyList_SET_ITEM(results, i, Py_None);
+            continue;
+        }
+        for (j=0; j<NI; j++)
+            if (indexes[j] == f->index)
+                break;
+        sip = malloc(sizeof(sip_t));
+        memcpy(sip, &f->wcs, sizeof(sip_t));
+        PyList_SET_ITEM(results, i, Py_BuildValue
+                        ("(NdnNNNN)",
+                         SWIG_NewPointerObj(sip, sip_type, SWIG_POINTER_OWN),
+                         f->logodds, j,
+                         batch_array(f->match_field,  f->nmatch, 1, NPY_INT),
+                         batch_array(f->match_radec,  f->nmatch, 2, NPY_DOUBLE),
+                         batch_array(f->match_refid,  f->nmatch, 1, NPY_INT),
+                         batch_array(f->match_weight, f->nmatch, 1, NPY_DOUBLE)));
+    }
+
+ bailout:
+    if (fields) {
+        for (i=0; i<N; i++)
+            solver_batch_field_free(fields + i);
+        free(fields);
+    }
+    free(indexes);
+    Py_XDECREF(arrs);
+    return results;
+}
+
+ %}
+
+%pythoncode %{
+def solve_fields(xs, ys, indexes, fluxes=None, W=0, H=0,
+                 scale_lo=None, scale_hi=None, radec=None,
+                 parity=2, logodds=None, maxquads=0, tweak_order=2,
+                 crpix_center=False, nthreads=1):
+    '''
+    Solves many fields, in "nthreads" threads, without touching the
+    filesystem (and without holding the GIL while solving).
+
+    xs, ys: lists of arrays of star positions (pixels), one per field.
+    indexes: list of index_t, eg, from astrometry.util.util.index_load().
+    fluxes: optional list of arrays; stars are tried brightest first.
+    W, H: image size (an int, or a list with one per field); 0 for the
+      bounds of the stars.
+    scale_lo, scale_hi: pixel scale range, arcsec/pixel.
+    radec: optional (ra, dec, radius) in degrees, or a list of them (or
+      None) per field, to restrict the search.
+    parity: 0 normal, 1 flipped, 2 (default) both.
+    logodds: log-odds to accept a solution; default log(1e9).
+    tweak_order: SIP order of the solution; 0 or 1 for TAN.
+
+    Returns a list with, for each field, None if it didn't solve, or a
+    dict with keys:
+      wcs: sip_t; logodds; index: the index_t that solved it;
+      match_field: indices into xs[i], ys[i] of the matched stars;
+      match_radec: (nmatch, 2) RA,Dec of the matched reference stars;
+      match_refid: rows of the reference stars in the index's star tree;
+      match_weight: weight of each match in [0, 1].
+    '''
+    import math
+    N = len(xs)
+    def per_field(v):
+        if isinstance(v, (list, tuple)):
+            assert(len(v) == N)
+            return list(v)
+        return [v] * N
+    if scale_lo is None or scale_hi is None:
+        raise ValueError('solve_fields: scale_lo and scale_hi are required')
+    Ws = [int(w) for w in per_field(W)]
+    Hs = [int(h) for h in per_field(H)]
+    if radec is not None and len(radec) == 3 and not isinstance(
+            radec[0], (list, tuple, type(None))):
+        radec = [radec] * N
+    if radec is None:
+        radec = [None] * N
+    ras   = [float(r[0]) if r is not None else 0. for r in radec]
+    decs  = [float(r[1]) if r is not None else 0. for r in radec]
+    radii = [float(r[2]) if r is not None else 0. for r in radec]
+    if logodds is None:
+        logodds = math.log(1e9)
+    indexes = list(indexes)
+    res = solve_fields_np(list(xs), list(ys),
+                          list(fluxes) if fluxes is not None else None,
+                          Ws, Hs, ras, decs, radii, indexes,
+                          float(scale_lo), float(scale_hi), int(parity),
+                          float(logodds), int(maxquads), int(tweak_order),
+                          int(bool(crpix_center)), int(nthreads))
+    out = []
+    for r in res:
+        if r is None:
+            out.append(None)
+            continue
+        (wcs, lo, ii, mf, mrd, mid, mw) = r
+        out.append(dict(wcs=wcs, logodds=lo, index=indexes[ii],
+                        match_field=mf, match_radec=mrd, match_refid=mid,
+                        match_weight=mw))
+    return out
+%}
@@ -0,0 +1,205 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "os-features.h"
+#include "solverstats.h"
+#include "solver.h"
+#include "tic.h"
+#include "qfits_float.h"
+#include "ioutils.h"
+#include "errors.h"
+
+static const char* stage_names[SOLVER_STAGE_N] = {
+    "solver_run",
+    "try_permutations",
+    "codekd_search",
+    "resolve_matches",
+    "verify_hit",
+    "startree_search",
+    "tweak2",
+};
+
+const char* solver_stats_stage_name(int stage) {
+    if (stage < 0 || stage >= SOLVER_STAGE_N)
+        return NULL;
+    return stage_names[stage];
+}
+
+solver_stats_t* solver_stats_new(void) {
+    solver_stats_t* st = calloc(1, sizeof(solver_stats_t));
+    if (!st) {
+        SYSERROR("Failed to allocate solver_stats_t");
+        return NULL;
+    }
+    st->tick0 = solver_stats_ticks();
+    st->wall0 = timenow();
+    return st;
+}
+
+void solver_stats_reset(solver_stats_t* st) {
+    int i;
+    memset(st->ticks, 0, sizeof(st->ticks));
+    memset(st->calls, 0, sizeof(st->calls));
+    memset(st->codekd_nres, 0, sizeof(st->codekd_nres));
+    memset(st->starkd_nres, 0, sizeof(st->starkd_nres));
+    memset(st->verify_bail, 0, sizeof(st->verify_bail));
+    st->verify_nobail = 0;
+    st->verify_coarse_rejected = 0;
+    st->refcache_hits = 0;
+    st->refcache_misses = 0;
+    for (i=0; i<st->nindexes; i++)
+        free(st->indexes[i].name);
+    st->nindexes = 0;
+}
+
+void solver_stats_free(solver_stats_t* st) {
+    if (!st)
+        return;
+    solver_stats_reset(st);
+    free(st->indexes);
+    free(st);
+}
+
+void solver_stats_add_hist(int64_t* hist, int64_t val) {
+    int bin = 0;
+    while (val > 0 && bin < SOLVER_STATS_NBINS-1) {
+        val >>= 1;
+        bin++;
+    }
+    hist[bin]++;
+}
+
+solver_index_stats_t* solver_stats_get_index(solver_stats_t* st,
+                                             const void* index,
+                                             const char* name) {
+    int i;
+    solver_index_stats_t* ist;
+    // search from the end: the current index is almost always the
+    // most recently added one.
+    for (i=st->nindexes-1; i>=0; i--)
+        if (st->indexes[i].index == index)
+            return st->indexes + i;
+    if (st->nindexes == st->indexcap) {
+        int newcap = MAX(8, st->indexcap * 2);
+        solver_index_stats_t* newarr = realloc(st->indexes, newcap * sizeof(solver_index_stats_t));
+        if (!newarr) {
+            SYSERROR("Failed to grow solver stats index array to %i", newcap);
+            return NULL;
+        }
+        st->indexes = newarr;
+        st->indexcap = newcap;
+    }
+    ist = st->indexes + st->nindexes;
+    st->nindexes++;
+    memset(ist, 0, sizeof(solver_index_stats_t));
+    ist->index = index;
+    ist->name = strdup_safe(name);
+    return ist;
+}
+
+double solver_stats_ticks_per_second(const solver_stats_t* st) {
+    double dt = timenow() - st->wall0;
+    uint64_t dticks = solver_stats_ticks() - st->tick0;
+    if (dt <= 0.0)
+        return 0.0;
+    return (double)dticks / dt;
+}
+
+static void write_json_string(FILE* fid, const char* s) {
+    fputc('"', fid);
+    for (; s && *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(fid, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fid, "\\u%04x", c);
+        else
+            fputc(c, fid);
+    }
+    fputc('"', fid);
+}
+
+// JSON has no inf or nan; they are written as null.  (isfinite() can't
+// be trusted with -ffinite-math-only.)
+static void write_json_double(FILE* fid, double x) {
+    if (qfits_isnan(x) || qfits_isinf(x))
+        fprintf(fid, "null");
+    else
+        fprintf(fid, "%g", x);
+}
+
+static void write_json_hist(FILE* fid, const char* name, const int64_t* hist) {
+    int i, N;
+    // trim trailing empty bins.
+    for (N=SOLVER_STATS_NBINS; N>0; N--)
+        if (hist[N-1])
+            break;
+    fprintf(fid, "\"%s\": [", name);
+    for (i=0; i<N; i++)
+        fprintf(fid, "%s%lld", (i ? ", " : ""), (long long)hist[i]);
+    fprintf(fid, "]");
+}
+
+int solver_stats_write_json(const solver_stats_t* st, const solver_t* sp,
+                            int fieldnum, FILE* fid) {
+    int i;
+    double tps = solver_stats_ticks_per_second(st);
+    double spt = (tps > 0 ? 1.0 / tps : 0.0);
+
+    fprintf(fid, "{\"field\": %i, ", fieldnum);
+    fprintf(fid, "\"solved\": %s, ", (sp->best_match_solves ? "true" : "false"));
+    fprintf(fid, "\"best_logodds\": ");
+    write_json_double(fid, sp->best_logodds);
+    fprintf(fid, ", \"ticks_per_second\": ");
+    write_json_double(fid, tps);
+    fprintf(fid, ", ");
+    fprintf(fid, "\"counters\": {\"numtries\": %i, \"nummatches\": %i, "
+            "\"numscaleok\": %i, \"num_cxdx_skipped\": %i, "
+            "\"num_meanx_skipped\": %i, \"num_radec_skipped\": %i, "
+            "\"num_abscale_skipped\": %i, \"num_verified\": %i, "
+            "\"last_examined_object\": %i}, ",
+            sp->numtries, sp->nummatches, sp->numscaleok,
+            sp->num_cxdx_skipped, sp->num_meanx_skipped,
+            sp->num_radec_skipped, sp->num_abscale_skipped,
+            sp->num_verified, sp->last_examined_object);
+
+    fprintf(fid, "\"stages\": {");
+    for (i=0; i<SOLVER_STAGE_N; i++)
+        fprintf(fid, "%s\"%s\": {\"calls\": %lld, \"ticks\": %llu, \"seconds\": %g}",
+                (i ? ", " : ""), stage_names[i], (long long)st->calls[i],
+                (unsigned long long)st->ticks[i], st->ticks[i] * spt);
+    fprintf(fid, "}, ");
+
+    write_json_hist(fid, "codekd_nres_log2", st->codekd_nres);
+    fprintf(fid, ", ");
+    write_json_hist(fid, "startree_nres_log2", st->starkd_nres);
+    fprintf(fid, ", ");
+    write_json_hist(fid, "verify_bail_depth_log2", st->verify_bail);
+    fprintf(fid, ", \"verify_nobail\": %lld, \"verify_coarse_rejected\": %lld, ",
+            (long long)st->verify_nobail, (long long)st->verify_coarse_rejected);
+    fprintf(fid, "\"refcache_hits\": %lld, \"refcache_misses\": %lld, ",
+            (long long)st->refcache_hits, (long long)st->refcache_misses);
+
+    fprintf(fid, "\"indexes\": [");
+    for (i=0; i<st->nindexes; i++) {
+        const solver_index_stats_t* ist = st->indexes + i;
+        fprintf(fid, "%s{\"name\": ", (i ? ", " : ""));
+        write_json_string(fid, ist->name);
+        fprintf(fid, ", \"seconds\": %g, \"ntries\": %lld, \"nmatches\": %lld, "
+                "\"nverified\": %lld}", ist->ticks * spt,
+                (long long)ist->ntries, (long long)ist->nmatches,
+                (long long)ist->nverified);
+    }
+    fprintf(fid, "]}\n");
+
+    if (ferror(fid)) {
+        SYSERROR("Failed to write solver stats");
+        return -1;
+    }
+    return 0;
+}
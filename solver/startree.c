@@ -2,6 +2,7 @@
  # This file is part of the Astrometry.net suite.
  # Licensed under a 3-clause BSD style license - see LICENSE
  */
+#include <limits.h>
 #include <assert.h>
 #include "startree.h"
 #include "kdtree.h"
@@ -143,6 +144,14 @@ startree_t* startree_build(fitstable_t* intable,
     if (!Nleaf)
         Nleaf = 25;
 
+    // The kd-tree (and its on-disk format) indexes stars with "int".
+    if (fitstable_nrows64(intable) > INT_MAX) {
+        ERROR("Catalog has %lld stars; a star kd-tree can hold at most %i.  "
+              "Run uniformize-catalog (or hpsplit) on it first.",
+              (long long)fitstable_nrows64(intable), INT_MAX);
+        return NULL;
+    }
+
     ra = fitstable_read_column(intable, racol, TFITS_BIN_TYPE_D);
     if (!ra) {
         ERROR("Failed to read RA from column %s", racol);
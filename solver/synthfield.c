@@ -0,0 +1,172 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "os-features.h"
+#include "synthfield.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "permutedsort.h"
+#include "log.h"
+#include "errors.h"
+
+void synthfield_args_init(synthfield_args_t* args) {
+    memset(args, 0, sizeof(synthfield_args_t));
+    args->W = 1024;
+    args->H = 1024;
+    args->scale_lo = 1.0;
+    args->scale_hi = 1.0;
+    args->flip = TRUE;
+    args->maxstars = 0;
+    args->seed = 1;
+}
+
+static void random_center(const synthfield_args_t* args, unsigned int* rng,
+                          double* ra, double* dec) {
+    tan_t t;
+    double d, b, r;
+    if (args->radius <= 0) {
+        // uniform on the sphere: sin(dec) is uniform.
+        *ra = uniform_sample_r(rng, 0, 360.0);
+        *dec = rad2deg(asin(uniform_sample_r(rng, -1.0, 1.0)));
+        return;
+    }
+    // uniform over the spherical cap: cos(d) is uniform.
+    d = acos(uniform_sample_r(rng, cos(deg2rad(args->radius)), 1.0));
+    b = uniform_sample_r(rng, 0, 2.0*M_PI);
+    r = rad2deg(tan(d));
+    // unit-scale TAN projection: "pixels" are intermediate world
+    // coordinates in degrees.
+    memset(&t, 0, sizeof(tan_t));
+    t.crval[0] = args->ra;
+    t.crval[1] = args->dec;
+    t.cd[0][0] = t.cd[1][1] = 1.0;
+    tan_pixelxy2radec(&t, r * sin(b), r * cos(b), ra, dec);
+}
+
+static int compare_sweep_id(const void* v1, const void* v2) {
+    const int* s1 = v1;
+    const int* s2 = v2;
+    if (s1[0] != s2[0])
+        return (s1[0] < s2[0]) ? -1 : 1;
+    if (s1[1] != s2[1])
+        return (s1[1] < s2[1]) ? -1 : 1;
+    return 0;
+}
+
+starxy_t* synthfield_generate(startree_t* skdt,
+                              const synthfield_args_t* args,
+                              tan_t* p_wcs) {
+    tan_t wcs;
+    double scale, theta, radius;
+    double *radec = NULL;
+    int *inds = NULL;
+    int *sweeps = NULL;
+    int *perm = NULL;
+    double *xy = NULL;
+    int N, Nreal, Nfake, Ntotal;
+    int i;
+    starxy_t* field = NULL;
+    double parity;
+    unsigned int rng = args->seed;
+
+    if (args->W <= 0 || args->H <= 0 ||
+        args->scale_lo <= 0 || args->scale_hi < args->scale_lo) {
+        ERROR("Invalid synthetic field size or scale range");
+        return NULL;
+    }
+
+    memset(&wcs, 0, sizeof(tan_t));
+    random_center(args, &rng, wcs.crval+0, wcs.crval+1);
+    wcs.crpix[0] = 0.5 + 0.5 * args->W;
+    wcs.crpix[1] = 0.5 + 0.5 * args->H;
+    scale = uniform_sample_r(&rng, args->scale_lo, args->scale_hi) / 3600.0;
+    theta = uniform_sample_r(&rng, 0, 2.0*M_PI);
+    parity = ((args->flip && uniform_sample_r(&rng, 0, 1) < 0.5) ? -1.0 : 1.0);
+    wcs.cd[0][0] = -scale * cos(theta);
+    wcs.cd[0][1] =  scale * sin(theta) * parity;
+    wcs.cd[1][0] =  scale * sin(theta);
+    wcs.cd[1][1] =  scale * cos(theta) * parity;
+    wcs.imagew = args->W;
+    wcs.imageh = args->H;
+
+    radius = 1.01 * hypot(args->W, args->H) * 0.5 * scale;
+    startree_search_for_radec(skdt, wcs.crval[0], wcs.crval[1], radius,
+                              NULL, &radec, &inds, &N);
+
+    // Order the stars the way the index builder did: by sweep, then
+    // by star id.  Trees without sweep numbers fall back to star id.
+    sweeps = malloc(MAX(N,1) * sizeof(int) * 2);
+    for (i=0; i<N; i++) {
+        sweeps[2*i+0] = startree_get_sweep(skdt, inds[i]);
+        sweeps[2*i+1] = inds[i];
+    }
+    perm = permuted_sort(sweeps, 2*sizeof(int), compare_sweep_id, NULL, N);
+
+    // Project, keeping the stars that land in the image and survive
+    // the dropout.
+    xy = malloc(MAX(N,1) * 2 * sizeof(double));
+    Nreal = 0;
+    for (i=0; i<N; i++) {
+        int k = perm[i];
+        double x, y;
+        if (!tan_radec2pixelxy(&wcs, radec[2*k], radec[2*k+1], &x, &y))
+            continue;
+        // FITS pixel coordinates are 1-indexed; the field is [0, W) x [0, H).
+        x -= 1.0;
+        y -= 1.0;
+        if (x < 0 || y < 0 || x >= args->W || y >= args->H)
+            continue;
+        if (args->dropout > 0 && uniform_sample_r(&rng, 0, 1) < args->dropout)
+            continue;
+        if (args->noise > 0) {
+            x += gaussian_sample_r(&rng, 0, args->noise);
+            y += gaussian_sample_r(&rng, 0, args->noise);
+        }
+        xy[2*Nreal+0] = x;
+        xy[2*Nreal+1] = y;
+        Nreal++;
+    }
+    free(radec);
+    free(inds);
+    free(sweeps);
+    free(perm);
+
+    Nfake = (int)floor(args->distractors * Nreal + 0.5);
+    Ntotal = Nreal + Nfake;
+    field = starxy_new(Ntotal, TRUE, FALSE);
+    if (!field) {
+        ERROR("Failed to allocate synthetic field");
+        free(xy);
+        return NULL;
+    }
+    for (i=0; i<Nreal; i++) {
+        starxy_set(field, i, xy[2*i], xy[2*i+1]);
+        starxy_set_flux(field, i, (double)(Ntotal - i));
+    }
+    free(xy);
+    for (i=0; i<Nfake; i++) {
+        int j = Nreal + i;
+        starxy_set(field, j, uniform_sample_r(&rng, 0, args->W),
+                   uniform_sample_r(&rng, 0, args->H));
+        // a random rank among the real stars; the half offset avoids ties.
+        starxy_set_flux(field, j, 0.5 + floor(uniform_sample_r(&rng, 0, Ntotal)));
+    }
+    starxy_sort_by_flux(field);
+
+    if (args->maxstars && field->N > args->maxstars)
+        field->N = args->maxstars;
+
+    debug("Synthetic field (seed %u): center (%g, %g), scale %g arcsec/pix, "
+          "%i real + %i distractor stars\n", args->seed, wcs.crval[0],
+          wcs.crval[1], scale * 3600.0, Nreal, Nfake);
+
+    if (p_wcs)
+        memcpy(p_wcs, &wcs, sizeof(tan_t));
+    return field;
+}
@@ -0,0 +1,89 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_depths(CuTest*);
+extern void test_sorting(CuTest*);
+extern void test_tweak_1(CuTest*);
+extern void test_tweak_2(CuTest*);
+extern void test_tchebytweak(CuTest*);
+extern void test_solve_multiindex(CuTest*);
+extern void test_predistort(CuTest*);
+extern void test_synthfield_repeatable(CuTest*);
+extern void test_synthfield_solves(CuTest*);
+extern void test_synthfield_coarse_verify(CuTest*);
+extern void test_solver_threads(CuTest*);
+extern void test_refcache_matches_search(CuTest*);
+extern void test_refcache_one_off_no_evict(CuTest*);
+extern void test_index_profile_roundtrip(CuTest*);
+extern void test_index_schedule_order(CuTest*);
+extern void test_quadmap_search(CuTest*);
+extern void test_quadmap_threads(CuTest*);
+extern void test_quadmap_in_index_file(CuTest*);
+extern void test_quadmap_stale_in_index_file(CuTest*);
+extern void test_tracking_sequence(CuTest*);
+extern void test_solver_batch(CuTest*);
+extern void test_solver_batch_radec_threads(CuTest*);
+extern void test_index_load_policies(CuTest*);
+extern void test_engine_quantum_tail(CuTest*);
+extern void test_engine_schedule_history(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_depths);
+    SUITE_ADD_TEST(suite, test_sorting);
+    SUITE_ADD_TEST(suite, test_tweak_1);
+    SUITE_ADD_TEST(suite, test_tweak_2);
+    SUITE_ADD_TEST(suite, test_tchebytweak);
+    SUITE_ADD_TEST(suite, test_solve_multiindex);
+    SUITE_ADD_TEST(suite, test_predistort);
+    SUITE_ADD_TEST(suite, test_synthfield_repeatable);
+    SUITE_ADD_TEST(suite, test_synthfield_solves);
+    SUITE_ADD_TEST(suite, test_synthfield_coarse_verify);
+    SUITE_ADD_TEST(suite, test_solver_threads);
+    SUITE_ADD_TEST(suite, test_refcache_matches_search);
+    SUITE_ADD_TEST(suite, test_refcache_one_off_no_evict);
+    SUITE_ADD_TEST(suite, test_index_profile_roundtrip);
+    SUITE_ADD_TEST(suite, test_index_schedule_order);
+    SUITE_ADD_TEST(suite, test_quadmap_search);
+    SUITE_ADD_TEST(suite, test_quadmap_threads);
+    SUITE_ADD_TEST(suite, test_quadmap_in_index_file);
+    SUITE_ADD_TEST(suite, test_quadmap_stale_in_index_file);
+    SUITE_ADD_TEST(suite, test_tracking_sequence);
+    SUITE_ADD_TEST(suite, test_solver_batch);
+    SUITE_ADD_TEST(suite, test_solver_batch_radec_threads);
+    SUITE_ADD_TEST(suite, test_index_load_policies);
+    SUITE_ADD_TEST(suite, test_engine_quantum_tail);
+    SUITE_ADD_TEST(suite, test_engine_schedule_history);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
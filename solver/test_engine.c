@@ -0,0 +1,175 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cutest.h"
+#include "engine.h"
+#include "synthfield.h"
+#include "xylist.h"
+#include "fitsioutils.h"
+#include "index.h"
+#include "ioutils.h"
+#include "log.h"
+
+// Bright stars far outside the image, too far from each other and from
+// the real stars to make quads with, ahead of the real ones.
+#define NJUNK 260
+
+static void count_solved(const MatchObj* mo, void* userdata) {
+    int* nsolved = userdata;
+    (*nsolved)++;
+}
+
+// Writes a job file whose real stars start at NJUNK+1.
+static char* write_job(index_t* index) {
+    synthfield_args_t args;
+    starxy_t* xy;
+    starxy_t* fld;
+    xylist_t* ls;
+    qfits_header* hdr;
+    tan_t truth;
+    char* fn;
+    int i, N;
+
+    synthfield_args_init(&args);
+    args.W = args.H = 1000;
+    args.scale_lo = args.scale_hi = 90.0;
+    args.maxstars = 40;
+    args.seed = 3;
+    xy = synthfield_generate(index->starkd, &args, &truth);
+    if (!xy)
+        return NULL;
+    N = starxy_n(xy);
+    fld = starxy_new(NJUNK + N, TRUE, FALSE);
+    for (i=0; i<NJUNK; i++) {
+        starxy_set(fld, i, 1e6 * (i + 1), 1e6);
+        starxy_set_flux(fld, i, 1e6 - i);
+    }
+    for (i=0; i<N; i++) {
+        starxy_set(fld, NJUNK + i, starxy_getx(xy, i), starxy_gety(xy, i));
+        starxy_set_flux(fld, NJUNK + i, starxy_get_flux(xy, i));
+    }
+    starxy_free(xy);
+
+    fn = create_temp_file("test_engine", "/tmp");
+    ls = xylist_open_for_writing(fn);
+    xylist_set_include_flux(ls, TRUE);
+    hdr = xylist_get_primary_header(ls);
+    fits_header_add_int(hdr, "IMAGEW", args.W, NULL);
+    fits_header_add_int(hdr, "IMAGEH", args.H, NULL);
+    qfits_header_add(hdr, "ANRUN", "T", NULL, NULL);
+    fits_header_add_double(hdr, "ANAPPL1", 0.95 * 90.0, NULL);
+    fits_header_add_double(hdr, "ANAPPU1", 1.05 * 90.0, NULL);
+    qfits_header_add(hdr, "ANTWEAK", "F", NULL, NULL);
+    if (xylist_write_primary_header(ls) ||
+        xylist_write_header(ls) ||
+        xylist_write_field(ls, fld) ||
+        xylist_fix_header(ls) ||
+        xylist_close(ls)) {
+        free(fn);
+        fn = NULL;
+    }
+    starxy_free(fld);
+    return fn;
+}
+
+static int run_job(engine_t* engine, const char* fn) {
+    job_t* job;
+    int nsolved = 0;
+    job = engine_read_job_file(engine, fn);
+    if (!job)
+        return -1;
+    // one open-ended range.
+    il_remove_all(job->depths);
+    il_append(job->depths, 1);
+    il_append(job->depths, 0);
+    job->bp.field_solved = count_solved;
+    job->bp.field_solved_userdata = &nsolved;
+    engine_run_job(engine, job);
+    job_free(job);
+    return nsolved;
+}
+
+// With a small quantum, the quantums end before the real stars; the
+// open-ended range after them must still reach them.
+void test_engine_quantum_tail(CuTest* ct) {
+    engine_t* engine;
+    index_t* index;
+    char* fn;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    fn = write_job(index);
+    CuAssertPtrNotNull(ct, fn);
+    index_free(index);
+
+    engine = engine_new();
+    CuAssertIntEquals(ct, 0, engine_add_index(engine, "index-9918.fits"));
+    // without quantums...
+    CuAssertIntEquals(ct, 1, run_job(engine, fn));
+    // ... and with quantums that only cover stars 1 to 255.
+    engine->quantum = 1;
+    CuAssertIntEquals(ct, 1, run_job(engine, fn));
+    engine_free(engine);
+
+    unlink(fn);
+    free(fn);
+}
+
+// With quantums, each index runs once per quantum; its history must
+// still count one run per job.
+void test_engine_schedule_history(CuTest* ct) {
+    engine_t* engine;
+    index_t* index;
+    char* fn;
+    char* histfn;
+    char line[256];
+    FILE* f;
+    int id, hp, nlines = 0;
+    long long runs = 0, solved = 0;
+    double cputime;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    fn = write_job(index);
+    CuAssertPtrNotNull(ct, fn);
+    index_free(index);
+    histfn = create_temp_file("test_engine_history", "/tmp");
+    unlink(histfn);
+
+    engine = engine_new();
+    CuAssertIntEquals(ct, 0, engine_add_index(engine, "index-9918.fits"));
+    engine->schedule = index_schedule_new();
+    CuAssertIntEquals(ct, 0, index_schedule_load_history(engine->schedule,
+                                                         histfn));
+    engine->quantum = 1;
+    CuAssertIntEquals(ct, 1, run_job(engine, fn));
+    CuAssertIntEquals(ct, 1, run_job(engine, fn));
+    engine_free(engine);
+
+    f = fopen(histfn, "r");
+    CuAssertPtrNotNull(ct, f);
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#')
+            continue;
+        CuAssertIntEquals(ct, 5, sscanf(line, "%i %i %lld %lld %lf", &id, &hp,
+                                        &runs, &solved, &cputime));
+        nlines++;
+    }
+    fclose(f);
+    CuAssertIntEquals(ct, 1, nlines);
+    CuAssertIntEquals(ct, 2, (int)runs);
+    CuAssertIntEquals(ct, 2, (int)solved);
+
+    unlink(histfn);
+    free(histfn);
+    unlink(fn);
+    free(fn);
+}
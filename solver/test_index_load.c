@@ -0,0 +1,72 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <string.h>
+
+#include "cutest.h"
+#include "index.h"
+#include "quadfile.h"
+#include "codekd.h"
+#include "starkd.h"
+#include "starutil.h"
+#include "fitsbin.h"
+#include "log.h"
+
+static index_t* load(int policy) {
+    index_t* index;
+    fitsbin_set_map_policy(policy);
+    index = index_load("index-9918.fits", 0, NULL);
+    fitsbin_set_map_policy(FITSBIN_MAP_LAZY);
+    return index;
+}
+
+// Every mapping policy gives the same tables.
+void test_index_load_policies(CuTest* ct) {
+    index_t* lazy;
+    int policy, i;
+
+    log_init(LOG_ERROR);
+    CuAssertIntEquals(ct, FITSBIN_MAP_LAZY, fitsbin_get_map_policy());
+    lazy = load(FITSBIN_MAP_LAZY);
+    CuAssertPtrNotNull(ct, lazy);
+    CuAssertIntEquals(ct, 0, index_check(lazy));
+
+    for (policy=FITSBIN_MAP_POPULATE; policy<=FITSBIN_MAP_PRELOAD; policy++) {
+        index_t* index = load(policy);
+        fitsbin_t* fbs[3], *lazyfbs[3];
+        int f;
+        CuAssertPtrNotNull(ct, index);
+        CuAssertIntEquals(ct, 0, index_check(index));
+        CuAssertIntEquals(ct, index_nquads(lazy), index_nquads(index));
+        CuAssertIntEquals(ct, index_nstars(lazy), index_nstars(index));
+
+        fbs[0] = index->quads->fb;
+        fbs[1] = index->codekd->tree->io;
+        fbs[2] = index->starkd->tree->io;
+        lazyfbs[0] = lazy->quads->fb;
+        lazyfbs[1] = lazy->codekd->tree->io;
+        lazyfbs[2] = lazy->starkd->tree->io;
+        for (f=0; f<3; f++) {
+            CuAssertIntEquals(ct, fitsbin_n_chunks(lazyfbs[f]),
+                              fitsbin_n_chunks(fbs[f]));
+            for (i=0; i<fitsbin_n_chunks(fbs[f]); i++) {
+                fitsbin_chunk_t* c1 = fitsbin_get_chunk(lazyfbs[f], i);
+                fitsbin_chunk_t* c2 = fitsbin_get_chunk(fbs[f], i);
+                CuAssertIntEquals(ct, c1->nrows, c2->nrows);
+                CuAssertIntEquals(ct, c1->itemsize, c2->itemsize);
+                CuAssertIntEquals(ct, 0, memcmp(c1->data, c2->data,
+                                                (size_t)c1->nrows * c1->itemsize));
+            }
+        }
+        // still usable once the file is closed
+        if (policy == FITSBIN_MAP_PRELOAD) {
+            unsigned int stars[DQMAX];
+            CuAssertIntEquals(ct, 0, index_close_fds(index));
+            CuAssertIntEquals(ct, 0, quadfile_get_stars(index->quads, 0, stars));
+            CuAssertIntEquals(ct, 0, index_check(index));
+        }
+        index_free(index);
+    }
+    index_free(lazy);
+}
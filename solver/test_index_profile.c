@@ -0,0 +1,64 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cutest.h"
+#include "index-profile.h"
+#include "index.h"
+#include "ioutils.h"
+#include "log.h"
+
+void test_index_profile_roundtrip(CuTest* ct) {
+    index_t* index;
+    index_profile_t prof;
+    index_profile_t* profs;
+    const index_profile_t* p;
+    double tols[] = { 0.005, 0.01, 0.02 };
+    char* fn;
+    int N, t;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    CuAssertIntEquals(ct, 0, index_profile_compute(index, tols, 3, 200, 0,
+                                                   &prof));
+    CuAssertIntEquals(ct, index->nquads, prof.nquads);
+    CuAssertIntEquals(ct, 3, prof.ntols);
+    CuAssert(ct, "leaves", prof.ck_nleaves > 0);
+    CuAssert(ct, "leaf sizes", prof.leaf_min <= prof.leaf_mean &&
+             prof.leaf_mean <= prof.leaf_max);
+    CuAssert(ct, "quad cells", prof.qhp_ncells > 0 &&
+             prof.qhp_mean * prof.qhp_ncells > index->nquads - 0.5);
+    for (t=0; t<3; t++) {
+        // each query finds at least the quad it was made from.
+        CuAssert(ct, "results", prof.nresults[t] >= 1.0);
+        CuAssert(ct, "pages", prof.npages[t] >= 2.0);
+        if (t)
+            CuAssert(ct, "monotonic",
+                     prof.nresults[t] >= prof.nresults[t-1]);
+    }
+
+    fn = create_temp_file("test_index_profile", NULL);
+    CuAssertIntEquals(ct, 0, index_profile_write(fn, &prof, 1));
+    profs = index_profile_read(fn, &N);
+    CuAssertPtrNotNull(ct, profs);
+    CuAssertIntEquals(ct, 1, N);
+    p = index_profile_find(profs, N, index->indexid, index->healpix);
+    CuAssertPtrNotNull(ct, p);
+    CuAssertStrEquals(ct, prof.indexname, p->indexname);
+    CuAssertIntEquals(ct, prof.nquads, p->nquads);
+    CuAssertIntEquals(ct, prof.qhp_max, p->qhp_max);
+    for (t=0; t<3; t++) {
+        CuAssertDblEquals(ct, prof.codetol[t], p->codetol[t], 0.0);
+        CuAssertDblEquals(ct, prof.nresults[t], p->nresults[t], 0.0);
+    }
+    CuAssertPtrEquals(ct, NULL, (void*)index_profile_find(profs, N, -1, 0));
+    free(profs);
+    unlink(fn);
+    free(fn);
+    index_free(index);
+}
@@ -0,0 +1,72 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cutest.h"
+#include "index-schedule.h"
+#include "index.h"
+#include "ioutils.h"
+#include "bl.h"
+
+static void fake_index(index_t* ind, int id, double lo, double hi) {
+    memset(ind, 0, sizeof(index_t));
+    ind->indexid = id;
+    ind->healpix = -1;
+    ind->index_scale_lower = lo;
+    ind->index_scale_upper = hi;
+}
+
+void test_index_schedule_order(CuTest* ct) {
+    index_schedule_t* s;
+    index_t inds[3];
+    pl* indexes = pl_new(4);
+    il* lst = il_new(4);
+    char* fn;
+    int i;
+
+    // field quads from 100 to 1000 arcsec.
+    fake_index(inds + 0, 1, 10, 120);
+    fake_index(inds + 1, 2, 100, 1000);
+    fake_index(inds + 2, 3, 60, 300);
+    for (i=0; i<3; i++) {
+        pl_append(indexes, inds + i);
+        il_append(lst, i);
+    }
+    s = index_schedule_new();
+    fn = create_temp_file("test_index_schedule", NULL);
+    // an empty file is a valid (empty) history.
+    CuAssertIntEquals(ct, 0, index_schedule_load_history(s, fn));
+
+    // By scale fit: the index covering the whole range first.
+    index_schedule_order(s, indexes, lst, 100, 1000, 0.01, FALSE);
+    CuAssertIntEquals(ct, 1, il_get(lst, 0));
+    CuAssertIntEquals(ct, 2, il_get(lst, 1));
+    CuAssertIntEquals(ct, 0, il_get(lst, 2));
+
+    // Index 3 keeps solving quickly, index 2 keeps failing.
+    for (i=0; i<10; i++) {
+        index_schedule_record(s, inds + 2, 0.1, TRUE);
+        index_schedule_record(s, inds + 1, 1.0, FALSE);
+    }
+    CuAssertIntEquals(ct, 0, index_schedule_save_history(s));
+    index_schedule_free(s);
+
+    // ... and the history persists.
+    s = index_schedule_new();
+    CuAssertIntEquals(ct, 0, index_schedule_load_history(s, fn));
+    index_schedule_order(s, indexes, lst, 100, 1000, 0.01, FALSE);
+    CuAssertIntEquals(ct, 2, il_get(lst, 0));
+    CuAssert(ct, "cost", index_schedule_cost(s, inds + 2, 100, 1000, 0.01, FALSE) <
+             index_schedule_cost(s, inds + 1, 100, 1000, 0.01, FALSE));
+    index_schedule_free(s);
+
+    unlink(fn);
+    free(fn);
+    il_free(lst);
+    pl_free(indexes);
+}
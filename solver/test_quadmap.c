@@ -0,0 +1,190 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "cutest.h"
+#include "quadmap.h"
+#include "index.h"
+#include "merge-index.h"
+#include "ioutils.h"
+#include "fitsioutils.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "bl.h"
+#include "log.h"
+
+static anbool quad_in_circle(index_t* index, int quad, const double* xyz,
+                             double r2) {
+    unsigned int stars[DQMAX];
+    int i;
+    quadfile_get_stars(index->quads, quad, stars);
+    for (i=0; i<index->dimquads; i++) {
+        double sxyz[3];
+        startree_get(index->starkd, stars[i], sxyz);
+        if (distsq(sxyz, xyz, 3) > r2)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void test_quadmap_search(CuTest* ct) {
+    index_t* index;
+    quadmap_t* qm;
+    double radii[] = { 0.5, 1.0, 3.0 };
+    int c, r, i;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    qm = index_get_quadmap(index);
+    CuAssertPtrNotNull(ct, qm);
+    CuAssertIntEquals(ct, index->nquads, qm->nquads);
+    // cached
+    CuAssertPtrEquals(ct, qm, index_get_quadmap(index));
+
+    // circles centered on a few of the stars, checked against all quads.
+    for (c=0; c<5; c++) {
+        double xyz[3];
+        startree_get(index->starkd, c * (index->nstars / 5), xyz);
+        for (r=0; r<sizeof(radii)/sizeof(double); r++) {
+            double r2 = deg2distsq(radii[r]);
+            il* quads = il_new(256);
+            il* brute = il_new(256);
+            int N;
+            N = quadmap_search(qm, index->quads, index->starkd, xyz, r2,
+                               quads);
+            CuAssertIntEquals(ct, il_size(quads), N);
+            for (i=0; i<index->nquads; i++)
+                if (quad_in_circle(index, i, xyz, r2))
+                    il_append(brute, i);
+            CuAssertIntEquals(ct, il_size(brute), N);
+            il_sort(quads, TRUE);
+            for (i=0; i<N; i++)
+                CuAssertIntEquals(ct, il_get(brute, i), il_get(quads, i));
+            il_free(quads);
+            il_free(brute);
+        }
+    }
+    index_free(index);
+}
+
+static void* get_quadmap_thread(void* v) {
+    return index_get_quadmap(v);
+}
+
+void test_quadmap_threads(CuTest* ct) {
+    index_t* index;
+    pthread_t threads[8];
+    void* qms[8];
+    int i;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    // threads sharing the index all get the one map.
+    for (i=0; i<8; i++)
+        CuAssertIntEquals(ct, 0, pthread_create(threads + i, NULL,
+                                                get_quadmap_thread, index));
+    for (i=0; i<8; i++)
+        CuAssertIntEquals(ct, 0, pthread_join(threads[i], qms + i));
+    CuAssertPtrNotNull(ct, qms[0]);
+    for (i=0; i<8; i++)
+        CuAssertPtrEquals(ct, qms[0], qms[i]);
+    CuAssertPtrEquals(ct, qms[0], index->quadmap);
+    index_free(index);
+}
+
+void test_quadmap_in_index_file(CuTest* ct) {
+    index_t* index;
+    quadmap_t* built;
+    quadmap_t* qm;
+    char* fn;
+
+    log_init(LOG_MSG);
+    fn = create_temp_file("test_quadmap", NULL);
+    CuAssertIntEquals(ct, 0, copy_file("index-9918.fits", fn));
+    index = index_load(fn, 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    // no map in the file: built in memory.
+    built = index_get_quadmap(index);
+    CuAssertPtrNotNull(ct, built);
+    CuAssertPtrEquals(ct, NULL, built->fb);
+    CuAssertIntEquals(ct, 0, merge_index_add_quadmap(index->quads,
+                                                     index->starkd, fn));
+
+    index_free(index);
+
+    // now it's read (mmap()ed) from the file, and is the same map.
+    index = index_load(fn, 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    qm = index_get_quadmap(index);
+    CuAssertPtrNotNull(ct, qm);
+    CuAssertPtrNotNull(ct, qm->fb);
+    built = quadmap_build(index->quads, index->starkd, qm->nside);
+    CuAssertIntEquals(ct, built->nquads, qm->nquads);
+    CuAssertIntEquals(ct, built->ncells, qm->ncells);
+    CuAssert(ct, "cells", memcmp(built->cells, qm->cells, (qm->ncells + 1) *
+                                 sizeof(quadmap_cell_t)) == 0);
+    CuAssert(ct, "quads", memcmp(built->quads, qm->quads,
+                                 qm->nquads * sizeof(int32_t)) == 0);
+    quadmap_free(built);
+    index_free(index);
+    unlink(fn);
+    free(fn);
+}
+
+void test_quadmap_stale_in_index_file(CuTest* ct) {
+    index_t* index;
+    quadmap_t* qm;
+    FILE* fid;
+    char* fn;
+    int N;
+
+    log_init(LOG_MSG);
+    fn = create_temp_file("test_quadmap", NULL);
+    CuAssertIntEquals(ct, 0, copy_file("index-9918.fits", fn));
+    index = index_load(fn, 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    N = index->nquads;
+    qm = quadmap_build(index->quads, index->starkd,
+                       quadmap_nside_for_scale(index->index_scale_upper));
+    CuAssertPtrNotNull(ct, qm);
+    CuAssertIntEquals(ct, 0, quadmap_check(qm, N));
+    CuAssertIntEquals(ct, -1, quadmap_check(qm, N - 1));
+
+    // a map that is missing a quad, as if the index had been rebuilt
+    // with one more.
+    qm->nquads--;
+    qm->cells[qm->ncells].start--;
+    if (qm->cells[qm->ncells - 1].start == qm->nquads) {
+        qm->cells[qm->ncells - 1] = qm->cells[qm->ncells];
+        qm->ncells--;
+    }
+    CuAssertIntEquals(ct, -1, quadmap_check(qm, N));
+    fid = fopen(fn, "r+b");
+    CuAssertPtrNotNull(ct, fid);
+    CuAssertIntEquals(ct, 0, fseeko(fid, 0, SEEK_END));
+    CuAssertIntEquals(ct, 0, quadmap_append_to(qm, fid));
+    CuAssertIntEquals(ct, 0, fits_pad_file(fid));
+    CuAssertIntEquals(ct, 0, fclose(fid));
+    quadmap_free(qm);
+    index_free(index);
+
+    // the stale map is ignored and a good one built.
+    index = index_load(fn, 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    qm = index_get_quadmap(index);
+    CuAssertPtrNotNull(ct, qm);
+    CuAssertPtrEquals(ct, NULL, qm->fb);
+    CuAssertIntEquals(ct, N, qm->nquads);
+    CuAssertIntEquals(ct, 0, quadmap_check(qm, N));
+    index_free(index);
+    unlink(fn);
+    free(fn);
+}
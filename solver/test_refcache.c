@@ -0,0 +1,111 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "refcache.h"
+#include "index.h"
+#include "starkd.h"
+#include "starutil.h"
+#include "log.h"
+#include "permutedsort.h"
+
+static void check_query(CuTest* ct, refcache_t* rc, const startree_t* skdt,
+                        const double* xyz, double r2) {
+    double *xyz1, *xyz2;
+    int *ids1, *ids2;
+    int64_t* keys;
+    int* perm;
+    int i, N1, N2;
+
+    startree_search_for(skdt, xyz, r2, &xyz1, NULL, &ids1, &N1);
+    refcache_search(rc, skdt, xyz, r2, &xyz2, &ids2, &N2);
+    CuAssertIntEquals(ct, N1, N2);
+    if (!N1)
+        return;
+    // the cache returns the stars sorted by sweep, then id.
+    keys = malloc(N1 * sizeof(int64_t));
+    for (i=0; i<N1; i++)
+        keys[i] = ((int64_t)skdt->sweep[ids1[i]] << 32) | ids1[i];
+    perm = permuted_sort(keys, sizeof(int64_t), compare_int64_asc, NULL, N1);
+    for (i=0; i<N1; i++) {
+        int j = perm[i];
+        CuAssertIntEquals(ct, ids1[j], ids2[i]);
+        CuAssertDblEquals(ct, xyz1[3*j+0], xyz2[3*i+0], 0.0);
+        CuAssertDblEquals(ct, xyz1[3*j+1], xyz2[3*i+1], 0.0);
+        CuAssertDblEquals(ct, xyz1[3*j+2], xyz2[3*i+2], 0.0);
+    }
+    free(keys);
+    free(perm);
+    free(xyz1);
+    free(ids1);
+    free(xyz2);
+    free(ids2);
+}
+
+void test_refcache_matches_search(CuTest* ct) {
+    index_t* index;
+    refcache_t* rc;
+    int64_t hits, misses;
+    int i, j;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    rc = refcache_new(4);
+    srand(42);
+    for (i=0; i<50; i++) {
+        double ra = 360.0 * rand() / (double)RAND_MAX;
+        double dec = asin(2.0 * rand() / (double)RAND_MAX - 1.0) * 180.0 / M_PI;
+        double rad = deg2rad(5.0 + 20.0 * rand() / (double)RAND_MAX);
+        // several jittered queries around each position, as for
+        // repeated verifications of nearby hypotheses.
+        for (j=0; j<5; j++) {
+            double xyz[3];
+            double dr = 0.1 * rand() / (double)RAND_MAX;
+            radecdeg2xyzarr(ra + dr, dec - dr, xyz);
+            check_query(ct, rc, index->starkd, xyz,
+                        rad2distsq(rad * (1.0 + 0.01 * j)));
+        }
+    }
+    refcache_get_stats(rc, &hits, &misses);
+    CuAssertIntEquals(ct, 250, (int)(hits + misses));
+    CuAssert(ct, "cache hits", hits > 0);
+    refcache_free(rc);
+    index_free(index);
+}
+
+void test_refcache_one_off_no_evict(CuTest* ct) {
+    index_t* index;
+    refcache_t* rc;
+    double xyz[3];
+    int i, N;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    rc = refcache_new(2);
+    radecdeg2xyzarr(100.0, 20.0, xyz);
+    // a cell is only cached once it has been missed twice.
+    CuAssertIntEquals(ct, 0, refcache_search(rc, index->starkd, xyz,
+                                             deg2distsq(10.0), NULL, NULL, &N));
+    CuAssertIntEquals(ct, 0, refcache_search(rc, index->starkd, xyz,
+                                             deg2distsq(10.0), NULL, NULL, &N));
+    CuAssertIntEquals(ct, 1, refcache_search(rc, index->starkd, xyz,
+                                             deg2distsq(10.0), NULL, NULL, &N));
+    // one-off queries in other cells don't evict it.
+    for (i=0; i<20; i++) {
+        double xyz2[3];
+        radecdeg2xyzarr(10.0 * i, -30.0, xyz2);
+        CuAssertIntEquals(ct, 0, refcache_search(rc, index->starkd, xyz2,
+                                                 deg2distsq(1.0), NULL, NULL, &N));
+    }
+    CuAssertIntEquals(ct, 1, refcache_search(rc, index->starkd, xyz,
+                                             deg2distsq(10.0), NULL, NULL, &N));
+    refcache_free(rc);
+    index_free(index);
+}
@@ -0,0 +1,257 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "solver-batch.h"
+#include "solver.h"
+#include "onefield.h"
+#include "verify.h"
+#include "permutedsort.h"
+#include "synthfield.h"
+#include "index.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "log.h"
+
+#define NFIELDS 8
+
+// Fields are given faintest-first, with fluxes, so the matches must be
+// mapped back through the flux sort.
+static void make_fields(index_t* index, solver_batch_field_t* fields,
+                        double* xs, double* ys, double* fluxes, tan_t* truth,
+                        int maxstars) {
+    int i, j;
+    for (i=0; i<NFIELDS; i++) {
+        synthfield_args_t args;
+        starxy_t* xy;
+        int N;
+        synthfield_args_init(&args);
+        args.W = args.H = 1000;
+        args.scale_lo = args.scale_hi = 90.0;
+        args.distractors = 0.25;
+        args.dropout = 0.1;
+        args.noise = 1.0;
+        args.maxstars = maxstars;
+        args.seed = i + 1;
+        xy = synthfield_generate(index->starkd, &args, truth + i);
+        N = starxy_n(xy);
+        for (j=0; j<N; j++) {
+            xs    [i*maxstars + j] = starxy_getx(xy, N-1-j);
+            ys    [i*maxstars + j] = starxy_gety(xy, N-1-j);
+            fluxes[i*maxstars + j] = starxy_get_flux(xy, N-1-j);
+        }
+        solver_batch_field_init(fields + i);
+        fields[i].x = xs + i*maxstars;
+        fields[i].y = ys + i*maxstars;
+        fields[i].flux = fluxes + i*maxstars;
+        fields[i].N = N;
+        fields[i].W = args.W;
+        fields[i].H = args.H;
+        starxy_free(xy);
+    }
+}
+
+// Solves "f" with a solver_t set up as the batch does, and counts the
+// field stars the best match has a reference star for; those beyond the
+// match's "nbest" go in "nbeyond".
+static int count_matches(index_t* index, const solver_batch_args_t* args,
+                         const solver_batch_field_t* f, int* nbeyond) {
+    solver_t* sp = solver_new();
+    starxy_t* xy;
+    int* perm;
+    int i, n = -1;
+
+    sp->funits_lower = args->scale_lo;
+    sp->funits_upper = args->scale_hi;
+    solver_set_parity(sp, args->parity);
+    solver_set_keep_logodds(sp, args->logodds_solve);
+    sp->logratio_stoplooking = args->logodds_solve;
+    sp->maxquads = args->maxquads;
+    sp->verify_pix = args->verify_pix;
+    if (args->tweak_order >= 2) {
+        sp->do_tweak = TRUE;
+        sp->tweak_aborder = sp->tweak_abporder = args->tweak_order;
+    }
+    solver_add_index(sp, index);
+
+    perm = permuted_sort(f->flux, sizeof(double), compare_doubles_desc,
+                         NULL, f->N);
+    xy = starxy_new(f->N, FALSE, FALSE);
+    for (i=0; i<f->N; i++)
+        starxy_set(xy, i, f->x[perm[i]], f->y[perm[i]]);
+    free(perm);
+    solver_set_field(sp, xy);
+    solver_set_field_bounds(sp, 0, f->W, 0, f->H);
+    solver_set_quad_size_fraction(sp, DEFAULT_QSF_LO, DEFAULT_QSF_HI);
+    solver_run(sp);
+    if (sp->have_best_match && solver_did_solve(sp)) {
+        MatchObj* mo = solver_get_best_match(sp);
+        n = 0;
+        for (i=0; i<mo->nfield; i++)
+            if (mo->theta[i] >= 0) {
+                n++;
+                if (i >= mo->nbest)
+                    (*nbeyond)++;
+            }
+    }
+    if (sp->have_best_match) {
+        free(sp->best_match.sip);
+        sp->best_match.sip = NULL;
+        verify_free_matchobj(&sp->best_match);
+    }
+    solver_cleanup_field(sp);
+    solver_free(sp);
+    return n;
+}
+
+void test_solver_batch(CuTest* ct) {
+    enum { MAXSTARS = 100 };
+    index_t* index;
+    solver_batch_args_t args;
+    solver_batch_field_t serial[NFIELDS], threaded[NFIELDS];
+    double xs[NFIELDS * MAXSTARS], ys[NFIELDS * MAXSTARS];
+    double fluxes[NFIELDS * MAXSTARS];
+    tan_t truth[NFIELDS];
+    int i, j, nsolved = 0, nbeyond = 0;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    make_fields(index, serial, xs, ys, fluxes, truth, MAXSTARS);
+    memcpy(threaded, serial, sizeof(serial));
+
+    solver_batch_args_init(&args);
+    args.scale_lo = 0.95 * 90.0;
+    args.scale_hi = 1.05 * 90.0;
+    args.maxquads = 2000;
+    CuAssertIntEquals(ct, 0, solver_batch_run(&args, &index, 1,
+                                              serial, NFIELDS));
+    args.nthreads = 4;
+    CuAssertIntEquals(ct, 0, solver_batch_run(&args, &index, 1,
+                                              threaded, NFIELDS));
+
+    for (i=0; i<NFIELDS; i++) {
+        solver_batch_field_t* f = serial + i;
+        double ra, dec, tra, tdec;
+        CuAssertIntEquals(ct, f->solved, threaded[i].solved);
+        CuAssertDblEquals(ct, f->logodds, threaded[i].logodds, 0.0);
+        CuAssertIntEquals(ct, f->nmatch, threaded[i].nmatch);
+        if (!f->solved)
+            continue;
+        nsolved++;
+        CuAssertPtrEquals(ct, index, f->index);
+        CuAssertIntEquals(ct, 2, f->wcs.a_order);
+        CuAssert(ct, "matches", f->nmatch > 10);
+        // every field star the solution matched.
+        CuAssertIntEquals(ct, f->nmatch, count_matches(index, &args, f,
+                                                       &nbeyond));
+        sip_pixelxy2radec(&f->wcs, 500, 500, &ra, &dec);
+        tan_pixelxy2radec(truth + i, 500, 500, &tra, &tdec);
+        // within a few pixels
+        CuAssert(ct, "center", arcsec_between_radecdeg(ra, dec, tra, tdec)
+                 < 3 * 90.0);
+        for (j=0; j<f->nmatch; j++) {
+            double x, y;
+            int k = f->match_field[j];
+            CuAssert(ct, "field index", k >= 0 && k < f->N);
+            CuAssertIntEquals(ct, k, threaded[i].match_field[j]);
+            CuAssert(ct, "projects", sip_radec2pixelxy(&f->wcs,
+                                                       f->match_radec[2*j],
+                                                       f->match_radec[2*j+1],
+                                                       &x, &y));
+            CuAssert(ct, "match position",
+                     hypot(x - f->x[k], y - f->y[k]) < 5.0);
+        }
+        solver_batch_field_free(f);
+        solver_batch_field_free(threaded + i);
+    }
+    CuAssert(ct, "most fields solve", nsolved > NFIELDS / 2);
+
+    // TAN only: the matched quad's stars are often past the verified ones.
+    args.tweak_order = 0;
+    CuAssertIntEquals(ct, 0, solver_batch_run(&args, &index, 1,
+                                              threaded, NFIELDS));
+    for (i=0; i<NFIELDS; i++) {
+        solver_batch_field_t* f = threaded + i;
+        if (!f->solved)
+            continue;
+        CuAssertIntEquals(ct, f->nmatch, count_matches(index, &args, f,
+                                                       &nbeyond));
+        solver_batch_field_free(f);
+    }
+    CuAssert(ct, "matches past nbest", nbeyond > 0);
+
+    // no indexes
+    CuAssertIntEquals(ct, -1, solver_batch_run(&args, &index, 0,
+                                               serial, NFIELDS));
+    index_free(index);
+    // a metadata-only index
+    index = index_load("index-9918.fits", INDEX_ONLY_LOAD_METADATA, NULL);
+    CuAssertPtrNotNull(ct, index);
+    CuAssertIntEquals(ct, -1, solver_batch_run(&args, &index, 1,
+                                               serial, NFIELDS));
+    index_free(index);
+}
+
+// RA,Dec-constrained fields, in several threads sharing the index: the
+// quad map and each thread's quad subsets.
+void test_solver_batch_radec_threads(CuTest* ct) {
+    enum { MAXSTARS = 100 };
+    index_t* index;
+    solver_batch_args_t args;
+    solver_batch_field_t serial[NFIELDS], threaded[NFIELDS];
+    double xs[NFIELDS * MAXSTARS], ys[NFIELDS * MAXSTARS];
+    double fluxes[NFIELDS * MAXSTARS];
+    tan_t truth[NFIELDS];
+    int i, nsolved = 0;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    make_fields(index, serial, xs, ys, fluxes, truth, MAXSTARS);
+    for (i=0; i<NFIELDS; i++) {
+        serial[i].use_radec = TRUE;
+        tan_pixelxy2radec(truth + i, 500, 500, &serial[i].ra, &serial[i].dec);
+        serial[i].radius = 20.0;
+    }
+    // the wrong side of the sky: must not solve.
+    serial[0].dec = -serial[0].dec;
+    serial[0].ra = fmod(serial[0].ra + 180.0, 360.0);
+    memcpy(threaded, serial, sizeof(serial));
+
+    solver_batch_args_init(&args);
+    args.scale_lo = 0.95 * 90.0;
+    args.scale_hi = 1.05 * 90.0;
+    args.maxquads = 2000;
+    CuAssertIntEquals(ct, 0, solver_batch_run(&args, &index, 1,
+                                              serial, NFIELDS));
+    CuAssertPtrNotNull(ct, index->quadmap);
+    args.nthreads = 4;
+    CuAssertIntEquals(ct, 0, solver_batch_run(&args, &index, 1,
+                                              threaded, NFIELDS));
+
+    CuAssert(ct, "wrong RA,Dec", !serial[0].solved && !threaded[0].solved);
+    for (i=0; i<NFIELDS; i++) {
+        solver_batch_field_t* f = serial + i;
+        double ra, dec;
+        CuAssertIntEquals(ct, f->solved, threaded[i].solved);
+        CuAssertDblEquals(ct, f->logodds, threaded[i].logodds, 0.0);
+        CuAssertIntEquals(ct, f->nmatch, threaded[i].nmatch);
+        if (!f->solved)
+            continue;
+        nsolved++;
+        sip_pixelxy2radec(&f->wcs, 500, 500, &ra, &dec);
+        CuAssert(ct, "within the circle",
+                 arcsec_between_radecdeg(ra, dec, f->ra, f->dec)
+                 < 3 * 90.0);
+        solver_batch_field_free(f);
+        solver_batch_field_free(threaded + i);
+    }
+    CuAssert(ct, "most fields solve", nsolved > NFIELDS / 2);
+    index_free(index);
+}
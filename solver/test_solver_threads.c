@@ -0,0 +1,141 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "cutest.h"
+#include "synthfield.h"
+#include "index.h"
+#include "solver.h"
+#include "tic.h"
+#include "log.h"
+#include "errors.h"
+
+/*
+ Several solver_t instances running at once, sharing one index.  Each
+ thread must get exactly the results of a serial run.  For a
+ data-race check, build with CFLAGS="-fsanitize=thread -g" and
+ LDFLAGS="-fsanitize=thread" and run ./test_solver_threads.
+ */
+
+#define NTHREADS 4
+#define NFIELDS 24
+
+struct result {
+    anbool solved;
+    double logodds;
+    int numtries;
+};
+
+struct job {
+    index_t* index;
+    int thread;
+    struct result results[NFIELDS];
+    char* errstr;
+};
+
+static void solve_one(index_t* index, unsigned int seed, struct result* res) {
+    synthfield_args_t args;
+    starxy_t* field;
+    solver_t* sp;
+
+    synthfield_args_init(&args);
+    args.W = args.H = 1000;
+    args.scale_lo = args.scale_hi = 90.0;
+    args.distractors = 0.25;
+    args.dropout = 0.1;
+    args.noise = 1.0;
+    args.maxstars = 100;
+    args.seed = seed;
+    field = synthfield_generate(index->starkd, &args, NULL);
+
+    sp = solver_new();
+    sp->funits_lower = 0.95 * args.scale_lo;
+    sp->funits_upper = 1.05 * args.scale_hi;
+    sp->maxquads = 2000;
+    solver_set_keep_logodds(sp, log(1e9));
+    sp->logratio_stoplooking = sp->logratio_tokeep;
+    solver_add_index(sp, index);
+    solver_set_field(sp, field);
+    solver_set_field_bounds(sp, 0, args.W, 0, args.H);
+    solver_run(sp);
+
+    res->solved = solver_did_solve(sp);
+    res->logodds = (sp->have_best_match ? sp->best_match.logodds : 0.0);
+    res->numtries = sp->numtries;
+
+    if (sp->have_best_match)
+        verify_free_matchobj(&sp->best_match);
+    solver_cleanup_field(sp);
+    solver_free(sp);
+}
+
+static void* solve_thread(void* v) {
+    struct job* job = v;
+    int i;
+    tic();
+    // errors reported here must only show up in this thread's stack.
+    errors_start_logging_to_string();
+    ERROR("thread %i", job->thread);
+    // each thread solves all fields, starting at a different one.
+    for (i=0; i<NFIELDS; i++) {
+        int k = (i + job->thread * NFIELDS / NTHREADS) % NFIELDS;
+        solve_one(job->index, k + 1, job->results + k);
+    }
+    job->errstr = errors_stop_logging_to_string(": ");
+    return NULL;
+}
+
+void test_solver_threads(CuTest* ct) {
+    index_t* index;
+    struct result serial[NFIELDS];
+    struct job jobs[NTHREADS];
+    pthread_t threads[NTHREADS];
+    int i, t;
+    int nsolved = 0;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+
+    for (i=0; i<NFIELDS; i++) {
+        solve_one(index, i + 1, serial + i);
+        if (serial[i].solved)
+            nsolved++;
+    }
+    CuAssert(ct, "most fields solve", nsolved > NFIELDS / 2);
+
+    for (t=0; t<NTHREADS; t++) {
+        memset(jobs + t, 0, sizeof(struct job));
+        jobs[t].index = index;
+        jobs[t].thread = t;
+        CuAssertIntEquals(ct, 0, pthread_create(threads + t, NULL,
+                                                solve_thread, jobs + t));
+    }
+    for (t=0; t<NTHREADS; t++) {
+        char expect[32];
+        CuAssertIntEquals(ct, 0, pthread_join(threads[t], NULL));
+        for (i=0; i<NFIELDS; i++) {
+            CuAssertIntEquals(ct, serial[i].solved, jobs[t].results[i].solved);
+            CuAssertIntEquals(ct, serial[i].numtries, jobs[t].results[i].numtries);
+            CuAssertDblEquals(ct, serial[i].logodds, jobs[t].results[i].logodds, 0.0);
+        }
+        sprintf(expect, "thread %i", t);
+        CuAssertPtrNotNull(ct, jobs[t].errstr);
+        CuAssert(ct, "per-thread error stack",
+                 strstr(jobs[t].errstr, expect) != NULL);
+        for (i=0; i<NTHREADS; i++) {
+            if (i == t)
+                continue;
+            sprintf(expect, "thread %i", i);
+            CuAssert(ct, "no errors from other threads",
+                     strstr(jobs[t].errstr, expect) == NULL);
+        }
+        free(jobs[t].errstr);
+    }
+    index_free(index);
+}
@@ -0,0 +1,150 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "synthfield.h"
+#include "index.h"
+#include "solver.h"
+#include "log.h"
+
+static void set_args(synthfield_args_t* args, unsigned int seed) {
+    synthfield_args_init(args);
+    args->W = args->H = 1000;
+    args->scale_lo = args->scale_hi = 90.0;
+    args->distractors = 0.25;
+    args->dropout = 0.1;
+    args->noise = 1.0;
+    args->maxstars = 100;
+    args->seed = seed;
+}
+
+void test_synthfield_repeatable(CuTest* ct) {
+    index_t* index;
+    synthfield_args_t args;
+    starxy_t *f1, *f2;
+    tan_t wcs1, wcs2;
+    int i;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+
+    set_args(&args, 42);
+    f1 = synthfield_generate(index->starkd, &args, &wcs1);
+    f2 = synthfield_generate(index->starkd, &args, &wcs2);
+    CuAssertPtrNotNull(ct, f1);
+    CuAssertPtrNotNull(ct, f2);
+    CuAssertIntEquals(ct, starxy_n(f1), starxy_n(f2));
+    CuAssert(ct, "some stars", starxy_n(f1) > 0);
+    CuAssertDblEquals(ct, wcs1.crval[0], wcs2.crval[0], 0.0);
+    CuAssertDblEquals(ct, wcs1.crval[1], wcs2.crval[1], 0.0);
+    for (i=0; i<starxy_n(f1); i++) {
+        double x = starxy_getx(f1, i);
+        double y = starxy_gety(f1, i);
+        CuAssertDblEquals(ct, x, starxy_getx(f2, i), 0.0);
+        CuAssertDblEquals(ct, y, starxy_gety(f2, i), 0.0);
+        // noise can push stars slightly out of the image.
+        CuAssert(ct, "x in bounds", x > -10 && x < args.W + 10);
+        CuAssert(ct, "y in bounds", y > -10 && y < args.H + 10);
+        if (i)
+            CuAssert(ct, "sorted by flux",
+                     starxy_get_flux(f1, i) <= starxy_get_flux(f1, i-1));
+    }
+    starxy_free(f1);
+    starxy_free(f2);
+    index_free(index);
+}
+
+void test_synthfield_solves(CuTest* ct) {
+    index_t* index;
+    synthfield_args_t args;
+    starxy_t* field;
+    solver_t* sp;
+    tan_t truewcs;
+    double ra, dec, x, y;
+
+    log_init(LOG_MSG);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+
+    // seed 1 solves on the first quad (see solver-bench).
+    set_args(&args, 1);
+    field = synthfield_generate(index->starkd, &args, &truewcs);
+    CuAssertPtrNotNull(ct, field);
+
+    sp = solver_new();
+    sp->funits_lower = 0.95 * args.scale_lo;
+    sp->funits_upper = 1.05 * args.scale_hi;
+    solver_set_keep_logodds(sp, log(1e9));
+    sp->logratio_stoplooking = sp->logratio_tokeep;
+    solver_add_index(sp, index);
+    solver_set_field(sp, field);
+    solver_set_field_bounds(sp, 0, args.W, 0, args.H);
+    solver_run(sp);
+
+    CuAssertIntEquals(ct, 1, solver_did_solve(sp));
+    tan_pixelxy2radec(&sp->best_match.wcstan, 500, 500, &ra, &dec);
+    CuAssertIntEquals(ct, 1, tan_radec2pixelxy(&truewcs, ra, dec, &x, &y));
+    CuAssertDblEquals(ct, 500, x - 1.0, 5.0);
+    CuAssertDblEquals(ct, 500, y - 1.0, 5.0);
+
+    verify_free_matchobj(&sp->best_match);
+    solver_cleanup_field(sp);
+    solver_free(sp);
+    index_free(index);
+}
+
+static anbool solve_seed(index_t* index, unsigned int seed, int ncoarse,
+                         solver_stats_t* stats) {
+    synthfield_args_t args;
+    starxy_t* field;
+    solver_t* sp;
+    anbool solved;
+
+    set_args(&args, seed);
+    field = synthfield_generate(index->starkd, &args, NULL);
+    sp = solver_new();
+    sp->funits_lower = 0.95 * args.scale_lo;
+    sp->funits_upper = 1.05 * args.scale_hi;
+    sp->verify_coarse = ncoarse;
+    sp->stats = stats;
+    solver_set_keep_logodds(sp, log(1e9));
+    sp->logratio_stoplooking = sp->logratio_tokeep;
+    solver_add_index(sp, index);
+    solver_set_field(sp, field);
+    solver_set_field_bounds(sp, 0, args.W, 0, args.H);
+    solver_run(sp);
+    solved = solver_did_solve(sp);
+    if (sp->have_best_match)
+        verify_free_matchobj(&sp->best_match);
+    solver_cleanup_field(sp);
+    solver_free(sp);
+    return solved;
+}
+
+void test_synthfield_coarse_verify(CuTest* ct) {
+    index_t* index;
+    solver_stats_t* stats;
+    int i, nplain = 0, ncoarse = 0;
+
+    log_init(LOG_ERROR);
+    index = index_load("index-9918.fits", 0, NULL);
+    CuAssertPtrNotNull(ct, index);
+    stats = solver_stats_new();
+
+    for (i=1; i<=20; i++) {
+        nplain += solve_seed(index, i, 0, NULL);
+        ncoarse += solve_seed(index, i, 20, stats);
+    }
+    // the coarse pass must reject most false matches without losing
+    // true ones.
+    CuAssert(ct, "coarse pass rejected matches", stats->verify_coarse_rejected > 0);
+    CuAssert(ct, "coarse pass keeps solutions", ncoarse >= nplain);
+
+    solver_stats_free(stats);
+    index_free(index);
+}
@@ -0,0 +1,89 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "tracking.h"
+#include "sip.h"
+#include "ioutils.h"
+#include "log.h"
+
+static void frame_wcs(sip_t* wcs, double ra, double dec) {
+    memset(wcs, 0, sizeof(sip_t));
+    wcs->wcstan.crval[0] = ra;
+    wcs->wcstan.crval[1] = dec;
+    wcs->wcstan.crpix[0] = 500.5;
+    wcs->wcstan.crpix[1] = 500.5;
+    // 2 arcsec/pixel
+    wcs->wcstan.cd[0][0] = -2.0 / 3600.0;
+    wcs->wcstan.cd[1][1] =  2.0 / 3600.0;
+    wcs->wcstan.imagew = 1000;
+    wcs->wcstan.imageh = 1000;
+}
+
+void test_tracking_sequence(CuTest* ct) {
+    tracking_t* t;
+    sip_t wcs, pred;
+    double ra, dec, radius;
+    char* fn;
+
+    log_init(LOG_MSG);
+    t = tracking_new();
+    CuAssertIntEquals(ct, FALSE, tracking_predict(t, &pred, &ra, &dec, &radius));
+
+    // no drift known yet: predict the last solution.
+    frame_wcs(&wcs, 359.9, 20.0);
+    tracking_solved(t, &wcs);
+    CuAssertIntEquals(ct, TRUE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    CuAssertDblEquals(ct, 359.9, ra, 1e-6);
+    CuAssertDblEquals(ct, 20.0, dec, 1e-6);
+    // twice the field radius.
+    CuAssertDblEquals(ct, hypot(1000, 1000) * 2.0 / 3600.0,
+                      radius, 1e-9);
+
+    // moving 0.2 deg in RA (across RA=0) and -0.05 in Dec per frame.
+    frame_wcs(&wcs, 0.1, 19.95);
+    tracking_solved(t, &wcs);
+    CuAssertIntEquals(ct, TRUE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    CuAssertDblEquals(ct, 0.3, ra, 1e-6);
+    CuAssertDblEquals(ct, 19.90, dec, 1e-6);
+    CuAssertDblEquals(ct, 0.3, pred.wcstan.crval[0], 1e-6);
+
+    // a missed frame: two steps ahead.
+    tracking_missed(t);
+    CuAssertIntEquals(ct, TRUE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    CuAssertDblEquals(ct, 0.5, ra, 1e-6);
+    CuAssertDblEquals(ct, 19.85, dec, 1e-6);
+
+    // the state persists.
+    fn = create_temp_file("test_tracking", NULL);
+    unlink(fn);
+    t->statefn = strdup(fn);
+    CuAssertIntEquals(ct, 0, tracking_save_state(t));
+    tracking_free(t);
+    t = tracking_new();
+    CuAssertIntEquals(ct, 0, tracking_load_state(t, fn));
+    CuAssertIntEquals(ct, TRUE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    CuAssertDblEquals(ct, 0.5, ra, 1e-6);
+    CuAssertDblEquals(ct, 19.85, dec, 1e-6);
+
+    // after "maxmissed" misses in a row the prior is dropped...
+    tracking_missed(t);
+    tracking_missed(t);
+    CuAssertIntEquals(ct, FALSE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    CuAssertIntEquals(ct, 0, tracking_save_state(t));
+    tracking_free(t);
+    // ... also in the file.
+    t = tracking_new();
+    CuAssertIntEquals(ct, 0, tracking_load_state(t, fn));
+    CuAssertIntEquals(ct, FALSE, tracking_predict(t, &pred, &ra, &dec, &radius));
+    tracking_free(t);
+    unlink(fn);
+    free(fn);
+}
@@ -0,0 +1,183 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tracking.h"
+#include "sip_qfits.h"
+#include "fitsioutils.h"
+#include "anqfits.h"
+#include "qfits_table.h"
+#include "ioutils.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "log.h"
+#include "errors.h"
+
+tracking_t* tracking_new(void) {
+    tracking_t* t = calloc(1, sizeof(tracking_t));
+    t->scale_slop = 0.1;
+    t->maxmissed = 3;
+    return t;
+}
+
+void tracking_free(tracking_t* t) {
+    if (!t)
+        return;
+    free(t->statefn);
+    free(t);
+}
+
+static void image_center(const sip_t* wcs, double* ra, double* dec) {
+    sip_pixelxy2radec(wcs, 0.5 + 0.5 * wcs->wcstan.imagew,
+                      0.5 + 0.5 * wcs->wcstan.imageh, ra, dec);
+}
+
+static double wrap_ra(double ra) {
+    ra = fmod(ra, 360.0);
+    if (ra < 0)
+        ra += 360.0;
+    return ra;
+}
+
+int tracking_load_state(tracking_t* t, const char* fn) {
+    qfits_header* hdr;
+    free(t->statefn);
+    t->statefn = strdup(fn);
+    t->valid = FALSE;
+    t->have_drift = FALSE;
+    if (!file_exists(fn)) {
+        logverb("Tracking state file %s does not exist yet\n", fn);
+        return 0;
+    }
+    hdr = anqfits_get_header2(fn, 0);
+    if (!hdr) {
+        ERROR("Failed to read tracking state file \"%s\"", fn);
+        return -1;
+    }
+    t->valid = qfits_header_getboolean(hdr, "TRKVALID", 0);
+    t->have_drift = qfits_header_getboolean(hdr, "TRKDRIFT", 0);
+    t->dra  = qfits_header_getdouble(hdr, "TRKDRA", 0.0);
+    t->ddec = qfits_header_getdouble(hdr, "TRKDDEC", 0.0);
+    t->nmissed = qfits_header_getint(hdr, "TRKNMISS", 0);
+    qfits_header_destroy(hdr);
+    if (!t->valid)
+        return 0;
+    if (!sip_read_tan_or_sip_header_file_ext(fn, 0, &t->wcs, FALSE)) {
+        ERROR("Failed to read WCS from tracking state file \"%s\"", fn);
+        t->valid = FALSE;
+        return -1;
+    }
+    image_center(&t->wcs, &t->ra, &t->dec);
+    logverb("Read tracking state from %s: last solution at RA,Dec (%g, %g)\n",
+            fn, t->ra, t->dec);
+    return 0;
+}
+
+int tracking_save_state(const tracking_t* t) {
+    qfits_header* hdr;
+    FILE* f;
+    char* tmpfn;
+    int rtn;
+    if (!t->statefn)
+        return 0;
+    if (!t->valid)
+        hdr = qfits_table_prim_header_default();
+    else if (t->wcs.a_order == 0 && t->wcs.ap_order == 0)
+        hdr = tan_create_header(&t->wcs.wcstan);
+    else
+        hdr = sip_create_header(&t->wcs);
+    if (!hdr) {
+        ERROR("Failed to create tracking state header");
+        return -1;
+    }
+    qfits_header_add(hdr, "TRKVALID", t->valid ? "T" : "F",
+                     "Is there a prior for the next frame?", NULL);
+    qfits_header_add(hdr, "TRKDRIFT", t->have_drift ? "T" : "F",
+                     "Is the drift known?", NULL);
+    fits_header_add_double(hdr, "TRKDRA", t->dra, "Drift in RA per frame (deg)");
+    fits_header_add_double(hdr, "TRKDDEC", t->ddec,
+                           "Drift in Dec per frame (deg)");
+    fits_header_add_int(hdr, "TRKNMISS", t->nmissed,
+                        "Frames since the last solution");
+    // write to a temp file and rename it, so a crash can't truncate the
+    // state.
+    asprintf_safe(&tmpfn, "%s.tmp", t->statefn);
+    f = fopen(tmpfn, "wb");
+    if (!f) {
+        SYSERROR("Failed to open tracking state file \"%s\" for writing", tmpfn);
+        qfits_header_destroy(hdr);
+        free(tmpfn);
+        return -1;
+    }
+    rtn = qfits_header_dump(hdr, f);
+    qfits_header_destroy(hdr);
+    if (rtn || fclose(f) || rename(tmpfn, t->statefn)) {
+        SYSERROR("Failed to write tracking state file \"%s\"", t->statefn);
+        free(tmpfn);
+        return -1;
+    }
+    free(tmpfn);
+    return 0;
+}
+
+anbool tracking_predict(const tracking_t* t, sip_t* wcs,
+                        double* ra, double* dec, double* radius) {
+    double n = t->nmissed + 1;
+    double dra = 0, ddec = 0;
+    if (!t->valid)
+        return FALSE;
+    if (t->have_drift) {
+        dra = n * t->dra;
+        ddec = n * t->ddec;
+    }
+    memcpy(wcs, &t->wcs, sizeof(sip_t));
+    wcs->wcstan.crval[0] = wrap_ra(wcs->wcstan.crval[0] + dra);
+    wcs->wcstan.crval[1] = MAX(-90.0, MIN(90.0, wcs->wcstan.crval[1] + ddec));
+    image_center(wcs, ra, dec);
+    if (t->radius > 0)
+        *radius = t->radius;
+    else
+        *radius = 2.0 * arcsec2deg(sip_pixel_scale(wcs)) * 0.5 *
+            hypot(wcs->wcstan.imagew, wcs->wcstan.imageh);
+    return TRUE;
+}
+
+void tracking_solved(tracking_t* t, const sip_t* wcs) {
+    double ra, dec;
+    image_center(wcs, &ra, &dec);
+    if (t->valid) {
+        double dra = ra - t->ra;
+        if (dra > 180.0)
+            dra -= 360.0;
+        if (dra < -180.0)
+            dra += 360.0;
+        t->dra = dra / (t->nmissed + 1);
+        t->ddec = (dec - t->dec) / (t->nmissed + 1);
+        t->have_drift = TRUE;
+        logverb("Tracking: image center moved by (%g, %g) arcsec per frame\n",
+                deg2arcsec(t->dra * cos(deg2rad(dec))), deg2arcsec(t->ddec));
+    }
+    memcpy(&t->wcs, wcs, sizeof(sip_t));
+    t->ra = ra;
+    t->dec = dec;
+    t->nmissed = 0;
+    t->valid = TRUE;
+}
+
+void tracking_missed(tracking_t* t) {
+    if (!t->valid)
+        return;
+    t->nmissed++;
+    if (t->nmissed >= t->maxmissed) {
+        logmsg("Tracking: %i frames in a row failed to solve; dropping the "
+               "prior\n", t->nmissed);
+        t->valid = FALSE;
+        t->have_drift = FALSE;
+        t->nmissed = 0;
+    }
+}
@@ -126,7 +126,7 @@ int main(int argc, char *argv[]) {
         ERROR("Couldn't read catalog %s", infn);
         exit(-1);
     }
-    logmsg("Got %i stars\n", fitstable_nrows(intable));
+    logmsg("Got %lld stars\n", (long long)fitstable_nrows64(intable));
 
     outtable = fitstable_open_for_writing(outfn);
     if (!outtable) {
@@ -54,7 +54,7 @@ static anbool is_duplicate(int hp, double ra, double dec, int Nside,
         if (!lst)
             continue;
         for (j=0; j<bl_size(lst); j++) {
-            int otherindex;
+            int64_t otherindex;
             bl_get(lst, j, &otherindex);
             radecdeg2xyzarr(ras[otherindex], decs[otherindex], xyz2);
             if (!distsq_exceeds(xyz, xyz2, 3, dedupr2))
@@ -64,6 +64,32 @@ static anbool is_duplicate(int hp, double ra, double dec, int Nside,
     return FALSE;
 }
 
+// Reads a whole double column in pieces, so that tables with more than
+// 2^31 rows can be read.
+static double* read_column_64(fitstable_t* intable, const char* colname,
+                              int64_t N) {
+    const int64_t chunk = 1 << 24;
+    double* data;
+    int64_t i;
+    data = malloc(MAX(N, 1) * sizeof(double));
+    if (!data) {
+        SYSERROR("Failed to allocate %lld values for column %s",
+                 (long long)N, colname);
+        return NULL;
+    }
+    for (i=0; i<N; i+=chunk) {
+        int n = (int)MIN(chunk, N - i);
+        if (fitstable_read_column_offset_into(intable, colname,
+                                              fitscolumn_double_type(),
+                                              data + i, sizeof(double),
+                                              i, n)) {
+            free(data);
+            return NULL;
+        }
+    }
+    return data;
+}
+
 int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
                        const char* racol, const char* deccol,
                        const char* sortcol, anbool sort_ascending,
@@ -81,19 +107,19 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     int NHP;
     anbool dense = FALSE;
     double dedupr2 = 0.0;
-    tfits_type dubl;
-    int N;
-    int* inorder = NULL;
-    int* outorder = NULL;
-    int outi;
+    int64_t N;
+    int64_t* inorder = NULL;
+    int64_t* outorder = NULL;
+    int64_t outi;
     double *ra = NULL, *dec = NULL;
     il* myhps = NULL;
-    int i,j,k;
+    int64_t i, j;
+    int k;
     int nkeep = nsweeps;
-    int noob = 0;
-    int ndup = 0;
+    int64_t noob = 0;
+    int64_t ndup = 0;
     struct oh_token token;
-    int* npersweep = NULL;
+    int64_t* npersweep = NULL;
     qfits_header* outhdr = NULL;
     double *sortval = NULL;
 
@@ -118,41 +144,47 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     }
     logverb("Healpix side length: %g arcmin.\n", healpix_side_length_arcmin(Nside));
 
-    dubl = fitscolumn_double_type();
+    N = fitstable_nrows64(intable);
     if (!racol)
         racol = "RA";
-    ra = fitstable_read_column(intable, racol, dubl);
+    ra = read_column_64(intable, racol, N);
     if (!ra) {
         ERROR("Failed to find RA column (%s) in table", racol);
         return -1;
     }
     if (!deccol)
         deccol = "DEC";
-    dec = fitstable_read_column(intable, deccol, dubl);
+    dec = read_column_64(intable, deccol, N);
     if (!dec) {
         ERROR("Failed to find DEC column (%s) in table", deccol);
         free(ra);
         return -1;
     }
 
-    N = fitstable_nrows(intable);
-    logverb("Have %i objects\n", N);
+    logverb("Have %lld objects\n", (long long)N);
 
     // FIXME -- argsort and seek around the input table, and append to
     // starlists in order; OR read from the input table in sequence and
     // sort in the starlists?
     if (sortcol) {
         logverb("Sorting by %s...\n", sortcol);
-        sortval = fitstable_read_column(intable, sortcol, dubl);
+        sortval = read_column_64(intable, sortcol, N);
         if (!sortval) {
             ERROR("Failed to read sorting column \"%s\"", sortcol);
             free(ra);
             free(dec);
             return -1;
         }
-        inorder = permuted_sort(sortval, sizeof(double),
-                                sort_ascending ? compare_doubles_asc : compare_doubles_desc,
-                                NULL, N);
+        inorder = permuted_sort_64(sortval, sizeof(double),
+                                   sort_ascending ? compare_doubles_asc : compare_doubles_desc,
+                                   NULL, N);
+        if (!inorder) {
+            SYSERROR("Failed to sort %lld objects", (long long)N);
+            free(sortval);
+            free(ra);
+            free(dec);
+            return -1;
+        }
         if (sort_min_cut > -HUGE_VAL) {
             logverb("Cutting to %s > %g...\n", sortcol, sort_min_cut);
             // Cut objects with sortval < sort_min_cut.
@@ -164,7 +196,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
                         break;
                 // move the "inorder" indices down.
                 if (i)
-                    memmove(inorder, inorder+i, (N-i)*sizeof(int));
+                    memmove(inorder, inorder+i, (N-i)*sizeof(int64_t));
                 N -= i;
             } else {
                 // skipped objects are at the end -- find the last obj to keep.
@@ -173,7 +205,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
                         break;
                 N = i+1;
             }
-            logverb("Cut to %i objects\n", N);
+            logverb("Cut to %lld objects\n", (long long)N);
         }
         //free(sortval);
     }
@@ -191,10 +223,10 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
         //ninside = (Nside/bignside)*(Nside/bignside);
         // Prime the queue with the fine healpixes that are on the
         // boundary of the big healpix.
-        for (i=0; i<((Nside / bignside) - 1); i++) {
+        for (k=0; k<((Nside / bignside) - 1); k++) {
             // add (i,0), (i,max), (0,i), and (0,max) healpixes
-            int xx = i + bighpx * (Nside / bignside);
-            int yy = i + bighpy * (Nside / bignside);
+            int xx = k + bighpx * (Nside / bignside);
+            int yy = k + bighpy * (Nside / bignside);
             int y0 =     bighpy * (Nside / bignside);
             // -1 prevents us from double-adding the corners.
             int y1 =(1 + bighpy)* (Nside / bignside) - 1;
@@ -225,13 +257,12 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     }
 
     dedupr2 = arcsec2distsq(dedup_radius);
-    starlists = intmap_new(sizeof(int32_t), nkeep, 0, dense);
+    starlists = intmap_new(sizeof(int64_t), nkeep, 0, dense);
 
     logverb("Placing stars in grid cells...\n");
     for (i=0; i<N; i++) {
         int hp;
         bl* lst;
-        int32_t j32;
         anbool oob;
         if (inorder) {
             j = inorder[i];
@@ -278,11 +309,10 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
         }
 
         // Add the new star (by index)
-        j32 = j;
-        bl_append(lst, &j32);
+        bl_append(lst, &j);
     }
-    logverb("%i outside the healpix\n", noob);
-    logverb("%i duplicates\n", ndup);
+    logverb("%lld outside the healpix\n", (long long)noob);
+    logverb("%lld duplicates\n", (long long)ndup);
 
     il_free(myhps);
     myhps = NULL;
@@ -293,14 +323,13 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     free(dec);
     dec = NULL;
 
-    outorder = malloc(N * sizeof(int));
+    outorder = malloc(MAX(N, 1) * sizeof(int64_t));
     outi = 0;
 
-    npersweep = calloc(nsweeps, sizeof(int));
+    npersweep = calloc(nsweeps, sizeof(int64_t));
 
     for (k=0; k<nsweeps; k++) {
-        int starti = outi;
-        int32_t j32;
+        int64_t starti = outi;
         for (i=0;; i++) {
             bl* lst;
             int hp;
@@ -308,19 +337,19 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
                 break;
             if (bl_size(lst) <= k)
                 continue;
-            bl_get(lst, k, &j32);
-            outorder[outi] = j32;
+            bl_get(lst, k, &j);
+            outorder[outi] = j;
             //printf("sweep %i, cell #%i, hp %i, star %i, %s = %g\n", k, i, hp, j32, sortcol, sortval[j32]);
             outi++;
         }
-        logmsg("Sweep %i: %i stars\n", k+1, outi - starti);
+        logmsg("Sweep %i: %lld stars\n", k+1, (long long)(outi - starti));
         npersweep[k] = outi - starti;
 
         if (sortcol) {
             // Re-sort within this sweep.
-            permuted_sort(sortval, sizeof(double),
-                          sort_ascending ? compare_doubles_asc : compare_doubles_desc,
-                          outorder + starti, npersweep[k]);
+            permuted_sort_64(sortval, sizeof(double),
+                             sort_ascending ? compare_doubles_asc : compare_doubles_desc,
+                             outorder + starti, npersweep[k]);
             /*
              for (i=0; i<npersweep[k]; i++) {
              printf("  within sweep %i: star %i, j=%i, %s=%g\n",
@@ -337,7 +366,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     free(sortval);
     sortval = NULL;
 
-    logmsg("Total: %i stars\n", outi);
+    logmsg("Total: %lld stars\n", (long long)outi);
     N = outi;
 
     outhdr = fitstable_get_primary_header(outtable);
@@ -360,7 +389,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     fits_add_long_history(outhdr, "  deduplication scale: %g arcsec", dedup_radius);
     fits_add_long_history(outhdr, "  number of sweeps: %i", nsweeps);
 
-    fits_header_add_int(outhdr, "NSTARS", N, "Number of stars.");
+    fits_header_addf(outhdr, "NSTARS", "Number of stars.", "%lld", (long long)N);
     fits_header_add_int(outhdr, "HEALPIX", bighp, "Healpix covered by this catalog, with Nside=HPNSIDE");
     fits_header_add_int(outhdr, "HPNSIDE", bignside, "Nside of HEALPIX.");
     fits_header_add_int(outhdr, "CUTNSIDE", Nside, "uniformization scale (healpix nside)");
@@ -373,7 +402,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     for (k=0; k<nsweeps; k++) {
         char key[64];
         sprintf(key, "SWEEP%i", (k+1));
-        fits_header_add_int(outhdr, key, npersweep[k], "# stars added");
+        fits_header_addf(outhdr, key, "# stars added", "%lld", (long long)npersweep[k]);
     }
     free(npersweep);
 
@@ -390,7 +419,7 @@ int uniformize_catalog(fitstable_t* intable, fitstable_t* outtable,
     }
     logmsg("Writing output...\n");
     logverb("Row size: %i\n", fitstable_row_size(intable));
-    if (fitstable_copy_rows_data(intable, outorder, N, outtable)) {
+    if (fitstable_copy_rows_data64(intable, outorder, N, outtable)) {
         ERROR("Failed to copy rows from input table to output");
         return -1;
     }
@@ -17,6 +17,7 @@
 #include "sip-utils.h"
 #include "healpix.h"
 #include "datalog.h"
+#include "xygrid.h"
 
 #define DEBUGVERIFY 0
 
@@ -64,7 +65,6 @@ static anbool* verify_deduplicate_field_stars(verify_t* v, const verify_field_t*
 
 verify_field_t* verify_field_preprocess(const starxy_t* fieldxy) {
     verify_field_t* vf;
-    int Nleaf = 5;
 
     vf = malloc(sizeof(verify_field_t));
     if (!vf) {
@@ -72,23 +72,23 @@ verify_field_t* verify_field_preprocess(const starxy_t* fieldxy) {
         return NULL;
     }
     vf->field = fieldxy;
-    // Note on kdtree type: I tried U32 (duu) but it was marginally slower.
-    // I didn't try U16 (dss) because we need a fair bit of accuracy here.
-    // Make a copy of the field objects, because we're going to build a
-    // kdtree out of them and that shuffles their order.
-    vf->fieldcopy = starxy_copy_xy(fieldxy);
     vf->xy = starxy_copy_xy(fieldxy);
-    if (!vf->fieldcopy || !vf->xy) {
+    if (!vf->xy) {
         fprintf(stderr, "Failed to copy the field.\n");
         return NULL;
     }
-    // Build a tree out of the field objects (in pixel space)
-    vf->ftree = kdtree_build(NULL, vf->fieldcopy, starxy_n(vf->field),
-                             2, Nleaf, KDTT_DOUBLE, KD_BUILD_SPLIT);
+    // Grid over the field objects (in pixel space), for deduplication.
+    // The dedup radius is about a pixel near the quad and grows away
+    // from it; let the grid pick its cell size from the star density.
+    vf->fgrid = xygrid_new(vf->xy, NULL, starxy_n(vf->field), 0.0);
 
     vf->do_uniformize = TRUE;
     vf->do_dedup = TRUE;
     vf->do_ror = TRUE;
+    vf->coarse_n = 0;
+    vf->coarse_logbail = -HUGE_VAL;
+    vf->stats = NULL;
+    vf->refcache = NULL;
 
     return vf;
 }
@@ -96,9 +96,9 @@ verify_field_t* verify_field_preprocess(const starxy_t* fieldxy) {
 void verify_field_free(verify_field_t* vf) {
     if (!vf)
         return;
-    kdtree_free(vf->ftree);
+    xygrid_free(vf->fgrid);
+    refcache_free(vf->refcache);
     free(vf->xy);
-    free(vf->fieldcopy);
     free(vf);
 }
 
@@ -446,6 +446,111 @@ static void verify_apply_ror(verify_t* v,
         *p_uninh = uni_nh;
 }
 
+/*
+ Orders the "n" test stars in "perm" by expected information: a star
+ that matches contributes log((1-d) A / (2 pi sigma^2 NR)) to the
+ log-odds, so (among stars of similar brightness) those with small
+ positional variance -- near the matched quad -- are the most
+ discriminating.  Stable, so brightness order breaks ties.  "n" is
+ small (a few dozen), so insertion sort is fine.
+ */
+static void verify_order_by_information(int* perm, int n, const double* sigma2) {
+    int i, j;
+    for (i=1; i<n; i++) {
+        int ti = perm[i];
+        for (j=i; j>0 && sigma2[perm[j-1]] > sigma2[ti]; j--)
+            perm[j] = perm[j-1];
+        perm[j] = ti;
+    }
+}
+
+/*
+ The coarse pass: before deduplicating, uniformizing, and applying the
+ radius of relevance to the whole field, score the "ncoarse" brightest
+ field stars (excluding the quad), taken in order of expected
+ information, against the reference stars.  This uses the same
+ foreground/background model as real_verify_star_lists() but with the
+ whole field as the effective area and without conflict resolution (a
+ reference star can only be matched once; later claimants count as
+ distractors).
+
+ Returns the log-odds after all "ncoarse" stars.  (Like the bail-out
+ test in the full pass, this is the running total, not the best prefix:
+ a false match that gets lucky on its first star has not earned a full
+ verification.)
+ */
+static double verify_coarse(const verify_t* v, const verify_field_t* vf,
+                            const MatchObj* mo, double pix2,
+                            double distractors, double fieldW, double fieldH,
+                            anbool do_gamma, int ncoarse) {
+    int i, j, n, NF;
+    int* tperm;
+    double* sigma2;
+    anbool* used;
+    double qc[2], Q2;
+    double maxsig2 = 0;
+    double logbg, logodds;
+    xygrid_t* grid;
+    int mu;
+
+    verify_get_quad_center(vf, mo, qc, &Q2);
+
+    NF = starxy_n(vf->field);
+    tperm = malloc(ncoarse * sizeof(int));
+    sigma2 = malloc(NF * sizeof(double));
+    n = 0;
+    for (i=0; i<NF && n<ncoarse; i++) {
+        anbool isquad = FALSE;
+        for (j=0; j<mo->dimquads; j++)
+            if (mo->field[j] == i) {
+                isquad = TRUE;
+                break;
+            }
+        if (isquad)
+            continue;
+        if (do_gamma)
+            sigma2[i] = get_sigma2_at_radius(pix2, distsq(vf->xy + 2*i, qc, 2), Q2);
+        else
+            sigma2[i] = pix2;
+        maxsig2 = MAX(maxsig2, sigma2[i]);
+        tperm[n] = i;
+        n++;
+    }
+    verify_order_by_information(tperm, n, sigma2);
+
+    grid = xygrid_new(v->refxy, v->refperm, v->NR, sqrt(25.0 * maxsig2));
+    used = calloc(v->NRall, sizeof(anbool));
+
+    logbg = log(1.0 / (fieldW * fieldH));
+    logodds = 0.0;
+    mu = 0;
+    for (i=0; i<n; i++) {
+        int ti = tperm[i];
+        double sig2 = sigma2[ti];
+        double logd = logd_at(distractors, mu, v->NR, logbg);
+        double logfg = logd;
+        double d2;
+        int ri = xygrid_nearest_within(grid, vf->xy + 2*ti, sig2 * 25.0, &d2);
+        if (ri != -1 && !used[ri]) {
+            double fg = log((1.0 - distractors) / (2.0 * M_PI * sig2 * v->NR))
+                - d2 / (2.0 * sig2);
+            if (fg > logd) {
+                logfg = fg;
+                used[ri] = TRUE;
+                mu++;
+            }
+        }
+        logodds += (logfg - logbg);
+    }
+    debug2("Coarse pass: %i test stars, %i matches, logodds %g\n", n, mu, logodds);
+
+    free(used);
+    xygrid_free(grid);
+    free(sigma2);
+    free(tperm);
+    return logodds;
+}
+
 static double real_verify_star_lists(verify_t* v,
                                      double effective_area,
                                      double distractors,
@@ -464,43 +569,33 @@ static double real_verify_star_lists(verify_t* v,
     double logbg;
     double logd;
     //double matchnsigma = 5.0;
-    double* refcopy;
-    kdtree_t* rtree;
-    int Nleaf = 10;
+    xygrid_t* rgrid;
+    double minsig2;
     int* rmatches;
     double* rprobs;
     double* all_logodds = NULL;
     int* theta = NULL;
     int mu;
-    int* rperm;
 
     if (!v->NR || !v->NT) {
         logerr("real_verify_star_lists: NR=%i, NT=%i\n", v->NR, v->NT);
         return -HUGE_VAL;
     }
 
-    // Build a tree out of the index stars in pixel space...
-    // kdtree scrambles the data array so make a copy first.
-    refcopy = malloc(2 * v->NR * sizeof(double));
-    // we must pack/unpermute the refxys; remember this packing order in "rperm".
-    // we borrow storage for "rperm"...
-    if (!v->badguys)
-        v->badguys = malloc(v->NR * sizeof(int));
-    rperm = v->badguys;
-    for (i=0; i<v->NR; i++) {
-        int ri = v->refperm[i];
-        rperm[i] = ri;
-        refcopy[2*i+0] = v->refxy[2*ri+0];
-        refcopy[2*i+1] = v->refxy[2*ri+1];
-    }
-    rtree = kdtree_build(NULL, refcopy, v->NR, 2, Nleaf, KDTT_DOUBLE, KD_BUILD_SPLIT);
+    // Grid over the (good) index stars in pixel space, with cells
+    // about the size of the smallest 5-sigma search radius.  Results
+    // are indices into "v->refxy", as are "rmatches" and "rprobs".
+    minsig2 = HUGE_VAL;
+    for (i=0; i<v->NT; i++)
+        minsig2 = MIN(minsig2, v->testsigma[v->testperm[i]]);
+    rgrid = xygrid_new(v->refxy, v->refperm, v->NR, sqrt(25.0 * minsig2));
 
-    rmatches = malloc(v->NR * sizeof(int));
-    for (i=0; i<v->NR; i++)
+    rmatches = malloc(v->NRall * sizeof(int));
+    for (i=0; i<v->NRall; i++)
         rmatches[i] = -1;
 
-    rprobs = malloc(v->NR * sizeof(double));
-    for (i=0; i<v->NR; i++)
+    rprobs = malloc(v->NRall * sizeof(double));
+    for (i=0; i<v->NRall; i++)
         rprobs[i] = -HUGE_VAL;
 
     if (p_logodds || data_log_passes(DATALOG_MASK_VERIFY, DLOG_ODDS))
@@ -527,7 +622,6 @@ static double real_verify_star_lists(verify_t* v,
         const double* testxy;
         double sig2;
         int refi;
-        int tmpi;
         double d2;
         //double reallogfg;
         double logfg;
@@ -543,16 +637,14 @@ static double real_verify_star_lists(verify_t* v,
         debug2("test star %i: (%.1f,%.1f), sigma: %.1f\n", i, testxy[0], testxy[1], sqrt(sig2));
 
         // find nearest ref star (within 5 sigma)
-        tmpi = kdtree_nearest_neighbour_within(rtree, testxy, sig2 * 25.0, &d2);
-        if (tmpi == -1) {
+        refi = xygrid_nearest_within(rgrid, testxy, sig2 * 25.0, &d2);
+        if (refi == -1) {
             // no nearest neighbour within range.
             debug2("  No nearest neighbour.\n");
             refi = -1;
             logfg = -HUGE_VAL;
         } else {
             double loggmax;
-            // Note that "refi" is w.r.t. the "refcopy" array (not the original data).
-            refi = kdtree_permute(rtree, tmpi);
             // peak value of the Gaussian
             loggmax = log((1.0 - distractors) / (2.0 * M_PI * sig2 * v->NR));
             // FIXME - do something with uninformative hits?
@@ -613,9 +705,8 @@ static double real_verify_star_lists(verify_t* v,
                     // upgrade: old match becomes a distractor.
                     debug2("  Conflict: upgrading.\n");
                     theta[oldj] = THETA_CONFLICT;
-                    // Note that here we want the entries in "theta" to be
-                    // indices into "v->refxy" et al, so apply the "rperm" permutation.
-                    theta[i] = rperm[refi];
+                    // "theta" entries are indices into "v->refxy" et al.
+                    theta[i] = refi;
                     // record this new match.
                     rmatches[refi] = i;
                     rprobs[refi] = logfg;
@@ -661,7 +752,7 @@ static double real_verify_star_lists(verify_t* v,
                 // new match.
                 rmatches[refi] = i;
                 rprobs[refi] = logfg;
-                theta[i] = rperm[refi];
+                theta[i] = refi;
                 mu++;
             }
         }
@@ -767,8 +858,7 @@ static double real_verify_star_lists(verify_t* v,
 
     free(rprobs);
 
-    kdtree_free(rtree);
-    free(refcopy);
+    xygrid_free(rgrid);
 
     return bestlogodds;
 }
@@ -857,12 +947,12 @@ void verify_get_index_stars(const double* fieldcenter, double fieldr2,
 static anbool* verify_deduplicate_field_stars(verify_t* v, const verify_field_t* vf, double nsigmas) {
     anbool* keepers = NULL;
     int i, j, ti;
-    kdtree_qres_t* res = NULL;
+    il* res;
     double nsig2 = nsigmas*nsigmas;
-    int options = KD_OPTIONS_NO_RESIZE_RESULTS | KD_OPTIONS_SMALL_RADIUS;
 
     // default to FALSE
     keepers = calloc(v->NTall, sizeof(anbool));
+    res = il_new(16);
     for (i=0; i<v->NT; i++) {
         ti = v->testperm[i];
         keepers[ti] = TRUE;
@@ -873,9 +963,10 @@ static anbool* verify_deduplicate_field_stars(verify_t* v, const verify_field_t*
         if (!keepers[ti])
             continue;
         starxy_get(vf->field, ti, sxy);
-        res = kdtree_rangesearch_options_reuse(vf->ftree, res, sxy, nsig2 * v->testsigma[ti], options);
-        for (j=0; j<res->nres; j++) {
-            int ind = res->inds[j];
+        il_remove_all(res);
+        xygrid_range(vf->fgrid, sxy, nsig2 * v->testsigma[ti], res);
+        for (j=0; j<il_size(res); j++) {
+            int ind = il_get(res, j);
             if (ind > i) {
                 keepers[ind] = FALSE;
                 if (DEBUGVERIFY) {
@@ -888,7 +979,7 @@ static anbool* verify_deduplicate_field_stars(verify_t* v, const verify_field_t*
             }
         }
     }
-    kdtree_free_query(res);
+    il_free(res);
     return keepers;
 }
 
@@ -1288,7 +1379,19 @@ void verify_hit(const startree_t* skdt, int index_cutnside, MatchObj* mo,
      */
     assert(skdt->sweep);
     // Find all index stars within the bounding circle of the field.
-    startree_search_for(skdt, fieldcenter, fieldr2, &refxyz, NULL, &v->refstarid, &v->NRall);
+    {
+        SOLVER_STATS_START(vf->stats, t0);
+        if (vf->refcache) {
+            if (refcache_search(vf->refcache, skdt, fieldcenter, fieldr2,
+                                &refxyz, &v->refstarid, &v->NRall))
+                SOLVER_STATS_DO(vf->stats, vf->stats->refcache_hits++);
+            else
+                SOLVER_STATS_DO(vf->stats, vf->stats->refcache_misses++);
+        } else
+            startree_search_for(skdt, fieldcenter, fieldr2, &refxyz, NULL, &v->refstarid, &v->NRall);
+        SOLVER_STATS_STOP(vf->stats, SOLVER_STAGE_STARKD, t0);
+        SOLVER_STATS_HIST(vf->stats, starkd_nres, v->NRall);
+    }
     debug2("%i reference stars in the bounding circle\n", v->NRall);
     if (!refxyz) {
         // no stars in range.
@@ -1323,14 +1426,17 @@ void verify_hit(const startree_t* skdt, int index_cutnside, MatchObj* mo,
     // bottom "NRimage" of the "refperm" array will be accessed in the
     // permuted_sort below, so none of
     // the elements between NRimage and NRall will be touched.)
-    sweep = malloc(v->NRall * sizeof(int));
-    for (i=0; i<v->NRall; i++)
-        sweep[i] = skdt->sweep[v->refstarid[i]];
-    // Note here that we're passing in an existing permutation array; it
-    // gets re-permuted during this call.
-    permuted_sort(sweep, sizeof(int), compare_ints_asc, v->refperm, v->NR);
-    free(sweep);
-    sweep = NULL;
+    // (The reference-star cache returns the stars already in sweep order.)
+    if (!vf->refcache) {
+        sweep = malloc(v->NRall * sizeof(int));
+        for (i=0; i<v->NRall; i++)
+            sweep[i] = skdt->sweep[v->refstarid[i]];
+        // Note here that we're passing in an existing permutation array; it
+        // gets re-permuted during this call.
+        permuted_sort(sweep, sizeof(int), compare_ints_asc, v->refperm, v->NR);
+        free(sweep);
+        sweep = NULL;
+    }
     debug2("Found %i reference stars.\n", v->NR);
 
     // "refstarids" are indices into the star kdtree and could be used to
@@ -1370,6 +1476,19 @@ void verify_hit(const startree_t* skdt, int index_cutnside, MatchObj* mo,
         goto bailout;
     }
 
+    // Cheap coarse check of a few bright stars near the quad before the
+    // full machinery below.
+    if (!fake_match && vf->coarse_n > 0) {
+        double coarse = verify_coarse(v, vf, mo, pix2, distractors, fieldW, fieldH,
+                                      do_gamma, vf->coarse_n);
+        if (coarse < vf->coarse_logbail) {
+            debug2("Coarse pass: logodds %g below %g; rejecting.\n",
+                   coarse, vf->coarse_logbail);
+            SOLVER_STATS_DO(vf->stats, vf->stats->verify_coarse_rejected++);
+            goto bailout;
+        }
+    }
+
     ///// FIXME -- we could compute the RoR and search for ref stars
     // based on the quad center and RoR rather than the image center
     // and image radius.
@@ -1383,6 +1502,10 @@ void verify_hit(const startree_t* skdt, int index_cutnside, MatchObj* mo,
             logerr("After applying ROR, NR = 0!\n");
             goto bailout;
         }
+        // Examine the first few test stars in order of expected information.
+        if (vf->coarse_n > 0)
+            verify_order_by_information(v->testperm, MIN(v->NT, vf->coarse_n),
+                                        v->testsigma);
     } else {
         verify_get_test_stars(v, vf, mo, pix2, do_gamma, fake_match);
         effA = fieldW * fieldH;
@@ -1399,6 +1522,14 @@ void verify_hit(const startree_t* skdt, int index_cutnside, MatchObj* mo,
                                &ibailed, &istopped);
     mo->logodds = K;
     mo->worstlogodds = worst;
+#if AN_SOLVER_STATS
+    if (vf->stats) {
+        if (ibailed == -1)
+            vf->stats->verify_nobail++;
+        else
+            solver_stats_add_hist(vf->stats->verify_bail, ibailed + 1);
+    }
+#endif
     // NTall so that caller knows how big 'etheta' is.
     mo->nfield = v->NTall;
     // NRimage: only the stars inside the image bounds.
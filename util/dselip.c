@@ -31,25 +31,43 @@ void dselip_cleanup() {
 
 #else
 
-static int high_water_mark = 0;
-static float* past_data = NULL;
-
-float dselip(unsigned long k, unsigned long n, float *arr) {
-    if (n > high_water_mark) {
-        free(past_data);
-        past_data = malloc(sizeof(float) * n);
-        high_water_mark = n;
-        //printf("dselip watermark=%lu\n",n);
+// Scratch space, kept between calls; one per thread.
+struct dselip_cache {
+    unsigned long high_water_mark;
+    float* past_data;
+};
+
+static void* dselip_init_key(void* user) {
+    return calloc(1, sizeof(struct dselip_cache));
+}
+
+static void dselip_free_cache(void* v) {
+    struct dselip_cache* c = v;
+    free(c->past_data);
+    free(c);
+}
+#define TSNAME dselip
+#define TSFREE dselip_free_cache
+#include "thread-specific.inc"
+
+float dselip(unsigned long k, unsigned long n, const float *arr) {
+    struct dselip_cache* c = dselip_get_key(NULL);
+    if (n > c->high_water_mark) {
+        free(c->past_data);
+        c->past_data = malloc(sizeof(float) * n);
+        c->high_water_mark = n;
     }
-    memcpy(past_data, arr, sizeof(float) * n);
-    qsort(past_data, n, sizeof(float), compare_floats_asc);
-    return past_data[k];
+    memcpy(c->past_data, arr, sizeof(float) * n);
+    qsort(c->past_data, n, sizeof(float), compare_floats_asc);
+    return c->past_data[k];
 }
 
+// frees the calling thread's scratch space.
 void dselip_cleanup() {
-    free(past_data);
-    past_data = NULL;
-    high_water_mark = 0;
+    struct dselip_cache* c = dselip_get_key(NULL);
+    free(c->past_data);
+    c->past_data = NULL;
+    c->high_water_mark = 0;
 }
 
 #endif
@@ -11,9 +11,39 @@
 #include "errors.h"
 #include "ioutils.h"
 #include "an-bool.h"
+#include "an-thread.h"
 
-static pl* estack = NULL;
-static anbool atexit_registered = FALSE;
+// Each thread has its own stack of error-handling states, so errors
+// reported by one thread never land in (or corrupt) another's.
+static void estack_free(void* v) {
+    pl* estack = v;
+    int i;
+    for (i=0; i<pl_size(estack); i++) {
+        err_t* e = pl_get(estack, i);
+        error_free(e);
+    }
+    pl_free(estack);
+}
+
+static void* errts_init_key(void* user) {
+    return pl_new(4);
+}
+#define TSNAME errts
+#define TSFREE estack_free
+#include "thread-specific.inc"
+
+AN_THREAD_DECLARE_STATIC_ONCE(atexit_once);
+
+static void register_atexit(void) {
+    // free the main thread's stack; other threads' are freed when
+    // they exit.
+    atexit(errors_free);
+}
+
+static pl* get_estack(void) {
+    AN_THREAD_CALL_ONCE(atexit_once, register_atexit);
+    return errts_get_key(NULL);
+}
 
 static err_t* error_copy(err_t* e) {
     int i, N;
@@ -82,14 +112,7 @@ void errors_clear_stack() {
 }
 
 err_t* errors_get_state() {
-    if (!estack) {
-        estack = pl_new(4);
-        // register an atexit() function to clean up.
-        if (!atexit_registered) {
-            if (atexit(errors_free) == 0)
-                atexit_registered = TRUE;
-        }
-    } 
+    pl* estack = get_estack();
     if (!pl_size(estack)) {
         err_t* e = error_new();
         e->print = stderr;
@@ -99,22 +122,17 @@ err_t* errors_get_state() {
 }
 
 void errors_free() {
-    int i;
-    if (!estack)
-        return;
-    for (i=0; i<pl_size(estack); i++) {
-        err_t* e = pl_get(estack, i);
-        error_free(e);
-    }
-    pl_free(estack);
-    estack = NULL;
+    estack_free(get_estack());
+    errts_clear_key();
 }
 
 void errors_push_state() {
+    pl* estack;
     err_t* now;
     err_t* snapshot;
     // make sure the stack and current state are initialized
     errors_get_state();
+    estack = get_estack();
     now = pl_pop(estack);
     snapshot = error_copy(now);
     pl_push(estack, snapshot);
@@ -122,7 +140,7 @@ void errors_push_state() {
 }
 
 void errors_pop_state() {
-    err_t* now = pl_pop(estack);
+    err_t* now = pl_pop(get_estack());
     error_free(now);
 }
 
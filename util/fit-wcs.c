@@ -20,6 +20,232 @@
 #include "gslutils.h"
 #include "sip-utils.h"
 
+/*
+ Weighted least-squares fits in the SIP monomial basis, shared by
+ fit_sip_wcs() and fit_sip_coefficients().
+
+ The callers collect (u, v) -- pixel offsets from CRPIX -- a weight and
+ two targets per point, then solve for both right-hand sides at once.
+ The monomials are evaluated with (u, v) scaled into [-1, 1], which
+ keeps the problem well-conditioned even at high orders; the solution
+ is scaled back afterward.  By default we solve the normal equations
+ by Cholesky; if that fails, or the factorization suggests the system
+ is badly conditioned, we fall back to QR of the full design matrix.
+
+ The per-point arrays and the normal-equation matrix live in a
+ per-thread workspace, so repeated fits (eg, tweak iterations) don't
+ allocate.
+ */
+
+// largest number of coefficients: orders up to SIP_MAXORDER-1.
+#define SIP_LSQ_MAXN (SIP_MAXORDER * (SIP_MAXORDER + 1) / 2)
+
+// Fall back to QR if the (Jacobi-scaled) normal equations look worse
+// than this; the ratio of the largest to smallest Cholesky pivot,
+// squared, is a lower bound on the condition number.
+#define SIP_LSQ_MAX_COND 1e10
+
+struct sip_lsq {
+    // per-point data: M points, capacity "Nalloc".
+    int M;
+    int Nalloc;
+    double* u;
+    double* v;
+    double* w;
+    // targets, 2 per point.
+    double* b;
+    double ATA[SIP_LSQ_MAXN * SIP_LSQ_MAXN];
+    double ATb[SIP_LSQ_MAXN * 2];
+    double colscale[SIP_LSQ_MAXN];
+};
+
+static void* siplsq_init_key(void* user) {
+    return calloc(1, sizeof(struct sip_lsq));
+}
+static void siplsq_free_key(void* v) {
+    struct sip_lsq* lsq = v;
+    if (!lsq)
+        return;
+    free(lsq->u);
+    free(lsq->v);
+    free(lsq->w);
+    free(lsq->b);
+    free(lsq);
+}
+#define TSNAME siplsq
+#define TSFREE siplsq_free_key
+#include "thread-specific.inc"
+
+static struct sip_lsq* sip_lsq_get(int M) {
+    struct sip_lsq* lsq = siplsq_get_key(NULL);
+    if (M > lsq->Nalloc) {
+        lsq->u = realloc(lsq->u, M * sizeof(double));
+        lsq->v = realloc(lsq->v, M * sizeof(double));
+        lsq->w = realloc(lsq->w, M * sizeof(double));
+        lsq->b = realloc(lsq->b, M * 2 * sizeof(double));
+        lsq->Nalloc = M;
+    }
+    lsq->M = 0;
+    return lsq;
+}
+
+static void sip_lsq_add(struct sip_lsq* lsq, double u, double v, double w,
+                        double b1, double b2) {
+    int i = lsq->M;
+    assert(i < lsq->Nalloc);
+    lsq->u[i] = u;
+    lsq->v[i] = v;
+    lsq->w[i] = w;
+    lsq->b[2*i + 0] = b1;
+    lsq->b[2*i + 1] = b2;
+    lsq->M++;
+}
+
+/* Fills "row" with the monomials in the order the coefficients are
+ * stored:
+ *   p q
+ *  (0,0) = 1     <- order 0
+ *  (1,0) = u     <- order 1
+ *  (0,1) = v
+ *  (2,0) = u^2   <- order 2
+ *  (1,1) = uv
+ *  (0,2) = v^2
+ *  ...
+ */
+static void sip_lsq_row(double u, double v, int order, double* row) {
+    double upow[SIP_MAXORDER];
+    double vpow[SIP_MAXORDER];
+    int o, q, j;
+    upow[0] = vpow[0] = 1.0;
+    for (o=1; o<=order; o++) {
+        upow[o] = upow[o-1] * u;
+        vpow[o] = vpow[o-1] * v;
+    }
+    j = 0;
+    for (o=0; o<=order; o++)
+        for (q=0; q<=o; q++)
+            row[j++] = upow[o - q] * vpow[q];
+}
+
+static int sip_lsq_solve_qr(const struct sip_lsq* lsq, int order, int N,
+                            double scale, double* x1, double* x2) {
+    gsl_matrix* mA;
+    gsl_vector *b1, *b2, *gx1 = NULL, *gx2 = NULL;
+    double row[SIP_LSQ_MAXN];
+    int i, j, rtn;
+    mA = gsl_matrix_alloc(lsq->M, N);
+    b1 = gsl_vector_alloc(lsq->M);
+    b2 = gsl_vector_alloc(lsq->M);
+    for (i=0; i<lsq->M; i++) {
+        double w = lsq->w[i];
+        sip_lsq_row(lsq->u[i] * scale, lsq->v[i] * scale, order, row);
+        for (j=0; j<N; j++)
+            gsl_matrix_set(mA, i, j, w * row[j]);
+        gsl_vector_set(b1, i, w * lsq->b[2*i + 0]);
+        gsl_vector_set(b2, i, w * lsq->b[2*i + 1]);
+    }
+    rtn = gslutils_solve_leastsquares_v(mA, 2, b1, &gx1, NULL, b2, &gx2, NULL);
+    if (!rtn) {
+        for (j=0; j<N; j++) {
+            x1[j] = gsl_vector_get(gx1, j);
+            x2[j] = gsl_vector_get(gx2, j);
+        }
+    }
+    if (gx1)
+        gsl_vector_free(gx1);
+    if (gx2)
+        gsl_vector_free(gx2);
+    gsl_matrix_free(mA);
+    gsl_vector_free(b1);
+    gsl_vector_free(b2);
+    return rtn;
+}
+
+/*
+ Solves for the N = (order+1)(order+2)/2 coefficients (in sip_lsq_row()
+ order) minimizing sum_i (w_i (row_i . x - b_i))^2, for both sets of
+ targets.
+ */
+static int sip_lsq_solve(struct sip_lsq* lsq, int order, int flags,
+                         double* x1, double* x2) {
+    int N = (order + 1) * (order + 2) / 2;
+    double row[SIP_LSQ_MAXN];
+    double maxuv = 0.0;
+    double scale, s;
+    int i, j, k, o, q;
+    anbool solved = FALSE;
+
+    assert(order < SIP_MAXORDER);
+    for (i=0; i<lsq->M; i++)
+        maxuv = MAX(maxuv, MAX(fabs(lsq->u[i]), fabs(lsq->v[i])));
+    scale = (maxuv > 0) ? 1.0 / maxuv : 1.0;
+
+    if (!(flags & FIT_SIP_QR)) {
+        double* A = lsq->ATA;
+        double* B = lsq->ATb;
+        double dmin, dmax;
+        memset(A, 0, N * N * sizeof(double));
+        memset(B, 0, N * 2 * sizeof(double));
+        // lower triangle of A^T W^2 A, and A^T W^2 b.
+        for (i=0; i<lsq->M; i++) {
+            double w2 = square(lsq->w[i]);
+            double b1 = lsq->b[2*i + 0];
+            double b2 = lsq->b[2*i + 1];
+            sip_lsq_row(lsq->u[i] * scale, lsq->v[i] * scale, order, row);
+            for (j=0; j<N; j++) {
+                double wr = w2 * row[j];
+                double* Aj = A + j*N;
+                for (k=0; k<=j; k++)
+                    Aj[k] += wr * row[k];
+                B[2*j + 0] += wr * b1;
+                B[2*j + 1] += wr * b2;
+            }
+        }
+        // Jacobi-scale to unit diagonal, so the pivots say something
+        // about the conditioning.
+        for (j=0; j<N; j++)
+            lsq->colscale[j] = (A[j*N + j] > 0) ? 1.0 / sqrt(A[j*N + j]) : 0.0;
+        for (j=0; j<N; j++) {
+            for (k=0; k<=j; k++)
+                A[j*N + k] *= lsq->colscale[j] * lsq->colscale[k];
+            B[2*j + 0] *= lsq->colscale[j];
+            B[2*j + 1] *= lsq->colscale[j];
+        }
+        if (cholesky_solve(A, N, B, 2) == 0) {
+            dmin = dmax = A[0];
+            for (j=1; j<N; j++) {
+                dmin = MIN(dmin, A[j*N + j]);
+                dmax = MAX(dmax, A[j*N + j]);
+            }
+            if (square(dmax / dmin) < SIP_LSQ_MAX_COND) {
+                for (j=0; j<N; j++) {
+                    x1[j] = B[2*j + 0] * lsq->colscale[j];
+                    x2[j] = B[2*j + 1] * lsq->colscale[j];
+                }
+                solved = TRUE;
+            } else
+                logverb("SIP fit: normal equations are ill-conditioned "
+                        "(%g); using QR\n", square(dmax / dmin));
+        } else
+            logverb("SIP fit: normal equations are not positive definite; "
+                    "using QR\n");
+    }
+    if (!solved && sip_lsq_solve_qr(lsq, order, N, scale, x1, x2))
+        return -1;
+
+    // undo the scaling of (u, v).
+    j = 0;
+    for (o=0; o<=order; o++) {
+        s = pow(scale, o);
+        for (q=0; q<=o; q++) {
+            x1[j] *= s;
+            x2[j] *= s;
+            j++;
+        }
+    }
+    return 0;
+}
+
 int fit_sip_wcs_2(const double* starxyz,
                   const double* fieldxy,
                   const double* weights,
@@ -82,6 +308,20 @@ int fit_sip_wcs(const double* starxyz,
                 int inv_order,
                 int doshift,
                 sip_t* sipout) {
+    return fit_sip_wcs_flags(starxyz, fieldxy, weights, M, tanin1,
+                             sip_order, inv_order, doshift, 0, sipout);
+}
+
+int fit_sip_wcs_flags(const double* starxyz,
+                      const double* fieldxy,
+                      const double* weights,
+                      int M,
+                      const tan_t* tanin1,
+                      int sip_order,
+                      int inv_order,
+                      int doshift,
+                      int flags,
+                      sip_t* sipout) {
     int sip_coeffs;
     double xyzcrval[3];
     double cdinv[2][2];
@@ -89,10 +329,9 @@ int fit_sip_wcs(const double* starxyz,
     int N;
     int i, j, p, q, order;
     double totalweight;
-    int rtn;
-    gsl_matrix *mA;
-    gsl_vector *b1, *b2, *x1, *x2;
-    gsl_vector *r1=NULL, *r2=NULL;
+    double x1[SIP_LSQ_MAXN];
+    double x2[SIP_LSQ_MAXN];
+    struct sip_lsq* lsq;
     tan_t tanin2;
     int ngood;
     const tan_t* tanin = &tanin2;
@@ -119,12 +358,7 @@ int fit_sip_wcs(const double* starxyz,
         return -1;
     }
 
-    mA = gsl_matrix_alloc(M, N);
-    b1 = gsl_vector_alloc(M);
-    b2 = gsl_vector_alloc(M);
-    assert(mA);
-    assert(b1);
-    assert(b2);
+    lsq = sip_lsq_get(M);
 
     /*
      *  We use a clever trick to estimate CD, A, and B terms in two
@@ -262,41 +496,7 @@ int fit_sip_wcs(const double* starxyz,
                 continue;
         }
 
-        gsl_vector_set(b1, ngood, weight * rad2deg(x));
-        gsl_vector_set(b2, ngood, weight * rad2deg(y));
-
-        /* The coefficients are stored in this order:
-         *   p q
-         *  (0,0) = 1     <- order 0
-         *  (1,0) = u     <- order 1
-         *  (0,1) = v
-         *  (2,0) = u^2   <- order 2
-         *  (1,1) = uv
-         *  (0,2) = v^2
-         *  ...
-         */
-
-        j = 0;
-        for (order=0; order<=sip_order; order++) {
-            for (q=0; q<=order; q++) {
-                p = order - q;
-                assert(j >= 0);
-                assert(j < N);
-                assert(p >= 0);
-                assert(q >= 0);
-                assert(p + q <= sip_order);
-                gsl_matrix_set(mA, ngood, j,
-                               weight * pow(u, (double)p) * pow(v, (double)q));
-                j++;
-            }
-        }
-        assert(j == N);
-
-        // The shift - aka (0,0) - SIP coefficient must be 1.
-        assert(gsl_matrix_get(mA, i, 0) == 1.0 * weight);
-        assert(fabs(gsl_matrix_get(mA, i, 1) - u * weight) < 1e-12);
-        assert(fabs(gsl_matrix_get(mA, i, 2) - v * weight) < 1e-12);
-
+        sip_lsq_add(lsq, u, v, weight, rad2deg(x), rad2deg(y));
         ngood++;
     }
 
@@ -308,20 +508,7 @@ int fit_sip_wcs(const double* starxyz,
     if (weights)
         logverb("Total weight: %g\n", totalweight);
 
-    if (ngood < M) {
-        _gsl_vector_view sub_b1 = gsl_vector_subvector(b1, 0, ngood);
-        _gsl_vector_view sub_b2 = gsl_vector_subvector(b2, 0, ngood);
-        _gsl_matrix_view sub_mA = gsl_matrix_submatrix(mA, 0, 0, ngood, N);
-
-        rtn = gslutils_solve_leastsquares_v(&(sub_mA.matrix), 2,
-                                            &(sub_b1.vector), &x1, NULL,
-                                            &(sub_b2.vector), &x2, NULL);
-
-    } else {
-        // Solve the equation.
-        rtn = gslutils_solve_leastsquares_v(mA, 2, b1, &x1, NULL, b2, &x2, NULL);
-    }
-    if (rtn) {
+    if (sip_lsq_solve(lsq, sip_order, flags, x1, x2)) {
         ERROR("Failed to solve SIP matrix equation!");
         return -1;
     }
@@ -332,10 +519,10 @@ int fit_sip_wcs(const double* starxyz,
 
     if (doshift) {
         // Grab CD.
-        sipout->wcstan.cd[0][0] = gsl_vector_get(x1, 1);
-        sipout->wcstan.cd[0][1] = gsl_vector_get(x1, 2);
-        sipout->wcstan.cd[1][0] = gsl_vector_get(x2, 1);
-        sipout->wcstan.cd[1][1] = gsl_vector_get(x2, 2);
+        sipout->wcstan.cd[0][0] = x1[1];
+        sipout->wcstan.cd[0][1] = x1[2];
+        sipout->wcstan.cd[1][0] = x2[1];
+        sipout->wcstan.cd[1][1] = x2[2];
 
         // Compute inv(CD)
         i = invert_2by2_arr((const double*)(sipout->wcstan.cd),
@@ -343,8 +530,8 @@ int fit_sip_wcs(const double* starxyz,
         assert(i == 0);
 
         // Grab the shift.
-        sx = gsl_vector_get(x1, 0);
-        sy = gsl_vector_get(x2, 0);
+        sx = x1[0];
+        sy = x2[0];
 
     } else {
         // Compute inv(CD)
@@ -366,12 +553,12 @@ int fit_sip_wcs(const double* starxyz,
             assert(p + q <= sip_order);
 
             sipout->a[p][q] =
-                cdinv[0][0] * gsl_vector_get(x1, j) +
-                cdinv[0][1] * gsl_vector_get(x2, j);
+                cdinv[0][0] * x1[j] +
+                cdinv[0][1] * x2[j];
 
             sipout->b[p][q] =
-                cdinv[1][0] * gsl_vector_get(x1, j) +
-                cdinv[1][1] * gsl_vector_get(x2, j);
+                cdinv[1][0] * x1[j] +
+                cdinv[1][1] * x2[j];
             j++;
         }
     }
@@ -409,17 +596,6 @@ int fit_sip_wcs(const double* starxyz,
         wcs_shift(&(sipout->wcstan), -su, -sv);
     }
 
-    if (r1)
-        gsl_vector_free(r1);
-    if (r2)
-        gsl_vector_free(r2);
-
-    gsl_matrix_free(mA);
-    gsl_vector_free(b1);
-    gsl_vector_free(b2);
-    gsl_vector_free(x1);
-    gsl_vector_free(x2);
-
     return 0;
 }
 
@@ -435,14 +611,26 @@ int fit_sip_coefficients(const double* starxyz,
                          int sip_order,
                          int inv_order,
                          sip_t* sipout) {
+    return fit_sip_coefficients_flags(starxyz, fieldxy, weights, M, tanin1,
+                                      sip_order, inv_order, 0, sipout);
+}
+
+int fit_sip_coefficients_flags(const double* starxyz,
+                               const double* fieldxy,
+                               const double* weights,
+                               int M,
+                               const tan_t* tanin1,
+                               int sip_order,
+                               int inv_order,
+                               int flags,
+                               sip_t* sipout) {
     int sip_coeffs;
     int N;
     int i, j, p, q, order;
     double totalweight;
-    int rtn;
-    gsl_matrix *mA;
-    gsl_vector *b1, *b2, *x1, *x2;
-    gsl_vector *r1=NULL, *r2=NULL;
+    double x1[SIP_LSQ_MAXN];
+    double x2[SIP_LSQ_MAXN];
+    struct sip_lsq* lsq;
     tan_t tanin2;
     int ngood;
     const tan_t* tanin = &tanin2;
@@ -469,12 +657,7 @@ int fit_sip_coefficients(const double* starxyz,
         return -1;
     }
 
-    mA = gsl_matrix_alloc(M, N);
-    b1 = gsl_vector_alloc(M);
-    b2 = gsl_vector_alloc(M);
-    assert(mA);
-    assert(b1);
-    assert(b2);
+    lsq = sip_lsq_get(M);
 
     /**
      * We're going to fit for the "forward" SIP coefficients
@@ -524,36 +707,7 @@ int fit_sip_coefficients(const double* starxyz,
 
         /// AHA!, since SIP computes an "fuv","guv" to ADD to
         /// x,y to get x',y', b is the DIFFERENCE!
-        gsl_vector_set(b1, ngood, weight * (xprime - x));
-        gsl_vector_set(b2, ngood, weight * (yprime - y));
-
-        /* The coefficients are stored in this order:
-         *   p q
-         *  (0,0) = 1     <- order 0
-         *  (1,0) = u     <- order 1
-         *  (0,1) = v
-         *  (2,0) = u^2   <- order 2
-         *  (1,1) = uv
-         *  (0,2) = v^2
-         *  ...
-         */
-
-        j = 0;
-        for (order=0; order<=sip_order; order++) {
-            for (q=0; q<=order; q++) {
-                p = order - q;
-                assert(j >= 0);
-                assert(j < N);
-                assert(p >= 0);
-                assert(q >= 0);
-                assert(p + q <= sip_order);
-                gsl_matrix_set(mA, ngood, j,
-                               weight * pow(x, (double)p) * pow(y, (double)q));
-                j++;
-            }
-        }
-        assert(j == N);
-
+        sip_lsq_add(lsq, x, y, weight, xprime - x, yprime - y);
         ngood++;
     }
 
@@ -564,20 +718,7 @@ int fit_sip_coefficients(const double* starxyz,
     if (weights)
         logverb("Total weight: %g\n", totalweight);
 
-    if (ngood < M) {
-        _gsl_vector_view sub_b1 = gsl_vector_subvector(b1, 0, ngood);
-        _gsl_vector_view sub_b2 = gsl_vector_subvector(b2, 0, ngood);
-        _gsl_matrix_view sub_mA = gsl_matrix_submatrix(mA, 0, 0, ngood, N);
-
-        rtn = gslutils_solve_leastsquares_v(&(sub_mA.matrix), 2,
-                                            &(sub_b1.vector), &x1, NULL,
-                                            &(sub_b2.vector), &x2, NULL);
-
-    } else {
-        // Solve the equation.
-        rtn = gslutils_solve_leastsquares_v(mA, 2, b1, &x1, NULL, b2, &x2, NULL);
-    }
-    if (rtn) {
+    if (sip_lsq_solve(lsq, sip_order, flags, x1, x2)) {
         ERROR("Failed to solve SIP matrix equation!");
         return -1;
     }
@@ -592,24 +733,13 @@ int fit_sip_coefficients(const double* starxyz,
             assert(p >= 0);
             assert(q >= 0);
             assert(p + q <= sip_order);
-            sipout->a[p][q] = gsl_vector_get(x1, j);
-            sipout->b[p][q] = gsl_vector_get(x2, j);
+            sipout->a[p][q] = x1[j];
+            sipout->b[p][q] = x2[j];
             j++;
         }
     }
     assert(j == N);
 
-    if (r1)
-        gsl_vector_free(r1);
-    if (r2)
-        gsl_vector_free(r2);
-
-    gsl_matrix_free(mA);
-    gsl_vector_free(b1);
-    gsl_vector_free(b2);
-    gsl_vector_free(x1);
-    gsl_vector_free(x2);
-
     return 0;
 }
 
@@ -690,11 +820,14 @@ int fit_tan_wcs_solve(const double* starxyz,
     double w = 0;
     double totalw;
 
+    // (S and work are the rows of "Swork")
+    double Vdata[4], Swork[4];
     gsl_matrix* A;
     gsl_matrix* U;
-    gsl_matrix* V;
-    gsl_vector* S;
-    gsl_vector* work;
+    gsl_matrix_view vV;
+    gsl_matrix_view vSwork;
+    gsl_vector_view vS;
+    gsl_vector_view vwork;
     gsl_matrix_view vcov;
     gsl_matrix_view vR;
 
@@ -781,22 +914,21 @@ int fit_tan_wcs_solve(const double* starxyz,
         assert(isfinite(cov[i]));
 
     // -run SVD
-    V = gsl_matrix_alloc(2, 2);
-    S = gsl_vector_alloc(2);
-    work = gsl_vector_alloc(2);
+    vV = gsl_matrix_view_array(Vdata, 2, 2);
+    vSwork = gsl_matrix_view_array(Swork, 2, 2);
+    vS = gsl_matrix_row(&(vSwork.matrix), 0);
+    vwork = gsl_matrix_row(&(vSwork.matrix), 1);
     vcov = gsl_matrix_view_array(cov, 2, 2);
     vR   = gsl_matrix_view_array(R, 2, 2);
     A = &(vcov.matrix);
     // The Jacobi version doesn't always compute an orthonormal U if S has zeros.
     //gsl_linalg_SV_decomp_jacobi(A, V, S);
-    gsl_linalg_SV_decomp(A, V, S, work);
+    gsl_linalg_SV_decomp(A, &(vV.matrix), &(vS.vector), &(vwork.vector));
     // the U result is written to A.
     U = A;
-    gsl_vector_free(S);
-    gsl_vector_free(work);
     // R = V U'
-    gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, V, U, 0.0, &(vR.matrix));
-    gsl_matrix_free(V);
+    gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, &(vV.matrix), U, 0.0,
+                   &(vR.matrix));
 
     for (i=0; i<4; i++)
         assert(isfinite(R[i]));
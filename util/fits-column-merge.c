@@ -102,8 +102,8 @@ int main(int argc, char** args) {
     }
 
     if (atable->nr != btable->nr) {
-        fprintf(stderr, "Input tables must have the same number of rows: %i vs %i.\n",
-                atable->nr, btable->nr);
+        fprintf(stderr, "Input tables must have the same number of rows: %lld vs %lld.\n",
+                (long long)atable->nr, (long long)btable->nr);
         exit(-1);
     }
 
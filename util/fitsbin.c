@@ -8,6 +8,8 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <assert.h>
 
 #include "keywords.h"
@@ -28,6 +30,53 @@ struct fitsext {
 };
 typedef struct fitsext fitsext_t;
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static int map_policy = FITSBIN_MAP_LAZY;
+
+void fitsbin_set_map_policy(int policy) {
+    map_policy = policy;
+}
+
+int fitsbin_get_map_policy(void) {
+    return map_policy;
+}
+
+// FITSBIN_MAP_PRELOAD: reads "size" bytes at "offset" into an anonymous
+// mapping, so that free_chunk() can munmap() it like a file mapping.
+static int preload_chunk(fitsbin_t* fb, fitsbin_chunk_t* chunk,
+                         off_t offset, size_t size) {
+    int fd = fileno(fb->fid);
+    size_t done = 0;
+    chunk->mapsize = (size ? size : 1);
+    chunk->map = mmap(0, chunk->mapsize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk->map == MAP_FAILED) {
+        SYSERROR("Couldn't allocate %zu bytes for table \"%s\" of file \"%s\"",
+                 size, chunk->tablename, fb->filename);
+        chunk->map = NULL;
+        return -1;
+    }
+    while (done < size) {
+        ssize_t n = pread(fd, chunk->map + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            SYSERROR("Failed to read table \"%s\" from file \"%s\"",
+                     chunk->tablename, fb->filename);
+            munmap(chunk->map, chunk->mapsize);
+            chunk->map = NULL;
+            return -1;
+        }
+        done += n;
+    }
+    mprotect(chunk->map, chunk->mapsize, PROT_READ);
+    chunk->data = chunk->map;
+    return 0;
+}
+
 qfits_header* fitsbin_get_header(const fitsbin_t* fb, int ext) {
     assert(fb->fits);
     return anqfits_get_header(fb->fits, ext);
@@ -505,15 +554,25 @@ static int read_chunk(fitsbin_t* fb, fitsbin_chunk_t* chunk) {
                   (int)(tabsize / (off_t)FITS_BLOCK_SIZE));
             return -1;
         }
+        if (map_policy == FITSBIN_MAP_PRELOAD)
+            return preload_chunk(fb, chunk, tabstart, expected);
         get_mmap_size(tabstart, tabsize, &mapstart, &(chunk->mapsize), &mapoffset);
         mode = PROT_READ;
         flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        if (map_policy == FITSBIN_MAP_POPULATE)
+            flags |= MAP_POPULATE;
+#endif
         chunk->map = mmap(0, chunk->mapsize, mode, flags, fileno(fb->fid), mapstart);
         if (chunk->map == MAP_FAILED) {
             SYSERROR("Couldn't mmap file \"%s\"", fb->filename);
             chunk->map = NULL;
             return -1;
         }
+#ifndef MAP_POPULATE
+        if (map_policy == FITSBIN_MAP_POPULATE)
+            madvise(chunk->map, chunk->mapsize, MADV_WILLNEED);
+#endif
         chunk->data = chunk->map + mapoffset;
     }
     return 0;
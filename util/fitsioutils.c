@@ -23,6 +23,7 @@
 #include "an-endian.h"
 #include "errors.h"
 #include "log.h"
+#include "an-thread.h"
 #include "errors.h"
 
 Malloc
@@ -1039,15 +1040,16 @@ int fits_blocks_needed(int size) {
 }
 
 static char fits_endian_string[16];
-static int  fits_endian_string_inited = 0;
+AN_THREAD_DECLARE_STATIC_ONCE(fits_endian_string_once);
+
+static void fits_make_endian_string(void) {
+    uint32_t endian = ENDIAN_DETECTOR;
+    unsigned char* cptr = (unsigned char*)&endian;
+    sprintf(fits_endian_string, "%02x:%02x:%02x:%02x", (uint)cptr[0], (uint)cptr[1], (uint)cptr[2], (uint)cptr[3]);
+}
 
 static void fits_init_endian_string() {
-    if (!fits_endian_string_inited) {
-        uint32_t endian = ENDIAN_DETECTOR;
-        unsigned char* cptr = (unsigned char*)&endian;
-        fits_endian_string_inited = 1;
-        sprintf(fits_endian_string, "%02x:%02x:%02x:%02x", (uint)cptr[0], (uint)cptr[1], (uint)cptr[2], (uint)cptr[3]);
-    }
+    AN_THREAD_CALL_ONCE(fits_endian_string_once, fits_make_endian_string);
 }
 
 void fits_fill_endian_string(char* str) {
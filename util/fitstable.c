@@ -3,6 +3,7 @@
  # Licensed under a 3-clause BSD style license - see LICENSE
  */
 
+#include <limits.h>
 #include <string.h>
 #include <assert.h>
 #include <stdarg.h>
@@ -68,7 +69,7 @@ static fitscol_t* getcol(const fitstable_t* t, int i) {
     return bl_access(t->cols, i);
 }
 
-static off_t get_row_offset(const fitstable_t* table, int row) {
+static off_t get_row_offset(const fitstable_t* table, int64_t row) {
     assert(table->end_table_offset);
     assert(table->table);
     assert(table->table->tab_w);
@@ -188,18 +189,18 @@ int fitstable_ncols(const fitstable_t* t) {
     return ncols(t);
 }
 
-int fitstable_read_row_data(fitstable_t* table, int row, void* dest) {
+int fitstable_read_row_data(fitstable_t* table, int64_t row, void* dest) {
     return fitstable_read_nrows_data(table, row, 1, dest);
 }
 
-int fitstable_read_nrows_data(fitstable_t* table, int row0, int nrows,
+int fitstable_read_nrows_data(fitstable_t* table, int64_t row0, int nrows,
                               void* dest) {
     int R;
     size_t nread;
     off_t off;
     assert(table);
     assert(row0 >= 0);
-    assert((row0 + nrows) <= fitstable_nrows(table));
+    assert((row0 + nrows) <= fitstable_nrows64(table));
     assert(dest);
     R = fitstable_row_size(table);
     if (in_memory(table)) {
@@ -228,7 +229,7 @@ int fitstable_read_nrows_data(fitstable_t* table, int row0, int nrows,
     }
     nread = (size_t)R * (size_t)nrows;
     if (fread(dest, 1, nread, table->readfid) != nread) {
-        SYSERROR("Failed to read %i rows starting from %i, from %s", nrows, row0, table->fn);
+        SYSERROR("Failed to read %i rows starting from %lld, from %s", nrows, (long long)row0, table->fn);
         return -1;
     }
     return 0;
@@ -286,16 +287,20 @@ int fitstable_write_row_data(fitstable_t* table, void* data) {
     return write_row_data(table, data, 0);
 }
 
-int fitstable_copy_rows_data(fitstable_t* intable, int* rows, int N, fitstable_t* outtable) {
+// Either "rows" or "rows64" (or neither, meaning rows 0 to N-1) is given.
+static int copy_rows_data(fitstable_t* intable, const int* rows,
+                          const int64_t* rows64, int64_t N,
+                          fitstable_t* outtable) {
     int R;
     char* buf = NULL;
-    int i;
+    int64_t i;
     // We need to endian-flip if we're going from FITS file <--> memory.
     anbool flip = need_endian_flip() && (in_memory(intable) != in_memory(outtable));
     R = fitstable_row_size(intable);
     buf = malloc(R);
     for (i=0; i<N; i++) {
-        if (fitstable_read_row_data(intable, rows ? rows[i] : i, buf)) {
+        int64_t row = (rows ? rows[i] : (rows64 ? rows64[i] : i));
+        if (fitstable_read_row_data(intable, row, buf)) {
             ERROR("Failed to read data from input table");
             return -1;
         }
@@ -316,6 +321,15 @@ int fitstable_copy_rows_data(fitstable_t* intable, int* rows, int N, fitstable_t
     return 0;
 }
 
+int fitstable_copy_rows_data(fitstable_t* intable, int* rows, int N, fitstable_t* outtable) {
+    return copy_rows_data(intable, rows, NULL, N, outtable);
+}
+
+int fitstable_copy_rows_data64(fitstable_t* intable, const int64_t* rows,
+                               int64_t N, fitstable_t* outtable) {
+    return copy_rows_data(intable, NULL, rows, N, outtable);
+}
+
 int fitstable_copy_row_data(fitstable_t* table, int row, fitstable_t* outtable) {
     return fitstable_copy_rows_data(table, &row, 1, outtable);
 }
@@ -867,7 +881,7 @@ void fitstable_clear_table(fitstable_t* tab) {
 static void* read_array_into(const fitstable_t* tab,
                              const char* colname, tfits_type ctype,
                              anbool array_ok,
-                             int offset, const int* inds, int Nread,
+                             int64_t offset, const int* inds, int Nread,
                              void* dest, int deststride,
                              int desired_arraysize,
                              int* p_arraysize) {
@@ -883,7 +897,7 @@ static void* read_array_into(const fitstable_t* tab,
     char* fitsdata;
     int cstride;
     int fitsstride;
-    int N;
+    int64_t N;
 
     colnum = fits_find_column(tab->table, colname);
     if (colnum == -1) {
@@ -908,15 +922,22 @@ static void* read_array_into(const fitstable_t* tab,
     fitssize = fits_get_atom_size(fitstype);
     csize = fits_get_atom_size(ctype);
     N = tab->table->nr;
-    if (Nread == -1)
+    if (Nread == -1) {
+        if (N > INT_MAX) {
+            ERROR("Column \"%s\" in FITS table %s has %lld rows; read it in pieces "
+                  "with fitstable_read_column_offset_into()", colname, tab->fn,
+                  (long long)N);
+            return NULL;
+        }
         Nread = N;
+    }
     if (offset == -1)
         offset = 0;
 
     if (dest)
         cdata = dest;
     else
-        cdata = calloc(Nread * arraysize, csize);
+        cdata = calloc((size_t)Nread * arraysize, csize);
 
     if (dest && deststride > 0)
         cstride = deststride;
@@ -927,7 +948,7 @@ static void* read_array_into(const fitstable_t* tab,
     if (csize < fitssize) {
         // Need to allocate a bigger temp array and down-convert the data.
         // HACK - could set data=tempdata and realloc after (if 'dest' is NULL)
-        tempdata = calloc(Nread * arraysize, fitssize);
+        tempdata = calloc((size_t)Nread * arraysize, fitssize);
         fitsdata = tempdata;
     } else {
         // We'll read the data into the first fraction of the output array.
@@ -943,19 +964,19 @@ static void* read_array_into(const fitstable_t* tab,
             return NULL;
         }
         if (offset + Nread > bl_size(tab->rows)) {
-            ERROR("Number of data items requested exceeds number of rows: offset %i, n %i, nrows %zu", offset, Nread, bl_size(tab->rows));
+            ERROR("Number of data items requested exceeds number of rows: offset %lld, n %i, nrows %zu", (long long)offset, Nread, bl_size(tab->rows));
             return NULL;
         }
         off = fits_offset_of_column(tab->table, colnum);
         sz = fitsstride;
         if (inds) {
             for (i=0; i<Nread; i++)
-                memcpy(fitsdata + i * fitsstride,
+                memcpy(fitsdata + (size_t)i * fitsstride,
                        ((char*)bl_access(tab->rows, inds[i])) + off,
                        sz);
         } else {
             for (i=0; i<Nread; i++)
-                memcpy(fitsdata + i * fitsstride,
+                memcpy(fitsdata + (size_t)i * fitsstride,
                        ((char*)bl_access(tab->rows, offset+i)) + off,
                        sz);
         }
@@ -1030,7 +1051,7 @@ void* fitstable_read_column_array_inds(const fitstable_t* tab,
 
 int fitstable_read_column_offset_into(const fitstable_t* tab,
                                       const char* colname, tfits_type read_as_type,
-                                      void* dest, int stride, int start, int N) {
+                                      void* dest, int stride, int64_t start, int N) {
     return (read_array_into(tab, colname, read_as_type, FALSE, start, NULL, N, dest, stride, 0, NULL)
             == NULL ? -1 : 0);
 }
@@ -1539,7 +1560,7 @@ int fitstable_pad_with(fitstable_t* t, char pad) {
 
 int fitstable_fix_header(fitstable_t* t) {
     // update NAXIS2 to reflect the number of rows written.
-    fits_header_mod_int(t->header, "NAXIS2", t->table->nr, NULL);
+    fits_header_modf(t->header, "NAXIS2", NULL, "%lld", (long long)t->table->nr);
 
     if (in_memory(t)) return 0;
 
@@ -1569,6 +1590,16 @@ void fitstable_close_table(fitstable_t* tab) {
 }
 
 int fitstable_nrows(const fitstable_t* t) {
+    if (!t->table) return 0;
+    if (t->table->nr > INT_MAX) {
+        ERROR("FITS table %s has %lld rows, too many for fitstable_nrows(); "
+              "use fitstable_nrows64()", t->fn, (long long)t->table->nr);
+        return -1;
+    }
+    return t->table->nr;
+}
+
+int64_t fitstable_nrows64(const fitstable_t* t) {
     if (!t->table) return 0;
     return t->table->nr;
 }
@@ -0,0 +1,186 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "os-features.h"
+#include "hpspill.h"
+#include "ioutils.h"
+#include "errors.h"
+#include "log.h"
+
+struct hpspill {
+    int NHP;
+    int rowsize;
+    size_t budget;
+    const char* tempdir;
+    char** fns;
+    char** bufs;
+    size_t* nbuf;
+    size_t* cap;
+    int64_t* nrows;
+    size_t total;
+};
+
+hpspill_t* hpspill_new(int NHP, int rowsize, size_t budget,
+                       const char* tempdir) {
+    hpspill_t* sp = calloc(1, sizeof(hpspill_t));
+    if (!sp) {
+        SYSERROR("Failed to allocate healpix spill buffers");
+        return NULL;
+    }
+    sp->NHP = NHP;
+    sp->rowsize = rowsize;
+    sp->budget = budget;
+    sp->tempdir = tempdir;
+    sp->fns = calloc(NHP, sizeof(char*));
+    sp->bufs = calloc(NHP, sizeof(char*));
+    sp->nbuf = calloc(NHP, sizeof(size_t));
+    sp->cap = calloc(NHP, sizeof(size_t));
+    sp->nrows = calloc(NHP, sizeof(int64_t));
+    if (!sp->fns || !sp->bufs || !sp->nbuf || !sp->cap || !sp->nrows) {
+        SYSERROR("Failed to allocate healpix spill buffers for %i healpixes",
+                 NHP);
+        hpspill_free(sp);
+        return NULL;
+    }
+    return sp;
+}
+
+void hpspill_free(hpspill_t* sp) {
+    int i;
+    if (!sp)
+        return;
+    for (i=0; i<sp->NHP; i++) {
+        if (sp->fns && sp->fns[i])
+            hpspill_remove(sp, i);
+        if (sp->bufs)
+            free(sp->bufs[i]);
+    }
+    free(sp->fns);
+    free(sp->bufs);
+    free(sp->nbuf);
+    free(sp->cap);
+    free(sp->nrows);
+    free(sp);
+}
+
+int hpspill_flush(hpspill_t* sp) {
+    int hp;
+    logverb("Spilling %zu bytes of buffered rows\n", sp->total);
+    for (hp=0; hp<sp->NHP; hp++) {
+        FILE* fid;
+        if (!sp->nbuf[hp])
+            continue;
+        if (!sp->fns[hp]) {
+            sp->fns[hp] = create_temp_file("hpspill", sp->tempdir);
+            if (!sp->fns[hp])
+                return -1;
+        }
+        fid = fopen(sp->fns[hp], "ab");
+        if (!fid) {
+            SYSERROR("Failed to open spill file \"%s\"", sp->fns[hp]);
+            return -1;
+        }
+        if (fwrite(sp->bufs[hp], 1, sp->nbuf[hp], fid) != sp->nbuf[hp] ||
+            fclose(fid)) {
+            SYSERROR("Failed to write spill file \"%s\"", sp->fns[hp]);
+            return -1;
+        }
+        free(sp->bufs[hp]);
+        sp->bufs[hp] = NULL;
+        sp->nbuf[hp] = sp->cap[hp] = 0;
+    }
+    sp->total = 0;
+    return 0;
+}
+
+int hpspill_append(hpspill_t* sp, int hp, const void* row) {
+    if (hp < 0 || hp >= sp->NHP) {
+        ERROR("Healpix %i is out of range [0, %i)", hp, sp->NHP);
+        return -1;
+    }
+    if (sp->nbuf[hp] + sp->rowsize > sp->cap[hp]) {
+        size_t newcap = MAX(sp->cap[hp] * 2, 64 * (size_t)sp->rowsize);
+        char* newbuf = realloc(sp->bufs[hp], newcap);
+        if (!newbuf) {
+            SYSERROR("Failed to grow healpix %i row buffer", hp);
+            return -1;
+        }
+        sp->total += newcap - sp->cap[hp];
+        sp->bufs[hp] = newbuf;
+        sp->cap[hp] = newcap;
+    }
+    memcpy(sp->bufs[hp] + sp->nbuf[hp], row, sp->rowsize);
+    sp->nbuf[hp] += sp->rowsize;
+    sp->nrows[hp]++;
+    if (sp->total > sp->budget)
+        return hpspill_flush(sp);
+    return 0;
+}
+
+int64_t hpspill_nrows(const hpspill_t* sp, int hp) {
+    return sp->nrows[hp];
+}
+
+FILE* hpspill_open(const hpspill_t* sp, int hp) {
+    FILE* fid;
+    if (!sp->fns[hp])
+        return NULL;
+    fid = fopen(sp->fns[hp], "rb");
+    if (!fid)
+        SYSERROR("Failed to open spill file \"%s\"", sp->fns[hp]);
+    return fid;
+}
+
+void* hpspill_read(const hpspill_t* sp, int hp) {
+    size_t nfile;
+    char* data;
+    if (!sp->nrows[hp])
+        return NULL;
+    data = malloc(sp->nrows[hp] * sp->rowsize);
+    if (!data) {
+        SYSERROR("Failed to allocate %lli rows for healpix %i",
+                 (long long)sp->nrows[hp], hp);
+        return NULL;
+    }
+    nfile = sp->nrows[hp] - sp->nbuf[hp] / sp->rowsize;
+    if (nfile) {
+        FILE* fid = hpspill_open(sp, hp);
+        if (!fid) {
+            free(data);
+            return NULL;
+        }
+        if (fread(data, sp->rowsize, nfile, fid) != nfile) {
+            SYSERROR("Failed to read spill file \"%s\"", sp->fns[hp]);
+            fclose(fid);
+            free(data);
+            return NULL;
+        }
+        fclose(fid);
+    }
+    if (sp->nbuf[hp])
+        memcpy(data + nfile * sp->rowsize, sp->bufs[hp], sp->nbuf[hp]);
+    return data;
+}
+
+int hpspill_remove(hpspill_t* sp, int hp) {
+    int rtn = 0;
+    if (sp->fns[hp]) {
+        if (unlink(sp->fns[hp])) {
+            SYSERROR("Failed to delete spill file \"%s\"", sp->fns[hp]);
+            rtn = -1;
+        }
+        free(sp->fns[hp]);
+        sp->fns[hp] = NULL;
+    }
+    sp->total -= sp->cap[hp];
+    free(sp->bufs[hp]);
+    sp->bufs[hp] = NULL;
+    sp->nbuf[hp] = sp->cap[hp] = 0;
+    sp->nrows[hp] = 0;
+    return rtn;
+}
@@ -10,10 +10,12 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "os-features.h"
 #include "healpix.h"
 #include "healpix-utils.h"
+#include "hpspill.h"
 #include "starutil.h"
 #include "errors.h"
 #include "log.h"
@@ -34,7 +36,7 @@
  rows that are within (or within range) of the healpix.
  */
 
-const char* OPTIONS = "hvn:r:d:m:o:gc:e:t:b:RC";
+const char* OPTIONS = "hvn:r:d:m:o:gc:e:t:b:RCM:j:";
 
 void printHelp(char* progname) {
     BOILERPLATE_HELP_HEADER(stdout);
@@ -49,6 +51,9 @@ void printHelp(char* progname) {
            "    [-c <name>]: copy given column name to the output files\n"
            "    [-e <name>]: copy given column name to the output files, converting to FITS type E (float)\n"
            "    [-C]: close output files after each input file has been read\n"
+           "    [-M <MB>]: out-of-core mode: buffer rows per healpix, in at most this\n"
+           "              much memory, spilling to temp files; then write the outputs\n"
+           "    [-j <threads>]: with -M, write this many outputs at once; default 1\n"
            "    [-t <temp-dir>]: use the given temp dir; default is /tmp\n"
            "    [-b <backref-file>]: save the filenumber->filename map in this file; enables writing backreferences too\n"
            "    [-v]: +verbose\n"
@@ -64,6 +69,229 @@ struct cap_s {
 };
 typedef struct cap_s cap_t;
 
+/*
+ Output options, shared by the direct and out-of-core modes.
+ */
+struct output_s {
+    const char* outfnpat;
+    anbool ringindex;
+    int nside;
+    // input table, for the column structure.
+    fitstable_t* intable;
+    // same, with its columns added as a struct, for endian-flipping.
+    fitstable_t* intable2;
+    sl* cols;
+    sl* e_cols;
+    anbool anycols;
+    anbool backref;
+    // input row size
+    int R;
+};
+typedef struct output_s output_t;
+
+static fitstable_t* open_output(const output_t* o, int hp) {
+    char* outfn;
+    fitstable_t* out;
+
+    // MEMLEAK the output filename.  You'll live.
+    if (o->ringindex) {
+        int ringhp = healpix_xy_to_ring(hp, o->nside);
+        logverb("Ring-indexed healpix: %i (xy index: %i)\n", ringhp,hp);
+        asprintf_safe(&outfn, o->outfnpat, ringhp);
+    } else {
+        asprintf_safe(&outfn, o->outfnpat, hp);
+    }
+
+    logmsg("Opening output file \"%s\"...\n", outfn);
+    out = fitstable_open_for_writing(outfn);
+    if (!out) {
+        ERROR("Failed to open output table \"%s\"", outfn);
+        return NULL;
+    }
+    // Set the output table structure.
+    if (o->anycols) {
+        if (o->cols)
+            fitstable_add_fits_columns_as_struct3(o->intable, out, o->cols, 0);
+        if (o->e_cols)
+            fitstable_add_fits_columns_as_struct4(o->intable, out, o->e_cols, 0, TFITS_BIN_TYPE_E);
+
+    } else
+        fitstable_add_fits_columns_as_struct2(o->intable, out);
+
+    if (o->backref) {
+        tfits_type i16type;
+        tfits_type i32type;
+        int off = o->R;
+        i16type = fitscolumn_i16_type();
+        i32type = fitscolumn_i32_type();
+        fitstable_add_read_column_struct(out, i16type, 1, off,
+                                         i16type, "backref_file", TRUE);
+        off += sizeof(int16_t);
+        fitstable_add_read_column_struct(out, i32type, 1, off,
+                                         i32type, "backref_index", TRUE);
+    }
+
+    if (fitstable_write_primary_header(out) ||
+        fitstable_write_header(out)) {
+        ERROR("Failed to write output file headers for \"%s\"", outfn);
+        return NULL;
+    }
+    return out;
+}
+
+// Writes one row (input format, plus backrefs) to an output table.
+static int write_output_row(const output_t* o, fitstable_t* out,
+                            void* rdata) {
+    if (o->anycols) {
+        fitstable_endian_flip_row_data(o->intable2, rdata);
+        return fitstable_write_struct(out, rdata);
+    }
+    return fitstable_write_row_data(out, rdata);
+}
+
+/*
+ Out-of-core mode: rows are binned by healpix with hpspill (which
+ spills them to temp files when they outgrow the memory budget).  At
+ the end, the output files are written from the spill files, by
+ several threads at once.
+ */
+struct spill_s {
+    hpspill_t* spill;
+    int NHP;
+    int rowsize;
+    size_t budget;
+
+    // for the output phase
+    const output_t* out;
+    int nexthp;
+    int failed;
+    pthread_mutex_t lock;
+};
+typedef struct spill_s spill_t;
+
+static spill_t* spill_new(int NHP, int rowsize, size_t budget,
+                          const char* tempdir) {
+    spill_t* sp = calloc(1, sizeof(spill_t));
+    assert(sp);
+    sp->NHP = NHP;
+    sp->rowsize = rowsize;
+    sp->budget = budget;
+    sp->spill = hpspill_new(NHP, rowsize, budget, tempdir);
+    assert(sp->spill);
+    pthread_mutex_init(&sp->lock, NULL);
+    return sp;
+}
+
+static void spill_free(spill_t* sp) {
+    hpspill_free(sp->spill);
+    pthread_mutex_destroy(&sp->lock);
+    free(sp);
+}
+
+static int spill_write_output(spill_t* sp, int hp, char* buf, size_t bufrows) {
+    fitstable_t* out;
+    FILE* fid;
+    int64_t r, nrows;
+    int rtn = -1;
+
+    // (the fitstable and qfits header code isn't thread-safe)
+    pthread_mutex_lock(&sp->lock);
+    out = open_output(sp->out, hp);
+    pthread_mutex_unlock(&sp->lock);
+    if (!out)
+        return -1;
+    fid = hpspill_open(sp->spill, hp);
+    if (!fid)
+        goto bailout;
+    nrows = hpspill_nrows(sp->spill, hp);
+    for (r=0; r<nrows;) {
+        size_t j, n = MIN(bufrows, (size_t)(nrows - r));
+        if (fread(buf, sp->rowsize, n, fid) != n) {
+            SYSERROR("Failed to read spill file for healpix %i", hp);
+            goto bailout;
+        }
+        for (j=0; j<n; j++) {
+            if (write_output_row(sp->out, out, buf + j * sp->rowsize)) {
+                ERROR("Failed to write a row to output healpix %i", hp);
+                goto bailout;
+            }
+        }
+        r += n;
+    }
+    rtn = 0;
+ bailout:
+    if (fid)
+        fclose(fid);
+    pthread_mutex_lock(&sp->lock);
+    hpspill_remove(sp->spill, hp);
+    if (fitstable_fix_header(out) ||
+        fitstable_fix_primary_header(out) ||
+        fitstable_close(out)) {
+        ERROR("Failed to close output table for healpix %i", hp);
+        rtn = -1;
+    }
+    pthread_mutex_unlock(&sp->lock);
+    return rtn;
+}
+
+static void* spill_output_thread(void* v) {
+    spill_t* sp = v;
+    size_t bufrows = MAX(1, sp->budget / sp->rowsize);
+    char* buf = malloc(bufrows * sp->rowsize);
+    if (!buf) {
+        SYSERROR("Failed to allocate output buffer");
+        pthread_mutex_lock(&sp->lock);
+        sp->failed = 1;
+        pthread_mutex_unlock(&sp->lock);
+        return NULL;
+    }
+    for (;;) {
+        int hp;
+        pthread_mutex_lock(&sp->lock);
+        hp = sp->nexthp++;
+        pthread_mutex_unlock(&sp->lock);
+        if (hp >= sp->NHP)
+            break;
+        if (!hpspill_nrows(sp->spill, hp))
+            continue;
+        if (spill_write_output(sp, hp, buf, bufrows)) {
+            pthread_mutex_lock(&sp->lock);
+            sp->failed = 1;
+            pthread_mutex_unlock(&sp->lock);
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+// Writes all the output files from the spill files, using "nthreads"
+// threads.  Each thread's read buffer gets a share of the budget.
+static int spill_write_outputs(spill_t* sp, const output_t* out,
+                               int nthreads) {
+    pthread_t* threads;
+    int i, nstarted = 0;
+    if (hpspill_flush(sp->spill))
+        return -1;
+    nthreads = MAX(1, nthreads);
+    sp->out = out;
+    sp->nexthp = 0;
+    sp->budget = MAX(1, sp->budget / nthreads);
+    threads = malloc(nthreads * sizeof(pthread_t));
+    assert(threads);
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + nstarted, NULL, spill_output_thread, sp)) {
+            SYSERROR("Failed to start output thread");
+            break;
+        }
+        nstarted++;
+    }
+    spill_output_thread(sp);
+    for (i=0; i<nstarted; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    return (sp->failed ? -1 : 0);
+}
+
 static int refill_rowbuffer(void* baton, void* buffer,
                             unsigned int offset, unsigned int nelems) {
     fitstable_t* table = baton;
@@ -92,6 +320,10 @@ int main(int argc, char *argv[]) {
     anbool ringindex = FALSE;
     anbool closefiles = FALSE;
     off_t* resume_offsets = NULL;
+    double membudget = 0;
+    int nthreads = 1;
+    spill_t* spill = NULL;
+    output_t outopts;
     
     fitstable_t* intable;
     fitstable_t* intable2;
@@ -108,6 +340,12 @@ int main(int argc, char *argv[]) {
         case 'C':
             closefiles = TRUE;
             break;
+        case 'M':
+            membudget = atof(optarg);
+            break;
+        case 'j':
+            nthreads = atoi(optarg);
+            break;
         case 'R':
             ringindex = TRUE;
             break;
@@ -182,6 +420,20 @@ int main(int argc, char *argv[]) {
     outtables = calloc(NHP, sizeof(fitstable_t*));
     assert(outtables);
 
+    if (membudget > 0 && closefiles) {
+        logmsg("Out-of-core mode (-M) never holds output files open; ignoring -C.\n");
+        closefiles = FALSE;
+    }
+
+    memset(&outopts, 0, sizeof(output_t));
+    outopts.outfnpat = outfnpat;
+    outopts.ringindex = ringindex;
+    outopts.nside = nside;
+    outopts.cols = cols;
+    outopts.e_cols = e_cols;
+    outopts.anycols = anycols;
+    outopts.backref = (backref != NULL);
+
     if (closefiles) {
         // In order to reduce the number of open output files, we're
         // going to close output files after we finished reading each
@@ -375,6 +627,17 @@ int main(int argc, char *argv[]) {
         R = fitstable_row_size(intable);
         rowbuf = buffered_read_new(R, 1000, NR, refill_rowbuffer, intable);
 
+        if (!outopts.intable) {
+            // The inputs all have the same format; keep the first one
+            // open to describe the outputs.
+            outopts.intable = intable;
+            outopts.intable2 = intable2;
+            outopts.R = R;
+        }
+        if (membudget > 0 && !spill)
+            spill = spill_new(NHP, R + (backref ? sizeof(int16_t) + sizeof(int32_t) : 0),
+                              (size_t)(membudget * 1024 * 1024), tempdir);
+
         if (fitstable_read_extension(intable, 1)) {
             ERROR("Failed to find RA and DEC columns (called \"%s\" and \"%s\" in the FITS file)", racol, deccol);
             exit(-1);
@@ -457,56 +720,10 @@ int main(int argc, char *argv[]) {
                 assert(hp >= 0);
 
                 // Open output file if necessary
-                if (!outtables[hp]) {
-                    char* outfn;
-                    fitstable_t* out;
-                    
-                    // MEMLEAK the output filename.  You'll live.
-                    if (ringindex) {
-                        int ringhp = healpix_xy_to_ring(hp, nside);
-                        logverb("Ring-indexed healpix: %i (xy index: %i)\n", ringhp,hp);
-                        asprintf_safe(&outfn, outfnpat, ringhp);
-                    } else {
-                        asprintf_safe(&outfn, outfnpat, hp);
-                    }
-
-                    logmsg("Opening output file \"%s\"...\n", outfn);
-                    out = fitstable_open_for_writing(outfn);
-                    if (!out) {
-                        ERROR("Failed to open output table \"%s\"", outfn);
+                if (!spill && !outtables[hp]) {
+                    outtables[hp] = open_output(&outopts, hp);
+                    if (!outtables[hp])
                         exit(-1);
-                    }
-                    // Set the output table structure.
-                    if (anycols) {
-                        if (cols)
-                            fitstable_add_fits_columns_as_struct3(intable, out, cols, 0);
-                        if (e_cols)
-                            fitstable_add_fits_columns_as_struct4(intable, out, e_cols, 0, TFITS_BIN_TYPE_E);
-
-                    } else
-                        fitstable_add_fits_columns_as_struct2(intable, out);
-
-                    if (backref) {
-                        tfits_type i16type;
-                        tfits_type i32type;
-                        // R = fitstable_row_size(intable);
-                        int off = R;
-                        i16type = fitscolumn_i16_type();
-                        i32type = fitscolumn_i32_type();
-                        fitstable_add_read_column_struct(out, i16type, 1, off,
-                                                         i16type, "backref_file", TRUE);
-                        off += sizeof(int16_t);
-                        fitstable_add_read_column_struct(out, i32type, 1, off,
-                                                         i32type, "backref_index", TRUE);
-                    }
-
-                    if (fitstable_write_primary_header(out) ||
-                        fitstable_write_header(out)) {
-                        ERROR("Failed to write output file headers for \"%s\"", outfn);
-                        exit(-1);
-                    }
-
-                    outtables[hp] = out;
                 }
 
                 if (backref) {
@@ -528,6 +745,16 @@ int main(int argc, char *argv[]) {
                     rdata = rowdata;
                 }
 
+                if (spill) {
+                    if (hpspill_append(spill->spill, hp, rdata)) {
+                        ERROR("Failed to buffer a row of data from input table \"%s\" for healpix %i", infn, hp);
+                        exit(-1);
+                    }
+                    if (!hps)
+                        break;
+                    continue;
+                }
+
                 if (closefiles && (outtables[hp]->fid == NULL)) {
                     char* outfn = outtables[hp]->fn;
                     logverb("Re-opening healpix %i file %s at offset %lu\n",
@@ -537,9 +764,10 @@ int main(int argc, char *argv[]) {
                 }
 
                 if (anycols) {
-                    if (!flipped) {
-                        // if we're writing to multiple output
-                        // healpixes, only flip once!
+                    // if we're writing to multiple output healpixes,
+                    // only flip once!  (Except that "padrowdata" is
+                    // re-copied from "rowdata" for each healpix.)
+                    if (!flipped || backref) {
                         flipped = TRUE;
                         fitstable_endian_flip_row_data(intable2, rdata);
                     }
@@ -566,7 +794,10 @@ int main(int argc, char *argv[]) {
         // who wrote this crazy code?  Oh, me of 5 years ago.  Jerk.
         free(rowbuf);
 
-        fitstable_close(intable);
+        if (intable != outopts.intable) {
+            fitstable_close(intable);
+            fitstable_close(intable2);
+        }
         il_free(hps);
 
         if (tempfn) {
@@ -635,6 +866,19 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (spill) {
+        logmsg("Writing output files...\n");
+        if (spill_write_outputs(spill, &outopts, nthreads)) {
+            ERROR("Failed to write output files");
+            exit(-1);
+        }
+        spill_free(spill);
+    }
+    if (outopts.intable) {
+        fitstable_close(outopts.intable);
+        fitstable_close(outopts.intable2);
+    }
+
     free(outtables);
     sl_free2(infns);
     sl_free2(cols);
@@ -9,6 +9,7 @@
 #include "ioutils.h"
 #include "healpix.h"
 #include "tic.h"
+#include "an-thread.h"
 
 #include "anqfits.h"
 #include "qfits_rw.h"
@@ -48,6 +49,31 @@ int index_nstars(const index_t* index) {
     return startree_N(index->starkd);
 }
 
+int index_check(const index_t* index) {
+    int nquads, nstars;
+    if (!index->quads || !index->codekd || !index->starkd) {
+        ERROR("Index %s is not loaded", index->indexname);
+        return -1;
+    }
+    nquads = quadfile_nquads(index->quads);
+    nstars = startree_N(index->starkd);
+    if (codetree_N(index->codekd) != nquads) {
+        ERROR("Index %s: code tree has %i codes but there are %i quads",
+              index->indexname, codetree_N(index->codekd), nquads);
+        return -1;
+    }
+    if (index->quads->numstars != nstars) {
+        ERROR("Index %s: quad file refers to %i stars but the star tree has %i",
+              index->indexname, index->quads->numstars, nstars);
+        return -1;
+    }
+    if (quadfile_check(index->quads)) {
+        ERROR("Index %s: bad quad file", index->indexname);
+        return -1;
+    }
+    return 0;
+}
+
 // Returns a newly-allocated string containing the filename, or NULL if not found.
 // Tries the index name, or name + ".fits" as a filename.
 static char* get_filename(const char* indexname) {
@@ -258,6 +284,42 @@ int index_dimquads(index_t* indx) {
     return indx->dimquads;
 }
 
+// Solver threads can share an index, so the first one to ask for its
+// quad map builds it while the others wait.
+AN_THREAD_DECLARE_STATIC_MUTEX(quadmaplock);
+
+quadmap_t* index_get_quadmap(index_t* index) {
+    quadmap_t* qm;
+    AN_THREAD_LOCK(quadmaplock);
+    if (!index->quadmap) {
+        if (!index->quads || !index->starkd) {
+            ERROR("Index %s is not loaded", index->indexname);
+            goto done;
+        }
+        // Use the one stored in the index file, if there is one.
+        if (index->fits)
+            index->quadmap = quadmap_open_fits(index->fits);
+        if (index->quadmap &&
+            quadmap_check(index->quadmap, index->quads->numquads)) {
+            logmsg("Warning: the quad map in %s doesn't match its quads; "
+                   "rebuilding it\n", index->indexfn);
+            quadmap_free(index->quadmap);
+            index->quadmap = NULL;
+        }
+        if (index->quadmap) {
+            logverb("Read quad map from %s\n", index->indexfn);
+            goto done;
+        }
+        index->quadmap = quadmap_build
+            (index->quads, index->starkd,
+             quadmap_nside_for_scale(index->index_scale_upper));
+    }
+ done:
+    qm = index->quadmap;
+    AN_THREAD_UNLOCK(quadmaplock);
+    return qm;
+}
+
 index_t* index_build_from(codetree_t* codekd, quadfile_t* quads, startree_t* starkd) {
     index_t* index = calloc(1, sizeof(index_t));
     index->codekd = codekd;
@@ -355,6 +417,8 @@ int index_reload(index_t* index) {
 }
 
 void index_unload(index_t* index) {
+    quadmap_free(index->quadmap);
+    index->quadmap = NULL;
     if (index->starkd) {
         startree_close(index->starkd);
         index->starkd = NULL;
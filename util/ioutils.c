@@ -596,7 +596,8 @@ int mkdir_p(const char* dirpath) {
     free(path);
     while (sl_size(tomake)) {
         char* path = sl_pop(tomake);
-        if (mkdir(path, 0777)) {
+        // (another process or thread may have just created it)
+        if (mkdir(path, 0777) && !(errno == EEXIST && path_is_dir(path))) {
             SYSERROR("Failed to mkdir(%s)", path);
             sl_free2(tomake);
             free(path);
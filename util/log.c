@@ -28,6 +28,7 @@ static void* logts_init_key(void* user) {
     return l;
 }
 #define TSNAME logts
+#define TSFREE free
 #include "thread-specific.inc"
 
 static log_t* get_logger() {
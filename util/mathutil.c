@@ -158,6 +158,43 @@ int invert_2by2_arr(const double* A, double* Ainv) {
     return 0;
 }
 
+int cholesky_solve(double* A, int N, double* B, int NB) {
+    int i, j, k;
+    // A = L L^T, L stored in the lower triangle of A.
+    for (j=0; j<N; j++) {
+        double d = A[j*N + j];
+        for (k=0; k<j; k++)
+            d -= A[j*N + k] * A[j*N + k];
+        if (!(d > 0))
+            return -1;
+        d = sqrt(d);
+        A[j*N + j] = d;
+        for (i=j+1; i<N; i++) {
+            double s = A[i*N + j];
+            for (k=0; k<j; k++)
+                s -= A[i*N + k] * A[j*N + k];
+            A[i*N + j] = s / d;
+        }
+    }
+    for (k=0; k<NB; k++) {
+        // forward: L y = b
+        for (i=0; i<N; i++) {
+            double s = B[i*NB + k];
+            for (j=0; j<i; j++)
+                s -= A[i*N + j] * B[j*NB + k];
+            B[i*NB + k] = s / A[i*N + i];
+        }
+        // back: L^T x = y
+        for (i=N-1; i>=0; i--) {
+            double s = B[i*NB + k];
+            for (j=i+1; j<N; j++)
+                s -= A[j*N + i] * B[j*NB + k];
+            B[i*NB + k] = s / A[i*N + i];
+        }
+    }
+    return 0;
+}
+
 int invert_2by2(const double A[2][2], double Ainv[2][2]) {
     double det;
     double inv_det;
@@ -270,6 +307,24 @@ double uniform_sample(double low, double high) {
     return low + (high - low)*((double)rand() / (double)RAND_MAX);
 }
 
+double uniform_sample_r(unsigned int* seed, double low, double high) {
+    if (low == high) return low;
+    return low + (high - low)*((double)rand_r(seed) / (double)RAND_MAX);
+}
+
+double gaussian_sample_r(unsigned int* seed, double mean, double stddev) {
+    // same algorithm as gaussian_sample(), but the second sample of
+    // each pair is discarded rather than cached.
+    double x1, x2, w;
+    do {
+        x1 = uniform_sample_r(seed, -1, 1);
+        x2 = uniform_sample_r(seed, -1, 1);
+        w = x1 * x1 + x2 * x2;
+    } while (w >= 1.0 || w == 0.0);
+    w = sqrt( (-2.0 * log(w)) / w );
+    return mean + x1 * w * stddev;
+}
+
 /* computes IN PLACE the inverse of a 3x3 matrix stored as a 9-vector
  with the first ROW of the matrix in positions 0-2, the second ROW
  in positions 3-5, and the last ROW in positions 6-8. */
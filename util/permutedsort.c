@@ -9,10 +9,12 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "permutedsort.h"
 #include "os-features.h"
 #include "ioutils.h"
+#include "an-bool.h"
 
 int* permutation_init(int* perm, int N) {
     int i;
@@ -48,6 +50,210 @@ void permutation_apply(const int* perm, int Nperm, const void* inarray,
     }
 }
 
+int64_t* permutation_init_64(int64_t* perm, int64_t N) {
+    int64_t i;
+    if (!N)
+        return perm;
+    if (!perm)
+        perm = malloc(sizeof(int64_t) * N);
+    if (!perm)
+        return NULL;
+    for (i=0; i<N; i++)
+        perm[i] = i;
+    return perm;
+}
+
+void permutation_apply_64(const int64_t* perm, int64_t Nperm,
+                          const void* inarray, void* outarray,
+                          int elemsize) {
+    void* temparr = NULL;
+    int64_t i;
+    const char* cinput;
+    char* coutput;
+    size_t esize = elemsize;
+
+    if (inarray == outarray) {
+        temparr = malloc(esize * Nperm);
+        coutput = temparr;
+    } else
+        coutput = outarray;
+
+    cinput = inarray;
+    for (i=0; i<Nperm; i++)
+        memcpy(coutput + i * esize, cinput + perm[i] * esize, esize);
+
+    if (inarray == outarray) {
+        memcpy(outarray, temparr, esize * Nperm);
+        free(temparr);
+    }
+}
+
+/*
+ Radix argsort, used instead of qsort when "compare" is one of the
+ built-in double/float/int/int64 comparators.  Keys are mapped to
+ unsigned integers whose order matches the comparator (NaNs last, as
+ in COMPARE below), then sorted with a stable LSD radix sort, eight
+ bits per pass.  Large arrays are split among several threads.
+ */
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_BUCKETS - 1)
+// below this, the merge sort wins.
+#define RADIX_MIN_N 256
+// elements per thread.
+#define RADIX_THREAD_N (1 << 18)
+#define RADIX_MAX_THREADS 8
+
+enum {
+    RADIX_DOUBLE,
+    RADIX_FLOAT,
+    RADIX_INT32,
+    RADIX_INT64,
+};
+
+enum {
+    RADIX_PHASE_KEYS,
+    RADIX_PHASE_COUNT,
+    RADIX_PHASE_SCATTER,
+};
+
+static inline uint64_t radix_key64(const char* p, int kind, anbool desc) {
+    uint64_t u;
+    int64_t i;
+    if (kind == RADIX_DOUBLE) {
+        memcpy(&u, p, sizeof(u));
+        if ((u & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL)
+            // NaN: last either way.  (No other key maps to this.)
+            return UINT64_MAX;
+        if ((u & 0x7fffffffffffffffULL) == 0)
+            // -0 == +0
+            u = 0;
+        u = (u >> 63) ? ~u : (u | 0x8000000000000000ULL);
+    } else {
+        memcpy(&i, p, sizeof(i));
+        u = (uint64_t)i ^ 0x8000000000000000ULL;
+    }
+    return desc ? ~u : u;
+}
+
+static inline uint32_t radix_key32(const char* p, int kind, anbool desc) {
+    uint32_t u;
+    int32_t i;
+    if (kind == RADIX_FLOAT) {
+        memcpy(&u, p, sizeof(u));
+        if ((u & 0x7fffffffU) > 0x7f800000U)
+            return UINT32_MAX;
+        if ((u & 0x7fffffffU) == 0)
+            u = 0;
+        u = (u >> 31) ? ~u : (u | 0x80000000U);
+    } else {
+        memcpy(&i, p, sizeof(i));
+        u = (uint32_t)i ^ 0x80000000U;
+    }
+    return desc ? ~u : u;
+}
+
+// Runs "func" on each of the "n" jobs, one per thread.
+static void radix_run(void* (*func)(void*), void* jobs, size_t jobsize,
+                      int n) {
+    pthread_t threads[RADIX_MAX_THREADS];
+    anbool started[RADIX_MAX_THREADS];
+    int t;
+    for (t=1; t<n; t++)
+        started[t] = (pthread_create(threads + t, NULL, func,
+                                     (char*)jobs + t * jobsize) == 0);
+    func(jobs);
+    for (t=1; t<n; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            // couldn't start a thread; do it here.
+            func((char*)jobs + t * jobsize);
+    }
+}
+
+#define KEYTYPE uint32_t
+#define KEYFUNC radix_key32
+#define INDTYPE int
+#define RADIX_SUFF _k32
+#include "permutedsort-radix.inc"
+#undef INDTYPE
+#undef RADIX_SUFF
+#define INDTYPE int64_t
+#define RADIX_SUFF _k32_64
+#include "permutedsort-radix.inc"
+#undef INDTYPE
+#undef RADIX_SUFF
+#undef KEYTYPE
+#undef KEYFUNC
+
+#define KEYTYPE uint64_t
+#define KEYFUNC radix_key64
+#define INDTYPE int
+#define RADIX_SUFF _k64
+#include "permutedsort-radix.inc"
+#undef INDTYPE
+#undef RADIX_SUFF
+#define INDTYPE int64_t
+#define RADIX_SUFF _k64_64
+#include "permutedsort-radix.inc"
+#undef INDTYPE
+#undef RADIX_SUFF
+#undef KEYTYPE
+#undef KEYFUNC
+
+static int radix_kind(int (*compare)(const void*, const void*),
+                      anbool* desc) {
+    *desc = FALSE;
+    if (compare == compare_doubles_asc)
+        return RADIX_DOUBLE;
+    if (compare == compare_floats_asc)
+        return RADIX_FLOAT;
+    if (compare == compare_ints_asc)
+        return RADIX_INT32;
+    if (compare == compare_int64_asc)
+        return RADIX_INT64;
+    *desc = TRUE;
+    if (compare == compare_doubles_desc)
+        return RADIX_DOUBLE;
+    if (compare == compare_floats_desc)
+        return RADIX_FLOAT;
+    if (compare == compare_ints_desc)
+        return RADIX_INT32;
+    if (compare == compare_int64_desc)
+        return RADIX_INT64;
+    return -1;
+}
+
+static int radix_nthreads(int64_t N) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int64_t n = N / RADIX_THREAD_N;
+    if (ncpu > 0)
+        n = MIN(n, ncpu);
+    return (int)MAX(1, MIN(n, RADIX_MAX_THREADS));
+}
+
+// Returns 0 if the permutation (exactly one of "perm", "perm64") was
+// sorted, -1 if the caller should fall back to qsort.
+static int radix_permuted_sort(const void* data, int stride,
+                               int (*compare)(const void*, const void*),
+                               int* perm, int64_t* perm64, int64_t N) {
+    anbool desc;
+    int kind = radix_kind(compare, &desc);
+    int nthreads;
+    if (kind == -1 || N < RADIX_MIN_N)
+        return -1;
+    nthreads = radix_nthreads(N);
+    if (kind == RADIX_DOUBLE || kind == RADIX_INT64) {
+        if (perm)
+            return radix_argsort_k64(data, stride, kind, desc, perm, N, nthreads);
+        return radix_argsort_k64_64(data, stride, kind, desc, perm64, N, nthreads);
+    }
+    if (perm)
+        return radix_argsort_k32(data, stride, kind, desc, perm, N, nthreads);
+    return radix_argsort_k32_64(data, stride, kind, desc, perm64, N, nthreads);
+}
+
 struct permuted_sort_t {
     int (*compare)(const void*, const void*);
     const void* data_array;
@@ -55,16 +261,63 @@ struct permuted_sort_t {
 };
 typedef struct permuted_sort_t permsort_t;
 
-// This is the comparison function we use.
+#define INDTYPE int
+#define MERGE_SUFF _32
+#include "permutedsort-merge.inc"
+#undef INDTYPE
+#undef MERGE_SUFF
+#define INDTYPE int64_t
+#define MERGE_SUFF _64
+#include "permutedsort-merge.inc"
+#undef INDTYPE
+#undef MERGE_SUFF
+
+// Comparison functions for QSORT_R, used only if the merge sort can't
+// get memory.  Ties are broken by index, which keeps the sort stable
+// when "perm" starts out in increasing order.
 static int QSORT_COMPARISON_FUNCTION(compare_permuted, void* user, const void* v1, const void* v2) {
     permsort_t* ps = user;
-    off_t i1 = *(int*)v1;
-    off_t i2 = *(int*)v2;
-    const void *val1, *val2;
-    const char* darray = ps->data_array;
-    val1 = darray + i1 * ps->data_array_stride;
-    val2 = darray + i2 * ps->data_array_stride;
-    return ps->compare(val1, val2);
+    int i1 = *(int*)v1;
+    int i2 = *(int*)v2;
+    int c = merge_cmp_32(ps, i1, i2);
+    if (c)
+        return c;
+    return (i1 < i2) ? -1 : (i1 > i2);
+}
+
+static int QSORT_COMPARISON_FUNCTION(compare_permuted_64, void* user, const void* v1, const void* v2) {
+    permsort_t* ps = user;
+    int64_t i1 = *(int64_t*)v1;
+    int64_t i2 = *(int64_t*)v2;
+    int c = merge_cmp_64(ps, i1, i2);
+    if (c)
+        return c;
+    return (i1 < i2) ? -1 : (i1 > i2);
+}
+
+int64_t* permuted_sort_64(const void* realarray, int array_stride,
+                          int (*compare)(const void*, const void*),
+                          int64_t* perm, int64_t N) {
+    permsort_t ps;
+    if (!perm) {
+        // (at least one element, so that NULL only means out of memory.)
+        perm = malloc(MAX(N, 1) * sizeof(int64_t));
+        if (!perm)
+            return NULL;
+        permutation_init_64(perm, N);
+    }
+
+    if (radix_permuted_sort(realarray, array_stride, compare, NULL, perm, N) == 0)
+        return perm;
+
+    ps.compare = compare;
+    ps.data_array = realarray;
+    ps.data_array_stride = array_stride;
+
+    if (merge_permuted_sort_64(&ps, perm, N))
+        QSORT_R(perm, N, sizeof(int64_t), &ps, compare_permuted_64);
+
+    return perm;
 }
 
 int* permuted_sort(const void* realarray, int array_stride,
@@ -74,26 +327,41 @@ int* permuted_sort(const void* realarray, int array_stride,
     if (!perm)
         perm = permutation_init(perm, N);
 
+    if (radix_permuted_sort(realarray, array_stride, compare, perm, NULL, N) == 0)
+        return perm;
+
     ps.compare = compare;
     ps.data_array = realarray;
     ps.data_array_stride = array_stride;
 
-    QSORT_R(perm, N, sizeof(int), &ps, compare_permuted);
+    if (merge_permuted_sort_32(&ps, perm, N))
+        QSORT_R(perm, N, sizeof(int), &ps, compare_permuted);
 
     return perm;
 }
 
-#define COMPARE(d1, d2, op1, op2)                       \
+// NaN tests on the bit pattern, like the radix keys above: isnan() can
+// be folded away under -ffinite-math-only.
+static inline anbool double_is_nan(double d) {
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return (u & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+}
+
+static inline anbool float_is_nan(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7fffffffU) > 0x7f800000U;
+}
+
+// NaNs go last, in either direction.
+#define COMPARE(d1, d2, op1, op2, isnanfunc)            \
+    anbool n1 = isnanfunc(d1);                          \
+    anbool n2 = isnanfunc(d2);                          \
+    if (n1 || n2) return (n1 && n2) ? 0 : (n1 ? 1 : -1); \
     if (d1 op1 d2) return -1;                           \
     if (d1 op2 d2) return 1;                            \
-    /* explicitly test for equality, to catch NaNs*/	\
-    if (d1 == d2) return 0;                             \
-    if (isnan(d1) && isnan(d2)) return 0;               \
-    if (isnan(d1)) return 1;                            \
-    if (isnan(d2)) return -1;                           \
-    assert(0); return 0;
-
-//printf("d1=%g, d2=%g\n", d1, d2);				   
+    return 0;
 
 #define INTCOMPARE(i1, i2, op1, op2)            \
     if (i1 op1 i2) return -1;                   \
@@ -103,26 +371,26 @@ int* permuted_sort(const void* realarray, int array_stride,
 int compare_doubles_asc(const void* v1, const void* v2) {
     const double d1 = *(double*)v1;
     const double d2 = *(double*)v2;
-    COMPARE(d1, d2, <, >);
+    COMPARE(d1, d2, <, >, double_is_nan);
 }
 
 int compare_doubles_desc(const void* v1, const void* v2) {
     // (note that v1,v2 are flipped)
     const double d1 = *(double*)v1;
     const double d2 = *(double*)v2;
-    COMPARE(d1, d2, >, <);
+    COMPARE(d1, d2, >, <, double_is_nan);
 }
 
 int compare_floats_asc(const void* v1, const void* v2) {
     float f1 = *(float*)v1;
     float f2 = *(float*)v2;
-    COMPARE(f1, f2, <, >);
+    COMPARE(f1, f2, <, >, float_is_nan);
 }
 
 int compare_floats_desc(const void* v1, const void* v2) {
     float f1 = *(float*)v1;
     float f2 = *(float*)v2;
-    COMPARE(f1, f2, >, <);
+    COMPARE(f1, f2, >, <, float_is_nan);
 }
 
 int compare_int64_asc(const void* v1, const void* v2) {
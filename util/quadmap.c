@@ -0,0 +1,343 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "quadmap.h"
+#include "healpix.h"
+#include "permutedsort.h"
+#include "fitsioutils.h"
+#include "starutil.h"
+#include "mathutil.h"
+#include "log.h"
+#include "errors.h"
+
+#define QUADMAP_MAX_NSIDE 8192
+
+#define CHUNK_CELLS 0
+#define CHUNK_QUADS 1
+
+int quadmap_nside_for_scale(double scale_upper) {
+    int nside = 1;
+    double target;
+    // cells about twice the size of the largest quads.
+    target = healpix_nside_for_side_length_arcmin(2.0 * scale_upper / 60.0);
+    while (nside * 2 <= target && nside < QUADMAP_MAX_NSIDE)
+        nside *= 2;
+    return nside;
+}
+
+static anbool valid_nside(int nside) {
+    return (nside >= 1 && nside <= QUADMAP_MAX_NSIDE &&
+            !(nside & (nside - 1)));
+}
+
+static void quad_center(const quadfile_t* qf, startree_t* skdt, int quad,
+                        double* xyz) {
+    unsigned int stars[DQMAX];
+    double xyzB[3];
+    quadfile_get_stars(qf, quad, stars);
+    startree_get(skdt, stars[0], xyz);
+    startree_get(skdt, stars[1], xyzB);
+    xyz[0] += xyzB[0];
+    xyz[1] += xyzB[1];
+    xyz[2] += xyzB[2];
+    normalize_3(xyz);
+}
+
+quadmap_t* quadmap_build(const quadfile_t* qf, startree_t* skdt,
+                         int nside) {
+    quadmap_t* qm;
+    int64_t* keys;
+    int* perm;
+    int i, N, lasthp;
+
+    if (!valid_nside(nside)) {
+        ERROR("Quad map nside must be a power of two in [1, %i]; got %i",
+              QUADMAP_MAX_NSIDE, nside);
+        return NULL;
+    }
+    N = qf->numquads;
+    qm = calloc(1, sizeof(quadmap_t));
+    qm->nside = nside;
+    qm->nquads = N;
+    if (N == 0) {
+        // just the sentinel.
+        qm->cells = malloc(sizeof(quadmap_cell_t));
+        qm->cells[0].hp = 12 * nside * nside;
+        qm->cells[0].start = 0;
+        return qm;
+    }
+    keys = calloc(N, sizeof(int64_t));
+    if (!keys) {
+        SYSERROR("Failed to allocate quad map keys for %i quads", N);
+        free(qm);
+        return NULL;
+    }
+    for (i=0; i<N; i++) {
+        double xyz[3];
+        quad_center(qf, skdt, i, xyz);
+        keys[i] = ((int64_t)xyzarrtohealpix(xyz, nside) << 32) | i;
+    }
+    perm = permuted_sort(keys, sizeof(int64_t), compare_int64_asc, NULL, N);
+
+    qm->quads = malloc(N * sizeof(int32_t));
+    // at most one cell per quad, plus the sentinel.
+    qm->cells = malloc((N + 1) * sizeof(quadmap_cell_t));
+    lasthp = -1;
+    for (i=0; i<N; i++) {
+        int64_t key = keys[perm[i]];
+        int hp = (int)(key >> 32);
+        qm->quads[i] = (int32_t)(key & 0xffffffff);
+        if (hp != lasthp) {
+            qm->cells[qm->ncells].hp = hp;
+            qm->cells[qm->ncells].start = i;
+            qm->ncells++;
+            lasthp = hp;
+        }
+    }
+    qm->cells[qm->ncells].hp = 12 * nside * nside;
+    qm->cells[qm->ncells].start = N;
+    qm->cells = realloc(qm->cells, (qm->ncells + 1) * sizeof(quadmap_cell_t));
+    free(perm);
+    free(keys);
+    debug("Built nside-%i quad map: %i quads in %i cells\n", nside, N,
+          qm->ncells);
+    return qm;
+}
+
+static int callback_read_header(fitsbin_t* fb, fitsbin_chunk_t* chunk) {
+    quadmap_t* qm = chunk->userdata;
+    if (fits_check_endian(chunk->header)) {
+        ERROR("Quad map was written with the wrong endianness");
+        return -1;
+    }
+    qm->nside = qfits_header_getint(chunk->header, "QMNSIDE", -1);
+    if (!valid_nside(qm->nside)) {
+        ERROR("Quad map has invalid QMNSIDE %i", qm->nside);
+        return -1;
+    }
+    return 0;
+}
+
+quadmap_t* quadmap_open_fits(anqfits_t* fits) {
+    quadmap_t* qm;
+    fitsbin_chunk_t chunk;
+    fitsbin_chunk_t* cells;
+    fitsbin_chunk_t* quads;
+
+    qm = calloc(1, sizeof(quadmap_t));
+    qm->fb = fitsbin_open_fits(fits);
+    if (!qm->fb)
+        goto bailout;
+
+    fitsbin_chunk_init(&chunk);
+    chunk.tablename = "quadmap_cells";
+    chunk.itemsize = sizeof(quadmap_cell_t);
+    chunk.required = FALSE;
+    chunk.callback_read_header = callback_read_header;
+    chunk.userdata = qm;
+    fitsbin_add_chunk(qm->fb, &chunk);
+    fitsbin_chunk_clean(&chunk);
+
+    fitsbin_chunk_init(&chunk);
+    chunk.tablename = "quadmap_quads";
+    chunk.itemsize = sizeof(int32_t);
+    chunk.required = FALSE;
+    fitsbin_add_chunk(qm->fb, &chunk);
+    fitsbin_chunk_clean(&chunk);
+
+    if (fitsbin_read(qm->fb))
+        goto bailout;
+    cells = fitsbin_get_chunk(qm->fb, CHUNK_CELLS);
+    quads = fitsbin_get_chunk(qm->fb, CHUNK_QUADS);
+    if (!cells->data || !quads->data)
+        goto bailout;
+    qm->cells = cells->data;
+    qm->quads = quads->data;
+    qm->ncells = cells->nrows - 1;
+    qm->nquads = quads->nrows;
+    if (qm->ncells < 0 || qm->cells[qm->ncells].start != qm->nquads) {
+        ERROR("Quad map tables in %s are inconsistent", fits->filename);
+        goto bailout;
+    }
+    fitsbin_close_fd(qm->fb);
+    debug("Read nside-%i quad map: %i quads in %i cells\n", qm->nside,
+          qm->nquads, qm->ncells);
+    return qm;
+
+ bailout:
+    quadmap_free(qm);
+    return NULL;
+}
+
+int quadmap_check(const quadmap_t* qm, int nquads) {
+    uint8_t* seen;
+    int c, i, nhp;
+
+    if (qm->nquads != nquads) {
+        logverb("Quad map has %i quads; the quad file has %i\n",
+                qm->nquads, nquads);
+        return -1;
+    }
+    nhp = 12 * qm->nside * qm->nside;
+    if (qm->ncells < 0 || qm->ncells > nquads ||
+        qm->cells[0].start != 0 ||
+        qm->cells[qm->ncells].start != nquads ||
+        qm->cells[qm->ncells].hp != nhp) {
+        logverb("Quad map cell table is inconsistent\n");
+        return -1;
+    }
+    for (c=0; c<qm->ncells; c++)
+        if (qm->cells[c].hp < 0 || qm->cells[c].hp >= qm->cells[c+1].hp ||
+            qm->cells[c].start >= qm->cells[c+1].start) {
+            logverb("Quad map cell %i is out of order\n", c);
+            return -1;
+        }
+    seen = calloc(MAX(nquads, 1), 1);
+    for (c=0; c<qm->ncells; c++)
+        for (i=qm->cells[c].start; i<qm->cells[c+1].start; i++) {
+            int32_t q = qm->quads[i];
+            if (q < 0 || q >= nquads || seen[q] ||
+                (i > qm->cells[c].start && q <= qm->quads[i-1])) {
+                logverb("Quad map entry %i (quad %i) is invalid\n", i, q);
+                free(seen);
+                return -1;
+            }
+            seen[q] = 1;
+        }
+    free(seen);
+    return 0;
+}
+
+int quadmap_append_to(const quadmap_t* qm, FILE* fid) {
+    fitsbin_chunk_t chunk;
+    qfits_header* hdr;
+    int rtn;
+
+    fitsbin_chunk_init(&chunk);
+    chunk.tablename = "quadmap_cells";
+    chunk.itemsize = sizeof(quadmap_cell_t);
+    chunk.nrows = qm->ncells + 1;
+    chunk.data = qm->cells;
+    hdr = fitsbin_get_chunk_header(NULL, &chunk);
+    fits_add_endian(hdr);
+    fits_header_add_int(hdr, "QMNSIDE", qm->nside,
+                        "Healpix nside of the quad map (XY scheme)");
+    fits_add_long_comment(hdr, "Healpix -> quad map: for each non-empty "
+                          "healpix, its number and the index of its first "
+                          "quad in the quadmap_quads table, as 32-bit "
+                          "native-endian ints; plus a sentinel row.");
+    rtn = fitsbin_write_chunk_to(NULL, &chunk, fid);
+    fitsbin_chunk_clean(&chunk);
+    if (rtn) {
+        ERROR("Failed to write quad map cells");
+        return -1;
+    }
+
+    fitsbin_chunk_init(&chunk);
+    chunk.tablename = "quadmap_quads";
+    chunk.itemsize = sizeof(int32_t);
+    chunk.nrows = qm->nquads;
+    chunk.data = qm->quads;
+    hdr = fitsbin_get_chunk_header(NULL, &chunk);
+    fits_add_endian(hdr);
+    rtn = fitsbin_write_chunk_to(NULL, &chunk, fid);
+    fitsbin_chunk_clean(&chunk);
+    if (rtn) {
+        ERROR("Failed to write quad map quads");
+        return -1;
+    }
+    return 0;
+}
+
+void quadmap_free(quadmap_t* qm) {
+    if (!qm)
+        return;
+    if (qm->fb)
+        fitsbin_close(qm->fb);
+    else {
+        free(qm->cells);
+        free(qm->quads);
+    }
+    free(qm);
+}
+
+// the cell for healpix "hp", or -1.
+static int find_cell(const quadmap_t* qm, int hp) {
+    int lo = 0, hi = qm->ncells;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (qm->cells[mid].hp < hp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < qm->ncells && qm->cells[lo].hp == hp)
+        return lo;
+    return -1;
+}
+
+static int search_cell(const quadmap_t* qm, const quadfile_t* qf,
+                       startree_t* skdt, const double* xyz, double r2,
+                       int hp, il* quads) {
+    unsigned int stars[DQMAX];
+    int c, i, j, n = 0;
+    int dimquads = qf->dimquads;
+    c = find_cell(qm, hp);
+    if (c == -1)
+        return 0;
+    for (i=qm->cells[c].start; i<qm->cells[c+1].start; i++) {
+        anbool ok = TRUE;
+        quadfile_get_stars(qf, qm->quads[i], stars);
+        for (j=0; j<dimquads; j++) {
+            double sxyz[3];
+            startree_get(skdt, stars[j], sxyz);
+            if (distsq(sxyz, xyz, 3) > r2) {
+                ok = FALSE;
+                break;
+            }
+        }
+        if (!ok)
+            continue;
+        il_append(quads, qm->quads[i]);
+        n++;
+    }
+    return n;
+}
+
+static int search_tree(const quadmap_t* qm, const quadfile_t* qf,
+                       startree_t* skdt, const double* xyz, double r2,
+                       double radius, int bighp, int x, int y, int nside,
+                       il* quads) {
+    int hp = healpix_compose_xy(bighp, x, y, nside);
+    // healpix_distance_to_xyz() is approximate (cell edges are not great
+    // circles), so pad by a fraction of the cell size.
+    double pad = 0.1 * healpix_side_length_arcmin(nside) / 60.0;
+    int i, j, n = 0;
+    // A quad whose stars are all inside the cone has its AB center
+    // inside the cone too.
+    if (healpix_distance_to_xyz(hp, nside, xyz, NULL) > radius + pad)
+        return 0;
+    if (nside == qm->nside)
+        return search_cell(qm, qf, skdt, xyz, r2, hp, quads);
+    for (i=0; i<2; i++)
+        for (j=0; j<2; j++)
+            n += search_tree(qm, qf, skdt, xyz, r2, radius, bighp,
+                             2*x + i, 2*y + j, 2*nside, quads);
+    return n;
+}
+
+int quadmap_search(const quadmap_t* qm, const quadfile_t* qf,
+                   startree_t* skdt, const double* xyz, double r2,
+                   il* quads) {
+    double radius = distsq2deg(r2);
+    int bighp, n = 0;
+    for (bighp=0; bighp<12; bighp++)
+        n += search_tree(qm, qf, skdt, xyz, r2, radius,
+                         bighp, 0, 0, 1, quads);
+    return n;
+}
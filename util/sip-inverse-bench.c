@@ -0,0 +1,206 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "os-features.h"
+#include "sip.h"
+#include "sip-utils.h"
+#include "mathutil.h"
+#include "boilerplate.h"
+#include "tic.h"
+#include "log.h"
+#include "errors.h"
+
+/**
+ Times inverse-SIP fitting the way a pipeline does it: one fit per
+ frame, each frame with a slightly different forward polynomial of the
+ same order and image size.  Reports the time per fit and the largest
+ round-trip error, for a fresh fitter per frame, one fitter reused for
+ all frames, and adaptive fits to a tolerance.
+
+ The fresh and reused fitters take about the same time: a fixed-grid
+ fit is dominated by evaluating the new forward polynomial and summing
+ the normal equations, which both have to do, not by allocating the
+ grid.  The adaptive fits stop refining when a finer grid no longer
+ helps, so if the inverse order is too low to reach the tolerance
+ (order 5 for the default distortion), that row says so; try -O 7.
+ */
+
+static const char* OPTIONS = "hvn:o:O:W:H:t:s:";
+
+static void printHelp(char* progname) {
+    BOILERPLATE_HELP_HEADER(stdout);
+    printf("\nUsage: %s [options]\n"
+           "    [-n <frames>]: default 200\n"
+           "    [-o <order>]: forward SIP order; default 4\n"
+           "    [-O <order>]: inverse SIP order; default forward + 1\n"
+           "    [-W <width>] [-H <height>]: image size; default 4096 x 4096\n"
+           "    [-t <pixels>]: tolerance for the adaptive fits; default 1e-3\n"
+           "    [-s <seed>]: random seed; default 1\n"
+           "    [-v]: +verbose\n"
+           "\n", progname);
+}
+
+// A random distortion of about "amp" pixels at the edge of the image.
+static void make_wcs(sip_t* sip, int order, int invorder, int W, int H,
+                     double amp, unsigned int* seed) {
+    int p, q;
+    double R = 0.5 * MAX(W, H);
+    memset(sip, 0, sizeof(sip_t));
+    sip->wcstan.crval[0] = 150.0;
+    sip->wcstan.crval[1] = 30.0;
+    sip->wcstan.crpix[0] = 0.5 + 0.5 * W;
+    sip->wcstan.crpix[1] = 0.5 + 0.5 * H;
+    sip->wcstan.cd[0][0] = -1e-4;
+    sip->wcstan.cd[1][1] = 1e-4;
+    sip->wcstan.imagew = W;
+    sip->wcstan.imageh = H;
+    sip->a_order = sip->b_order = order;
+    sip->ap_order = sip->bp_order = invorder;
+    for (p=0; p<=order; p++)
+        for (q=0; p+q<=order; q++) {
+            if (p + q < 2)
+                continue;
+            sip->a[p][q] = uniform_sample_r(seed, -amp, amp) / pow(R, p+q);
+            sip->b[p][q] = uniform_sample_r(seed, -amp, amp) / pow(R, p+q);
+        }
+}
+
+// Largest round-trip error over a grid of pixels.
+static double roundtrip_error(const sip_t* sip) {
+    double x, y, maxerr = 0;
+    double step = MAX(sip->wcstan.imagew, sip->wcstan.imageh) / 50.0;
+    for (y=1; y<=sip->wcstan.imageh; y+=step)
+        for (x=1; x<=sip->wcstan.imagew; x+=step) {
+            double X, Y, x2, y2;
+            sip_pixel_distortion(sip, x, y, &X, &Y);
+            sip_pixel_undistortion(sip, X, Y, &x2, &y2);
+            maxerr = MAX(maxerr, hypot(x2 - x, y2 - y));
+        }
+    return maxerr;
+}
+
+static void run(const char* name, sip_t* frames, int n, int mode,
+                double tolerance) {
+    sip_inverse_fitter_t* fitter = NULL;
+    double t0, dt, maxerr = 0;
+    int i, nmissed = 0;
+    if (mode == 1)
+        fitter = sip_inverse_fitter_new();
+    t0 = timenow();
+    for (i=0; i<n; i++) {
+        double fiterr = 0;
+        int rtn;
+        if (mode == 1) {
+            rtn = sip_inverse_fitter_fit(fitter, frames + i, 0, 0,
+                                         0, 0, 0, 0, tolerance, &fiterr);
+        } else {
+            sip_inverse_fitter_t* f = sip_inverse_fitter_new();
+            rtn = sip_inverse_fitter_fit(f, frames + i, 0, 0,
+                                         0, 0, 0, 0, tolerance, NULL);
+            sip_inverse_fitter_free(f);
+        }
+        if (rtn) {
+            ERROR("Fit failed for frame %i", i);
+            exit(-1);
+        }
+        if (tolerance > 0 && fiterr > tolerance)
+            nmissed++;
+    }
+    dt = timenow() - t0;
+    for (i=0; i<n; i++)
+        maxerr = MAX(maxerr, roundtrip_error(frames + i));
+    printf("%-28s %8.3f ms/fit   max round-trip error %.3g pixels",
+           name, 1000.0 * dt / n, maxerr);
+    if (nmissed)
+        printf("   (tolerance not reached in %i of %i fits: inverse "
+               "order too low)", nmissed, n);
+    printf("\n");
+    sip_inverse_fitter_free(fitter);
+}
+
+int main(int argc, char** args) {
+    int argchar;
+    char* progname = args[0];
+    int n = 200;
+    int order = 4;
+    int invorder = -1;
+    int W = 4096, H = 4096;
+    double tolerance = 1e-3;
+    unsigned int seed = 1;
+    int loglvl = LOG_MSG;
+    sip_t* frames;
+    sip_t base;
+    char name[64];
+    int i, p, q;
+
+    while ((argchar = getopt(argc, args, OPTIONS)) != -1)
+        switch (argchar) {
+        case 'v':
+            loglvl++;
+            break;
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 'o':
+            order = atoi(optarg);
+            break;
+        case 'O':
+            invorder = atoi(optarg);
+            break;
+        case 'W':
+            W = atoi(optarg);
+            break;
+        case 'H':
+            H = atoi(optarg);
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        case 'h':
+            printHelp(progname);
+            exit(0);
+        default:
+            printHelp(progname);
+            exit(-1);
+        }
+    log_init(loglvl);
+    if (invorder < 0)
+        invorder = order + 1;
+    if (n < 1 || order < 2 || invorder >= SIP_MAXORDER) {
+        printHelp(progname);
+        exit(-1);
+    }
+
+    // frames: the same distortion, drifting by ~1%.
+    make_wcs(&base, order, invorder, W, H, 5.0, &seed);
+    frames = malloc(n * sizeof(sip_t));
+    for (i=0; i<n; i++) {
+        memcpy(frames + i, &base, sizeof(sip_t));
+        for (p=0; p<=order; p++)
+            for (q=0; p+q<=order; q++) {
+                frames[i].a[p][q] *= 1.0 + uniform_sample_r(&seed, -0.01, 0.01);
+                frames[i].b[p][q] *= 1.0 + uniform_sample_r(&seed, -0.01, 0.01);
+            }
+    }
+    printf("%i frames, %i x %i, order %i, inverse order %i\n",
+           n, W, H, order, invorder);
+
+    run("fixed grid, new fitter", frames, n, 0, 0);
+    run("fixed grid, reused fitter", frames, n, 1, 0);
+    sprintf(name, "adaptive to %g px, reused", tolerance);
+    run(name, frames, n, 1, tolerance);
+
+    free(frames);
+    return 0;
+}
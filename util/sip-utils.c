@@ -7,12 +7,8 @@
 #include <assert.h>
 #include <string.h>
 
-#include <gsl/gsl_matrix_double.h>
-#include <gsl/gsl_vector_double.h>
-
 #include "os-features.h"
 #include "sip-utils.h"
-#include "gslutils.h"
 #include "starutil.h"
 #include "mathutil.h"
 #include "errors.h"
@@ -47,199 +43,341 @@ int sip_ensure_inverse_polynomials(sip_t* sip) {
     return sip_compute_inverse_polynomials(sip, 0, 0, 0, 0, 0, 0);
 }
 
-int sip_compute_inverse_polynomials(sip_t* sip, int NX, int NY,
-                                    double xlo, double xhi,
-                                    double ylo, double yhi) {
-    int inv_sip_order;
-    int M, N;
-    int i, j, p, q, gu, gv;
-    double maxu, maxv, minu, minv;
-    double u, v, U, V;
-    gsl_matrix *mA;
-    gsl_vector *b1, *b2, *x1, *x2;
-    tan_t* tan;
+/*
+ basic idea: lay down a grid in image, for each gridpoint, push
+ through the polynomial to get yourself into warped image
+ coordinate (but not yet lifted onto the sky).  Then, using the
+ set of warped gridpoints as inputs, fit back to their original
+ grid locations as targets.
+
+ Rearranging formula (4), (5), and (6) from the SIP paper gives, for
+ each grid point (u,v) with U = u + f(u,v), V = v + g(u,v):
+
+     -f(u,v) = SUM ap[p][q] U^p V^q
+     -g(u,v) = SUM bp[p][q] U^p V^q
+
+ which we solve by least squares, through the normal equations.  The
+ basis is (U/s)^p (V/s)^q with s the size of the grid, so that the
+ normal matrix stays well-conditioned at order 5 and above.
+
+ The grid is a nested one: level 0 has "n0" points on a side, and each
+ level adds the points halfway between the previous level's, so level
+ l has (n0-1) 2^l + 1 on a side.  The normal equations are sums over the
+ points, so moving to the next level only adds its new points' terms.
+ In adaptive mode the new points are first used to check the current
+ solution, which is kept if it's good enough.
+ */
+
+// largest grid, on a side, in adaptive mode.
+#define SIP_INVERSE_MAX_GRID 257
+
+struct sip_inverse_fitter {
+    // the grid: bounds (relative to CRPIX), size of level 0, levels so far
+    double minu, maxu, minv, maxv;
+    int nx0, ny0;
+    int nlevels;
+    // points of all levels, level "l" starting at level_start[l]
+    double* u;
+    double* v;
+    int M, Mcap;
+    int level_start[16];
+    // their distorted positions, for the forward polynomial being fit
+    double* U;
+    double* V;
+
+    // normal equations
+    int order;
+    int N;
+    double scale;
+    double* ATA;
+    double* ATb;
+    double* work;
+
+    // the last fit
+    anbool have_result;
+    sip_t last;
+    double last_maxerr;
+};
+
+sip_inverse_fitter_t* sip_inverse_fitter_new(void) {
+    return calloc(1, sizeof(sip_inverse_fitter_t));
+}
+
+void sip_inverse_fitter_free(sip_inverse_fitter_t* f) {
+    if (!f)
+        return;
+    free(f->u);
+    free(f->v);
+    free(f->U);
+    free(f->V);
+    free(f->ATA);
+    free(f->ATb);
+    free(f->work);
+    free(f);
+}
+
+static int level_side(int n0, int level) {
+    return (n0 - 1) * (1 << level) + 1;
+}
+
+// Adds the points of grid level "level" (which must be the next one).
+static void add_level(sip_inverse_fitter_t* f) {
+    int level = f->nlevels;
+    int nx = level_side(f->nx0, level);
+    int ny = level_side(f->ny0, level);
+    int i, j, n;
+    // all of level 0; after that, the points with an odd index.
+    n = level ? nx * ny - level_side(f->nx0, level-1) *
+        level_side(f->ny0, level-1) : nx * ny;
+    if (f->M + n > f->Mcap) {
+        f->Mcap = f->M + n;
+        f->u = realloc(f->u, f->Mcap * sizeof(double));
+        f->v = realloc(f->v, f->Mcap * sizeof(double));
+        f->U = realloc(f->U, f->Mcap * sizeof(double));
+        f->V = realloc(f->V, f->Mcap * sizeof(double));
+    }
+    f->level_start[level] = f->M;
+    for (j=0; j<ny; j++) {
+        for (i=0; i<nx; i++) {
+            if (level && !(i % 2) && !(j % 2))
+                continue;
+            f->u[f->M] = f->minu + i * (f->maxu - f->minu) / (nx - 1);
+            f->v[f->M] = f->minv + j * (f->maxv - f->minv) / (ny - 1);
+            f->M++;
+        }
+    }
+    f->nlevels++;
+    f->level_start[f->nlevels] = f->M;
+}
+
+// Accumulates points [i0, i1) into the normal equations.
+static void accumulate(sip_inverse_fitter_t* f, int i0, int i1) {
+    int N = f->N;
+    int order = f->order;
+    double* phi = f->work;
+    double powu[SIP_MAXORDER], powv[SIP_MAXORDER];
+    int i, j, k, p, q;
+    for (i=i0; i<i1; i++) {
+        double U = f->U[i] / f->scale;
+        double V = f->V[i] / f->scale;
+        double bu = f->u[i] - f->U[i];
+        double bv = f->v[i] - f->V[i];
+        powu[0] = powv[0] = 1.0;
+        for (p=1; p<=order; p++) {
+            powu[p] = powu[p-1] * U;
+            powv[p] = powv[p-1] * V;
+        }
+        k = 0;
+        for (p=0; p<=order; p++)
+            for (q=0; p+q<=order; q++)
+                phi[k++] = powu[p] * powv[q];
+        for (j=0; j<N; j++) {
+            double* row = f->ATA + j*N;
+            for (k=0; k<=j; k++)
+                row[k] += phi[j] * phi[k];
+            f->ATb[2*j + 0] += phi[j] * bu;
+            f->ATb[2*j + 1] += phi[j] * bv;
+        }
+    }
+}
+
+// Solves the normal equations (leaving them intact) into sip->ap,bp.
+static int solve(sip_inverse_fitter_t* f, sip_t* sip) {
+    int N = f->N;
+    double* A = f->work + N;
+    double* x = A + N*N;
+    int p, q, k;
+    memcpy(A, f->ATA, N*N*sizeof(double));
+    memcpy(x, f->ATb, 2*N*sizeof(double));
+    if (cholesky_solve(A, N, x, 2)) {
+        ERROR("Failed to solve SIP inverse matrix equation!");
+        return -1;
+    }
+    memset(sip->ap, 0, sizeof(sip->ap));
+    memset(sip->bp, 0, sizeof(sip->bp));
+    k = 0;
+    for (p=0; p<=f->order; p++)
+        for (q=0; p+q<=f->order; q++) {
+            double s = pow(f->scale, -(p+q));
+            sip->ap[p][q] = x[2*k + 0] * s;
+            sip->bp[p][q] = x[2*k + 1] * s;
+            k++;
+        }
+    return 0;
+}
+
+// Largest round-trip error, in pixels, of points [i0, i1).
+static double max_error(const sip_inverse_fitter_t* f, const sip_t* sip,
+                        int i0, int i1) {
+    double maxerr2 = 0;
+    double uu[64], vv[64];
+    int i, k;
+    for (i=i0; i<i1; i+=64) {
+        int n = MIN(64, i1 - i);
+        sip_calc_inv_distortion_array(sip, f->U + i, f->V + i, n, uu, vv);
+        for (k=0; k<n; k++)
+            maxerr2 = MAX(maxerr2, square(uu[k] - f->u[i+k]) +
+                          square(vv[k] - f->v[i+k]));
+    }
+    return sqrt(maxerr2);
+}
+
+static anbool same_forward(const sip_t* a, const sip_t* b) {
+    return (a->a_order == b->a_order && a->b_order == b->b_order &&
+            a->ap_order == b->ap_order &&
+            memcmp(a->a, b->a, sizeof(a->a)) == 0 &&
+            memcmp(a->b, b->b, sizeof(a->b)) == 0);
+}
+
+int sip_inverse_fitter_fit(sip_inverse_fitter_t* f, sip_t* sip,
+                           int NX, int NY,
+                           double xlo, double xhi, double ylo, double yhi,
+                           double tolerance, double* p_maxerr) {
+    tan_t* tan = &(sip->wcstan);
+    int order = sip->ap_order;
+    double minu, maxu, minv, maxv;
+    int level, N;
+    double maxerr = -1;
+    double preverr = -1;
 
     assert(sip->a_order == sip->b_order);
     assert(sip->ap_order == sip->bp_order);
-    tan = &(sip->wcstan);
-
-    logverb("sip_compute-inverse_polynomials: A %i, AP %i\n",
+    if (order < 0 || order >= SIP_MAXORDER) {
+        ERROR("Inverse SIP order %i out of range", order);
+        return -1;
+    }
+    logverb("sip_inverse_fitter_fit: A %i, AP %i\n",
             sip->a_order, sip->ap_order);
 
-    /*
-     basic idea: lay down a grid in image, for each gridpoint, push
-     through the polynomial to get yourself into warped image
-     coordinate (but not yet lifted onto the sky).  Then, using the
-     set of warped gridpoints as inputs, fit back to their original
-     grid locations as targets.
-     */
-    inv_sip_order = sip->ap_order;
-
-    // Number of grid points to use:
-    if (NX == 0)
-        NX = 10 * (inv_sip_order + 1);
-    if (NY == 0)
-        NY = 10 * (inv_sip_order + 1);
+    if (tolerance > 0) {
+        NX = NY = 2 * (order + 1) + 1;
+    } else {
+        // Number of grid points to use:
+        if (NX == 0)
+            NX = 10 * (order + 1);
+        if (NY == 0)
+            NY = 10 * (order + 1);
+    }
     if (xhi == 0)
         xhi = tan->imagew;
     if (yhi == 0)
         yhi = tan->imageh;
-
-    logverb("NX,NY %i,%i, x range [%f, %f], y range [%f, %f]\n",
-            NX,NY, xlo, xhi, ylo, yhi);
-
-    // Number of coefficients to solve for:
-    // We only compute the upper triangle polynomial terms
-    N = (inv_sip_order + 1) * (inv_sip_order + 2) / 2;
-
-    // Number of samples to fit.
-    M = NX * NY;
-
-    mA = gsl_matrix_alloc(M, N);
-    b1 = gsl_vector_alloc(M);
-    b2 = gsl_vector_alloc(M);
-    assert(mA);
-    assert(b1);
-    assert(b2);
-
-    /*
-     *  Rearranging formula (4), (5), and (6) from the SIP paper gives the
-     *  following equations:
-     * 
-     *    +----------------------- Linear pixel coordinates in PIXELS
-     *    |                        before SIP correction
-     *    |                   +--- Intermediate world coordinates in DEGREES
-     *    |                   |
-     *    v                   v
-     *                   -1
-     *    U = [CD11 CD12]   * x
-     *    V   [CD21 CD22]     y
-     * 
-     *    +---------------- PIXEL distortion delta from telescope to
-     *    |                 linear coordinates
-     *    |    +----------- Linear PIXEL coordinates before SIP correction
-     *    |    |       +--- Polynomial U,V terms in powers of PIXELS
-     *    v    v       v
-     * 
-     *    -f(u1,v1) =  p11 p12 p13 p14 p15 ... * ap1
-     *    -f(u2,v2) =  p21 p22 p23 p24 p25 ...   ap2
-     *    ...
-     * 
-     *    -g(u1,v1) =  p11 p12 p13 p14 p15 ... * bp1
-     *    -g(u2,v2) =  p21 p22 p23 p24 p25 ...   bp2
-     *    ...
-     * 
-     *  which recovers the A and B's.
-     */
-
     minu = xlo - tan->crpix[0];
     maxu = xhi - tan->crpix[0];
     minv = ylo - tan->crpix[1];
     maxv = yhi - tan->crpix[1];
-	
-    // Sample grid locations.
-    i = 0;
-    for (gu=0; gu<NX; gu++) {
-        for (gv=0; gv<NY; gv++) {
-            double fuv, guv;
-            // Calculate grid position in original image pixels
-            u = (gu * (maxu - minu) / (NX-1)) + minu;
-            v = (gv * (maxv - minv) / (NY-1)) + minv;
-            // compute U=u+f(u,v) and V=v+g(u,v)
-            sip_calc_distortion(sip, u, v, &U, &V);
-            fuv = U - u;
-            guv = V - v;
-            // Polynomial terms...
-            j = 0;
-            for (p = 0; p <= inv_sip_order; p++)
-                for (q = 0; q <= inv_sip_order; q++) {
-                    if (p + q > inv_sip_order)
-                        continue;
-                    assert(j < N);
-                    gsl_matrix_set(mA, i, j,
-                                   pow(U, (double)p) * pow(V, (double)q));
-                    j++;
-                }
-            assert(j == N);
-            gsl_vector_set(b1, i, -fuv);
-            gsl_vector_set(b2, i, -guv);
-            i++;
-        }
-    }
-    assert(i == M);
 
-    // Solve the linear equation.
-    if (gslutils_solve_leastsquares_v(mA, 2, b1, &x1, NULL, b2, &x2, NULL)) {
-        ERROR("Failed to solve SIP inverse matrix equation!");
-        return -1;
+    logverb("NX,NY %i,%i, x range [%f, %f], y range [%f, %f]\n",
+            NX,NY, xlo, xhi, ylo, yhi);
+
+    if (f->nx0 != NX || f->ny0 != NY || f->order != order ||
+        f->minu != minu || f->maxu != maxu ||
+        f->minv != minv || f->maxv != maxv) {
+        // a new grid.
+        f->nx0 = NX;
+        f->ny0 = NY;
+        f->minu = minu;
+        f->maxu = maxu;
+        f->minv = minv;
+        f->maxv = maxv;
+        f->nlevels = 0;
+        f->M = 0;
+        f->order = order;
+        // Number of coefficients to solve for:
+        // We only compute the upper triangle polynomial terms
+        f->N = (order + 1) * (order + 2) / 2;
+        f->ATA = realloc(f->ATA, f->N * f->N * sizeof(double));
+        f->ATb = realloc(f->ATb, 2 * f->N * sizeof(double));
+        f->work = realloc(f->work, (f->N + f->N * f->N + 2 * f->N) *
+                          sizeof(double));
+        f->scale = MAX(1.0, MAX(MAX(fabs(minu), fabs(maxu)),
+                                MAX(fabs(minv), fabs(maxv))));
+        f->have_result = FALSE;
+        add_level(f);
+    } else if (f->have_result && same_forward(&f->last, sip) &&
+               (tolerance > 0 ? (f->last_maxerr >= 0 &&
+                                 f->last_maxerr <= tolerance)
+                : TRUE)) {
+        // same polynomial as last time.
+        memcpy(sip->ap, f->last.ap, sizeof(sip->ap));
+        memcpy(sip->bp, f->last.bp, sizeof(sip->bp));
+        if (p_maxerr)
+            *p_maxerr = (f->last_maxerr >= 0 ? f->last_maxerr :
+                         max_error(f, sip, 0, f->level_start[1]));
+        return 0;
     }
+    N = f->N;
+
+    memset(f->ATA, 0, N*N*sizeof(double));
+    memset(f->ATb, 0, 2*N*sizeof(double));
+    sip_calc_distortion_array(sip, f->u, f->v, f->level_start[1],
+                              f->U, f->V);
+    accumulate(f, 0, f->level_start[1]);
+    if (solve(f, sip))
+        return -1;
 
-    // Extract the coefficients
-    j = 0;
-    for (p = 0; p <= inv_sip_order; p++)
-        for (q = 0; q <= inv_sip_order; q++) {
-            if ((p + q > inv_sip_order))
-                continue;
-            assert(j < N);
-            sip->ap[p][q] = gsl_vector_get(x1, j);
-            sip->bp[p][q] = gsl_vector_get(x2, j);
-            j++;
-        }
-    assert(j == N);
-
-    // Check that we found values that actually invert the polynomial.
-    // The error should be particularly small at the grid points.
-    if (log_get_level() > LOG_VERB) {
-        // rms error accumulators:
-        double sumdu = 0;
-        double sumdv = 0;
-        int Z;
-        for (gu = 0; gu < NX; gu++) {
-            for (gv = 0; gv < NY; gv++) {
-                double newu, newv;
-                // Calculate grid position in original image pixels
-                u = (gu * (maxu - minu) / (NX-1)) + minu;
-                v = (gv * (maxv - minv) / (NY-1)) + minv;
-                sip_calc_distortion(sip, u, v, &U, &V);
-                sip_calc_inv_distortion(sip, U, V, &newu, &newv);
-                sumdu += square(u - newu);
-                sumdv += square(v - newv);
-            }
+    for (level=1; tolerance > 0; level++) {
+        int i0, i1;
+        if (level_side(f->nx0, level) > SIP_INVERSE_MAX_GRID ||
+            level_side(f->ny0, level) > SIP_INVERSE_MAX_GRID ||
+            level >= (int)(sizeof(f->level_start)/sizeof(int)) - 1) {
+            logverb("Inverse SIP: reached the largest grid with error %g "
+                    "pixels\n", maxerr);
+            break;
         }
-        sumdu /= (NX*NY);
-        sumdv /= (NX*NY);
-        debug("RMS error of inverting a distortion (at the grid points, in pixels):\n");
-        debug("  du: %g\n", sqrt(sumdu));
-        debug("  dv: %g\n", sqrt(sumdu));
-        debug("  dist: %g\n", sqrt(sumdu + sumdv));
-
-        sumdu = 0;
-        sumdv = 0;
-        Z = 1000;
-        for (i=0; i<Z; i++) {
-            double newu, newv;
-            u = uniform_sample(minu, maxu);
-            v = uniform_sample(minv, maxv);
-            sip_calc_distortion(sip, u, v, &U, &V);
-            sip_calc_inv_distortion(sip, U, V, &newu, &newv);
-            sumdu += square(u - newu);
-            sumdv += square(v - newv);
+        if (level == f->nlevels)
+            add_level(f);
+        i0 = f->level_start[level];
+        i1 = f->level_start[level+1];
+        sip_calc_distortion_array(sip, f->u + i0, f->v + i0, i1 - i0,
+                                  f->U + i0, f->V + i0);
+        // check the current solution on the new points
+        maxerr = max_error(f, sip, i0, i1);
+        debug("Inverse SIP: grid level %i, error %g pixels\n", level-1,
+              maxerr);
+        if (maxerr <= tolerance)
+            break;
+        if (preverr >= 0 && maxerr > 0.9 * preverr) {
+            // a finer grid isn't helping: the order is too low.
+            logverb("Inverse SIP: error %g pixels at order %i; not refining "
+                    "further\n", maxerr, order);
+            break;
         }
-        sumdu /= Z;
-        sumdv /= Z;
-        debug("RMS error of inverting a distortion (at random points, in pixels):\n");
-        debug("  du: %g\n", sqrt(sumdu));
-        debug("  dv: %g\n", sqrt(sumdu));
-        debug("  dist: %g\n", sqrt(sumdu + sumdv));
+        preverr = maxerr;
+        accumulate(f, i0, i1);
+        if (solve(f, sip))
+            return -1;
+        maxerr = -1;
     }
+    if (maxerr < 0 && (p_maxerr || tolerance > 0))
+        // (on the points it was fit to)
+        maxerr = max_error(f, sip, 0, f->level_start[level]);
+    if (p_maxerr)
+        *p_maxerr = maxerr;
+
+    memcpy(&f->last, sip, sizeof(sip_t));
+    f->last_maxerr = maxerr;
+    f->have_result = TRUE;
+    return 0;
+}
 
-    gsl_matrix_free(mA);
-    gsl_vector_free(b1);
-    gsl_vector_free(b2);
-    gsl_vector_free(x1);
-    gsl_vector_free(x2);
+// One fitter per thread for sip_compute_inverse_polynomials(), so that
+// refitting images of the same size reuses its grid.
+static void* sipinv_init_key(void* user) {
+    return sip_inverse_fitter_new();
+}
+static void sipinv_free_key(void* v) {
+    sip_inverse_fitter_free(v);
+}
+#define TSNAME sipinv
+#define TSFREE sipinv_free_key
+#include "thread-specific.inc"
 
-    return 0;
+int sip_compute_inverse_polynomials(sip_t* sip, int NX, int NY,
+                                    double xlo, double xhi,
+                                    double ylo, double yhi) {
+    return sip_inverse_fitter_fit(sipinv_get_key(NULL), sip, NX, NY,
+                                  xlo, xhi, ylo, yhi, 0, NULL);
 }
 
 anbool tan_pixel_is_inside_image(const tan_t* wcs, double x, double y) {
@@ -346,40 +346,123 @@ anbool tan_radec2pixelxy(const tan_t* tan, double a, double d, double *px, doubl
     return tan_xyzarr2pixelxy(tan, xyzpt, px, py);
 }
 
-void sip_calc_distortion(const sip_t* sip, double u, double v, double* U, double *V) {
-    // Do SIP distortion (in relative pixel coordinates)
-    // See the sip_t struct definition in header file for details
+// Evaluates SUM c[p][q] u^p v^q over p+q <= order, in Horner form:
+// nested over v inside each power of u, then over u.
+static double sip_poly(const double c[SIP_MAXORDER][SIP_MAXORDER], int order,
+                       double u, double v) {
     int p, q;
-    double fuv=0.;
-    double guv=0.;
-
-    // avoid using pow() function
-    double powu[SIP_MAXORDER];
-    double powv[SIP_MAXORDER];
-    powu[0] = 1.0;
-    powu[1] = u;
-    powv[0] = 1.0;
-    powv[1] = v;
-    for (p=2; p <= MAX(sip->a_order, sip->b_order); p++) {
-        powu[p] = powu[p-1] * u;
-        powv[p] = powv[p-1] * v;
+    double f = 0.;
+    for (p=order; p>=0; p--) {
+        double h = 0.;
+        for (q=order-p; q>=0; q--)
+            h = h * v + c[p][q];
+        f = f * u + h;
+    }
+    return f;
+}
+
+// Points are evaluated in blocks of this many, term by term, so that the
+// inner loops run over points and can be vectorized.
+#define SIP_BLOCK 64
+
+// sip_poly() for each of N (<= SIP_BLOCK) points.
+static void sip_poly_block(const double c[SIP_MAXORDER][SIP_MAXORDER],
+                           int order, const double* u, const double* v,
+                           int N, double* f) {
+    double h[SIP_BLOCK];
+    int p, q, k;
+    for (k=0; k<N; k++)
+        f[k] = 0.;
+    for (p=order; p>=0; p--) {
+        for (k=0; k<N; k++)
+            h[k] = c[p][order-p];
+        for (q=order-p-1; q>=0; q--) {
+            const double cpq = c[p][q];
+            for (k=0; k<N; k++)
+                h[k] = h[k] * v[k] + cpq;
+        }
+        for (k=0; k<N; k++)
+            f[k] = f[k] * u[k] + h[k];
     }
+}
 
-    for (p=0; p<=sip->a_order; p++)
-        for (q=0; q<=sip->a_order; q++)
-            // We include all terms, even the constant and linear ones; the standard
-            // isn't clear on whether these are allowed or not.
-            if (p+q <= sip->a_order)
-                fuv += sip->a[p][q] * powu[p] * powv[q];
-    for (p=0; p<=sip->b_order; p++) 
-        for (q=0; q<=sip->b_order; q++) 
-            if (p+q <= sip->b_order)
-                guv += sip->b[p][q] * powu[p] * powv[q];
+// Adds the polynomials "a" and "b" to N points (x - x0, y - y0), then
+// adds x0,y0 back.  The outputs may alias the inputs.
+static void sip_poly_array(const double a[SIP_MAXORDER][SIP_MAXORDER],
+                           int aorder,
+                           const double b[SIP_MAXORDER][SIP_MAXORDER],
+                           int border, double x0, double y0,
+                           const double* x, const double* y, int N,
+                           double* X, double* Y) {
+    double u[SIP_BLOCK], v[SIP_BLOCK], f[SIP_BLOCK], g[SIP_BLOCK];
+    int i, k;
+    for (i=0; i<N; i+=SIP_BLOCK) {
+        int n = MIN(SIP_BLOCK, N - i);
+        for (k=0; k<n; k++) {
+            u[k] = x[i+k] - x0;
+            v[k] = y[i+k] - y0;
+        }
+        sip_poly_block(a, aorder, u, v, n, f);
+        sip_poly_block(b, border, u, v, n, g);
+        for (k=0; k<n; k++) {
+            X[i+k] = u[k] + f[k] + x0;
+            Y[i+k] = v[k] + g[k] + y0;
+        }
+    }
+}
+
+void sip_calc_distortion(const sip_t* sip, double u, double v, double* U, double *V) {
+    // Do SIP distortion (in relative pixel coordinates)
+    // See the sip_t struct definition in header file for details
 
+    // We include all terms, even the constant and linear ones; the standard
+    // isn't clear on whether these are allowed or not.
+    double fuv = sip_poly(sip->a, sip->a_order, u, v);
+    double guv = sip_poly(sip->b, sip->b_order, u, v);
     *U = u + fuv;
     *V = v + guv;
 }
 
+void sip_calc_distortion_array(const sip_t* sip, const double* u,
+                               const double* v, int N, double* U, double* V) {
+    sip_poly_array(sip->a, sip->a_order, sip->b, sip->b_order, 0., 0.,
+                   u, v, N, U, V);
+}
+
+void sip_calc_inv_distortion_array(const sip_t* sip, const double* U,
+                                   const double* V, int N,
+                                   double* u, double* v) {
+    sip_poly_array(sip->ap, sip->ap_order, sip->bp, sip->bp_order, 0., 0.,
+                   U, V, N, u, v);
+}
+
+void sip_pixel_distortion_array(const sip_t* sip, const double* x,
+                                const double* y, int N,
+                                double* X, double* Y) {
+    sip_poly_array(sip->a, sip->a_order, sip->b, sip->b_order,
+                   sip->wcstan.crpix[0], sip->wcstan.crpix[1],
+                   x, y, N, X, Y);
+}
+
+void sip_pixel_undistortion_array(const sip_t* sip, const double* x,
+                                  const double* y, int N,
+                                  double* X, double* Y) {
+    if (!has_distortions(sip)) {
+        if (X != x)
+            memmove(X, x, N * sizeof(double));
+        if (Y != y)
+            memmove(Y, y, N * sizeof(double));
+        return;
+    }
+    if (sip->a_order != 0 && sip->ap_order == 0) {
+        fprintf(stderr, "suspicious inversion; no inverse SIP coeffs "
+                "yet there are forward SIP coeffs\n");
+    }
+    sip_poly_array(sip->ap, sip->ap_order, sip->bp, sip->bp_order,
+                   sip->wcstan.crpix[0], sip->wcstan.crpix[1],
+                   x, y, N, X, Y);
+}
+
 void sip_pixel_distortion(const sip_t* sip, double x, double y, double* X, double *Y) {
     sip_distortion(sip, x, y, X, Y);
 }
@@ -406,31 +489,8 @@ void sip_pixel_undistortion(const sip_t* sip, double x, double y, double* X, dou
 
 void sip_calc_inv_distortion(const sip_t* sip, double U, double V, double* u, double *v)
 {
-    int p, q;
-    double fUV=0.;
-    double gUV=0.;
-
-    // avoid using pow() function
-    double powu[SIP_MAXORDER];
-    double powv[SIP_MAXORDER];
-    powu[0] = 1.0;
-    powu[1] = U;
-    powv[0] = 1.0;
-    powv[1] = V;
-    for (p=2; p <= MAX(sip->ap_order, sip->bp_order); p++) {
-        powu[p] = powu[p-1] * U;
-        powv[p] = powv[p-1] * V;
-    }
-
-    for (p=0; p<=sip->ap_order; p++)
-        for (q=0; q<=sip->ap_order; q++)
-            if (p+q <= sip->ap_order)
-                fUV += sip->ap[p][q] * powu[p] * powv[q];
-    for (p=0; p<=sip->bp_order; p++) 
-        for (q=0; q<=sip->bp_order; q++) 
-            if (p+q <= sip->bp_order)
-                gUV += sip->bp[p][q] * powu[p] * powv[q];
-
+    double fUV = sip_poly(sip->ap, sip->ap_order, U, V);
+    double gUV = sip_poly(sip->bp, sip->bp_order, U, V);
     *u = U + fUV;
     *v = V + gUV;
 }
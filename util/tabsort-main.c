@@ -10,12 +10,14 @@
 #include "tabsort.h"
 #include "fitsioutils.h"
 
-static const char* OPTIONS = "hd";
+static const char* OPTIONS = "hdM:t:";
 
 static void printHelp(char* progname) {
     printf("%s  [options]  <column-name> <input-file> <output-file>\n"
            "  options include:\n"
-           "      [-d]: sort in descending order (default, ascending)\n",
+           "      [-d]: sort in descending order (default, ascending)\n"
+           "      [-M <MB>]: memory budget; bigger tables are sorted out-of-core\n"
+           "      [-t <temp-dir>]: directory for out-of-core temp files; default $TMP or /tmp\n",
            progname);
 }
 
@@ -27,12 +29,20 @@ int main(int argc, char *argv[]) {
     char* colname = NULL;
     char* progname = argv[0];
     anbool descending = FALSE;
+    size_t memlimit = 0;
+    char* tempdir = NULL;
 
     while ((argchar = getopt(argc, argv, OPTIONS)) != -1)
         switch (argchar) {
         case 'd':
             descending = TRUE;
             break;
+        case 'M':
+            memlimit = (size_t)(atof(optarg) * 1024 * 1024);
+            break;
+        case 't':
+            tempdir = optarg;
+            break;
         case '?':
         case 'h':
             printHelp(progname);
@@ -52,6 +62,6 @@ int main(int argc, char *argv[]) {
 
     fits_use_error_system();
 
-    return tabsort(infn, outfn, colname, descending);
+    return tabsort2(infn, outfn, colname, descending, memlimit, tempdir);
 }
 
@@ -10,20 +10,228 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 
+#include "os-features.h"
 #include "anqfits.h"
 #include "ioutils.h"
 #include "fitsioutils.h"
 #include "permutedsort.h"
+#include "an-endian.h"
+#include "tabsort.h"
 #include "errors.h"
 
+/*
+ External-memory sort of one table's rows: sorted runs that each fit
+ in "memlimit" bytes are written one after another to a temp file,
+ then merged with a k-way heap merge into "fout".  All file I/O is in
+ large sequential blocks.
+ */
+struct run {
+    off_t pos, end;     // next unread byte, end of run (in the temp file)
+    unsigned char* buf; // buffered rows
+    size_t nbuf;        // rows in buf
+    size_t ibuf;        // current row in buf
+};
+
+// Copies the sort key of a row into "key", in native byte order.
+static void row_key(const unsigned char* row, int keyoff, int atomsize,
+                    void* key) {
+    memcpy(key, row + keyoff, atomsize);
+    if (!is_big_endian())
+        endian_swap(key, atomsize);
+}
+
+static int run_refill(struct run* r, FILE* fid, int W, size_t bufrows) {
+    size_t n = MIN(bufrows, (size_t)((r->end - r->pos) / W));
+    r->ibuf = 0;
+    r->nbuf = n;
+    if (!n)
+        return 0;
+    if (fseeko(fid, r->pos, SEEK_SET) ||
+        fread(r->buf, W, n, fid) != n) {
+        SYSERROR("Failed to read sorted run from temp file");
+        return -1;
+    }
+    r->pos += (off_t)n * W;
+    return 0;
+}
+
+// Is run "a"'s current row before run "b"'s?  Ties go to the earlier
+// run, which keeps the sort stable.
+static anbool run_before(const struct run* runs, int a, int b, int W,
+                         int keyoff, int atomsize,
+                         int (*sort_func)(const void*, const void*)) {
+    int64_t ka, kb;
+    int c;
+    row_key(runs[a].buf + runs[a].ibuf * W, keyoff, atomsize, &ka);
+    row_key(runs[b].buf + runs[b].ibuf * W, keyoff, atomsize, &kb);
+    c = sort_func(&ka, &kb);
+    if (c)
+        return (c < 0);
+    return (a < b);
+}
+
+static void heap_down(int* heap, int n, int i, const struct run* runs,
+                      int W, int keyoff, int atomsize,
+                      int (*sort_func)(const void*, const void*)) {
+    for (;;) {
+        int l = 2*i + 1;
+        int m = i;
+        int tmp;
+        if (l < n && run_before(runs, heap[l], heap[m], W, keyoff, atomsize, sort_func))
+            m = l;
+        if (l+1 < n && run_before(runs, heap[l+1], heap[m], W, keyoff, atomsize, sort_func))
+            m = l+1;
+        if (m == i)
+            return;
+        tmp = heap[i];
+        heap[i] = heap[m];
+        heap[m] = tmp;
+        i = m;
+    }
+}
+
+static int sort_table_external(FILE* fin, off_t datstart, int64_t NR, int W,
+                               int keyoff, int atomsize,
+                               int (*sort_func)(const void*, const void*),
+                               size_t memlimit, const char* tempdir,
+                               FILE* fout) {
+    char* tempfn = NULL;
+    FILE* ftmp = NULL;
+    unsigned char* rows = NULL;
+    unsigned char* keys = NULL;
+    struct run* runs = NULL;
+    int* heap = NULL;
+    int nruns, nheap, i;
+    int64_t runrows, r0;
+    size_t bufrows;
+    int rtn = -1;
+
+    // rows, their keys, and the permutation.
+    runrows = MAX(1, memlimit / (W + atomsize + sizeof(int64_t)));
+    runrows = MIN(runrows, NR);
+    nruns = (int)((NR + runrows - 1) / runrows);
+
+    tempfn = create_temp_file("tabsort", tempdir);
+    if (!tempfn)
+        goto bailout;
+    ftmp = fopen(tempfn, "w+b");
+    if (!ftmp) {
+        SYSERROR("Failed to open temp file %s", tempfn);
+        goto bailout;
+    }
+    rows = malloc(runrows * W);
+    keys = malloc(runrows * atomsize);
+    runs = calloc(nruns, sizeof(struct run));
+    heap = malloc(nruns * sizeof(int));
+    if (!rows || !keys || !runs || !heap) {
+        SYSERROR("Failed to allocate buffers for %lld-row runs",
+                 (long long)runrows);
+        goto bailout;
+    }
+
+    printf("Sorting %lld rows in %i runs of up to %lld rows\n",
+           (long long)NR, nruns, (long long)runrows);
+    for (i=0, r0=0; i<nruns; i++, r0+=runrows) {
+        int64_t n = MIN(runrows, NR - r0);
+        int64_t j;
+        int64_t* perm;
+        if (fseeko(fin, datstart + r0 * W, SEEK_SET) ||
+            fread(rows, W, n, fin) != n) {
+            SYSERROR("Failed to read rows %lld to %lld", (long long)r0,
+                     (long long)(r0 + n));
+            goto bailout;
+        }
+        for (j=0; j<n; j++)
+            row_key(rows + j * W, keyoff, atomsize, keys + j * atomsize);
+        perm = permuted_sort_64(keys, atomsize, sort_func, NULL, n);
+        if (!perm) {
+            SYSERROR("Failed to sort run %i", i);
+            goto bailout;
+        }
+        runs[i].pos = (off_t)r0 * W;
+        runs[i].end = (off_t)(r0 + n) * W;
+        for (j=0; j<n; j++) {
+            if (fwrite(rows + perm[j] * W, 1, W, ftmp) != W) {
+                SYSERROR("Failed to write sorted run to temp file %s", tempfn);
+                free(perm);
+                goto bailout;
+            }
+        }
+        free(perm);
+    }
+    free(keys);
+    keys = NULL;
+    free(rows);
+    rows = NULL;
+    if (fflush(ftmp)) {
+        SYSERROR("Failed to write temp file %s", tempfn);
+        goto bailout;
+    }
+
+    // Merge, with the memory budget split among the run buffers.
+    bufrows = MAX(1, memlimit / ((size_t)nruns * W));
+    nheap = 0;
+    for (i=0; i<nruns; i++) {
+        runs[i].buf = malloc(bufrows * W);
+        if (!runs[i].buf) {
+            SYSERROR("Failed to allocate merge buffer");
+            goto bailout;
+        }
+        if (run_refill(runs + i, ftmp, W, bufrows))
+            goto bailout;
+        if (runs[i].nbuf)
+            heap[nheap++] = i;
+    }
+    for (i=nheap/2-1; i>=0; i--)
+        heap_down(heap, nheap, i, runs, W, keyoff, atomsize, sort_func);
+    while (nheap) {
+        struct run* r = runs + heap[0];
+        if (fwrite(r->buf + r->ibuf * W, 1, W, fout) != W) {
+            SYSERROR("Failed to write FITS table row");
+            goto bailout;
+        }
+        r->ibuf++;
+        if (r->ibuf == r->nbuf) {
+            if (run_refill(r, ftmp, W, bufrows))
+                goto bailout;
+            if (!r->nbuf)
+                heap[0] = heap[--nheap];
+        }
+        heap_down(heap, nheap, 0, runs, W, keyoff, atomsize, sort_func);
+    }
+    rtn = 0;
+
+ bailout:
+    if (runs)
+        for (i=0; i<nruns; i++)
+            free(runs[i].buf);
+    free(runs);
+    free(heap);
+    free(rows);
+    free(keys);
+    if (ftmp)
+        fclose(ftmp);
+    if (tempfn) {
+        if (unlink(tempfn))
+            SYSERROR("Failed to delete temp file %s", tempfn);
+        free(tempfn);
+    }
+    return rtn;
+}
+
 int tabsort(const char* infn, const char* outfn, const char* colname,
             int descending) {
+    return tabsort2(infn, outfn, colname, descending, 0, NULL);
+}
+
+int tabsort2(const char* infn, const char* outfn, const char* colname,
+             int descending, size_t memlimit, const char* tempdir) {
     FILE* fin;
     FILE* fout;
     int ext, nextens;
     off_t start, size;
     void* data = NULL;
-    int* perm = NULL;
+    int64_t* perm = NULL;
     unsigned char* map = NULL;
     size_t mapsize = 0;
     anqfits_t* anq = NULL;
@@ -67,7 +275,7 @@ int tabsort(const char* infn, const char* outfn, const char* colname,
         unsigned char* tabledata;
         unsigned char* tablehdr;
         off_t hdrstart, hdrsize, datsize, datstart;
-        int i;
+        int64_t i;
 
         hdrstart = anqfits_header_start(anq, ext);
         hdrsize  = anqfits_header_size (anq, ext);
@@ -90,21 +298,18 @@ int tabsort(const char* infn, const char* outfn, const char* colname,
         col = table->col + c;
         switch (col->atom_type) {
         case TFITS_BIN_TYPE_D:
-            data = realloc(data, table->nr * sizeof(double));
             if (descending)
                 sort_func = compare_doubles_desc;
             else
                 sort_func = compare_doubles_asc;
             break;
         case TFITS_BIN_TYPE_E:
-            data = realloc(data, table->nr * sizeof(float));
             if (descending)
                 sort_func = compare_floats_desc;
             else
                 sort_func = compare_floats_asc;
             break;
         case TFITS_BIN_TYPE_K:
-            data = realloc(data, table->nr * sizeof(int64_t));
             if (descending)
                 sort_func = compare_int64_desc;
             else
@@ -116,13 +321,37 @@ int tabsort(const char* infn, const char* outfn, const char* colname,
             continue;
         }
 
-        // Grab the sort column.
         atomsize = fits_get_atom_size(col->atom_type);
+
+        if (memlimit && (size_t)table->nr * table->tab_w > memlimit) {
+            // Too big to sort in memory.
+            if (pipe_file_offset(fin, hdrstart, hdrsize, fout) ||
+                sort_table_external(fin, datstart, table->nr, table->tab_w,
+                                    fits_offset_of_column(table, c), atomsize,
+                                    sort_func, memlimit, tempdir, fout)) {
+                ERROR("Failed to sort extension %i", ext);
+                goto bailout;
+            }
+            if (fits_pad_file(fout)) {
+                ERROR("Failed to add padding to extension %i", ext);
+                goto bailout;
+            }
+            qfits_table_close(table);
+            continue;
+        }
+
+        // Grab the sort column.
+        data = realloc(data, MAX(table->nr, 1) * atomsize);
+        if (!data) {
+            SYSERROR("Failed to allocate sort column for %lld rows",
+                     (long long)table->nr);
+            goto bailout;
+        }
         printf("Reading sort column \"%s\"\n", colname);
         qfits_query_column_seq_to_array(table, c, 0, table->nr, data, atomsize);
         // Sort it.
         printf("Sorting sort column\n");
-        perm = permuted_sort(data, atomsize, sort_func, NULL, table->nr);
+        perm = permuted_sort_64(data, atomsize, sort_func, NULL, table->nr);
 
         // mmap the input file.
         printf("mmapping input file\n");
@@ -149,7 +378,7 @@ int tabsort(const char* infn, const char* outfn, const char* colname,
         for (i=0; i<table->nr; i++) {
             unsigned char* rowptr;
             if (i % 100000 == 0)
-                printf("Writing row %i\n", i);
+                printf("Writing row %lld\n", (long long)i);
             rowptr = tabledata + (off_t)(perm[i]) * (off_t)table->tab_w;
             if (fwrite(rowptr, 1, table->tab_w, fout) != table->tab_w) {
                 SYSERROR("Failed to write FITS table row");
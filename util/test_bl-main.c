@@ -0,0 +1,97 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_big_list(CuTest*);
+extern void test_il_sorted(CuTest*);
+extern void test_ll_sorted_contains_1(CuTest*);
+extern void test_ll_sorted_index_of_1(CuTest*);
+extern void test_il_remove_index_range_1(CuTest*);
+extern void test_sl_split_1(CuTest*);
+extern void test_sl_split_2(CuTest*);
+extern void test_sl_split_3(CuTest*);
+extern void test_il_new(CuTest*);
+extern void test_il_size(CuTest*);
+extern void test_il_get_push(CuTest*);
+extern void test_il_push_pop(CuTest*);
+extern void test_il_push_pop2(CuTest*);
+extern void test_il(CuTest*);
+extern void test_il_remove_value(CuTest*);
+extern void test_il_contains(CuTest*);
+extern void test_il_insert_ascending(CuTest*);
+extern void test_il_insert_descending(CuTest*);
+extern void test_il_insert_unique_ascending(CuTest*);
+extern void test_il_copy(CuTest*);
+extern void test_il_dupe(CuTest*);
+extern void test_delete(CuTest*);
+extern void test_delete_2(CuTest*);
+extern void test_delete_3(CuTest*);
+extern void test_set(CuTest*);
+extern void test_delete_4(CuTest*);
+extern void test_dl_push(CuTest*);
+extern void test_bl_extend(CuTest*);
+extern void test_sl_join(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_big_list);
+    SUITE_ADD_TEST(suite, test_il_sorted);
+    SUITE_ADD_TEST(suite, test_ll_sorted_contains_1);
+    SUITE_ADD_TEST(suite, test_ll_sorted_index_of_1);
+    SUITE_ADD_TEST(suite, test_il_remove_index_range_1);
+    SUITE_ADD_TEST(suite, test_sl_split_1);
+    SUITE_ADD_TEST(suite, test_sl_split_2);
+    SUITE_ADD_TEST(suite, test_sl_split_3);
+    SUITE_ADD_TEST(suite, test_il_new);
+    SUITE_ADD_TEST(suite, test_il_size);
+    SUITE_ADD_TEST(suite, test_il_get_push);
+    SUITE_ADD_TEST(suite, test_il_push_pop);
+    SUITE_ADD_TEST(suite, test_il_push_pop2);
+    SUITE_ADD_TEST(suite, test_il);
+    SUITE_ADD_TEST(suite, test_il_remove_value);
+    SUITE_ADD_TEST(suite, test_il_contains);
+    SUITE_ADD_TEST(suite, test_il_insert_ascending);
+    SUITE_ADD_TEST(suite, test_il_insert_descending);
+    SUITE_ADD_TEST(suite, test_il_insert_unique_ascending);
+    SUITE_ADD_TEST(suite, test_il_copy);
+    SUITE_ADD_TEST(suite, test_il_dupe);
+    SUITE_ADD_TEST(suite, test_delete);
+    SUITE_ADD_TEST(suite, test_delete_2);
+    SUITE_ADD_TEST(suite, test_delete_3);
+    SUITE_ADD_TEST(suite, test_set);
+    SUITE_ADD_TEST(suite, test_delete_4);
+    SUITE_ADD_TEST(suite, test_dl_push);
+    SUITE_ADD_TEST(suite, test_bl_extend);
+    SUITE_ADD_TEST(suite, test_sl_join);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
@@ -11,6 +11,7 @@
 
 #include "fit-wcs.h"
 #include "sip.h"
+#include "mathutil.h"
 
 //sip_t* wcs_shift(sip_t* wcs, double xs, double ys);
 
@@ -159,6 +160,71 @@ void test_wcs_shift(CuTest* tc) {
      */
 }
 
+// Recovers a known order-4 distortion from noiseless, weighted
+// correspondences, with the normal equations and with QR.
+void test_fit_sip_wcs(CuTest* tc) {
+    int M = 200;
+    int order = 4;
+    double xyz[200*3];
+    double xy[200*2];
+    double weights[200];
+    unsigned int seed = 42;
+    sip_t truth, fit[2];
+    int i, k, p, q;
+
+    memset(&truth, 0, sizeof(sip_t));
+    truth.wcstan.crval[0] = 150.0;
+    truth.wcstan.crval[1] = 30.0;
+    truth.wcstan.crpix[0] = 1024.5;
+    truth.wcstan.crpix[1] = 1024.5;
+    truth.wcstan.cd[0][0] = -2e-4;
+    truth.wcstan.cd[0][1] = 1e-5;
+    truth.wcstan.cd[1][1] = 2e-4;
+    truth.wcstan.imagew = truth.wcstan.imageh = 2048;
+    truth.a_order = truth.b_order = order;
+    for (p=0; p<=order; p++)
+        for (q=0; p+q<=order; q++) {
+            if (p + q < 2)
+                continue;
+            truth.a[p][q] = uniform_sample_r(&seed, -3, 3) / pow(1024, p+q);
+            truth.b[p][q] = uniform_sample_r(&seed, -3, 3) / pow(1024, p+q);
+        }
+    for (i=0; i<M; i++) {
+        xy[2*i+0] = uniform_sample_r(&seed, 1, 2048);
+        xy[2*i+1] = uniform_sample_r(&seed, 1, 2048);
+        sip_pixelxy2xyzarr(&truth, xy[2*i+0], xy[2*i+1], xyz + 3*i);
+        weights[i] = uniform_sample_r(&seed, 0.2, 1.0);
+    }
+
+    for (k=0; k<2; k++) {
+        CuAssertIntEquals(tc, 0,
+                          fit_sip_coefficients_flags(xyz, xy, weights, M,
+                                                     &truth.wcstan, order, 0,
+                                                     k ? FIT_SIP_QR : 0,
+                                                     fit + k));
+        for (p=0; p<=order; p++)
+            for (q=0; p+q<=order; q++) {
+                double tol = 1e-9 / pow(1024, p+q);
+                CuAssertDblEquals(tc, truth.a[p][q], fit[k].a[p][q], tol);
+                CuAssertDblEquals(tc, truth.b[p][q], fit[k].b[p][q], tol);
+            }
+    }
+
+    // The full fit, from a perturbed TAN.
+    memcpy(&(fit[1].wcstan), &truth.wcstan, sizeof(tan_t));
+    fit[1].wcstan.crval[0] += 1e-3;
+    fit[1].wcstan.cd[0][0] *= 1.001;
+    CuAssertIntEquals(tc, 0,
+                      fit_sip_wcs(xyz, xy, weights, M, &(fit[1].wcstan),
+                                  order, order+1, 1, fit + 0));
+    for (i=0; i<M; i++) {
+        double x, y;
+        CuAssertTrue(tc, sip_xyzarr2pixelxy(fit + 0, xyz + 3*i, &x, &y));
+        CuAssertDblEquals(tc, xy[2*i+0], x, 1e-2);
+        CuAssertDblEquals(tc, xy[2*i+1], y, 1e-2);
+    }
+}
+
 #if 0
 int main() {
     CuString *output = CuStringNew();
@@ -0,0 +1,77 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_copy_rows_file_to_memory(CuTest*);
+extern void test_copy_rows_inmemory(CuTest*);
+extern void test_one_column_write_read(CuTest*);
+extern void test_headers(CuTest*);
+extern void test_multi_headers(CuTest*);
+extern void test_one_int_column_write_read(CuTest*);
+extern void test_two_columns_with_conversion(CuTest*);
+extern void test_arrays(CuTest*);
+extern void test_conversion(CuTest*);
+extern void test_struct_1(CuTest*);
+extern void test_struct_2(CuTest*);
+extern void test_inmemory_one_column_write_read(CuTest*);
+extern void test_inmemory_headers(CuTest*);
+extern void test_inmemory_one_int_column_write_read(CuTest*);
+extern void test_inmemory_two_columns_with_conversion(CuTest*);
+extern void test_inmemory_struct_2(CuTest*);
+extern void test_inmemory_arrays(CuTest*);
+extern void test_inmemory_conversion(CuTest*);
+extern void test_inmemory_struct_1(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_copy_rows_file_to_memory);
+    SUITE_ADD_TEST(suite, test_copy_rows_inmemory);
+    SUITE_ADD_TEST(suite, test_one_column_write_read);
+    SUITE_ADD_TEST(suite, test_headers);
+    SUITE_ADD_TEST(suite, test_multi_headers);
+    SUITE_ADD_TEST(suite, test_one_int_column_write_read);
+    SUITE_ADD_TEST(suite, test_two_columns_with_conversion);
+    SUITE_ADD_TEST(suite, test_arrays);
+    SUITE_ADD_TEST(suite, test_conversion);
+    SUITE_ADD_TEST(suite, test_struct_1);
+    SUITE_ADD_TEST(suite, test_struct_2);
+    SUITE_ADD_TEST(suite, test_inmemory_one_column_write_read);
+    SUITE_ADD_TEST(suite, test_inmemory_headers);
+    SUITE_ADD_TEST(suite, test_inmemory_one_int_column_write_read);
+    SUITE_ADD_TEST(suite, test_inmemory_two_columns_with_conversion);
+    SUITE_ADD_TEST(suite, test_inmemory_struct_2);
+    SUITE_ADD_TEST(suite, test_inmemory_arrays);
+    SUITE_ADD_TEST(suite, test_inmemory_conversion);
+    SUITE_ADD_TEST(suite, test_inmemory_struct_1);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
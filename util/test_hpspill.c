@@ -0,0 +1,57 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cutest.h"
+#include "hpspill.h"
+
+void test_hpspill_roundtrip(CuTest* ct) {
+    int NHP = 12;
+    int N = 10000;
+    int i, hp;
+    int64_t total = 0;
+    // a small budget, so most rows get spilled.
+    hpspill_t* sp = hpspill_new(NHP, sizeof(int64_t), 1000, "/tmp");
+    CuAssertPtrNotNull(ct, sp);
+    for (i=0; i<N; i++) {
+        int64_t row = i;
+        CuAssertIntEquals(ct, 0, hpspill_append(sp, (i * 7) % NHP, &row));
+    }
+    for (hp=0; hp<NHP; hp++) {
+        int64_t n = hpspill_nrows(sp, hp);
+        int64_t* rows = hpspill_read(sp, hp);
+        CuAssertPtrNotNull(ct, rows);
+        // in the order they were appended
+        for (i=0; i<n; i++)
+            CuAssertIntEquals(ct, hp, (int)((rows[i] * 7) % NHP));
+        for (i=1; i<n; i++)
+            CuAssert(ct, "order", rows[i] > rows[i-1]);
+        free(rows);
+        total += n;
+    }
+    CuAssertIntEquals(ct, N, (int)total);
+    {
+        int64_t row = 0;
+        CuAssertIntEquals(ct, -1, hpspill_append(sp, -1, &row));
+        CuAssertIntEquals(ct, -1, hpspill_append(sp, NHP, &row));
+    }
+
+    CuAssertIntEquals(ct, 0, hpspill_flush(sp));
+    for (hp=0; hp<NHP; hp++) {
+        FILE* fid = hpspill_open(sp, hp);
+        int64_t row;
+        CuAssertPtrNotNull(ct, fid);
+        for (i=0; i<hpspill_nrows(sp, hp); i++)
+            CuAssertIntEquals(ct, 1, (int)fread(&row, sizeof(int64_t), 1, fid));
+        CuAssertIntEquals(ct, 0, (int)fread(&row, sizeof(int64_t), 1, fid));
+        fclose(fid);
+    }
+    CuAssertIntEquals(ct, 0, hpspill_remove(sp, 0));
+    CuAssertIntEquals(ct, 0, (int)hpspill_nrows(sp, 0));
+    CuAssertPtrEquals(ct, NULL, hpspill_open(sp, 0));
+    hpspill_free(sp);
+}
@@ -0,0 +1,69 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_run_command_1(CuTest*);
+extern void test_run_command(CuTest*);
+extern void test_split_long_string(CuTest*);
+extern void test_streq_1(CuTest*);
+extern void test_canon_1(CuTest*);
+extern void test_canon_2(CuTest*);
+extern void test_canon_2b(CuTest*);
+extern void test_canon_2c(CuTest*);
+extern void test_canon_3(CuTest*);
+extern void test_canon_3b(CuTest*);
+extern void test_canon_4(CuTest*);
+extern void test_canon_4b(CuTest*);
+extern void test_canon_4c(CuTest*);
+extern void test_canon_5(CuTest*);
+extern void test_mkdir_p_threads(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_run_command_1);
+    SUITE_ADD_TEST(suite, test_run_command);
+    SUITE_ADD_TEST(suite, test_split_long_string);
+    SUITE_ADD_TEST(suite, test_streq_1);
+    SUITE_ADD_TEST(suite, test_canon_1);
+    SUITE_ADD_TEST(suite, test_canon_2);
+    SUITE_ADD_TEST(suite, test_canon_2b);
+    SUITE_ADD_TEST(suite, test_canon_2c);
+    SUITE_ADD_TEST(suite, test_canon_3);
+    SUITE_ADD_TEST(suite, test_canon_3b);
+    SUITE_ADD_TEST(suite, test_canon_4);
+    SUITE_ADD_TEST(suite, test_canon_4b);
+    SUITE_ADD_TEST(suite, test_canon_4c);
+    SUITE_ADD_TEST(suite, test_canon_5);
+    SUITE_ADD_TEST(suite, test_mkdir_p_threads);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
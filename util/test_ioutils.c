@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <pthread.h>
 
 #include "cutest.h"
 #include "ioutils.h"
@@ -325,3 +327,33 @@ void test_canon_5(CuTest* tc) {
     assertCanon(tc, "/../..//x", "/x");
 }
 
+static void* mkdir_p_thread(void* dir) {
+    return (void*)(long)mkdir_p(dir);
+}
+
+void test_mkdir_p_threads(CuTest* tc) {
+    pthread_t threads[8];
+    char* base;
+    char* dir;
+    void* rtn;
+    int i;
+
+    base = create_temp_dir("test_mkdir_p", NULL);
+    CuAssertPtrNotNull(tc, base);
+    asprintf_safe(&dir, "%s/a/b/c", base);
+    // all the threads try to create the same directories.
+    for (i=0; i<8; i++)
+        CuAssertIntEquals(tc, 0, pthread_create(threads + i, NULL,
+                                                mkdir_p_thread, dir));
+    for (i=0; i<8; i++) {
+        CuAssertIntEquals(tc, 0, pthread_join(threads[i], &rtn));
+        CuAssertIntEquals(tc, 0, (int)(long)rtn);
+    }
+    CuAssert(tc, "created", path_is_dir(dir));
+    CuAssertIntEquals(tc, 0, mkdir_p(dir));
+    free(dir);
+    asprintf_safe(&dir, "rm -r %s", base);
+    CuAssertIntEquals(tc, 0, system(dir));
+    free(dir);
+    free(base);
+}
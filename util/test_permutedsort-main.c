@@ -0,0 +1,47 @@
+
+
+/* This is auto-generated code. Edit at your own peril. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cutest.h"
+
+
+extern void test_permuted_sort_64(CuTest*);
+extern void test_permuted_sort_radix(CuTest*);
+extern void test_permuted_sort_merge(CuTest*);
+extern void test_permuted_sort_nan(CuTest*);
+
+
+void RunAllTests(void) 
+{
+    CuString *output = CuStringNew();
+    CuSuite* suite = CuSuiteNew();
+
+
+    SUITE_ADD_TEST(suite, test_permuted_sort_64);
+    SUITE_ADD_TEST(suite, test_permuted_sort_radix);
+    SUITE_ADD_TEST(suite, test_permuted_sort_merge);
+    SUITE_ADD_TEST(suite, test_permuted_sort_nan);
+
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+
+    printf("%s\n", output->buffer);
+
+    CuSuiteFree(suite);
+    CuStringFree(output);
+}
+
+int main(int argc, char** args)
+{
+    if (argc > 1 && !strcmp(args[1], "-d")) {
+        printf("Setting die on fail.\n");
+        CuDieOnFail();
+    }
+    RunAllTests();
+    return 0;
+}
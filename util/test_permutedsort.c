@@ -0,0 +1,225 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "permutedsort.h"
+#include "mathutil.h"
+
+void test_permuted_sort_64(CuTest* tc) {
+    unsigned int seed = 3;
+    int N = 1000;
+    int i;
+    double* d = malloc(N * sizeof(double));
+    double* sorted = malloc(N * sizeof(double));
+    int* perm32;
+    int64_t* perm64;
+
+    for (i=0; i<N; i++)
+        d[i] = uniform_sample_r(&seed, -10, 10);
+
+    perm32 = permuted_sort(d, sizeof(double), compare_doubles_asc, NULL, N);
+    perm64 = permuted_sort_64(d, sizeof(double), compare_doubles_asc, NULL, N);
+    CuAssertPtrNotNull(tc, perm64);
+    for (i=0; i<N; i++)
+        CuAssertIntEquals(tc, perm32[i], (int)perm64[i]);
+
+    permutation_apply_64(perm64, N, d, sorted, sizeof(double));
+    for (i=1; i<N; i++)
+        CuAssert(tc, "sorted", sorted[i-1] <= sorted[i]);
+
+    // in-place.
+    permutation_apply_64(perm64, N, d, d, sizeof(double));
+    for (i=0; i<N; i++)
+        CuAssertDblEquals(tc, sorted[i], d[i], 0.0);
+
+    free(perm32);
+    free(perm64);
+    free(sorted);
+    free(d);
+
+    // empty input is not an allocation failure.
+    perm64 = permuted_sort_64(NULL, sizeof(double), compare_doubles_asc,
+                              NULL, 0);
+    CuAssertPtrNotNull(tc, perm64);
+    free(perm64);
+}
+
+// Not one of the built-in comparators, so permuted_sort uses the merge
+// sort.
+static int cmp_doubles_qsort(const void* v1, const void* v2) {
+    return compare_doubles_asc(v1, v2);
+}
+
+static void check_sorted_stable(CuTest* tc, const char* data, int stride,
+                                int (*compare)(const void*, const void*),
+                                const int* perm, int N) {
+    int i;
+    for (i=1; i<N; i++) {
+        int c = compare(data + perm[i-1] * stride, data + perm[i] * stride);
+        CuAssert(tc, "sorted", c <= 0);
+        if (c == 0)
+            CuAssert(tc, "stable", perm[i-1] < perm[i]);
+    }
+}
+
+void test_permuted_sort_radix(CuTest* tc) {
+    unsigned int seed = 11;
+    // big enough to use several threads.
+    int N = 600000;
+    int i;
+    double* d = malloc(N * sizeof(double));
+    float* f = malloc(N * sizeof(float));
+    int* iv = malloc(N * sizeof(int));
+    int64_t* lv = malloc(N * sizeof(int64_t));
+    int* perm;
+    int* perm2;
+    int64_t* perm64;
+
+    for (i=0; i<N; i++) {
+        // few distinct values, so there are plenty of ties.
+        d[i] = (int)uniform_sample_r(&seed, -50, 50) * 0.25;
+        f[i] = d[i];
+        iv[i] = (int)uniform_sample_r(&seed, -1e9, 1e9);
+        lv[i] = (int64_t)iv[i] * 1000003LL;
+    }
+    d[5] = -0.0;
+
+    perm = permuted_sort(d, sizeof(double), compare_doubles_asc, NULL, N);
+    check_sorted_stable(tc, (char*)d, sizeof(double), compare_doubles_asc, perm, N);
+    // both sorts are stable, so they agree exactly.
+    perm2 = permuted_sort(d, sizeof(double), cmp_doubles_qsort, NULL, N);
+    for (i=0; i<N; i++)
+        CuAssertIntEquals(tc, perm[i], perm2[i]);
+    free(perm2);
+    free(perm);
+
+    perm = permuted_sort(d, sizeof(double), compare_doubles_desc, NULL, N);
+    check_sorted_stable(tc, (char*)d, sizeof(double), compare_doubles_desc, perm, N);
+    free(perm);
+
+    perm = permuted_sort(f, sizeof(float), compare_floats_desc, NULL, N);
+    check_sorted_stable(tc, (char*)f, sizeof(float), compare_floats_desc, perm, N);
+    free(perm);
+
+    perm = permuted_sort(iv, sizeof(int), compare_ints_asc, NULL, N);
+    check_sorted_stable(tc, (char*)iv, sizeof(int), compare_ints_asc, perm, N);
+    free(perm);
+
+    perm64 = permuted_sort_64(lv, sizeof(int64_t), compare_int64_desc, NULL, N);
+    for (i=1; i<N; i++)
+        CuAssert(tc, "sorted", lv[perm64[i-1]] >= lv[perm64[i]]);
+    free(perm64);
+
+    // strided keys, and a non-identity starting permutation.
+    perm = malloc(N/2 * sizeof(int));
+    for (i=0; i<N/2; i++)
+        perm[i] = N/2 - 1 - i;
+    permuted_sort(d, 2*sizeof(double), compare_doubles_asc, perm, N/2);
+    for (i=1; i<N/2; i++) {
+        CuAssert(tc, "sorted", d[2*perm[i-1]] <= d[2*perm[i]]);
+        if (d[2*perm[i-1]] == d[2*perm[i]])
+            CuAssert(tc, "stable", perm[i-1] > perm[i]);
+    }
+    free(perm);
+
+    free(d);
+    free(f);
+    free(iv);
+    free(lv);
+}
+
+// Small arrays and custom comparators are stable too.
+void test_permuted_sort_merge(CuTest* tc) {
+    unsigned int seed = 5;
+    double d[1000];
+    int perm[1000];
+    int64_t perm64[1000];
+    int sizes[] = { 0, 1, 2, 15, 16, 17, 100, 255, 256, 1000 };
+    int s, i;
+    for (i=0; i<1000; i++)
+        d[i] = (int)uniform_sample_r(&seed, 0, 8);
+    for (s=0; s<sizeof(sizes)/sizeof(int); s++) {
+        int N = sizes[s];
+        int* p;
+        p = permuted_sort(d, sizeof(double), cmp_doubles_qsort, NULL, N);
+        check_sorted_stable(tc, (char*)d, sizeof(double), cmp_doubles_qsort,
+                            p, N);
+        free(p);
+        p = permuted_sort(d, sizeof(double), compare_doubles_desc, NULL, N);
+        check_sorted_stable(tc, (char*)d, sizeof(double), compare_doubles_desc,
+                            p, N);
+        free(p);
+
+        // a non-identity starting permutation keeps its order for ties.
+        for (i=0; i<N; i++) {
+            perm[i] = N - 1 - i;
+            perm64[i] = N - 1 - i;
+        }
+        permuted_sort(d, sizeof(double), cmp_doubles_qsort, perm, N);
+        permuted_sort_64(d, sizeof(double), cmp_doubles_qsort, perm64, N);
+        for (i=0; i<N; i++)
+            CuAssertIntEquals(tc, perm[i], (int)perm64[i]);
+        for (i=1; i<N; i++) {
+            CuAssert(tc, "sorted", d[perm[i-1]] <= d[perm[i]]);
+            if (d[perm[i-1]] == d[perm[i]])
+                CuAssert(tc, "stable", perm[i-1] > perm[i]);
+        }
+    }
+}
+
+// (isnan() can't be trusted with -ffinite-math-only)
+static int float_is_nan(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x7fffffffU) > 0x7f800000U;
+}
+
+// NaNs go last on both the radix (N >= 256) and merge sort paths.
+void test_permuted_sort_nan(CuTest* tc) {
+    double d[300];
+    float f[300];
+    int* perm;
+    int i, k;
+    int Ns[] = { 300, 100 };
+    for (k=0; k<2; k++) {
+        int N = Ns[k];
+        // one NaN in seven
+        int nnan = (N + 6) / 7;
+        for (i=0; i<N; i++) {
+            d[i] = (i % 7 == 0) ? NAN : (double)((i * 37) % 101) - 50.0;
+            f[i] = d[i];
+        }
+        d[1] = -HUGE_VAL;
+        d[2] = HUGE_VAL;
+
+        perm = permuted_sort(d, sizeof(double), compare_doubles_asc, NULL, N);
+        CuAssertIntEquals(tc, 1, perm[0]);
+        for (i=0; i<N; i++) {
+            // NaNs at the end, in their original order.
+            if (i < N - nnan) {
+                CuAssert(tc, "not nan", !float_is_nan(d[perm[i]]));
+                if (i)
+                    CuAssert(tc, "sorted", d[perm[i-1]] <= d[perm[i]]);
+            } else
+                CuAssertIntEquals(tc, (i - (N - nnan)) * 7, perm[i]);
+        }
+        CuAssertIntEquals(tc, 2, perm[N - nnan - 1]);
+        free(perm);
+
+        perm = permuted_sort(f, sizeof(float), compare_floats_desc, NULL, N);
+        for (i=0; i<N - nnan; i++) {
+            CuAssert(tc, "not nan", !float_is_nan(f[perm[i]]));
+            if (i)
+                CuAssert(tc, "sorted", f[perm[i-1]] >= f[perm[i]]);
+        }
+        for (; i<N; i++)
+            CuAssert(tc, "nan", float_is_nan(f[perm[i]]));
+        free(perm);
+    }
+}
@@ -55,3 +55,150 @@ void test_compute_inverse(CuTest* tc) {
 }
 
 
+
+void test_distortion_array(CuTest* tc) {
+    sip_t* wcs = sip_from_string(wcsfile, 0, NULL);
+    double x[200], y[200], X[200], Y[200];
+    int i, p, q, N = 200;
+    CuAssertPtrNotNull(tc, wcs);
+    CuAssertIntEquals(tc, 0, sip_ensure_inverse_polynomials(wcs));
+
+    for (i=0; i<N; i++) {
+        x[i] = (i * 37) % 4096;
+        y[i] = (i * 91) % 2048;
+    }
+    sip_pixel_distortion_array(wcs, x, y, N, X, Y);
+    for (i=0; i<N; i++) {
+        // the terms summed directly
+        double u = x[i] - wcs->wcstan.crpix[0];
+        double v = y[i] - wcs->wcstan.crpix[1];
+        double fuv = 0, guv = 0;
+        double U, V;
+        for (p=0; p<=wcs->a_order; p++)
+            for (q=0; p+q<=wcs->a_order; q++) {
+                fuv += wcs->a[p][q] * pow(u, p) * pow(v, q);
+                guv += wcs->b[p][q] * pow(u, p) * pow(v, q);
+            }
+        CuAssertDblEquals(tc, x[i] + fuv, X[i], 1e-8);
+        CuAssertDblEquals(tc, y[i] + guv, Y[i], 1e-8);
+        sip_pixel_distortion(wcs, x[i], y[i], &U, &V);
+        CuAssertDblEquals(tc, U, X[i], 1e-10);
+        CuAssertDblEquals(tc, V, Y[i], 1e-10);
+        sip_pixel_undistortion(wcs, X[i], Y[i], &U, &V);
+        x[i] = U;
+        y[i] = V;
+    }
+    // in place
+    sip_pixel_undistortion_array(wcs, X, Y, N, X, Y);
+    for (i=0; i<N; i++) {
+        CuAssertDblEquals(tc, x[i], X[i], 1e-10);
+        CuAssertDblEquals(tc, y[i], Y[i], 1e-10);
+    }
+    sip_free(wcs);
+}
+
+// Order-5 inverse coefficients (p, q, AP_p_q, BP_p_q) of "wcsfile", from
+// the QR least-squares fit that sip_compute_inverse_polynomials() used
+// before the normal-equation fitter.
+static const double qr_inverse[][4] = {
+    { 0, 0, -0.00079112674855413791, 0.00044918170083924888 },
+    { 0, 1, 5.5925565931148968e-08, -3.4603035076925299e-08 },
+    { 0, 2, -2.164815898644619e-06, 7.2294806504514651e-06 },
+    { 0, 3, -5.107623310550415e-11, 5.3931332266786321e-10 },
+    { 0, 4, -1.7603112820105827e-14, 1.5242826611900073e-14 },
+    { 0, 5, -6.4156828578056834e-19, 1.0859277798112126e-18 },
+    { 1, 0, -1.7346279984340338e-08, 2.2827811199104647e-08 },
+    { 1, 1, 5.2023621882390979e-06, -6.1704160000906874e-06 },
+    { 1, 2, 6.5803519766104906e-10, -1.0658797886454638e-10 },
+    { 1, 3, 3.7356336662859366e-14, -3.84253568944885e-14 },
+    { 1, 4, 2.8343478732990198e-18, -1.8131124495983048e-18 },
+    { 2, 0, -8.5415280217027504e-06, 1.7464332034992651e-06 },
+    { 2, 1, -1.3001556653910516e-10, 6.4982141458465021e-10 },
+    { 2, 2, -7.0573995684902331e-14, 5.4357888808952924e-14 },
+    { 2, 3, -3.4904964498601721e-18, 4.9160375219270037e-18 },
+    { 3, 0, 6.3068895202183435e-10, -1.2512304893042809e-10 },
+    { 3, 1, 1.3733266277935433e-14, -2.532733804361854e-14 },
+    { 3, 2, 5.4294828519053559e-18, -2.9007677317419403e-18 },
+    { 4, 0, -5.1867908276649798e-14, 2.4334663895885855e-14 },
+    { 4, 1, -1.7634176528520102e-18, 2.6123366018846498e-18 },
+    { 5, 0, 3.057845765068672e-18, -1.2507862333169214e-18 }
+};
+
+void test_inverse_matches_qr(CuTest* tc) {
+    sip_t* wcs = sip_from_string(wcsfile, 0, NULL);
+    sip_inverse_fitter_t* fitter = sip_inverse_fitter_new();
+    sip_t fit;
+    int i;
+    CuAssertPtrNotNull(tc, wcs);
+    wcs->ap_order = wcs->bp_order = 5;
+    memcpy(&fit, wcs, sizeof(sip_t));
+    CuAssertIntEquals(tc, 0, sip_compute_inverse_polynomials(wcs, 0, 0,
+                                                             0, 0, 0, 0));
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, &fit, 0, 0,
+                                                    0, 0, 0, 0, 0, NULL));
+    for (i=0; i<sizeof(qr_inverse)/sizeof(qr_inverse[0]); i++) {
+        int p = (int)qr_inverse[i][0];
+        int q = (int)qr_inverse[i][1];
+        double ap = qr_inverse[i][2];
+        double bp = qr_inverse[i][3];
+        CuAssertDblEquals(tc, ap, wcs->ap[p][q], 1e-6 * fabs(ap));
+        CuAssertDblEquals(tc, bp, wcs->bp[p][q], 1e-6 * fabs(bp));
+        CuAssertDblEquals(tc, ap, fit.ap[p][q], 1e-6 * fabs(ap));
+        CuAssertDblEquals(tc, bp, fit.bp[p][q], 1e-6 * fabs(bp));
+    }
+    sip_inverse_fitter_free(fitter);
+    sip_free(wcs);
+}
+
+void test_inverse_fitter(CuTest* tc) {
+    sip_t* wcs = sip_from_string(wcsfile, 0, NULL);
+    sip_inverse_fitter_t* fitter = sip_inverse_fitter_new();
+    sip_t fixed;
+    double maxerr, ap00;
+    double x, y;
+    CuAssertPtrNotNull(tc, wcs);
+    wcs->ap_order = wcs->bp_order = 5;
+
+    // same answer as the default fixed grid.
+    memcpy(&fixed, wcs, sizeof(sip_t));
+    CuAssertIntEquals(tc, 0, sip_compute_inverse_polynomials(&fixed, 0, 0,
+                                                             0, 0, 0, 0));
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, wcs, 0, 0,
+                                                    0, 0, 0, 0, 0, &maxerr));
+    CuAssertDblEquals(tc, fixed.ap[1][0], wcs->ap[1][0], 1e-12);
+    CuAssertDblEquals(tc, fixed.bp[0][2], wcs->bp[0][2], 1e-15);
+
+    // adaptive: order 5 can't get to 1e-3 pixels, order 6 can.
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, wcs, 0, 0,
+                                                    0, 0, 0, 0, 1e-3,
+                                                    &maxerr));
+    CuAssert(tc, "order 5", maxerr > 1e-3 && maxerr < 1e-2);
+    wcs->ap_order = wcs->bp_order = 6;
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, wcs, 0, 0,
+                                                    0, 0, 0, 0, 1e-3,
+                                                    &maxerr));
+    CuAssert(tc, "tolerance", maxerr >= 0 && maxerr <= 1e-3);
+    for (y=0; y<=sip_imageh(wcs); y+=97) {
+        for (x=0; x<=sip_imagew(wcs); x+=89) {
+            double X, Y, x2, y2;
+            sip_pixel_distortion(wcs, x, y, &X, &Y);
+            sip_pixel_undistortion(wcs, X, Y, &x2, &y2);
+            CuAssertDblEquals(tc, x, x2, 5e-3);
+            CuAssertDblEquals(tc, y, y2, 5e-3);
+        }
+    }
+
+    // unchanged: the same answer; changed: a new one.
+    ap00 = wcs->ap[0][0];
+    wcs->ap[0][0] = 0;
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, wcs, 0, 0,
+                                                    0, 0, 0, 0, 1e-3, NULL));
+    CuAssertDblEquals(tc, ap00, wcs->ap[0][0], 0);
+    wcs->a[0][0] = 0.5;
+    CuAssertIntEquals(tc, 0, sip_inverse_fitter_fit(fitter, wcs, 0, 0,
+                                                    0, 0, 0, 0, 1e-3, NULL));
+    CuAssertDblEquals(tc, -0.5, wcs->ap[0][0], 1e-3);
+
+    sip_inverse_fitter_free(fitter);
+    sip_free(wcs);
+}
@@ -0,0 +1,95 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tabsort.h"
+#include "fitstable.h"
+#include "fitsioutils.h"
+#include "ioutils.h"
+
+#include "cutest.h"
+
+static char* get_tmpfile(int i) {
+    static char fn[256];
+    sprintf(fn, "/tmp/test-tabsort-%i", i);
+    return fn;
+}
+
+static void write_table(CuTest* ct, const char* fn, int N) {
+    fitstable_t* t;
+    int i;
+    t = fitstable_open_for_writing(fn);
+    CuAssertPtrNotNull(ct, t);
+    fitstable_add_write_column(t, fitscolumn_i64_type(), "KEY", "");
+    fitstable_add_write_column(t, fitscolumn_i32_type(), "ROW", "");
+    CuAssertIntEquals(ct, 0, fitstable_write_primary_header(t));
+    CuAssertIntEquals(ct, 0, fitstable_write_header(t));
+    for (i=0; i<N; i++) {
+        // lots of ties, so the sort must be stable to be repeatable.
+        int64_t key = (int64_t)((i * 7919) % 97) - 40;
+        int32_t row = i;
+        CuAssertIntEquals(ct, 0, fitstable_write_row(t, &key, &row));
+    }
+    CuAssertIntEquals(ct, 0, fitstable_fix_header(t));
+    CuAssertIntEquals(ct, 0, fitstable_close(t));
+}
+
+void test_tabsort_external(CuTest* ct) {
+    int N = 5000;
+    char* infn = strdup(get_tmpfile(0));
+    char* fn1 = strdup(get_tmpfile(1));
+    char* fn2 = strdup(get_tmpfile(2));
+    char* fn3 = strdup(get_tmpfile(3));
+    char *data1, *data2;
+    size_t len1, len2;
+    fitstable_t* t;
+    int64_t* key;
+    int32_t* row;
+    int i;
+
+    write_table(ct, infn, N);
+    CuAssertIntEquals(ct, 0, tabsort2(infn, fn1, "KEY", 1, 0, NULL));
+    // 1 kB budget: over a hundred runs of 36 rows (merge-sorted).
+    CuAssertIntEquals(ct, 0, tabsort2(infn, fn2, "KEY", 1, 1024, NULL));
+    // 16 kB: runs of 585 rows (radix-sorted).
+    CuAssertIntEquals(ct, 0, tabsort2(infn, fn3, "KEY", 1, 16384, NULL));
+
+    data1 = file_get_contents(fn1, &len1, FALSE);
+    CuAssertPtrNotNull(ct, data1);
+    data2 = file_get_contents(fn2, &len2, FALSE);
+    CuAssertPtrNotNull(ct, data2);
+    CuAssertIntEquals(ct, (int)len1, (int)len2);
+    CuAssert(ct, "same output", memcmp(data1, data2, len1) == 0);
+    free(data2);
+    data2 = file_get_contents(fn3, &len2, FALSE);
+    CuAssertPtrNotNull(ct, data2);
+    CuAssertIntEquals(ct, (int)len1, (int)len2);
+    CuAssert(ct, "same output", memcmp(data1, data2, len1) == 0);
+    free(data1);
+    free(data2);
+
+    t = fitstable_open(fn2);
+    CuAssertPtrNotNull(ct, t);
+    CuAssertIntEquals(ct, N, fitstable_nrows(t));
+    key = fitstable_read_column(t, "KEY", fitscolumn_i64_type());
+    row = fitstable_read_column(t, "ROW", fitscolumn_i32_type());
+    CuAssertPtrNotNull(ct, key);
+    CuAssertPtrNotNull(ct, row);
+    for (i=1; i<N; i++) {
+        CuAssert(ct, "descending", key[i-1] >= key[i]);
+        if (key[i-1] == key[i])
+            CuAssert(ct, "stable", row[i-1] < row[i]);
+    }
+    free(key);
+    free(row);
+    fitstable_close(t);
+    free(infn);
+    free(fn1);
+    free(fn2);
+    free(fn3);
+}
@@ -0,0 +1,157 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cutest.h"
+#include "wcs-resample.h"
+#include "anwcs.h"
+#include "sip.h"
+#include "starutil.h"
+
+static void make_sip(sip_t* sip, double ra, double dec, double scale,
+                     double theta, int W, int H) {
+    double c = cos(deg2rad(theta)), s = sin(deg2rad(theta));
+    memset(sip, 0, sizeof(sip_t));
+    sip->wcstan.crval[0] = ra;
+    sip->wcstan.crval[1] = dec;
+    sip->wcstan.crpix[0] = W/2.0 + 0.3;
+    sip->wcstan.crpix[1] = H/2.0 - 0.2;
+    sip->wcstan.cd[0][0] = -scale * c;
+    sip->wcstan.cd[0][1] =  scale * s;
+    sip->wcstan.cd[1][0] =  scale * s;
+    sip->wcstan.cd[1][1] =  scale * c;
+    sip->wcstan.imagew = W;
+    sip->wcstan.imageh = H;
+}
+
+static anwcs_t* make_wcs(double ra, double dec, double scale, double theta,
+                         int W, int H, double distort) {
+    sip_t sip;
+    make_sip(&sip, ra, dec, scale, theta, W, H);
+    // (only used for pixel -> sky, so no inverse terms)
+    if (distort != 0) {
+        sip.a_order = sip.b_order = 2;
+        sip.a[2][0] = distort;
+        sip.b[0][2] = -distort;
+    }
+    return anwcs_new_sip(&sip);
+}
+
+// Exact nearest-neighbour resampling, one pixel at a time.
+static void brute_rgba(const anwcs_t* inwcs, const unsigned char* in,
+                       int inW, int inH, const anwcs_t* outwcs,
+                       unsigned char* out, int W, int H) {
+    int i, j;
+    for (j=0; j<H; j++)
+        for (i=0; i<W; i++) {
+            double xyz[3], x, y;
+            int ix, iy;
+            if (anwcs_pixelxy2xyz(outwcs, i+1, j+1, xyz) ||
+                anwcs_xyz2pixelxy(inwcs, xyz, &x, &y))
+                continue;
+            ix = round(x - 1.0);
+            iy = round(y - 1.0);
+            if (ix < 0 || ix >= inW || iy < 0 || iy >= inH)
+                continue;
+            memcpy(out + 4*(j*W + i), in + 4*(iy*inW + ix), 4);
+        }
+}
+
+void test_resample_grid_rgba(CuTest* tc) {
+    int inW = 300, inH = 200;
+    int W = 257, H = 301;
+    unsigned char* in = malloc(inW * inH * 4);
+    unsigned char* out = calloc(W * H * 4, 1);
+    unsigned char* brute = calloc(W * H * 4, 1);
+    float* fin = malloc(inW * inH * sizeof(float));
+    float* fout = calloc(W * H, sizeof(float));
+    anwcs_t* inwcs = make_wcs(150.0, 30.0, 1e-3, 20.0, inW, inH, 0.0);
+    anwcs_t* outwcs = make_wcs(150.05, 30.02, 0.8e-3, 0.0, W, H, 1e-5);
+    resample_grid_t* grid;
+    int i, nthreads;
+
+    for (i=0; i<inW*inH*4; i++)
+        in[i] = (i * 7919) % 251;
+    for (i=0; i<inW*inH; i++)
+        fin[i] = i;
+    brute_rgba(inwcs, in, inW, inH, outwcs, brute, W, H);
+
+    grid = resample_grid_new(outwcs, W, H, 16);
+    CuAssertPtrNotNull(tc, grid);
+    for (nthreads=1; nthreads<=4; nthreads+=3) {
+        memset(out, 0, W * H * 4);
+        CuAssertIntEquals(tc, 0, resample_wcs_rgba_grid(grid, inwcs, in,
+                                                        inW, inH, out,
+                                                        nthreads));
+        CuAssert(tc, "rgba", memcmp(out, brute, W * H * 4) == 0);
+    }
+
+    // the float version picks the same pixels.
+    for (i=0; i<W*H; i++)
+        fout[i] = -1;
+    CuAssertIntEquals(tc, 0, resample_wcs_grid(grid, inwcs, fin, inW, inH,
+                                               fout, 2));
+    for (i=0; i<W*H; i++) {
+        if (fout[i] == -1)
+            continue;
+        CuAssertIntEquals(tc, 0, memcmp(out + 4*i, in + 4*(int)fout[i], 4));
+    }
+
+    CuAssert(tc, "matches", resample_grid_matches(grid, outwcs, W, H));
+    CuAssert(tc, "size", !resample_grid_matches(grid, outwcs, W+1, H));
+    anwcs_scale_wcs(outwcs, 0.5);
+    CuAssert(tc, "changed", !resample_grid_matches(grid, outwcs, W, H));
+
+    resample_grid_free(grid);
+    anwcs_free(inwcs);
+    anwcs_free(outwcs);
+    free(in);
+    free(out);
+    free(brute);
+    free(fin);
+    free(fout);
+}
+
+// A saddle-shaped distortion is interpolated exactly at the center of
+// each grid cell but not along its edges.
+void test_resample_grid_saddle(CuTest* tc) {
+    int inW = 300, inH = 200;
+    int W = 257, H = 301;
+    unsigned char* in = malloc(inW * inH * 4);
+    unsigned char* out = calloc(W * H * 4, 1);
+    unsigned char* brute = calloc(W * H * 4, 1);
+    anwcs_t* inwcs = make_wcs(150.0, 30.0, 1e-3, 20.0, inW, inH, 0.0);
+    anwcs_t* outwcs;
+    resample_grid_t* grid;
+    sip_t sip;
+    int i;
+
+    make_sip(&sip, 150.05, 30.02, 0.8e-3, 0.0, W, H);
+    sip.a_order = sip.b_order = 2;
+    sip.a[2][0] =  1e-3;
+    sip.a[0][2] = -1e-3;
+    sip.b[2][0] = -1e-3;
+    sip.b[0][2] =  1e-3;
+    outwcs = anwcs_new_sip(&sip);
+
+    for (i=0; i<inW*inH*4; i++)
+        in[i] = (i * 7919) % 251;
+    brute_rgba(inwcs, in, inW, inH, outwcs, brute, W, H);
+
+    grid = resample_grid_new(outwcs, W, H, 16);
+    CuAssertPtrNotNull(tc, grid);
+    CuAssertIntEquals(tc, 0, resample_wcs_rgba_grid(grid, inwcs, in,
+                                                    inW, inH, out, 2));
+    CuAssert(tc, "rgba", memcmp(out, brute, W * H * 4) == 0);
+
+    resample_grid_free(grid);
+    anwcs_free(inwcs);
+    anwcs_free(outwcs);
+    free(in);
+    free(out);
+    free(brute);
+}
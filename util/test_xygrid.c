@@ -0,0 +1,113 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "cutest.h"
+#include "xygrid.h"
+#include "bl.h"
+#include "mathutil.h"
+
+static double* random_points(int N, double W, double H, unsigned int* seed) {
+    int i;
+    double* xy = malloc(2 * N * sizeof(double));
+    for (i=0; i<N; i++) {
+        xy[2*i+0] = uniform_sample_r(seed, 0, W);
+        xy[2*i+1] = uniform_sample_r(seed, 0, H);
+    }
+    return xy;
+}
+
+static int brute_nearest(const double* xy, const int* inds, int N,
+                         const double* pt, double maxd2) {
+    int i, best = -1;
+    double bestd2 = maxd2;
+    for (i=0; i<N; i++) {
+        int j = (inds ? inds[i] : i);
+        double d2 = distsq(xy + 2*j, pt, 2);
+        if (d2 <= bestd2 && (best == -1 || d2 < bestd2)) {
+            best = j;
+            bestd2 = d2;
+        }
+    }
+    return best;
+}
+
+void test_xygrid_nearest(CuTest* tc) {
+    unsigned int seed = 42;
+    int N = 500;
+    double* xy = random_points(N, 1000, 600, &seed);
+    double cellsizes[] = { 0, 5, 50, 2000 };
+    int c, i;
+
+    for (c=0; c<sizeof(cellsizes)/sizeof(double); c++) {
+        xygrid_t* g = xygrid_new(xy, NULL, N, cellsizes[c]);
+        CuAssertPtrNotNull(tc, g);
+        for (i=0; i<1000; i++) {
+            double pt[2], d2;
+            double r = uniform_sample_r(&seed, 0, 100);
+            int got, expect;
+            // queries also land outside the points' bounding box.
+            pt[0] = uniform_sample_r(&seed, -100, 1100);
+            pt[1] = uniform_sample_r(&seed, -100, 700);
+            expect = brute_nearest(xy, NULL, N, pt, r*r);
+            got = xygrid_nearest_within(g, pt, r*r, &d2);
+            CuAssertIntEquals(tc, expect, got);
+            if (got != -1)
+                CuAssertDblEquals(tc, distsq(xy + 2*got, pt, 2), d2, 1e-9);
+        }
+        xygrid_free(g);
+    }
+    free(xy);
+}
+
+void test_xygrid_range_subset(CuTest* tc) {
+    unsigned int seed = 7;
+    int N = 300;
+    double* xy = random_points(N, 200, 2000, &seed);
+    int* inds = malloc(N * sizeof(int));
+    int* found = malloc(N * sizeof(int));
+    il* res = il_new(16);
+    xygrid_t* g;
+    int i, j, n, NI;
+
+    // every third point.
+    NI = 0;
+    for (i=0; i<N; i+=3)
+        inds[NI++] = i;
+    g = xygrid_new(xy, inds, NI, 10.0);
+    CuAssertPtrNotNull(tc, g);
+
+    for (i=0; i<N; i++) {
+        double r2 = 40.0 * 40.0;
+        il_remove_all(res);
+        n = xygrid_range(g, xy + 2*i, r2, res);
+        CuAssertIntEquals(tc, n, il_size(res));
+        for (j=0; j<N; j++)
+            found[j] = 0;
+        for (j=0; j<n; j++)
+            found[il_get(res, j)]++;
+        for (j=0; j<N; j++) {
+            int expect = ((j % 3) == 0) && (distsq(xy + 2*j, xy + 2*i, 2) <= r2);
+            CuAssertIntEquals(tc, expect, found[j]);
+        }
+        // nearest also only sees the subset.
+        CuAssertIntEquals(tc, brute_nearest(xy, inds, NI, xy + 2*i, r2),
+                          xygrid_nearest_within(g, xy + 2*i, r2, NULL));
+    }
+    xygrid_free(g);
+
+    // empty grid.
+    g = xygrid_new(xy, NULL, 0, 1.0);
+    CuAssertPtrNotNull(tc, g);
+    CuAssertIntEquals(tc, -1, xygrid_nearest_within(g, xy, 1e6, NULL));
+    CuAssertIntEquals(tc, 0, xygrid_range(g, xy, 1e6, res));
+    xygrid_free(g);
+
+    il_free(res);
+    free(found);
+    free(inds);
+    free(xy);
+}
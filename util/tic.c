@@ -10,14 +10,24 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "tic.h"
 #include "errors.h"
 #include "log.h"
 
-static time_t starttime;
-static double starttime2;
-static double startutime, startstime;
+// tic() / toc() state, per thread.
+struct ticstate {
+    double starttime;
+    double startutime, startstime;
+};
+
+static void* tic_init_key(void* user) {
+    return calloc(1, sizeof(struct ticstate));
+}
+#define TSNAME tic
+#define TSFREE free
+#include "thread-specific.inc"
 
 double timenow() {
     struct timeval tv;
@@ -35,9 +45,9 @@ double millis_between(struct timeval* tv1, struct timeval* tv2) {
 }
 
 void tic() {
-    starttime = time(NULL);
-    starttime2 = timenow();
-    if (get_resource_stats(&startutime, &startstime, NULL)) {
+    struct ticstate* ts = tic_get_key(NULL);
+    ts->starttime = timenow();
+    if (get_resource_stats(&ts->startutime, &ts->startstime, NULL)) {
         ERROR("Failed to get_resource_stats()");
         return;
     }
@@ -62,17 +72,16 @@ int get_resource_stats(double* p_usertime, double* p_systime, long* p_maxrss) {
 }
 
 void toc() {
+    struct ticstate* ts = tic_get_key(NULL);
     double utime, stime;
     long rss;
-    //int dtime;
     double dtime2;
-    //time_t endtime = time(NULL);
-    //dtime = (int)(endtime - starttime);
-    dtime2 = timenow() - starttime2;
+    dtime2 = timenow() - ts->starttime;
     if (get_resource_stats(&utime, &stime, &rss)) {
         ERROR("Failed to get_resource_stats()");
         return;
     }
     logmsg("Used %g s user, %g s system (%g s total), %g s wall time since last check\n",
-           utime-startutime, stime-startstime, (utime + stime)-(startutime+startstime), dtime2);
+           utime-ts->startutime, stime-ts->startstime,
+           (utime + stime)-(ts->startutime+ts->startstime), dtime2);
 }
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "os-features.h"
 #include "wcs-resample.h"
@@ -360,3 +361,294 @@ int resample_wcs_rgba(const anwcs_t* inwcs, const unsigned char* inimg,
 
 }
 
+
+resample_grid_t* resample_grid_new(const anwcs_t* outwcs, int W, int H,
+                                   int B) {
+    resample_grid_t* grid;
+    int i, j;
+    if (B < 1) {
+        ERROR("Resampling grid step must be positive; got %i", B);
+        return NULL;
+    }
+    grid = calloc(1, sizeof(resample_grid_t));
+    grid->wcs = outwcs;
+    grid->W = W;
+    grid->H = H;
+    grid->B = B;
+    // nodes every B pixels; the cells cover the whole image.
+    grid->NX = 1 + (MAX(W, 1) + B - 1) / B;
+    grid->NY = 1 + (MAX(H, 1) + B - 1) / B;
+    grid->xyz = malloc(grid->NX * grid->NY * 3 * sizeof(double));
+    grid->ok = malloc(grid->NX * grid->NY * sizeof(anbool));
+    for (j=0; j<grid->NY; j++)
+        for (i=0; i<grid->NX; i++) {
+            int k = j * grid->NX + i;
+            // +1 for FITS pixel coordinates.
+            grid->ok[k] = !anwcs_pixelxy2xyz(outwcs, i*B + 1, j*B + 1,
+                                             grid->xyz + 3*k);
+        }
+    return grid;
+}
+
+anbool resample_grid_matches(const resample_grid_t* grid,
+                             const anwcs_t* outwcs, int W, int H) {
+    int k, n;
+    int nodes[3];
+    if (grid->wcs != outwcs || grid->W != W || grid->H != H)
+        return FALSE;
+    // the WCS may have been changed in place: spot-check a few nodes.
+    n = grid->NX * grid->NY;
+    nodes[0] = 0;
+    nodes[1] = grid->NX - 1;
+    nodes[2] = n - 1;
+    for (k=0; k<3; k++) {
+        double xyz[3];
+        int i = nodes[k] % grid->NX;
+        int j = nodes[k] / grid->NX;
+        anbool ok = !anwcs_pixelxy2xyz(outwcs, i * grid->B + 1,
+                                       j * grid->B + 1, xyz);
+        if (ok != grid->ok[nodes[k]])
+            return FALSE;
+        if (ok && memcmp(xyz, grid->xyz + 3*nodes[k], sizeof(xyz)))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void resample_grid_free(resample_grid_t* grid) {
+    if (!grid)
+        return;
+    free(grid->xyz);
+    free(grid->ok);
+    free(grid);
+}
+
+// Interpolated input pixel positions are trusted if they're within this
+// many pixels of the exact positions at the center of the block and the
+// middles of its edges, and aren't within this distance of a pixel edge.
+#define GRID_TOLERANCE 0.01
+
+struct grid_job {
+    const resample_grid_t* grid;
+    const anwcs_t* inwcs;
+    int inW, inH;
+    // input (0-based) pixel positions of the grid nodes
+    double* inxy;
+    anbool* inok;
+    // one of these pairs is set
+    const unsigned char* rgba_in;
+    unsigned char* rgba_out;
+    const float* f_in;
+    float* f_out;
+
+    int nextrow;
+    pthread_mutex_t lock;
+};
+
+static anbool grid_exact(const struct grid_job* job, int i, int j,
+                         double* inx, double* iny) {
+    double xyz[3];
+    // +-1 for FITS pixel coordinates.
+    if (anwcs_pixelxy2xyz(job->grid->wcs, i+1, j+1, xyz) ||
+        anwcs_xyz2pixelxy(job->inwcs, xyz, inx, iny))
+        return FALSE;
+    *inx -= 1.0;
+    *iny -= 1.0;
+    return TRUE;
+}
+
+static anbool near_pixel_edge(double x) {
+    return (fabs(x - floor(x) - 0.5) < GRID_TOLERANCE);
+}
+
+static void grid_copy_pixel(const struct grid_job* job, int i, int j,
+                            double inx, double iny) {
+    int x, y;
+    x = round(inx);
+    y = round(iny);
+    if (x < 0 || x >= job->inW || y < 0 || y >= job->inH)
+        return;
+    if (job->rgba_out)
+        memcpy(job->rgba_out + 4 * (j * job->grid->W + i),
+               job->rgba_in + 4 * (y * job->inW + x), 4);
+    else
+        job->f_out[j * job->grid->W + i] = job->f_in[y * job->inW + x];
+}
+
+static void grid_resample_block(const struct grid_job* job, int bi, int bj) {
+    const resample_grid_t* grid = job->grid;
+    int B = grid->B;
+    int ilo, ihi, jlo, jhi, i, j, k;
+    int corners[4];
+    int nok = 0;
+    anbool interp;
+    double* xy[4];
+
+    ilo = bi * B;
+    jlo = bj * B;
+    ihi = MIN(grid->W, ilo + B);
+    jhi = MIN(grid->H, jlo + B);
+    corners[0] = bj * grid->NX + bi;
+    corners[1] = corners[0] + 1;
+    corners[2] = corners[0] + grid->NX;
+    corners[3] = corners[2] + 1;
+    for (k=0; k<4; k++) {
+        if (job->inok[corners[k]])
+            nok++;
+        xy[k] = job->inxy + 2 * corners[k];
+    }
+    // None of the block maps onto the input image.
+    if (nok == 0)
+        return;
+    interp = (nok == 4);
+    if (interp) {
+        double xlo, xhi, ylo, yhi;
+        // Check the interpolation at the center of the block and the
+        // middles of its edges: the error along an edge is largest
+        // midway, and a saddle-shaped distortion can cancel out at the
+        // center.
+        int checks[5][2];
+        checks[0][0] = (ilo + ihi - 1) / 2;
+        checks[0][1] = (jlo + jhi - 1) / 2;
+        checks[1][0] = checks[0][0];
+        checks[1][1] = jlo;
+        checks[2][0] = checks[0][0];
+        checks[2][1] = jhi - 1;
+        checks[3][0] = ilo;
+        checks[3][1] = checks[0][1];
+        checks[4][0] = ihi - 1;
+        checks[4][1] = checks[0][1];
+        for (k=0; interp && k<5; k++) {
+            double ex, ey, ix, iy;
+            double fx = (double)(checks[k][0] - ilo) / B;
+            double fy = (double)(checks[k][1] - jlo) / B;
+            ix = (1-fy) * ((1-fx) * xy[0][0] + fx * xy[1][0]) +
+                fy * ((1-fx) * xy[2][0] + fx * xy[3][0]);
+            iy = (1-fy) * ((1-fx) * xy[0][1] + fx * xy[1][1]) +
+                fy * ((1-fx) * xy[2][1] + fx * xy[3][1]);
+            if (!grid_exact(job, checks[k][0], checks[k][1], &ex, &ey) ||
+                hypot(ix - ex, iy - ey) > GRID_TOLERANCE)
+                interp = FALSE;
+        }
+        xlo = ylo = HUGE_VAL;
+        xhi = yhi = -HUGE_VAL;
+        for (k=0; k<4; k++) {
+            xlo = MIN(xlo, xy[k][0]);
+            xhi = MAX(xhi, xy[k][0]);
+            ylo = MIN(ylo, xy[k][1]);
+            yhi = MAX(yhi, xy[k][1]);
+        }
+        // The whole block is off the input image.
+        if (interp &&
+            (xhi < -0.5 - GRID_TOLERANCE ||
+             xlo > job->inW - 0.5 + GRID_TOLERANCE ||
+             yhi < -0.5 - GRID_TOLERANCE ||
+             ylo > job->inH - 0.5 + GRID_TOLERANCE))
+            return;
+    }
+    for (j=jlo; j<jhi; j++) {
+        double fy = (double)(j - jlo) / B;
+        double x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        if (interp) {
+            x0 = (1-fy) * xy[0][0] + fy * xy[2][0];
+            y0 = (1-fy) * xy[0][1] + fy * xy[2][1];
+            x1 = (1-fy) * xy[1][0] + fy * xy[3][0];
+            y1 = (1-fy) * xy[1][1] + fy * xy[3][1];
+        }
+        for (i=ilo; i<ihi; i++) {
+            double inx, iny;
+            if (interp) {
+                double fx = (double)(i - ilo) / B;
+                inx = (1-fx) * x0 + fx * x1;
+                iny = (1-fx) * y0 + fx * y1;
+                if ((near_pixel_edge(inx) || near_pixel_edge(iny)) &&
+                    !grid_exact(job, i, j, &inx, &iny))
+                    continue;
+            } else if (!grid_exact(job, i, j, &inx, &iny))
+                continue;
+            grid_copy_pixel(job, i, j, inx, iny);
+        }
+    }
+}
+
+static void* grid_resample_thread(void* v) {
+    struct grid_job* job = v;
+    int bi, bj;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        bj = job->nextrow++;
+        pthread_mutex_unlock(&job->lock);
+        if (bj >= job->grid->NY - 1)
+            break;
+        for (bi=0; bi<job->grid->NX - 1; bi++)
+            grid_resample_block(job, bi, bj);
+    }
+    return NULL;
+}
+
+static int grid_resample(struct grid_job* job, int nthreads) {
+    const resample_grid_t* grid = job->grid;
+    pthread_t* threads;
+    int i, N, nstarted = 0;
+
+    N = grid->NX * grid->NY;
+    job->inxy = malloc(N * 2 * sizeof(double));
+    job->inok = malloc(N * sizeof(anbool));
+    for (i=0; i<N; i++) {
+        job->inok[i] = (grid->ok[i] &&
+                        !anwcs_xyz2pixelxy(job->inwcs, grid->xyz + 3*i,
+                                           job->inxy + 2*i,
+                                           job->inxy + 2*i + 1));
+        // -1 for FITS pixel coordinates.
+        job->inxy[2*i + 0] -= 1.0;
+        job->inxy[2*i + 1] -= 1.0;
+    }
+    pthread_mutex_init(&job->lock, NULL);
+    nthreads = MAX(1, MIN(nthreads, grid->NY - 1));
+    threads = malloc(nthreads * sizeof(pthread_t));
+    for (i=1; i<nthreads; i++) {
+        if (pthread_create(threads + nstarted, NULL, grid_resample_thread,
+                           job)) {
+            SYSERROR("Failed to start resampling thread");
+            break;
+        }
+        nstarted++;
+    }
+    grid_resample_thread(job);
+    for (i=0; i<nstarted; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&job->lock);
+    free(job->inxy);
+    free(job->inok);
+    return 0;
+}
+
+int resample_wcs_rgba_grid(const resample_grid_t* grid,
+                           const anwcs_t* inwcs, const unsigned char* inimg,
+                           int inW, int inH, unsigned char* outimg,
+                           int nthreads) {
+    struct grid_job job;
+    memset(&job, 0, sizeof(job));
+    job.grid = grid;
+    job.inwcs = inwcs;
+    job.inW = inW;
+    job.inH = inH;
+    job.rgba_in = inimg;
+    job.rgba_out = outimg;
+    return grid_resample(&job, nthreads);
+}
+
+int resample_wcs_grid(const resample_grid_t* grid,
+                      const anwcs_t* inwcs, const float* inimg,
+                      int inW, int inH, float* outimg, int nthreads) {
+    struct grid_job job;
+    memset(&job, 0, sizeof(job));
+    job.grid = grid;
+    job.inwcs = inwcs;
+    job.inW = inW;
+    job.inH = inH;
+    job.f_in = inimg;
+    job.f_out = outimg;
+    return grid_resample(&job, nthreads);
+}
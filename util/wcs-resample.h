@@ -7,6 +7,7 @@
 #define WCS_RESAMPLE_H
 
 #include "anwcs.h"
+#include "an-bool.h"
 
 int resample_wcs_files(const char* infitsfn, int infitsext,
 					   const char* inwcsfn, int inwcsext,
@@ -23,5 +24,52 @@ int resample_wcs_rgba(const anwcs_t* inwcs, const unsigned char* inimg,
 					  const anwcs_t* outwcs, unsigned char* outimg,
 					  int outW, int outH);
 
+/**
+ The unit-sphere positions of a grid of points, every "B" pixels, of an
+ output image: computed once and shared by all the images resampled
+ onto that output image.
+ */
+struct resample_grid {
+    // not owned
+    const anwcs_t* wcs;
+    int W, H;
+    int B;
+    // grid nodes (i*B, j*B), for i < NX, j < NY
+    int NX, NY;
+    double* xyz;
+    anbool* ok;
+};
+typedef struct resample_grid resample_grid_t;
+
+resample_grid_t* resample_grid_new(const anwcs_t* outwcs, int W, int H,
+                                   int B);
+
+/**
+ Is "grid" (still) the grid of "outwcs" at size W x H?
+ */
+anbool resample_grid_matches(const resample_grid_t* grid,
+                             const anwcs_t* outwcs, int W, int H);
+
+void resample_grid_free(resample_grid_t* grid);
+
+/**
+ Nearest-neighbour resampling onto "grid"'s output image (of size
+ grid->W x grid->H), in "nthreads" threads.  Input pixel positions are
+ interpolated across each grid cell where they agree with the exact
+ positions (to 0.01 pixel) at the cell's center and the middles of its
+ edges, and computed exactly elsewhere.  For distortions that are
+ smooth on the scale of a cell, the results are the same as
+ resample_wcs_rgba()'s (and resample_wcs()'s with lanczos_order 0).
+ Pixels that don't land on the input image are left untouched.
+ */
+int resample_wcs_rgba_grid(const resample_grid_t* grid,
+                           const anwcs_t* inwcs, const unsigned char* inimg,
+                           int inW, int inH, unsigned char* outimg,
+                           int nthreads);
+
+int resample_wcs_grid(const resample_grid_t* grid,
+                      const anwcs_t* inwcs, const float* inimg,
+                      int inW, int inH, float* outimg, int nthreads);
+
 #endif
 
@@ -0,0 +1,164 @@
+/*
+ # This file is part of the Astrometry.net suite.
+ # Licensed under a 3-clause BSD style license - see LICENSE
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "os-features.h"
+#include "xygrid.h"
+#include "mathutil.h"
+#include "errors.h"
+
+static int cell_index(double v, double v0, double cell, int n) {
+    int i = (int)floor((v - v0) / cell);
+    return MAX(0, MIN(n-1, i));
+}
+
+static int point_index(const int* inds, int i) {
+    return (inds ? inds[i] : i);
+}
+
+xygrid_t* xygrid_new(const double* xy, const int* inds, int N,
+                     double cellsize) {
+    xygrid_t* g;
+    double xlo = 0, xhi = 0, ylo = 0, yhi = 0;
+    double area;
+    int i, c, nc;
+    int* cellid = NULL;
+
+    g = calloc(1, sizeof(xygrid_t));
+    if (!g) {
+        SYSERROR("Failed to allocate xygrid");
+        return NULL;
+    }
+    g->xy = xy;
+    g->N = N;
+
+    for (i=0; i<N; i++) {
+        const double* p = xy + 2 * point_index(inds, i);
+        if (i == 0 || p[0] < xlo) xlo = p[0];
+        if (i == 0 || p[0] > xhi) xhi = p[0];
+        if (i == 0 || p[1] < ylo) ylo = p[1];
+        if (i == 0 || p[1] > yhi) yhi = p[1];
+    }
+    g->x0 = xlo;
+    g->y0 = ylo;
+
+    // At least "cellsize", and about one point per cell (but not so
+    // small that a thin strip of points gets N^2 cells).
+    area = (xhi - xlo) * (yhi - ylo);
+    g->cell = cellsize;
+    if (N) {
+        g->cell = MAX(g->cell, sqrt(area / N));
+        g->cell = MAX(g->cell, MAX(xhi - xlo, yhi - ylo) / N);
+    }
+    if (!(g->cell > 0))
+        g->cell = 1.0;
+    g->nx = MAX(1, (int)ceil((xhi - xlo) / g->cell));
+    g->ny = MAX(1, (int)ceil((yhi - ylo) / g->cell));
+    nc = g->nx * g->ny;
+
+    g->cellstart = calloc(nc + 1, sizeof(int));
+    g->inds = malloc(MAX(N, 1) * sizeof(int));
+    cellid = malloc(MAX(N, 1) * sizeof(int));
+    if (!g->cellstart || !g->inds || !cellid) {
+        SYSERROR("Failed to allocate xygrid with %i cells, %i points", nc, N);
+        free(cellid);
+        xygrid_free(g);
+        return NULL;
+    }
+
+    // Counting sort: count, take the running sum (so cellstart[c] is the
+    // end of cell c), then fill backward, leaving cellstart[c] at the
+    // start of cell c.
+    for (i=0; i<N; i++) {
+        const double* p = xy + 2 * point_index(inds, i);
+        c = cell_index(p[1], g->y0, g->cell, g->ny) * g->nx +
+            cell_index(p[0], g->x0, g->cell, g->nx);
+        cellid[i] = c;
+        g->cellstart[c]++;
+    }
+    for (c=1; c<nc; c++)
+        g->cellstart[c] += g->cellstart[c-1];
+    g->cellstart[nc] = N;
+    for (i=N-1; i>=0; i--)
+        g->inds[--g->cellstart[cellid[i]]] = point_index(inds, i);
+
+    free(cellid);
+    return g;
+}
+
+void xygrid_free(xygrid_t* g) {
+    if (!g)
+        return;
+    free(g->cellstart);
+    free(g->inds);
+    free(g);
+}
+
+// Cells overlapping the box of half-width "r" around "pt".  Points
+// outside the grid were put in the edge cells, and queries clamp the
+// same way, so nothing is missed.
+static void cell_range(const xygrid_t* g, const double* pt, double r,
+                       int* ix0, int* ix1, int* iy0, int* iy1) {
+    *ix0 = cell_index(pt[0] - r, g->x0, g->cell, g->nx);
+    *ix1 = cell_index(pt[0] + r, g->x0, g->cell, g->nx);
+    *iy0 = cell_index(pt[1] - r, g->y0, g->cell, g->ny);
+    *iy1 = cell_index(pt[1] + r, g->y0, g->cell, g->ny);
+}
+
+int xygrid_nearest_within(const xygrid_t* g, const double* pt,
+                          double maxd2, double* p_d2) {
+    int iy, ix0, ix1, iy0, iy1, k;
+    int best = -1;
+    double bestd2 = maxd2;
+
+    if (!g->N || maxd2 < 0)
+        return -1;
+    cell_range(g, pt, sqrt(maxd2), &ix0, &ix1, &iy0, &iy1);
+    for (iy=iy0; iy<=iy1; iy++) {
+        const int* cs = g->cellstart + iy * g->nx;
+        for (k=cs[ix0]; k<cs[ix1+1]; k++) {
+            int j = g->inds[k];
+            const double* p = g->xy + 2*j;
+            double dx = p[0] - pt[0];
+            double dy = p[1] - pt[1];
+            double d2 = dx*dx + dy*dy;
+            if (d2 > bestd2)
+                continue;
+            if (best == -1 || d2 < bestd2) {
+                best = j;
+                bestd2 = d2;
+            }
+        }
+    }
+    if (best != -1 && p_d2)
+        *p_d2 = bestd2;
+    return best;
+}
+
+int xygrid_range(const xygrid_t* g, const double* pt, double maxd2,
+                 il* results) {
+    int iy, ix0, ix1, iy0, iy1, k;
+    int nres = 0;
+
+    if (!g->N || maxd2 < 0)
+        return 0;
+    cell_range(g, pt, sqrt(maxd2), &ix0, &ix1, &iy0, &iy1);
+    for (iy=iy0; iy<=iy1; iy++) {
+        const int* cs = g->cellstart + iy * g->nx;
+        // cells ix0..ix1 of a row are contiguous in "inds".
+        for (k=cs[ix0]; k<cs[ix1+1]; k++) {
+            int j = g->inds[k];
+            const double* p = g->xy + 2*j;
+            double dx = p[0] - pt[0];
+            double dy = p[1] - pt[1];
+            if (dx*dx + dy*dy <= maxd2) {
+                il_append(results, j);
+                nres++;
+            }
+        }
+    }
+    return nres;
+}